@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+/* getpwnam_r, getgrnam_r */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pwd.h>
+#include <grp.h>
+#include <pthread.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "accountcache.h"
+
+#ifndef GETPW_R_SIZE_MAX
+#define GETPW_R_SIZE_MAX 10000
+#endif
+
+#ifndef GETGR_R_SIZE_MAX
+#define GETGR_R_SIZE_MAX 10000
+#endif
+
+/* entry types, part of the key */
+#define ACCOUNT_USER   1
+#define ACCOUNT_GROUP  2
+
+typedef struct account_entry {
+    int type; /* 0 if the slot is empty */
+    char * name;
+    int rc; /* ACCOUNT_OK or ACCOUNT_NOTFOUND */
+    uid_t uid;
+    gid_t gid;
+    time_t expires;
+} account_entry_t;
+
+/* process wide cache, protected by the mutex */
+static pthread_mutex_t accounts_mutex= PTHREAD_MUTEX_INITIALIZER;
+static account_entry_t accounts[ACCOUNTCACHE_SIZE];
+static long accounts_ttl= 0;
+static long accounts_negative_ttl= 0;
+
+/* FNV-1a hash of the type and name */
+static size_t account_slot(int type, const char * name) {
+    unsigned long hash= 2166136261UL;
+    hash^= (unsigned long)type;
+    hash*= 16777619UL;
+    while (*name != '\0') {
+        hash^= (unsigned char)*name++;
+        hash*= 16777619UL;
+    }
+    return (size_t)(hash % ACCOUNTCACHE_SIZE);
+}
+
+/* empties the slot, accounts_mutex must be locked */
+static void account_clear(account_entry_t * entry) {
+    if (entry->name != NULL) free(entry->name);
+    memset(entry,0,sizeof(account_entry_t));
+}
+
+/* looks up a valid entry, returns -1 on miss */
+static int account_lookup(int type, const char * name, uid_t * uid, gid_t * gid) {
+    account_entry_t * entry;
+    int rc= -1;
+    pthread_mutex_lock(&accounts_mutex);
+    if (accounts_ttl > 0) {
+        entry= &accounts[account_slot(type,name)];
+        if (entry->type == type && strcmp(entry->name,name) == 0) {
+            if (entry->expires > time(NULL)) {
+                rc= entry->rc;
+                if (uid != NULL) *uid= entry->uid;
+                if (gid != NULL) *gid= entry->gid;
+            }
+            else {
+                account_clear(entry);
+            }
+        }
+    }
+    pthread_mutex_unlock(&accounts_mutex);
+    return rc;
+}
+
+/* stores a resolution, replacing the entry in the slot */
+static void account_store(int type, const char * name, int rc, uid_t uid, gid_t gid) {
+    account_entry_t * entry;
+    long ttl;
+    size_t name_l;
+    char * name_copy;
+    pthread_mutex_lock(&accounts_mutex);
+    ttl= (rc == ACCOUNT_OK) ? accounts_ttl : accounts_negative_ttl;
+    if (accounts_ttl <= 0 || ttl <= 0) {
+        pthread_mutex_unlock(&accounts_mutex);
+        return;
+    }
+    name_l= strlen(name);
+    name_copy= calloc(name_l + 1,sizeof(char));
+    if (name_copy == NULL) {
+        pthread_mutex_unlock(&accounts_mutex);
+        pep_log_warn("account_store: can't allocate name (%d bytes).",(int)name_l);
+        return;
+    }
+    strncpy(name_copy,name,name_l);
+    entry= &accounts[account_slot(type,name)];
+    account_clear(entry);
+    entry->type= type;
+    entry->name= name_copy;
+    entry->rc= rc;
+    entry->uid= uid;
+    entry->gid= gid;
+    entry->expires= time(NULL) + ttl;
+    pthread_mutex_unlock(&accounts_mutex);
+}
+
+void pep_accountcache_setttl(long ttl, long negative_ttl) {
+    pthread_mutex_lock(&accounts_mutex);
+    accounts_ttl= (ttl > 0) ? ttl : 0;
+    accounts_negative_ttl= (negative_ttl > 0) ? negative_ttl : 0;
+    pthread_mutex_unlock(&accounts_mutex);
+    if (ttl <= 0) pep_accountcache_flush();
+}
+
+void pep_accountcache_flush(void) {
+    int i;
+    pthread_mutex_lock(&accounts_mutex);
+    for (i= 0; i < ACCOUNTCACHE_SIZE; i++) {
+        if (accounts[i].type != 0) account_clear(&accounts[i]);
+    }
+    pthread_mutex_unlock(&accounts_mutex);
+}
+
+int pep_accountcache_getuser(const char * username, uid_t * uid, gid_t * gid) {
+    struct passwd pw;
+    struct passwd * result= NULL;
+    char buf[GETPW_R_SIZE_MAX];
+    int rc;
+    if (username == NULL || uid == NULL || gid == NULL) {
+        pep_log_warn("pep_accountcache_getuser: NULL username, uid or gid.");
+        return ACCOUNT_ERROR;
+    }
+    rc= account_lookup(ACCOUNT_USER,username,uid,gid);
+    if (rc != -1) {
+        pep_log_debug("pep_accountcache_getuser: %s found in cache",username);
+        return rc;
+    }
+    rc= getpwnam_r(username,&pw,buf,GETPW_R_SIZE_MAX,&result);
+    if (rc == 0 && result != NULL) {
+        *uid= pw.pw_uid;
+        *gid= pw.pw_gid;
+        account_store(ACCOUNT_USER,username,ACCOUNT_OK,pw.pw_uid,pw.pw_gid);
+        return ACCOUNT_OK;
+    }
+    else if (rc == 0) {
+        /* no such user */
+        account_store(ACCOUNT_USER,username,ACCOUNT_NOTFOUND,0,0);
+        return ACCOUNT_NOTFOUND;
+    }
+    else {
+        errno= rc;
+        return ACCOUNT_ERROR;
+    }
+}
+
+int pep_accountcache_getgroup(const char * groupname, gid_t * gid) {
+    struct group gr;
+    struct group * result= NULL;
+    char buf[GETGR_R_SIZE_MAX];
+    int rc;
+    if (groupname == NULL || gid == NULL) {
+        pep_log_warn("pep_accountcache_getgroup: NULL groupname or gid.");
+        return ACCOUNT_ERROR;
+    }
+    rc= account_lookup(ACCOUNT_GROUP,groupname,NULL,gid);
+    if (rc != -1) {
+        pep_log_debug("pep_accountcache_getgroup: %s found in cache",groupname);
+        return rc;
+    }
+    rc= getgrnam_r(groupname,&gr,buf,GETGR_R_SIZE_MAX,&result);
+    if (rc == 0 && result != NULL) {
+        *gid= gr.gr_gid;
+        account_store(ACCOUNT_GROUP,groupname,ACCOUNT_OK,0,gr.gr_gid);
+        return ACCOUNT_OK;
+    }
+    else if (rc == 0) {
+        /* no such group */
+        account_store(ACCOUNT_GROUP,groupname,ACCOUNT_NOTFOUND,0,0);
+        return ACCOUNT_NOTFOUND;
+    }
+    else {
+        errno= rc;
+        return ACCOUNT_ERROR;
+    }
+}
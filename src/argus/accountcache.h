@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_ACCOUNTCACHE_H_
+#define _PEP_ACCOUNTCACHE_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h> /* uid_t, gid_t */
+
+/** pep_accountcache_* return codes */
+#define ACCOUNT_OK         0
+#define ACCOUNT_NOTFOUND   1 /* no such user or group */
+#define ACCOUNT_ERROR     -1 /* resolution failed (NSS error, ...) */
+
+/** Number of slots of the account cache */
+#define ACCOUNTCACHE_SIZE 512
+
+/*
+ * Process wide cache of the POSIX account resolutions (getpwnam_r and
+ * getgrnam_r), shared by the obligation handlers. The cache is a bounded
+ * direct-mapped table protected by a mutex: a new entry replaces the one in
+ * its slot. The names not found are also cached (negative caching), the
+ * resolution errors are never cached. The cache is disabled by default.
+ */
+
+/**
+ * Sets the time-to-live of the cached resolutions. A ttl of 0 disables the
+ * cache and flushes it, a negative_ttl of 0 disables the negative caching.
+ *
+ * @param long ttl time-to-live in seconds of the resolved names.
+ * @param long negative_ttl time-to-live in seconds of the names not found.
+ */
+void pep_accountcache_setttl(long ttl, long negative_ttl);
+
+/**
+ * Resolves the POSIX uid and primary gid of the user, from the cache or with
+ * getpwnam_r.
+ *
+ * @return int ACCOUNT_OK, ACCOUNT_NOTFOUND or ACCOUNT_ERROR.
+ */
+int pep_accountcache_getuser(const char * username, uid_t * uid, gid_t * gid);
+
+/**
+ * Resolves the POSIX gid of the group, from the cache or with getgrnam_r.
+ *
+ * @return int ACCOUNT_OK, ACCOUNT_NOTFOUND or ACCOUNT_ERROR.
+ */
+int pep_accountcache_getgroup(const char * groupname, gid_t * gid);
+
+/**
+ * Removes all the cached resolutions.
+ */
+void pep_accountcache_flush(void);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
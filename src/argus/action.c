@@ -22,9 +22,12 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "attrindex.h"
 
 struct xacml_action {
     pep_linkedlist_t * attributes;
+    pep_attrindex_t * index; /* attributes by id, built on lookup */
 };
 
 xacml_action_t * xacml_action_create() {
@@ -51,11 +54,14 @@ int xacml_action_addattribute(xacml_action_t * action, xacml_attribute_t * attr)
         pep_log_error("xacml_action_addattribute: can't add attribute to list.");
         return PEP_XACML_ERROR;
     }
-    else return PEP_XACML_OK;
+    pep_attrindex_invalidate(&(action->index));
+    xacml_attribute_setindex(attr,&(action->index));
+    return PEP_XACML_OK;
 }
 
 void xacml_action_delete(xacml_action_t * action) {
     if (action == NULL) return;
+    pep_attrindex_invalidate(&(action->index));
     pep_llist_delete_elements(action->attributes,(pep_llist_delete_elt_f)xacml_attribute_delete);
     pep_llist_delete(action->attributes);
     free(action);
@@ -78,3 +84,40 @@ xacml_attribute_t * xacml_action_getattribute(const xacml_action_t * action, int
     return pep_llist_get(action->attributes, index);
 }
 
+xacml_attribute_t * xacml_action_findattribute(const xacml_action_t * action, const char * id) {
+    if (action == NULL || id == NULL) {
+        pep_log_error("xacml_action_findattribute: NULL action or id.");
+        return NULL;
+    }
+    /* the index is a cache, built on the first lookup */
+    return pep_attrindex_find(&(((xacml_action_t *)action)->index),action->attributes,id);
+}
+
+/**
+ * Clone the action and its attributes.
+ */
+xacml_action_t * xacml_action_clone(const xacml_action_t * action) {
+    xacml_action_t * clone;
+    size_t attrs_l;
+    int i;
+    if (action == NULL) {
+        pep_log_warn("xacml_action_clone: action is NULL.");
+        return NULL;
+    }
+    clone= xacml_action_create();
+    if (clone == NULL) {
+        pep_log_error("xacml_action_clone: can't create clone.");
+        return NULL;
+    }
+    attrs_l= pep_llist_length(action->attributes);
+    for (i= 0; i < attrs_l; i++) {
+        xacml_attribute_t * attr= xacml_attribute_clone(pep_llist_get(action->attributes,i));
+        if (attr == NULL || xacml_action_addattribute(clone,attr) != PEP_XACML_OK) {
+            pep_log_error("xacml_action_clone: can't clone attribute[%d].",i);
+            if (attr != NULL) xacml_attribute_delete(attr);
+            xacml_action_delete(clone);
+            return NULL;
+        }
+    }
+    return clone;
+}
@@ -23,14 +23,85 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "intern.h"
+#include "attrindex.h"
+
+/*
+ * refcounted values list, shared by the cloned attributes and copied
+ * before modification (copy-on-write)
+ */
+typedef struct xacml_values {
+    volatile int refcount;
+    pep_linkedlist_t * list; /* string list */
+} xacml_values_t;
 
 struct xacml_attribute {
     char * id; /* mandatory */
     char * datatype; /* optional */
     char * issuer; /* optional */
-    pep_linkedlist_t * values; /* string list */
+    xacml_values_t * values;
+    int id_interned; /* id from the intern pool */
+    int datatype_interned; /* datatype from the intern pool */
+    pep_attrindex_t ** index; /* index of the container, invalidated when the id changes */
 };
 
+static xacml_values_t * values_create(void) {
+    xacml_values_t * values= calloc(1,sizeof(xacml_values_t));
+    if (values == NULL) {
+        return NULL;
+    }
+    values->refcount= 1;
+    values->list= pep_llist_create();
+    if (values->list == NULL) {
+        free(values);
+        return NULL;
+    }
+    return values;
+}
+
+static xacml_values_t * values_retain(xacml_values_t * values) {
+    __sync_add_and_fetch(&(values->refcount),1);
+    return values;
+}
+
+static void values_release(xacml_values_t * values) {
+    if (values == NULL) return;
+    if (__sync_sub_and_fetch(&(values->refcount),1) == 0) {
+        pep_llist_delete_elements(values->list,(pep_llist_delete_elt_f)free);
+        pep_llist_delete(values->list);
+        free(values);
+    }
+}
+
+/* makes the values list exclusive to the attribute before a modification */
+static int values_own(xacml_attribute_t * attr) {
+    xacml_values_t * values;
+    size_t values_l, i;
+    if (attr->values->refcount == 1) return PEP_XACML_OK;
+    values= values_create();
+    if (values == NULL) {
+        pep_log_error("xacml_attribute: can't create values list.");
+        return PEP_XACML_ERROR;
+    }
+    values_l= pep_llist_length(attr->values->list);
+    for (i= 0; i<values_l; i++) {
+        const char * value= pep_llist_get(attr->values->list,i);
+        size_t size= strlen(value);
+        char * v= calloc(size + 1, sizeof(char));
+        if (v == NULL || pep_llist_add(values->list,v) != LLIST_OK) {
+            pep_log_error("xacml_attribute: can't copy value[%d] (%d bytes).",(int)i,(int)size);
+            if (v != NULL) free(v);
+            values_release(values);
+            return PEP_XACML_ERROR;
+        }
+        strncpy(v,value,size);
+    }
+    values_release(attr->values);
+    attr->values= values;
+    return PEP_XACML_OK;
+}
+
 /**
  * Creates a PEP attribute with the given id.
  */
@@ -43,20 +114,19 @@ xacml_attribute_t * xacml_attribute_create(const char * id) {
     attr->id= NULL;
     if (id != NULL) {
         size_t size= strlen(id);
-        attr->id= calloc(size + 1,sizeof(char));
+        attr->id= pep_intern_strdup(id,&(attr->id_interned));
         if (attr->id == NULL) {
             pep_log_error("xacml_attribute_create: can't allocate id (%d bytes).",(int)size);
             free(attr);
             return NULL;
         }
-        strncpy(attr->id,id,size);
     }
     attr->datatype= NULL;
     attr->issuer= NULL;
-    attr->values= pep_llist_create();
+    attr->values= values_create();
     if (attr->values == NULL) {
         pep_log_error("xacml_attribute_create: can't create values list.");
-        free(attr->id);
+        pep_intern_strfree(attr->id,attr->id_interned);
         free(attr);
         return NULL;
     }
@@ -64,47 +134,50 @@ xacml_attribute_t * xacml_attribute_create(const char * id) {
 }
 
 /**
- * Clone the attribute and return a copy
+ * Clone the attribute and return a copy. The clone shares the values of the
+ * attribute until one of them is modified.
  */
 xacml_attribute_t * xacml_attribute_clone(const xacml_attribute_t * attr) {
-    xacml_attribute_t * clone;
-    size_t nvalues;
-    int i;
     if (attr == NULL) {
         pep_log_warn("xacml_attribute_clone: attr is NULL.");
         return NULL;
     }
-    clone= xacml_attribute_create(attr->id);
-    if (clone == NULL) {
-        pep_log_error("xacml_attribute_clone: can't create clone with id: %s", attr->id);
+    return xacml_attribute_derive(attr,attr->id,attr->datatype);
+}
+
+/**
+ * Creates a copy of the attribute with a new id and datatype, sharing the
+ * values of the attribute.
+ */
+xacml_attribute_t * xacml_attribute_derive(const xacml_attribute_t * attr, const char * id, const char * datatype) {
+    xacml_attribute_t * derived;
+    if (attr == NULL) {
+        pep_log_warn("xacml_attribute_derive: attr is NULL.");
+        return NULL;
+    }
+    derived= xacml_attribute_create(id);
+    if (derived == NULL) {
+        pep_log_error("xacml_attribute_derive: can't create attribute with id: %s", id);
         return NULL;
     }
     /* datatype */
-    if (xacml_attribute_setdatatype(clone,attr->datatype) != PEP_XACML_OK) {
-        pep_log_error("xacml_attribute_clone: can't set datatype: %s",attr->datatype);
-        xacml_attribute_delete(clone);
+    if (xacml_attribute_setdatatype(derived,datatype) != PEP_XACML_OK) {
+        pep_log_error("xacml_attribute_derive: can't set datatype: %s",datatype);
+        xacml_attribute_delete(derived);
         return NULL;
     }
     /* issuer */
-    if (xacml_attribute_setissuer(clone,attr->issuer) != PEP_XACML_OK) {
-        pep_log_error("xacml_attribute_clone: can't set issuer: %s",attr->issuer);
-        xacml_attribute_delete(clone);
+    if (xacml_attribute_setissuer(derived,attr->issuer) != PEP_XACML_OK) {
+        pep_log_error("xacml_attribute_derive: can't set issuer: %s",attr->issuer);
+        xacml_attribute_delete(derived);
         return NULL;
     }
-    /* values */
-    nvalues= xacml_attribute_values_length(attr);
-    for(i= 0; i<nvalues; i++) {
-        const char * value= xacml_attribute_getvalue(attr,i);
-        if (xacml_attribute_addvalue(clone,value) != PEP_XACML_OK) {
-            pep_log_error("xacml_attribute_clone: can't clone value[%d]: %s",i,value);
-            xacml_attribute_delete(clone);
-            return NULL;
-        }
-    }
-    return clone;
+    /* shared values */
+    values_release(derived->values);
+    derived->values= values_retain(attr->values);
+    return derived;
 }
 
-
 /**
  * Sets the PEP attribute id. id is mandatory and can't be NULL.
  */
@@ -118,19 +191,26 @@ int xacml_attribute_setid(xacml_attribute_t * attr, const char * id) {
         pep_log_error("xacml_attribute_setid: NULL id.");
         return PEP_XACML_ERROR;
     }
+    if (attr->index != NULL) {
+        pep_attrindex_invalidate(attr->index);
+    }
     if (attr->id != NULL) {
-        free(attr->id);
+        pep_intern_strfree(attr->id,attr->id_interned);
     }
     size= strlen(id);
-    attr->id= calloc(size + 1,sizeof(char));
+    attr->id= pep_intern_strdup(id,&(attr->id_interned));
     if (attr->id == NULL) {
         pep_log_error("xacml_attribute_setid: can't allocate id (%d bytes).", (int)size);
         return PEP_XACML_ERROR;
     }
-    strncpy(attr->id,id,size);
     return PEP_XACML_OK;
 }
 
+void xacml_attribute_setindex(xacml_attribute_t * attr, struct pep_attrindex ** index) {
+    if (attr == NULL) return;
+    attr->index= index;
+}
+
 const char * xacml_attribute_getid(const xacml_attribute_t * attr) {
     if (attr == NULL) {
         pep_log_error("xacml_attribute_getid: NULL attribute.");
@@ -148,17 +228,16 @@ int xacml_attribute_setdatatype(xacml_attribute_t * attr, const char * datatype)
         return PEP_XACML_ERROR;
     }
     if (attr->datatype != NULL) {
-        free(attr->datatype);
+        pep_intern_strfree(attr->datatype,attr->datatype_interned);
     }
     attr->datatype= NULL;
     if (datatype != NULL) {
         size_t size= strlen(datatype);
-        attr->datatype= calloc(size + 1,sizeof(char));
+        attr->datatype= pep_intern_strdup(datatype,&(attr->datatype_interned));
         if (attr->datatype == NULL) {
             pep_log_error("xacml_attribute_setdatatype: can't allocate datatype (%d bytes).", (int)size);
             return PEP_XACML_ERROR;
         }
-        strncpy(attr->datatype,datatype,size);
     }
     return PEP_XACML_OK;
 }
@@ -215,6 +294,10 @@ int xacml_attribute_addvalue(xacml_attribute_t * attr, const char *value) {
         pep_log_error("xacml_attribute_addvalue: NULL attribute or value.");
         return PEP_XACML_ERROR;
     }
+    if (values_own(attr) != PEP_XACML_OK) {
+        pep_log_error("xacml_attribute_addvalue: can't copy the shared values.");
+        return PEP_XACML_ERROR;
+    }
     /* copy the const value */
     size= strlen(value);
 /*
@@ -229,7 +312,7 @@ int xacml_attribute_addvalue(xacml_attribute_t * attr, const char *value) {
         return PEP_XACML_ERROR;
     }
     strncpy(v,value,size);
-    if (pep_llist_add(attr->values,v) != LLIST_OK) {
+    if (pep_llist_add(attr->values->list,v) != LLIST_OK) {
         pep_log_error("xacml_attribute_addvalue: can't add value to list.");
         return PEP_XACML_ERROR;
     }
@@ -241,7 +324,7 @@ size_t xacml_attribute_values_length(const xacml_attribute_t * attr) {
         pep_log_warn("xacml_attribute_values_length: NULL attribute.");
         return 0;
     }
-    return pep_llist_length(attr->values);
+    return pep_llist_length(attr->values->list);
 }
 
 const char * xacml_attribute_getvalue(const xacml_attribute_t * attr,int index) {
@@ -249,7 +332,7 @@ const char * xacml_attribute_getvalue(const xacml_attribute_t * attr,int index)
         pep_log_error("xacml_attribute_getvalue: NULL attribute.");
         return NULL;
     }
-    return pep_llist_get(attr->values,index);
+    return pep_llist_get(attr->values->list,index);
 }
 
 /**
@@ -257,11 +340,10 @@ const char * xacml_attribute_getvalue(const xacml_attribute_t * attr,int index)
  */
 void xacml_attribute_delete(xacml_attribute_t * attr) {
     if (attr == NULL) return;
-    if (attr->id != NULL) free(attr->id);
-    if (attr->datatype != NULL) free(attr->datatype);
+    if (attr->id != NULL) pep_intern_strfree(attr->id,attr->id_interned);
+    if (attr->datatype != NULL) pep_intern_strfree(attr->datatype,attr->datatype_interned);
     if (attr->issuer != NULL) free(attr->issuer);
-    pep_llist_delete_elements(attr->values,(pep_llist_delete_elt_f)free);
-    pep_llist_delete(attr->values);
+    values_release(attr->values);
     free(attr);
     attr= NULL;
 }
@@ -22,11 +22,14 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "intern.h"
 
 struct xacml_attributeassignment {
     char * id; /* mandatory */
     char * datatype;
     char * value;
+    int id_interned; /* id from the intern pool */
+    int datatype_interned; /* datatype from the intern pool */
 };
 
 /**
@@ -41,13 +44,12 @@ xacml_attributeassignment_t * xacml_attributeassignment_create(const char * id)
     attr->id= NULL;
     if (id != NULL) {
         size_t size= strlen(id);
-        attr->id= calloc(size + 1,sizeof(char));
+        attr->id= pep_intern_strdup(id,&(attr->id_interned));
         if (attr->id == NULL) {
             pep_log_error("xacml_attributeassignment_create: can't allocate id (%d bytes).",(int)size);
             free(attr);
             return NULL;
         }
-        strncpy(attr->id,id,size);
     }
     return attr;
 }
@@ -66,15 +68,14 @@ int xacml_attributeassignment_setid(xacml_attributeassignment_t * attr, const ch
         return PEP_XACML_ERROR;
     }
     if (attr->id != NULL) {
-        free(attr->id);
+        pep_intern_strfree(attr->id,attr->id_interned);
     }
     size= strlen(id);
-    attr->id= calloc(size + 1,sizeof(char));
+    attr->id= pep_intern_strdup(id,&(attr->id_interned));
     if (attr->id == NULL) {
         pep_log_error("xacml_attributeassignment_setid: can't allocate id (%d bytes).", (int)size);
         return PEP_XACML_ERROR;
     }
-    strncpy(attr->id,id,size);
     return PEP_XACML_OK;
 }
 
@@ -99,18 +100,17 @@ int xacml_attributeassignment_setdatatype(xacml_attributeassignment_t * attr, co
     }
 
     if (attr->datatype != NULL) {
-        free(attr->datatype);
+        pep_intern_strfree(attr->datatype,attr->datatype_interned);
     }
 
     attr->datatype= NULL;
     if (datatype!=NULL) {
         size_t size= strlen(datatype);
-        attr->datatype= calloc(size + 1,sizeof(char));
+        attr->datatype= pep_intern_strdup(datatype,&(attr->datatype_interned));
         if (attr->datatype == NULL) {
             pep_log_error("xacml_attributeassignment_setdatatype: can't allocate datatype (%d bytes).", (int)size);
             return PEP_XACML_ERROR;
         }
-        strncpy(attr->datatype,datatype,size);
     }
     return PEP_XACML_OK;
 }
@@ -194,8 +194,8 @@ const char * xacml_attributeassignment_getvalue(const xacml_attributeassignment_
  */
 void xacml_attributeassignment_delete(xacml_attributeassignment_t * attr) {
     if (attr == NULL) return;
-    if (attr->id != NULL) free(attr->id);
-    if (attr->datatype != NULL) free(attr->datatype);
+    if (attr->id != NULL) pep_intern_strfree(attr->id,attr->id_interned);
+    if (attr->datatype != NULL) pep_intern_strfree(attr->datatype,attr->datatype_interned);
     if (attr->value != NULL) free(attr->value);
     free(attr);
     attr= NULL;
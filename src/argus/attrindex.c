@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "attrindex.h"
+
+/*
+ * Open addressing hash table of the attributes, keyed by id. Only the first
+ * attribute with a given id is indexed.
+ */
+struct pep_attrindex {
+    xacml_attribute_t ** attrs; /* NULL if the slot is empty */
+    unsigned long * hashes;
+    size_t slots_mask;
+};
+
+/* FNV-1a hash of the id */
+static unsigned long attrindex_hash(const char * id) {
+    unsigned long hash= 2166136261UL;
+    while (*id != '\0') {
+        hash^= (unsigned char)*id++;
+        hash*= 16777619UL;
+    }
+    return hash;
+}
+
+/* returns the slot of the id, either empty or holding the id */
+static size_t attrindex_slot(const pep_attrindex_t * index, const char * id, unsigned long hash) {
+    size_t slot= hash & index->slots_mask;
+    while (index->attrs[slot] != NULL) {
+        if (index->hashes[slot] == hash) {
+            const char * attr_id= xacml_attribute_getid(index->attrs[slot]);
+            /* ids are interned, compare the pointers first */
+            if (attr_id == id || strcmp(attr_id,id) == 0) break;
+        }
+        slot= (slot + 1) & index->slots_mask;
+    }
+    return slot;
+}
+
+static void attrindex_delete(pep_attrindex_t * index) {
+    if (index == NULL) return;
+    if (index->attrs != NULL) free(index->attrs);
+    if (index->hashes != NULL) free(index->hashes);
+    free(index);
+}
+
+/* pep_llist_foreach function: indexes the attribute */
+static int attrindex_add(void * element, void * arg) {
+    pep_attrindex_t * index= arg;
+    xacml_attribute_t * attr= element;
+    const char * id= xacml_attribute_getid(attr);
+    unsigned long hash;
+    size_t slot;
+    if (id == NULL) return 0;
+    hash= attrindex_hash(id);
+    slot= attrindex_slot(index,id,hash);
+    if (index->attrs[slot] == NULL) {
+        index->attrs[slot]= attr;
+        index->hashes[slot]= hash;
+    }
+    return 0;
+}
+
+static pep_attrindex_t * attrindex_build(const pep_linkedlist_t * attributes) {
+    pep_attrindex_t * index;
+    size_t attrs_l= pep_llist_length(attributes);
+    size_t slots_l= 8;
+    /* load factor <= 0.5 */
+    while (slots_l < 2 * attrs_l) slots_l*= 2;
+    index= calloc(1,sizeof(pep_attrindex_t));
+    if (index == NULL) {
+        pep_log_error("attrindex_build: can't allocate pep_attrindex_t.");
+        return NULL;
+    }
+    index->slots_mask= slots_l - 1;
+    index->attrs= calloc(slots_l,sizeof(xacml_attribute_t *));
+    index->hashes= calloc(slots_l,sizeof(unsigned long));
+    if (index->attrs == NULL || index->hashes == NULL) {
+        pep_log_error("attrindex_build: can't allocate hash table (%d slots).",(int)slots_l);
+        attrindex_delete(index);
+        return NULL;
+    }
+    pep_llist_foreach(attributes,attrindex_add,index);
+    return index;
+}
+
+/* linear search state */
+typedef struct attrindex_match {
+    const char * id;
+    xacml_attribute_t * attr;
+} attrindex_match_t;
+
+/* pep_llist_foreach function: finds the attribute without index */
+static int attrindex_match(void * element, void * arg) {
+    attrindex_match_t * match= arg;
+    const char * attr_id= xacml_attribute_getid(element);
+    if (attr_id != NULL && (attr_id == match->id || strcmp(attr_id,match->id) == 0)) {
+        match->attr= element;
+        return 1;
+    }
+    return 0;
+}
+
+xacml_attribute_t * pep_attrindex_find(pep_attrindex_t ** index, const pep_linkedlist_t * attributes, const char * id) {
+    pep_attrindex_t * current;
+    size_t slot;
+    if (index == NULL || attributes == NULL || id == NULL) {
+        pep_log_error("pep_attrindex_find: NULL index, attributes or id.");
+        return NULL;
+    }
+    current= *index;
+    /* pairs with the compare and swap publishing the index */
+    __sync_synchronize();
+    if (current == NULL) {
+        pep_attrindex_t * built= attrindex_build(attributes);
+        if (built == NULL) {
+            /* no index, linear search */
+            attrindex_match_t match= { id, NULL };
+            pep_llist_foreach(attributes,attrindex_match,&match);
+            return match.attr;
+        }
+        /* publish, or use the index built concurrently */
+        if (__sync_bool_compare_and_swap(index,NULL,built)) {
+            current= built;
+        }
+        else {
+            attrindex_delete(built);
+            current= *index;
+        }
+    }
+    slot= attrindex_slot(current,id,attrindex_hash(id));
+    return current->attrs[slot];
+}
+
+void pep_attrindex_invalidate(pep_attrindex_t ** index) {
+    if (index == NULL || *index == NULL) return;
+    attrindex_delete(*index);
+    *index= NULL;
+}
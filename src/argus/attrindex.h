@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_ATTRINDEX_H_
+#define _PEP_ATTRINDEX_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/* from ../util */
+#include "linkedlist.h"
+
+#include "xacml.h"
+
+/*
+ * Hash index of the Attributes of a Subject, Resource, Action or Environment
+ * by Attribute id. The index is built on the first lookup and published
+ * atomically, concurrent lookups on an unmodified container are safe. The
+ * container invalidates its index when an Attribute is added, and the
+ * Attribute when its id changes (see xacml_attribute_setindex).
+ */
+typedef struct pep_attrindex pep_attrindex_t;
+
+/**
+ * Looks up the first Attribute with the id, building the index of the
+ * attributes list if needed.
+ *
+ * @param pep_attrindex_t ** index the index of the container, NULL if not built.
+ * @param pep_linkedlist_t * attributes the Attributes list of the container.
+ * @return xacml_attribute_t * the Attribute or NULL if not found.
+ */
+xacml_attribute_t * pep_attrindex_find(pep_attrindex_t ** index, const pep_linkedlist_t * attributes, const char * id);
+
+/**
+ * Deletes the index, the next lookup rebuilds it.
+ */
+void pep_attrindex_invalidate(pep_attrindex_t ** index);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
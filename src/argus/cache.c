@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* from ../util */
+#include "linkedlist.h"
+#include "buffer.h"
+#include "log.h"
+
+#include "cache.h"
+#include "i_xacml.h"
+
+/* number of xacml_decision_t values */
+#define CACHE_DECISIONS 4
+
+/* cache entry: key and value bytes, chained in hash bucket and in LRU list */
+typedef struct pep_cache_entry {
+    unsigned long hash;
+    unsigned char * key;
+    size_t key_l;
+    unsigned char * value;
+    size_t value_l;
+    char * subjectid;
+    time_t expires;
+    struct pep_cache_entry * next; /* bucket chain */
+    struct pep_cache_entry * lru_prev; /* more recently used */
+    struct pep_cache_entry * lru_next; /* less recently used */
+} pep_cache_entry_t;
+
+/* obligation TTL override */
+typedef struct pep_cache_obligationttl {
+    char * obligationid;
+    long ttl;
+} pep_cache_obligationttl_t;
+
+struct pep_cache {
+    pep_cache_entry_t ** buckets;
+    size_t buckets_l; /* power of 2 */
+    size_t entries_l;
+    size_t max_entries;
+    pep_cache_entry_t * lru_head; /* most recently used */
+    pep_cache_entry_t * lru_tail; /* least recently used */
+    long ttl;
+    int decision_cacheable[CACHE_DECISIONS];
+    pep_linkedlist_t * obligation_ttls; /* pep_cache_obligationttl_t list */
+};
+
+/* FNV-1a hash of the key bytes */
+static unsigned long cache_hash(const unsigned char * key, size_t key_l) {
+    unsigned long hash= 2166136261UL;
+    size_t i;
+    for (i= 0; i < key_l; i++) {
+        hash ^= key[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static void cache_entry_delete(pep_cache_entry_t * entry) {
+    if (entry == NULL) return;
+    if (entry->key != NULL) free(entry->key);
+    if (entry->value != NULL) free(entry->value);
+    if (entry->subjectid != NULL) free(entry->subjectid);
+    free(entry);
+}
+
+/* unlinks the entry from its bucket and from the LRU list, and deletes it */
+static void cache_entry_remove(pep_cache_t * cache, pep_cache_entry_t * entry) {
+    pep_cache_entry_t ** link= &(cache->buckets[entry->hash & (cache->buckets_l - 1)]);
+    while (*link != NULL && *link != entry) {
+        link= &((*link)->next);
+    }
+    if (*link == entry) {
+        *link= entry->next;
+    }
+    if (entry->lru_prev != NULL) entry->lru_prev->lru_next= entry->lru_next;
+    else cache->lru_head= entry->lru_next;
+    if (entry->lru_next != NULL) entry->lru_next->lru_prev= entry->lru_prev;
+    else cache->lru_tail= entry->lru_prev;
+    cache->entries_l--;
+    cache_entry_delete(entry);
+}
+
+/* moves the entry at the head of the LRU list */
+static void cache_entry_touch(pep_cache_t * cache, pep_cache_entry_t * entry) {
+    if (cache->lru_head == entry) return;
+    /* unlink */
+    if (entry->lru_prev != NULL) entry->lru_prev->lru_next= entry->lru_next;
+    if (entry->lru_next != NULL) entry->lru_next->lru_prev= entry->lru_prev;
+    else cache->lru_tail= entry->lru_prev;
+    /* link as head */
+    entry->lru_prev= NULL;
+    entry->lru_next= cache->lru_head;
+    if (cache->lru_head != NULL) cache->lru_head->lru_prev= entry;
+    cache->lru_head= entry;
+    if (cache->lru_tail == NULL) cache->lru_tail= entry;
+}
+
+static pep_cache_entry_t * cache_entry_lookup(const pep_cache_t * cache, unsigned long hash, const unsigned char * key, size_t key_l) {
+    pep_cache_entry_t * entry= cache->buckets[hash & (cache->buckets_l - 1)];
+    while (entry != NULL) {
+        if (entry->hash == hash && entry->key_l == key_l && memcmp(entry->key,key,key_l) == 0) {
+            return entry;
+        }
+        entry= entry->next;
+    }
+    return NULL;
+}
+
+pep_cache_t * pep_cache_create(size_t max_entries, long ttl) {
+    pep_cache_t * cache= NULL;
+    if (max_entries < 1) {
+        max_entries= CACHE_DEFAULT_SIZE;
+    }
+    cache= calloc(1,sizeof(struct pep_cache));
+    if (cache == NULL) {
+        pep_log_error("pep_cache_create: can't allocate pep_cache_t.");
+        return NULL;
+    }
+    /* load factor <= 1 */
+    cache->buckets_l= 16;
+    while (cache->buckets_l < max_entries) {
+        cache->buckets_l <<= 1;
+    }
+    cache->buckets= calloc(cache->buckets_l,sizeof(pep_cache_entry_t *));
+    if (cache->buckets == NULL) {
+        pep_log_error("pep_cache_create: can't allocate %d buckets.",(int)cache->buckets_l);
+        free(cache);
+        return NULL;
+    }
+    cache->obligation_ttls= pep_llist_create();
+    if (cache->obligation_ttls == NULL) {
+        pep_log_error("pep_cache_create: can't create obligation TTLs list.");
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+    cache->max_entries= max_entries;
+    cache->entries_l= 0;
+    cache->lru_head= NULL;
+    cache->lru_tail= NULL;
+    cache->ttl= ttl;
+    cache->decision_cacheable[XACML_DECISION_DENY]= TRUE;
+    cache->decision_cacheable[XACML_DECISION_PERMIT]= TRUE;
+    cache->decision_cacheable[XACML_DECISION_INDETERMINATE]= FALSE;
+    cache->decision_cacheable[XACML_DECISION_NOT_APPLICABLE]= FALSE;
+    return cache;
+}
+
+void pep_cache_delete(pep_cache_t * cache) {
+    if (cache == NULL) return;
+    pep_cache_removesubject(cache,NULL);
+    free(cache->buckets);
+    while (pep_llist_length(cache->obligation_ttls) > 0) {
+        pep_cache_obligationttl_t * obligation_ttl= pep_llist_remove(cache->obligation_ttls,0);
+        if (obligation_ttl != NULL) {
+            free(obligation_ttl->obligationid);
+            free(obligation_ttl);
+        }
+    }
+    pep_llist_delete(cache->obligation_ttls);
+    free(cache);
+}
+
+int pep_cache_setsize(pep_cache_t * cache, size_t max_entries) {
+    pep_cache_entry_t ** buckets= NULL;
+    pep_cache_entry_t * entry= NULL;
+    size_t buckets_l= 16;
+    if (cache == NULL) {
+        pep_log_error("pep_cache_setsize: NULL cache.");
+        return CACHE_ERROR;
+    }
+    if (max_entries < 1) {
+        max_entries= CACHE_DEFAULT_SIZE;
+    }
+    while (buckets_l < max_entries) {
+        buckets_l <<= 1;
+    }
+    buckets= calloc(buckets_l,sizeof(pep_cache_entry_t *));
+    if (buckets == NULL) {
+        pep_log_error("pep_cache_setsize: can't allocate %d buckets.",(int)buckets_l);
+        return CACHE_ERROR;
+    }
+    /* evict least recently used */
+    cache->max_entries= max_entries;
+    while (cache->entries_l > cache->max_entries && cache->lru_tail != NULL) {
+        cache_entry_remove(cache,cache->lru_tail);
+    }
+    /* rehash */
+    for (entry= cache->lru_head; entry != NULL; entry= entry->lru_next) {
+        size_t bucket= entry->hash & (buckets_l - 1);
+        entry->next= buckets[bucket];
+        buckets[bucket]= entry;
+    }
+    free(cache->buckets);
+    cache->buckets= buckets;
+    cache->buckets_l= buckets_l;
+    return CACHE_OK;
+}
+
+int pep_cache_setttl(pep_cache_t * cache, long ttl) {
+    if (cache == NULL) {
+        pep_log_error("pep_cache_setttl: NULL cache.");
+        return CACHE_ERROR;
+    }
+    cache->ttl= ttl;
+    return CACHE_OK;
+}
+
+int pep_cache_setobligationttl(pep_cache_t * cache, const char * obligationid, long ttl) {
+    pep_cache_obligationttl_t * obligation_ttl= NULL;
+    size_t size, i, obligation_ttls_l;
+    if (cache == NULL || obligationid == NULL) {
+        pep_log_error("pep_cache_setobligationttl: NULL cache or obligation id.");
+        return CACHE_ERROR;
+    }
+    /* replace existing override */
+    obligation_ttls_l= pep_llist_length(cache->obligation_ttls);
+    for (i= 0; i < obligation_ttls_l; i++) {
+        obligation_ttl= pep_llist_get(cache->obligation_ttls,i);
+        if (obligation_ttl != NULL && strcmp(obligationid,obligation_ttl->obligationid) == 0) {
+            obligation_ttl->ttl= ttl;
+            return CACHE_OK;
+        }
+    }
+    obligation_ttl= calloc(1,sizeof(pep_cache_obligationttl_t));
+    if (obligation_ttl == NULL) {
+        pep_log_error("pep_cache_setobligationttl: can't allocate pep_cache_obligationttl_t.");
+        return CACHE_ERROR;
+    }
+    size= strlen(obligationid);
+    obligation_ttl->obligationid= calloc(size + 1,sizeof(char));
+    if (obligation_ttl->obligationid == NULL) {
+        pep_log_error("pep_cache_setobligationttl: can't allocate obligation id (%d bytes).",(int)size);
+        free(obligation_ttl);
+        return CACHE_ERROR;
+    }
+    strncpy(obligation_ttl->obligationid,obligationid,size);
+    obligation_ttl->ttl= ttl;
+    if (pep_llist_add(cache->obligation_ttls,obligation_ttl) != LLIST_OK) {
+        pep_log_error("pep_cache_setobligationttl: can't add obligation TTL to list.");
+        free(obligation_ttl->obligationid);
+        free(obligation_ttl);
+        return CACHE_ERROR;
+    }
+    return CACHE_OK;
+}
+
+int pep_cache_setdecisioncacheable(pep_cache_t * cache, xacml_decision_t decision, int cacheable) {
+    if (cache == NULL) {
+        pep_log_error("pep_cache_setdecisioncacheable: NULL cache.");
+        return CACHE_ERROR;
+    }
+    if (decision < XACML_DECISION_DENY || decision > XACML_DECISION_NOT_APPLICABLE) {
+        pep_log_error("pep_cache_setdecisioncacheable: invalid decision: %d.",(int)decision);
+        return CACHE_ERROR;
+    }
+    cache->decision_cacheable[decision]= cacheable ? TRUE : FALSE;
+    return CACHE_OK;
+}
+
+int pep_cache_isdecisioncacheable(const pep_cache_t * cache, xacml_decision_t decision) {
+    if (cache == NULL) return 0;
+    if (decision < XACML_DECISION_DENY || decision > XACML_DECISION_NOT_APPLICABLE || !cache->decision_cacheable[decision]) {
+        pep_log_debug("pep_cache_isdecisioncacheable: decision %d not cacheable.",(int)decision);
+        return 0;
+    }
+    return 1;
+}
+
+long pep_cache_getobligationttl(const pep_cache_t * cache, const char * obligationid, long ttl) {
+    size_t obligation_ttls_l, k;
+    if (cache == NULL || obligationid == NULL) return ttl;
+    obligation_ttls_l= pep_llist_length(cache->obligation_ttls);
+    for (k= 0; k < obligation_ttls_l; k++) {
+        pep_cache_obligationttl_t * obligation_ttl= pep_llist_get(cache->obligation_ttls,k);
+        if (obligation_ttl != NULL && obligation_ttl->ttl < ttl && strcmp(obligationid,obligation_ttl->obligationid) == 0) {
+            pep_log_debug("pep_cache_getobligationttl: obligation %s TTL: %ld.",obligationid,obligation_ttl->ttl);
+            ttl= obligation_ttl->ttl;
+        }
+    }
+    return ttl;
+}
+
+long pep_cache_getresponsettl(const pep_cache_t * cache, const xacml_response_t * response) {
+    size_t results_l, obligations_l, i, j;
+    long ttl;
+    if (cache == NULL || response == NULL) {
+        return 0;
+    }
+    ttl= cache->ttl;
+    results_l= xacml_response_results_length(response);
+    if (results_l < 1) {
+        return 0;
+    }
+    for (i= 0; i < results_l && ttl > 0; i++) {
+        xacml_result_t * result= xacml_response_getresult(response,i);
+        if (!pep_cache_isdecisioncacheable(cache,xacml_result_getdecision(result))) {
+            return 0;
+        }
+        if (pep_llist_length(cache->obligation_ttls) < 1) continue;
+        obligations_l= xacml_result_obligations_length(result);
+        for (j= 0; j < obligations_l; j++) {
+            ttl= pep_cache_getobligationttl(cache,xacml_obligation_getid(xacml_result_getobligation(result,j)),ttl);
+        }
+    }
+    return (ttl > 0) ? ttl : 0;
+}
+
+long pep_cache_getttl(const pep_cache_t * cache) {
+    return (cache != NULL) ? cache->ttl : 0;
+}
+
+int pep_cache_get(pep_cache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value) {
+    pep_cache_entry_t * entry= NULL;
+    if (cache == NULL || key == NULL || value == NULL) {
+        pep_log_error("pep_cache_get: NULL cache, key or value buffer.");
+        return CACHE_ERROR;
+    }
+    entry= cache_entry_lookup(cache,cache_hash(key,key_l),key,key_l);
+    if (entry == NULL) {
+        return CACHE_MISS;
+    }
+    if (entry->expires <= time(NULL)) {
+        pep_log_debug("pep_cache_get: entry expired.");
+        cache_entry_remove(cache,entry);
+        return CACHE_MISS;
+    }
+    if (pep_buffer_write(entry->value,sizeof(unsigned char),entry->value_l,value) != entry->value_l) {
+        pep_log_error("pep_cache_get: can't write %d bytes into value buffer.",(int)entry->value_l);
+        return CACHE_ERROR;
+    }
+    cache_entry_touch(cache,entry);
+    return CACHE_OK;
+}
+
+int pep_cache_put(pep_cache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value, const char * subjectid, long ttl) {
+    pep_cache_entry_t * entry= NULL;
+    unsigned long hash;
+    size_t bucket, value_l;
+    if (cache == NULL || key == NULL || value == NULL) {
+        pep_log_error("pep_cache_put: NULL cache, key or value buffer.");
+        return CACHE_ERROR;
+    }
+    pep_buffer_rewind(value);
+    value_l= pep_buffer_length(value);
+    hash= cache_hash(key,key_l);
+    /* replace existing entry */
+    entry= cache_entry_lookup(cache,hash,key,key_l);
+    if (entry != NULL) {
+        cache_entry_remove(cache,entry);
+    }
+    /* evict least recently used */
+    while (cache->entries_l >= cache->max_entries && cache->lru_tail != NULL) {
+        cache_entry_remove(cache,cache->lru_tail);
+    }
+    entry= calloc(1,sizeof(pep_cache_entry_t));
+    if (entry == NULL) {
+        pep_log_error("pep_cache_put: can't allocate pep_cache_entry_t.");
+        return CACHE_ERROR;
+    }
+    entry->key= calloc(key_l + 1,sizeof(unsigned char));
+    entry->value= calloc(value_l + 1,sizeof(unsigned char));
+    if (entry->key == NULL || entry->value == NULL) {
+        pep_log_error("pep_cache_put: can't allocate key (%d bytes) or value (%d bytes).",(int)key_l,(int)value_l);
+        cache_entry_delete(entry);
+        return CACHE_ERROR;
+    }
+    memcpy(entry->key,key,key_l);
+    entry->key_l= key_l;
+    if (pep_buffer_read(entry->value,sizeof(unsigned char),value_l,value) != value_l) {
+        pep_log_error("pep_cache_put: can't read %d bytes from value buffer.",(int)value_l);
+        cache_entry_delete(entry);
+        return CACHE_ERROR;
+    }
+    entry->value_l= value_l;
+    if (subjectid != NULL) {
+        size_t size= strlen(subjectid);
+        entry->subjectid= calloc(size + 1,sizeof(char));
+        if (entry->subjectid == NULL) {
+            pep_log_error("pep_cache_put: can't allocate subject id (%d bytes).",(int)size);
+            cache_entry_delete(entry);
+            return CACHE_ERROR;
+        }
+        strncpy(entry->subjectid,subjectid,size);
+    }
+    entry->hash= hash;
+    entry->expires= time(NULL) + (time_t)ttl;
+    /* link in bucket and as LRU head */
+    bucket= hash & (cache->buckets_l - 1);
+    entry->next= cache->buckets[bucket];
+    cache->buckets[bucket]= entry;
+    entry->lru_prev= NULL;
+    entry->lru_next= cache->lru_head;
+    if (cache->lru_head != NULL) cache->lru_head->lru_prev= entry;
+    cache->lru_head= entry;
+    if (cache->lru_tail == NULL) cache->lru_tail= entry;
+    cache->entries_l++;
+    return CACHE_OK;
+}
+
+size_t pep_cache_removesubject(pep_cache_t * cache, const char * subjectid) {
+    pep_cache_entry_t * entry= NULL;
+    size_t removed= 0;
+    if (cache == NULL) return 0;
+    entry= cache->lru_head;
+    while (entry != NULL) {
+        pep_cache_entry_t * next= entry->lru_next;
+        if (subjectid == NULL || (entry->subjectid != NULL && strcmp(subjectid,entry->subjectid) == 0)) {
+            cache_entry_remove(cache,entry);
+            removed++;
+        }
+        entry= next;
+    }
+    return removed;
+}
+
+const char * pep_cache_getsubjectid(const xacml_request_t * request) {
+    size_t subjects_l, i;
+    subjects_l= xacml_request_subjects_length(request);
+    for (i= 0; i < subjects_l; i++) {
+        const xacml_subject_t * subject= xacml_request_peeksubject(request,i);
+        xacml_attribute_t * attr= xacml_subject_findattribute(subject,XACML_SUBJECT_ID);
+        if (attr != NULL && xacml_attribute_values_length(attr) > 0) {
+            return xacml_attribute_getvalue(attr,0);
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_CACHE_H_
+#define _PEP_CACHE_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+#include <time.h> /* time_t */
+
+#include "xacml.h"
+#include "buffer.h" /* ../util/buffer.h */
+
+/** Return codes */
+#define CACHE_OK     0
+#define CACHE_ERROR -1
+#define CACHE_MISS   1
+
+/** Default maximum number of entries in the cache */
+#define CACHE_DEFAULT_SIZE 1024
+
+/**
+ * ADT decision cache type.
+ *
+ * The cache maps the canonical digest of a request (see xacml_request_digest)
+ * to the serialized Hessian bytes of the PEPd response. The cache is not thread
+ * safe, it is owned by a PEP handle.
+ */
+typedef struct pep_cache pep_cache_t;
+
+/**
+ * Creates a decision cache able to store max_entries entries.
+ *
+ * Responses are cached for ttl seconds, PERMIT and DENY decisions are
+ * cacheable, INDETERMINATE and NOT_APPLICABLE decisions are not.
+ *
+ * @param size_t max_entries maximum number of entries (LRU eviction).
+ * @param long ttl the default time-to-live of an entry in seconds.
+ *
+ * @return pep_cache_t * the new cache or NULL on error.
+ */
+pep_cache_t * pep_cache_create(size_t max_entries, long ttl);
+
+/**
+ * Deletes the cache and all its entries and policies.
+ */
+void pep_cache_delete(pep_cache_t * cache);
+
+/**
+ * Sets the maximum number of entries of the cache. The least recently used
+ * entries are evicted if the cache contains more entries.
+ *
+ * @return int CACHE_OK or CACHE_ERROR.
+ */
+int pep_cache_setsize(pep_cache_t * cache, size_t max_entries);
+
+/**
+ * Sets the default time-to-live in seconds of the cached responses.
+ *
+ * @return int CACHE_OK or CACHE_ERROR.
+ */
+int pep_cache_setttl(pep_cache_t * cache, long ttl);
+
+/**
+ * Sets the time-to-live in seconds of the responses containing the obligation
+ * obligationid. A ttl of 0 means that responses containing this obligation are
+ * never cached. The smallest ttl of all the obligations of a response is used.
+ *
+ * @return int CACHE_OK or CACHE_ERROR.
+ */
+int pep_cache_setobligationttl(pep_cache_t * cache, const char * obligationid, long ttl);
+
+/**
+ * Sets whether the responses with the given decision are cacheable or not.
+ *
+ * @return int CACHE_OK or CACHE_ERROR.
+ */
+int pep_cache_setdecisioncacheable(pep_cache_t * cache, xacml_decision_t decision, int cacheable);
+
+/**
+ * Returns the default time-to-live in seconds of the cached responses.
+ */
+long pep_cache_getttl(const pep_cache_t * cache);
+
+/**
+ * Returns 1 if the responses with this decision can be cached, 0 otherwise.
+ */
+int pep_cache_isdecisioncacheable(const pep_cache_t * cache, xacml_decision_t decision);
+
+/**
+ * Returns the TTL override of the obligation if it is lower than ttl,
+ * otherwise returns ttl unchanged.
+ */
+long pep_cache_getobligationttl(const pep_cache_t * cache, const char * obligationid, long ttl);
+
+/**
+ * Returns the time-to-live in seconds of the response, according to the cache
+ * policies (decision and obligation TTL overrides).
+ *
+ * @return long the TTL or 0 if the response must not be cached.
+ */
+long pep_cache_getresponsettl(const pep_cache_t * cache, const xacml_response_t * response);
+
+/**
+ * Looks up the cached response bytes for the key and writes them into the
+ * value buffer. Expired entries are removed.
+ *
+ * @return int CACHE_OK on hit, CACHE_MISS or CACHE_ERROR.
+ */
+int pep_cache_get(pep_cache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value);
+
+/**
+ * Stores (or replaces) the response bytes of the value buffer for the key, for
+ * ttl seconds. The value buffer is rewinded. The subjectid can be NULL, and is
+ * used by pep_cache_removesubject(cache,subjectid). The least recently used entry
+ * is evicted when the cache is full.
+ *
+ * @return int CACHE_OK or CACHE_ERROR.
+ */
+int pep_cache_put(pep_cache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value, const char * subjectid, long ttl);
+
+/**
+ * Removes all the entries of the subjectid, or all entries if subjectid is NULL.
+ *
+ * @return size_t the number of entries removed.
+ */
+size_t pep_cache_removesubject(pep_cache_t * cache, const char * subjectid);
+
+/**
+ * Returns the first value of the XACML_SUBJECT_ID attribute of the request
+ * subjects, or NULL if not present.
+ */
+const char * pep_cache_getsubjectid(const xacml_request_t * request);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+/* open, write, close */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "capture.h"
+
+/* type byte and 4 bytes length */
+#define CAPTURE_HEADER_LENGTH 5
+
+struct pep_capture {
+    int fd;
+    unsigned char * record; /* header and data of the record to write */
+    size_t record_size;
+};
+
+pep_capture_t * pep_capture_open(const char * filename) {
+    pep_capture_t * capture;
+    if (filename == NULL) {
+        pep_log_error("pep_capture_open: NULL filename.");
+        return NULL;
+    }
+    capture= calloc(1,sizeof(pep_capture_t));
+    if (capture == NULL) {
+        pep_log_error("pep_capture_open: can't allocate pep_capture_t.");
+        return NULL;
+    }
+    capture->fd= open(filename,O_WRONLY | O_CREAT | O_APPEND,0600);
+    if (capture->fd < 0) {
+        pep_log_error("pep_capture_open: can't open %s: %s.",filename,strerror(errno));
+        free(capture);
+        return NULL;
+    }
+    return capture;
+}
+
+int pep_capture_write(pep_capture_t * capture, int type, pep_buffer_t * buffer) {
+    size_t length, pos, record_l;
+    ssize_t written;
+    if (capture == NULL || buffer == NULL) {
+        pep_log_error("pep_capture_write: NULL capture or buffer.");
+        return CAPTURE_ERROR;
+    }
+    length= pep_buffer_length(buffer);
+    if (length > CAPTURE_MAX_LENGTH) {
+        pep_log_warn("pep_capture_write: record too long (%lu bytes), not captured.",(unsigned long)length);
+        return CAPTURE_ERROR;
+    }
+    record_l= CAPTURE_HEADER_LENGTH + length;
+    if (record_l > capture->record_size) {
+        unsigned char * record= realloc(capture->record,record_l);
+        if (record == NULL) {
+            pep_log_warn("pep_capture_write: can't allocate record (%lu bytes).",(unsigned long)record_l);
+            return CAPTURE_ERROR;
+        }
+        capture->record= record;
+        capture->record_size= record_l;
+    }
+    capture->record[0]= (unsigned char)type;
+    capture->record[1]= (unsigned char)((length >> 24) & 0xFF);
+    capture->record[2]= (unsigned char)((length >> 16) & 0xFF);
+    capture->record[3]= (unsigned char)((length >> 8) & 0xFF);
+    capture->record[4]= (unsigned char)(length & 0xFF);
+    pos= pep_buffer_tell(buffer);
+    pep_buffer_rewind(buffer);
+    pep_buffer_read(capture->record + CAPTURE_HEADER_LENGTH,sizeof(unsigned char),length,buffer);
+    pep_buffer_seek(buffer,pos);
+    /* a single write, not interleaved with the other writers */
+    written= write(capture->fd,capture->record,record_l);
+    if (written < 0 || (size_t)written != record_l) {
+        pep_log_warn("pep_capture_write: can't write record (%lu bytes): %s.",(unsigned long)record_l,(written < 0) ? strerror(errno) : "short write");
+        return CAPTURE_ERROR;
+    }
+    return CAPTURE_OK;
+}
+
+void pep_capture_close(pep_capture_t * capture) {
+    if (capture == NULL) return;
+    close(capture->fd);
+    if (capture->record != NULL) free(capture->record);
+    free(capture);
+}
+
+int pep_capture_read(FILE * in, int * type, pep_buffer_t * buffer) {
+    unsigned char header[CAPTURE_HEADER_LENGTH];
+    char chunk[4096];
+    size_t n, length;
+    if (in == NULL || type == NULL || buffer == NULL) {
+        pep_log_error("pep_capture_read: NULL input, type or buffer.");
+        return CAPTURE_ERROR;
+    }
+    n= fread(header,sizeof(unsigned char),CAPTURE_HEADER_LENGTH,in);
+    if (n == 0) return CAPTURE_EOF;
+    if (n != CAPTURE_HEADER_LENGTH) {
+        pep_log_error("pep_capture_read: truncated record header.");
+        return CAPTURE_ERROR;
+    }
+    *type= header[0];
+    length= ((size_t)header[1] << 24) | ((size_t)header[2] << 16) | ((size_t)header[3] << 8) | (size_t)header[4];
+    pep_buffer_reset(buffer);
+    while (length > 0) {
+        n= fread(chunk,sizeof(char),(length < sizeof(chunk)) ? length : sizeof(chunk),in);
+        if (n == 0) {
+            pep_log_error("pep_capture_read: truncated record data, %lu bytes missing.",(unsigned long)length);
+            return CAPTURE_ERROR;
+        }
+        pep_buffer_write(chunk,sizeof(char),n,buffer);
+        length-= n;
+    }
+    return CAPTURE_OK;
+}
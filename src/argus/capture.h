@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_CAPTURE_H_
+#define _PEP_CAPTURE_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h> /* FILE */
+
+/* from ../util */
+#include "buffer.h"
+
+/** pep_capture_* return codes */
+#define CAPTURE_OK      0
+#define CAPTURE_EOF     1 /* no more record */
+#define CAPTURE_ERROR  -1
+
+/** Record types */
+#define CAPTURE_REQUEST   'Q' /* marshalled Hessian request */
+#define CAPTURE_RESPONSE  'R' /* raw (base64 encoded) HTTP response body */
+
+/** Maximum length of a record */
+#define CAPTURE_MAX_LENGTH 0x7FFFFFFF
+
+/*
+ * Capture file of the PEP traffic: records appended by the PEP clients, and
+ * read back by a replay tool (see test/bench/replay_capture.c). A record is
+ * the type byte, the 4 bytes big-endian length of the data and the data.
+ * Each record is appended with a single write(2) on a O_APPEND descriptor,
+ * several PEP clients and processes can capture into the same file.
+ */
+typedef struct pep_capture pep_capture_t;
+
+/**
+ * Opens the capture file in append mode, creates it if needed.
+ *
+ * @return pep_capture_t * or NULL on error.
+ */
+pep_capture_t * pep_capture_open(const char * filename);
+
+/**
+ * Appends the whole content of the buffer as a record of the type. The read
+ * position of the buffer is left unchanged.
+ *
+ * @param int type CAPTURE_REQUEST or CAPTURE_RESPONSE.
+ * @return int CAPTURE_OK or CAPTURE_ERROR.
+ */
+int pep_capture_write(pep_capture_t * capture, int type, pep_buffer_t * buffer);
+
+/**
+ * Closes the capture file.
+ */
+void pep_capture_close(pep_capture_t * capture);
+
+/**
+ * Reads the next record of a capture file into the buffer, after resetting it.
+ *
+ * @param int * type set to the record type.
+ * @return int CAPTURE_OK, CAPTURE_EOF or CAPTURE_ERROR on a truncated record.
+ */
+int pep_capture_read(FILE * in, int * type, pep_buffer_t * buffer);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -22,9 +22,12 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "attrindex.h"
 
 struct xacml_environment {
     pep_linkedlist_t * attributes;
+    pep_attrindex_t * index; /* attributes by id, built on lookup */
 };
 
 xacml_environment_t * xacml_environment_create() {
@@ -51,7 +54,9 @@ int xacml_environment_addattribute(xacml_environment_t * env, xacml_attribute_t
         pep_log_error("xacml_environment_addattribute: can't add attribute to list.");
         return PEP_XACML_ERROR;
     }
-    else return PEP_XACML_OK;
+    pep_attrindex_invalidate(&(env->index));
+    xacml_attribute_setindex(attr,&(env->index));
+    return PEP_XACML_OK;
 }
 
 size_t xacml_environment_attributes_length(const xacml_environment_t * env) {
@@ -72,11 +77,49 @@ xacml_attribute_t * xacml_environment_getattribute(const xacml_environment_t * e
 
 }
 
+xacml_attribute_t * xacml_environment_findattribute(const xacml_environment_t * env, const char * id) {
+    if (env == NULL || id == NULL) {
+        pep_log_error("xacml_environment_findattribute: NULL environment or id.");
+        return NULL;
+    }
+    /* the index is a cache, built on the first lookup */
+    return pep_attrindex_find(&(((xacml_environment_t *)env)->index),env->attributes,id);
+}
+
 void xacml_environment_delete(xacml_environment_t * env) {
     if (env == NULL) return;
+    pep_attrindex_invalidate(&(env->index));
     pep_llist_delete_elements(env->attributes,(pep_llist_delete_elt_f)xacml_attribute_delete);
     pep_llist_delete(env->attributes);
     free(env);
     env= NULL;
 }
 
+/**
+ * Clone the environment and its attributes.
+ */
+xacml_environment_t * xacml_environment_clone(const xacml_environment_t * env) {
+    xacml_environment_t * clone;
+    size_t attrs_l;
+    int i;
+    if (env == NULL) {
+        pep_log_warn("xacml_environment_clone: env is NULL.");
+        return NULL;
+    }
+    clone= xacml_environment_create();
+    if (clone == NULL) {
+        pep_log_error("xacml_environment_clone: can't create clone.");
+        return NULL;
+    }
+    attrs_l= pep_llist_length(env->attributes);
+    for (i= 0; i < attrs_l; i++) {
+        xacml_attribute_t * attr= xacml_attribute_clone(pep_llist_get(env->attributes,i));
+        if (attr == NULL || xacml_environment_addattribute(clone,attr) != PEP_XACML_OK) {
+            pep_log_error("xacml_environment_clone: can't clone attribute[%d].",i);
+            if (attr != NULL) xacml_attribute_delete(attr);
+            xacml_environment_delete(clone);
+            return NULL;
+        }
+    }
+    return clone;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _INTERNAL_XACML_H_
+#define _INTERNAL_XACML_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+
+#include "xacml.h"
+
+/*
+ * INTERNAL XACML Request functions and constants
+ */
+
+/**
+ * XACML Request sections, in Hessian serialization order.
+ */
+#define XACML_REQUEST_SUBJECTS     0
+#define XACML_REQUEST_RESOURCES    1
+#define XACML_REQUEST_ACTION       2
+#define XACML_REQUEST_ENVIRONMENT  3
+#define XACML_REQUEST_SECTIONS     4
+
+/**
+ * Read-only accessors, with const return types. Like the xacml_request_get*
+ * functions, they never copy a section inherited from a template or a base request.
+ */
+const xacml_subject_t * xacml_request_peeksubject(const xacml_request_t * request, int subject_idx);
+const xacml_resource_t * xacml_request_peekresource(const xacml_request_t * request, int resource_idx);
+const xacml_action_t * xacml_request_peekaction(const xacml_request_t * request);
+const xacml_environment_t * xacml_request_peekenvironment(const xacml_request_t * request);
+
+/**
+ * Copies into the request all the sections still inherited from the template
+ * or the base request, e.g. before a legacy PIP that modifies the sections
+ * returned by the xacml_request_get* functions.
+ *
+ * @return int PEP_XACML_OK or PEP_XACML_ERROR.
+ */
+int xacml_request_ownsections(xacml_request_t * request);
+
+/**
+ * Creates a request overlaying the base request: the sections are shared with
+ * the base request until modified (copy-on-write). The base request must not
+ * be modified or deleted before the overlay is deleted.
+ */
+xacml_request_t * xacml_request_createoverlay(const xacml_request_t * base);
+
+/**
+ * Merges into the request the attributes, subjects and resources added to the
+ * overlays of the request, in the overlays order. The attribute values are
+ * shared with the overlays.
+ *
+ * @return int PEP_XACML_OK or PEP_XACML_ERROR.
+ */
+int xacml_request_merge(xacml_request_t * request, xacml_request_t * const * overlays, size_t overlays_l);
+
+/**
+ * Returns the template of the request, or NULL if the request was not created
+ * from a template.
+ */
+const xacml_request_template_t * xacml_request_gettemplate(const xacml_request_t * request);
+
+/**
+ * Gets the pre-serialized Hessian bytes (<key,value> pair) of a request section
+ * still inherited from the template.
+ *
+ * @return int 1 if the section is inherited and bytes is set, 0 otherwise.
+ */
+int xacml_request_getsectionbytes(const xacml_request_t * request, int section, const unsigned char ** bytes, size_t * bytes_l);
+
+/*
+ * INTERNAL XACML Response functions
+ */
+
+/**
+ * Sets the serialized Hessian bytes of the effective request in the response,
+ * replacing the request. The bytes are unmarshalled by xacml_response_getrequest
+ * on the first call. The response takes ownership of the bytes.
+ *
+ * @return int PEP_XACML_OK or PEP_XACML_ERROR.
+ */
+int xacml_response_setrequestbytes(xacml_response_t * response, unsigned char * bytes, size_t bytes_l);
+
+/*
+ * INTERNAL XACML Attribute functions
+ */
+
+/**
+ * Attaches the Attribute to the hashed Attribute index of its container
+ * (see attrindex.h): changing the Attribute id invalidates the index.
+ */
+struct pep_attrindex;
+void xacml_attribute_setindex(xacml_attribute_t * attr, struct pep_attrindex ** index);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
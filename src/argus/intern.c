@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "xacml.h"
+#include "profiles.h"
+#include "intern.h"
+
+/* number of slots of the seeded and runtime tables, power of 2 */
+#define INTERN_SEEDS_SIZE    256
+#define INTERN_STRINGS_SIZE  (2 * INTERN_MAX_STRINGS)
+
+/* XACML and profiles constants */
+static const char * const intern_seeds[]= {
+    XACML_DATATYPE_X500NAME,
+    XACML_DATATYPE_RFC822NAME,
+    XACML_DATATYPE_IPADDRESS,
+    XACML_DATATYPE_DNSNAME,
+    XACML_DATATYPE_STRING,
+    XACML_DATATYPE_BOOLEAN,
+    XACML_DATATYPE_INTEGER,
+    XACML_DATATYPE_DOUBLE,
+    XACML_DATATYPE_TIME,
+    XACML_DATATYPE_DATE,
+    XACML_DATATYPE_DATETIME,
+    XACML_DATATYPE_ANYURI,
+    XACML_DATATYPE_HEXBINARY,
+    XACML_DATATYPE_BASE64BINARY,
+    XACML_DATATYPE_DAY_TIME_DURATION,
+    XACML_DATATYPE_YEAR_MONTH_DURATION,
+    XACML_SUBJECT_ID,
+    XACML_SUBJECT_ID_QUALIFIER,
+    XACML_SUBJECT_KEY_INFO,
+    XACML_SUBJECT_CATEGORY_ACCESS,
+    XACML_SUBJECT_CATEGORY_INTERMEDIARY,
+    XACML_SUBJECT_CATEGORY_RECIPIENT,
+    XACML_SUBJECT_CATEGORY_CODEBASE,
+    XACML_SUBJECT_CATEGORY_REQUESTING_MACHINE,
+    XACML_RESOURCE_ID,
+    XACML_ACTION_ID,
+    XACML_ENVIRONMENT_CURRENT_TIME,
+    XACML_ENVIRONMENT_CURRENT_DATE,
+    XACML_ENVIRONMENT_CURRENT_DATETIME,
+    XACML_STATUSCODE_OK,
+    XACML_STATUSCODE_MISSINGATTRIBUTE,
+    XACML_STATUSCODE_SYNTAXERROR,
+    XACML_STATUSCODE_PROCESSINGERROR,
+    XACML_COMMONAUTHZ_PROFILE_1_1,
+    XACML_DCISEC_ATTRIBUTE_PROFILE_ID,
+    XACML_DCISEC_ATTRIBUTE_SUBJECT_ISSUER,
+    XACML_DCISEC_ATTRIBUTE_VIRTUAL_ORGANIZATION,
+    XACML_DCISEC_ATTRIBUTE_GROUP,
+    XACML_DCISEC_ATTRIBUTE_GROUP_PRIMARY,
+    XACML_DCISEC_ATTRIBUTE_ROLE,
+    XACML_DCISEC_ATTRIBUTE_ROLE_PRIMARY,
+    XACML_DCISEC_ATTRIBUTE_RESOURCE_OWNER,
+    XACML_DCISEC_ACTION_NAMESPACE,
+    XACML_DCISEC_ACTION_ANY,
+    XACML_DCISEC_OBLIGATION_MAP_LOCAL_USER,
+    XACML_DCISEC_OBLIGATION_MAP_POSIX_USER,
+    XACML_DCISEC_ATTRIBUTE_USER_ID,
+    XACML_DCISEC_ATTRIBUTE_GROUP_ID,
+    XACML_DCISEC_ATTRIBUTE_GROUP_ID_PRIMARY,
+    XACML_GRIDWN_PROFILE_VERSION,
+    XACML_GRIDWN_ATTRIBUTE_PROFILE_ID,
+    XACML_GLITE_ATTRIBUTE_PROFILE_ID,
+    XACML_GLITE_ATTRIBUTE_SUBJECT_ISSUER,
+    XACML_GLITE_ATTRIBUTE_VOMS_ISSUER,
+    XACML_GLITE_ATTRIBUTE_VIRTUAL_ORGANIZATION,
+    XACML_GLITE_ATTRIBUTE_FQAN,
+    XACML_GLITE_ATTRIBUTE_FQAN_PRIMARY,
+    XACML_GLITE_ATTRIBUTE_PILOT_JOB_CLASSIFIER,
+    XACML_GLITE_ATTRIBUTE_USER_ID,
+    XACML_GLITE_ATTRIBUTE_GROUP_ID,
+    XACML_GLITE_ATTRIBUTE_GROUP_ID_PRIMARY,
+    XACML_GLITE_OBLIGATION_LOCAL_ENVIRONMENT_MAP,
+    XACML_GLITE_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX,
+    XACML_GLITE_DATATYPE_FQAN,
+    XACML_GRIDWN_ATTRIBUTE_SUBJECT_ISSUER,
+    XACML_GRIDWN_ATTRIBUTE_VIRTUAL_ORGANIZATION,
+    XACML_GRIDWN_ATTRIBUTE_FQAN,
+    XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY,
+    XACML_GRIDWN_ATTRIBUTE_PILOT_JOB_CLASSIFIER,
+    XACML_GRIDWN_ATTRIBUTE_VOMS_ISSUER,
+    XACML_GRIDWN_ATTRIBUTE_USER_ID,
+    XACML_GRIDWN_ATTRIBUTE_GROUP_ID,
+    XACML_GRIDWN_ATTRIBUTE_GROUP_ID_PRIMARY,
+    XACML_GRIDWN_OBLIGATION_LOCAL_ENVIRONMENT_MAP,
+    XACML_GRIDWN_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX,
+    XACML_GRIDWN_DATATYPE_FQAN,
+    XACML_AUTHZINTEROP_SUBJECT_X509_ID,
+    XACML_AUTHZINTEROP_SUBJECT_X509_ISSUER,
+    XACML_AUTHZINTEROP_SUBJECT_VO,
+    XACML_AUTHZINTEROP_SUBJECT_CERTCHAIN,
+    XACML_AUTHZINTEROP_SUBJECT_VOMS_FQAN,
+    XACML_AUTHZINTEROP_SUBJECT_VOMS_PRIMARY_FQAN,
+    XACML_AUTHZINTEROP_OBLIGATION_UIDGID,
+    XACML_AUTHZINTEROP_OBLIGATION_SECONDARY_GIDS,
+    XACML_AUTHZINTEROP_OBLIGATION_USERNAME,
+    XACML_AUTHZINTEROP_OBLIGATION_AFS_TOKEN,
+    XACML_AUTHZINTEROP_OBLIGATION_ATTR_POSIX_UID,
+    XACML_AUTHZINTEROP_OBLIGATION_ATTR_POSIX_GID,
+    XACML_AUTHZINTEROP_OBLIGATION_ATTR_USERNAME,
+    XACML_AUTHZINTEROP_OBLIGATION_ATTR_AFS_TOKEN
+};
+
+/* seeded table, read-only after intern_init */
+static const char * seeds_table[INTERN_SEEDS_SIZE];
+static pthread_once_t seeds_once= PTHREAD_ONCE_INIT;
+
+/* runtime table, protected by the mutex */
+static pthread_mutex_t strings_mutex= PTHREAD_MUTEX_INITIALIZER;
+static char * strings_table[INTERN_STRINGS_SIZE];
+static size_t strings_l= 0;
+
+/* FNV-1a hash of the string */
+static unsigned long intern_hash(const char * str) {
+    unsigned long hash= 2166136261UL;
+    while (*str != '\0') {
+        hash^= (unsigned char)*str++;
+        hash*= 16777619UL;
+    }
+    return hash;
+}
+
+/* returns the slot of str in the table, either empty or holding str */
+static size_t intern_slot(const char * const * table, size_t table_size, const char * str, unsigned long hash) {
+    size_t slot= hash & (table_size - 1);
+    while (table[slot] != NULL && strcmp(table[slot],str) != 0) {
+        slot= (slot + 1) & (table_size - 1);
+    }
+    return slot;
+}
+
+static void intern_init(void) {
+    size_t i, slot;
+    for (i= 0; i < sizeof(intern_seeds)/sizeof(intern_seeds[0]); i++) {
+        /* the deprecated constants have the same value, first one wins */
+        slot= intern_slot(seeds_table,INTERN_SEEDS_SIZE,intern_seeds[i],intern_hash(intern_seeds[i]));
+        if (seeds_table[slot] == NULL) seeds_table[slot]= intern_seeds[i];
+    }
+}
+
+const char * pep_intern(const char * str) {
+    unsigned long hash;
+    size_t slot, str_l;
+    char * copy;
+    if (str == NULL) return NULL;
+    pthread_once(&seeds_once,intern_init);
+    hash= intern_hash(str);
+    slot= intern_slot(seeds_table,INTERN_SEEDS_SIZE,str,hash);
+    if (seeds_table[slot] != NULL) return seeds_table[slot];
+    str_l= strlen(str);
+    if (str_l > INTERN_MAX_LENGTH) return NULL;
+    pthread_mutex_lock(&strings_mutex);
+    slot= intern_slot((const char * const *)strings_table,INTERN_STRINGS_SIZE,str,hash);
+    if (strings_table[slot] == NULL) {
+        if (strings_l >= INTERN_MAX_STRINGS) {
+            pthread_mutex_unlock(&strings_mutex);
+            return NULL;
+        }
+        copy= calloc(str_l + 1,sizeof(char));
+        if (copy == NULL) {
+            pthread_mutex_unlock(&strings_mutex);
+            pep_log_error("pep_intern: can't allocate string (%d bytes).",(int)str_l);
+            return NULL;
+        }
+        strncpy(copy,str,str_l);
+        strings_table[slot]= copy;
+        strings_l++;
+    }
+    copy= strings_table[slot];
+    pthread_mutex_unlock(&strings_mutex);
+    return copy;
+}
+
+char * pep_intern_strdup(const char * str, int * interned) {
+    const char * istr;
+    size_t size;
+    char * copy;
+    *interned= 0;
+    if (str == NULL) return NULL;
+    istr= pep_intern(str);
+    if (istr != NULL) {
+        *interned= 1;
+        /* never modified by the XACML objects */
+        return (char *)istr;
+    }
+    size= strlen(str);
+    copy= calloc(size + 1,sizeof(char));
+    if (copy == NULL) {
+        pep_log_error("pep_intern_strdup: can't allocate string (%d bytes).",(int)size);
+        return NULL;
+    }
+    strncpy(copy,str,size);
+    return copy;
+}
+
+void pep_intern_strfree(char * str, int interned) {
+    if (str != NULL && !interned) free(str);
+}
+
+const char * xacml_intern(const char * str) {
+    return pep_intern(str);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_INTERN_H_
+#define _PEP_INTERN_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of strings interned at runtime, beside the XACML constants */
+#define INTERN_MAX_STRINGS  4096
+
+/** Maximum length of a string interned at runtime */
+#define INTERN_MAX_LENGTH   512
+
+/*
+ * Process wide pool of interned strings for the XACML identifiers and
+ * datatypes. The pool is pre-seeded with the constants of xacml.h and
+ * profiles.h, which are looked up without lock. The other strings are
+ * interned under a mutex, up to INTERN_MAX_STRINGS strings. The interned
+ * strings are never freed.
+ */
+
+/**
+ * Returns the interned copy of the string.
+ *
+ * @return const char * the interned string, or NULL if the string is NULL,
+ *         too long or the pool is full.
+ */
+const char * pep_intern(const char * str);
+
+/**
+ * Duplicates the string for a XACML object: returns the interned string if
+ * possible, or a heap copy.
+ *
+ * @param int * interned set to 1 if the returned string is interned, 0 if it
+ *        is a heap copy.
+ * @return char * the string or NULL on error.
+ */
+char * pep_intern_strdup(const char * str, int * interned);
+
+/**
+ * Releases a string returned by pep_intern_strdup.
+ */
+void pep_intern_strfree(char * str, int interned);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
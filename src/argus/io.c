@@ -15,6 +15,7 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "io.h"
@@ -41,13 +42,18 @@ static int xacml_action_unmarshal(xacml_action_t ** action, const hessian_object
 static int xacml_environment_marshal(const xacml_environment_t * env, hessian_object_t ** h_environment);
 static int xacml_environment_unmarshal(xacml_environment_t ** env, const hessian_object_t * h_environment);
 static int xacml_request_marshal(const xacml_request_t * request, hessian_object_t ** h_request);
+static int xacml_request_subjects_marshal(const xacml_request_t * request, hessian_object_t ** h_subjects);
+static int xacml_request_resources_marshal(const xacml_request_t * request, hessian_object_t ** h_resources);
+static int xacml_request_section_marshal(const xacml_request_t * request, int section, hessian_object_t ** h_key, hessian_object_t ** h_value);
 static int xacml_request_unmarshal(xacml_request_t ** request, const hessian_object_t * h_request);
 static int xacml_response_unmarshal(xacml_response_t ** response, const hessian_object_t * h_response);
+static int xacml_response_results_unmarshal(xacml_response_t * response, const hessian_object_t * h_results);
 static int xacml_result_unmarshal(xacml_result_t ** result, const hessian_object_t * h_result);
 static int xacml_status_unmarshal(xacml_status_t ** status, const hessian_object_t * h_status);
 static int xacml_statuscode_unmarshal(xacml_statuscode_t ** statuscode, const hessian_object_t * h_statuscode);
 static int xacml_obligation_unmarshal(xacml_obligation_t ** obligation, const hessian_object_t * h_obligation);
 static int xacml_attributeassignment_unmarshal(xacml_attributeassignment_t ** attr, const hessian_object_t * h_attribute);
+static pep_error_t xacml_request_template_marshalling(const xacml_request_t * request, pep_buffer_t * output);
 
 /**
  * Returns the Hessian map for this Action or a Hessian null if the Action is null.
@@ -557,121 +563,131 @@ static int xacml_environment_unmarshal(xacml_environment_t ** env, const hessian
 /**
  * Returns PEP_IO_OK or PEP_IO_ERROR
  */
-static int xacml_request_marshal(const xacml_request_t * request, hessian_object_t ** h_req) {
-    hessian_object_t * h_request, * h_subjects, * h_subjects_key, * h_resources, * h_resources_key; 
-    hessian_object_t * h_action, * h_action_key, * h_environment, * h_environment_key;
-    xacml_action_t * action;
-    xacml_environment_t * environment;
+static int xacml_request_subjects_marshal(const xacml_request_t * request, hessian_object_t ** h_subs) {
+    hessian_object_t * h_subjects;
     size_t list_l;
     int i;
-    if (request == NULL) {
-        pep_log_error("xacml_request_marshal: NULL request object.");
-        return PEP_IO_ERROR;
-    }
-    /* request as hessian map */
-    h_request= hessian_create(HESSIAN_MAP,XACML_HESSIAN_REQUEST_CLASSNAME);
-    if (h_request == NULL) {
-        pep_log_error("xacml_request_marshal: can't create request Hessian map: %s.",XACML_HESSIAN_REQUEST_CLASSNAME);
-        return PEP_IO_ERROR;
-    }
-    /* subjects list */
     h_subjects= hessian_create(HESSIAN_LIST);
     if (h_subjects == NULL) {
-        pep_log_error("xacml_request_marshal: can't create subjects Hessian list.");
-        hessian_delete(h_request);
+        pep_log_error("xacml_request_subjects_marshal: can't create subjects Hessian list.");
         return PEP_IO_ERROR;
     }
     list_l= xacml_request_subjects_length(request);
     for (i= 0; i < list_l; i++) {
-        xacml_subject_t * subject= xacml_request_getsubject(request,i);
+        const xacml_subject_t * subject= xacml_request_peeksubject(request,i);
         hessian_object_t * h_subject= NULL;
         if (xacml_subject_marshal(subject,&h_subject) != PEP_IO_OK) {
-            pep_log_error("xacml_request_marshal: failed to marshal XACML subject at: %d.",i);
-            hessian_delete(h_request);
+            pep_log_error("xacml_request_subjects_marshal: failed to marshal XACML subject at: %d.",i);
             hessian_delete(h_subjects);
             return PEP_IO_ERROR;
         }
         if (hessian_list_add(h_subjects,h_subject) != HESSIAN_OK) {
-            pep_log_error("xacml_request_marshal: can't add Hessian subject %d in Hessian subjects list.",i);
-            hessian_delete(h_request);
+            pep_log_error("xacml_request_subjects_marshal: can't add Hessian subject %d in Hessian subjects list.",i);
             hessian_delete(h_subjects);
             hessian_delete(h_subject);
             return PEP_IO_ERROR;
         }
     }
-    h_subjects_key= hessian_create(HESSIAN_STRING,XACML_HESSIAN_REQUEST_SUBJECTS);
-    if (hessian_map_add(h_request,h_subjects_key,h_subjects) != HESSIAN_OK) {
-        pep_log_error("xacml_request_marshal: can't add Hessian subjects list in Hessian request map.");
-        hessian_delete(h_request);
-        hessian_delete(h_subjects_key);
-        hessian_delete(h_subjects);
-        return PEP_IO_ERROR;
-    }
-    /* resources list */
+    *h_subs= h_subjects;
+    return PEP_IO_OK;
+}
+
+static int xacml_request_resources_marshal(const xacml_request_t * request, hessian_object_t ** h_res) {
+    hessian_object_t * h_resources;
+    size_t list_l;
+    int i;
     h_resources= hessian_create(HESSIAN_LIST);
     if (h_resources == NULL) {
-        pep_log_error("xacml_request_marshal: can't create resources Hessian list.");
-        hessian_delete(h_request);
+        pep_log_error("xacml_request_resources_marshal: can't create resources Hessian list.");
         return PEP_IO_ERROR;
     }
     list_l= xacml_request_resources_length(request);
     for (i= 0; i < list_l; i++) {
-        xacml_resource_t * resource= xacml_request_getresource(request,i);
+        const xacml_resource_t * resource= xacml_request_peekresource(request,i);
         hessian_object_t * h_resource= NULL;
         if (xacml_resource_marshal(resource,&h_resource) != PEP_IO_OK) {
-            pep_log_error("xacml_request_marshal: failed to marshal XACML resource at: %d.",i);
-            hessian_delete(h_request);
+            pep_log_error("xacml_request_resources_marshal: failed to marshal XACML resource at: %d.",i);
             hessian_delete(h_resources);
             return PEP_IO_ERROR;
         }
         if (hessian_list_add(h_resources,h_resource) != HESSIAN_OK) {
-            pep_log_error("xacml_request_marshal: can't add Hessian resource %d to Hessian resources list.",i);
-            hessian_delete(h_request);
+            pep_log_error("xacml_request_resources_marshal: can't add Hessian resource %d to Hessian resources list.",i);
             hessian_delete(h_resources);
             hessian_delete(h_resource);
             return PEP_IO_ERROR;
         }
     }
-    h_resources_key= hessian_create(HESSIAN_STRING,XACML_HESSIAN_REQUEST_RESOURCES);
-    if (hessian_map_add(h_request,h_resources_key,h_resources) != HESSIAN_OK) {
-        pep_log_error("xacml_request_marshal: can't add Hessian resources list to Hessian request map.");
-        hessian_delete(h_request);
-        hessian_delete(h_resources_key);
-        hessian_delete(h_resources);
-        return PEP_IO_ERROR;
+    *h_res= h_resources;
+    return PEP_IO_OK;
+}
+
+/* marshals one request section as its <key,value> Hessian objects */
+static int xacml_request_section_marshal(const xacml_request_t * request, int section, hessian_object_t ** h_key, hessian_object_t ** h_value) {
+    int rc;
+    const char * key;
+    *h_value= NULL;
+    switch (section) {
+        case XACML_REQUEST_SUBJECTS:
+            key= XACML_HESSIAN_REQUEST_SUBJECTS;
+            rc= xacml_request_subjects_marshal(request,h_value);
+            break;
+        case XACML_REQUEST_RESOURCES:
+            key= XACML_HESSIAN_REQUEST_RESOURCES;
+            rc= xacml_request_resources_marshal(request,h_value);
+            break;
+        case XACML_REQUEST_ACTION:
+            key= XACML_HESSIAN_REQUEST_ACTION;
+            rc= xacml_action_marshal(xacml_request_peekaction(request),h_value);
+            break;
+        case XACML_REQUEST_ENVIRONMENT:
+            key= XACML_HESSIAN_REQUEST_ENVIRONMENT;
+            rc= xacml_environment_marshal(xacml_request_peekenvironment(request),h_value);
+            break;
+        default:
+            pep_log_error("xacml_request_section_marshal: invalid request section: %d.",section);
+            return PEP_IO_ERROR;
     }
-    /* action */
-    action= xacml_request_getaction(request);
-    h_action= NULL;
-    if (xacml_action_marshal(action,&h_action) != PEP_IO_OK) {
-        pep_log_error("xacml_request_marshal: failed to marshal XACML action.");
-        hessian_delete(h_request);
+    if (rc != PEP_IO_OK) {
+        pep_log_error("xacml_request_section_marshal: failed to marshal XACML %s.",key);
         return PEP_IO_ERROR;
     }
-    h_action_key= hessian_create(HESSIAN_STRING,XACML_HESSIAN_REQUEST_ACTION);
-    if (hessian_map_add(h_request,h_action_key,h_action) != HESSIAN_OK) {
-        pep_log_error("xacml_request_marshal: can't add Hessian action to Hessian request.");
-        hessian_delete(h_request);
-        hessian_delete(h_action_key);
-        hessian_delete(h_action);
+    *h_key= hessian_create(HESSIAN_STRING,key);
+    if (*h_key == NULL) {
+        pep_log_error("xacml_request_section_marshal: can't create Hessian string: %s.",key);
+        hessian_delete(*h_value);
         return PEP_IO_ERROR;
     }
-    /* environment */
-    environment= xacml_request_getenvironment(request);
-    h_environment= NULL;
-    if (xacml_environment_marshal(environment,&h_environment) != PEP_IO_OK) {
-        pep_log_error("xacml_request_marshal: failed to marshal XACML environment.");
-        hessian_delete(h_request);
+    return PEP_IO_OK;
+}
+
+static int xacml_request_marshal(const xacml_request_t * request, hessian_object_t ** h_req) {
+    hessian_object_t * h_request, * h_key, * h_value;
+    int section;
+    if (request == NULL) {
+        pep_log_error("xacml_request_marshal: NULL request object.");
         return PEP_IO_ERROR;
     }
-    h_environment_key= hessian_create(HESSIAN_STRING,XACML_HESSIAN_REQUEST_ENVIRONMENT);
-    if (hessian_map_add(h_request,h_environment_key,h_environment) != HESSIAN_OK) {
-        pep_log_error("xacml_request_marshal: can't add Hessian environment to Hessian request.");
-        hessian_delete(h_request);
-        hessian_delete(h_environment_key);
-        hessian_delete(h_environment);
+    /* request as hessian map */
+    h_request= hessian_create(HESSIAN_MAP,XACML_HESSIAN_REQUEST_CLASSNAME);
+    if (h_request == NULL) {
+        pep_log_error("xacml_request_marshal: can't create request Hessian map: %s.",XACML_HESSIAN_REQUEST_CLASSNAME);
         return PEP_IO_ERROR;
     }
+    /* subjects, resources, action and environment */
+    for (section= 0; section < XACML_REQUEST_SECTIONS; section++) {
+        if (xacml_request_section_marshal(request,section,&h_key,&h_value) != PEP_IO_OK) {
+            pep_log_error("xacml_request_marshal: failed to marshal XACML request section: %d.",section);
+            hessian_delete(h_request);
+            return PEP_IO_ERROR;
+        }
+        if (hessian_map_add(h_request,h_key,h_value) != HESSIAN_OK) {
+            pep_log_error("xacml_request_marshal: can't add Hessian %s to Hessian request map.",hessian_string_getstring(h_key));
+            hessian_delete(h_request);
+            hessian_delete(h_key);
+            hessian_delete(h_value);
+            return PEP_IO_ERROR;
+        }
+    }
     *h_req= h_request;
     return PEP_IO_OK;
 }
@@ -1157,6 +1173,10 @@ static int xacml_subject_unmarshal(xacml_subject_t ** subj, const hessian_object
 /* OK */
 pep_error_t xacml_request_marshalling(const xacml_request_t * request, pep_buffer_t * output) {
     hessian_object_t * h_request= NULL;
+    if (xacml_request_gettemplate(request) != NULL) {
+        /* request created from a template: reuse the pre-serialized sections */
+        return xacml_request_template_marshalling(request,output);
+    }
     if (xacml_request_marshal(request,&h_request) != PEP_IO_OK) {
         pep_log_error("xacml_request_marshalling: can't marshal XACML request into Hessian object.");
         /* pep_errmsg("failed to marshal XACML request into Hessian object"); */
@@ -1172,6 +1192,58 @@ pep_error_t xacml_request_marshalling(const xacml_request_t * request, pep_buffe
     return PEP_OK;
 }
 
+pep_error_t xacml_request_section_marshalling(const xacml_request_t * request, int section, pep_buffer_t * output) {
+    hessian_object_t * h_key= NULL, * h_value= NULL;
+    if (xacml_request_section_marshal(request,section,&h_key,&h_value) != PEP_IO_OK) {
+        pep_log_error("xacml_request_section_marshalling: can't marshal XACML request section %d into Hessian objects.",section);
+        return PEP_ERR_MARSHALLING_HESSIAN;
+    }
+    if (hessian_serialize(h_key,output) != HESSIAN_OK || hessian_serialize(h_value,output) != HESSIAN_OK) {
+        pep_log_error("xacml_request_section_marshalling: failed to serialize Hessian objects.");
+        hessian_delete(h_key);
+        hessian_delete(h_value);
+        return PEP_ERR_MARSHALLING_IO;
+    }
+    hessian_delete(h_key);
+    hessian_delete(h_value);
+    return PEP_OK;
+}
+
+/*
+ * Writes the request Hessian map: 'M' 't' b16 b8 type, the <key,value> pairs of
+ * the sections, the inherited ones copied from the template bytes, and 'z'.
+ */
+static pep_error_t xacml_request_template_marshalling(const xacml_request_t * request, pep_buffer_t * output) {
+    size_t type_l= strlen(XACML_HESSIAN_REQUEST_CLASSNAME);
+    size_t utf8_l= hessian_utf8_strlen(XACML_HESSIAN_REQUEST_CLASSNAME);
+    const unsigned char * bytes;
+    size_t bytes_l;
+    pep_error_t rc;
+    int section;
+    pep_buffer_putc('M',output);
+    pep_buffer_putc('t',output);
+    pep_buffer_putc((int)(utf8_l >> 8),output);
+    pep_buffer_putc((int)(utf8_l & 0x00FF),output);
+    if (pep_buffer_write(XACML_HESSIAN_REQUEST_CLASSNAME,1,type_l,output) != type_l) {
+        pep_log_error("xacml_request_template_marshalling: can't write Hessian map type.");
+        return PEP_ERR_MARSHALLING_IO;
+    }
+    for (section= 0; section < XACML_REQUEST_SECTIONS; section++) {
+        if (xacml_request_getsectionbytes(request,section,&bytes,&bytes_l)) {
+            if (pep_buffer_write(bytes,1,bytes_l,output) != bytes_l) {
+                pep_log_error("xacml_request_template_marshalling: can't write %d template bytes of section %d.",(int)bytes_l,section);
+                return PEP_ERR_MARSHALLING_IO;
+            }
+        }
+        else {
+            rc= xacml_request_section_marshalling(request,section,output);
+            if (rc != PEP_OK) return rc;
+        }
+    }
+    pep_buffer_putc('z',output);
+    return PEP_OK;
+}
+
 /* OK */
 pep_error_t xacml_response_unmarshalling(xacml_response_t ** response, pep_buffer_t * input) {
     hessian_object_t * h_response= hessian_deserialize(input);
@@ -1191,12 +1263,485 @@ pep_error_t xacml_response_unmarshalling(xacml_response_t ** response, pep_buffe
 
 }
 
+pep_error_t xacml_request_unmarshalling(xacml_request_t ** request, pep_buffer_t * input) {
+    hessian_object_t * h_request= hessian_deserialize(input);
+    if (h_request == NULL) {
+        pep_log_error("xacml_request_unmarshalling: failed to deserialize Hessian object.");
+        return PEP_ERR_UNMARSHALLING_IO;
+    }
+    if (xacml_request_unmarshal(request,h_request) != PEP_IO_OK) {
+        pep_log_error("xacml_request_unmarshalling: can't unmarshal XACML request from Hessian object.");
+        hessian_delete(h_request);
+        return PEP_ERR_UNMARSHALLING_HESSIAN;
+    }
+    hessian_delete(h_request);
+    return PEP_OK;
+}
+
+/*
+ * Parses the response Hessian map pair by pair: the results are unmarshalled,
+ * the request value is only skipped and its bytes kept in the response.
+ */
+static int xacml_response_lazy_unmarshal(xacml_response_t * response, pep_buffer_t * input) {
+    int tag= pep_buffer_getc(input);
+    int next_tag;
+    if (tag != 'M') {
+        pep_log_error("xacml_response_lazy_unmarshal: wrong Hessian tag: %c (%d).",(char)tag,tag);
+        return PEP_IO_ERROR;
+    }
+    next_tag= pep_buffer_getc(input);
+    if (next_tag == 't') {
+        int b16= pep_buffer_getc(input);
+        int b8= pep_buffer_getc(input);
+        size_t utf8_l= (b16 << 8) + b8;
+        char * map_type= hessian_utf8_bgets(utf8_l,input);
+        if (map_type == NULL || strcmp(XACML_HESSIAN_RESPONSE_CLASSNAME,map_type) != 0) {
+            pep_log_error("xacml_response_lazy_unmarshal: wrong Hessian map type: %s.",map_type != NULL ? map_type : "NULL");
+            if (map_type != NULL) free(map_type);
+            return PEP_IO_ERROR;
+        }
+        free(map_type);
+        next_tag= pep_buffer_getc(input);
+    }
+    else {
+        pep_log_error("xacml_response_lazy_unmarshal: NULL Hessian map type.");
+        return PEP_IO_ERROR;
+    }
+    /* parse all map pair<key>s */
+    while (next_tag != 'z') {
+        hessian_object_t * h_map_key;
+        const char * key;
+        if (next_tag == BUFFER_EOF) {
+            pep_log_error("xacml_response_lazy_unmarshal: truncated Hessian map.");
+            return PEP_IO_ERROR;
+        }
+        h_map_key= hessian_deserialize_tag(next_tag,input);
+        if (h_map_key == NULL || hessian_gettype(h_map_key) != HESSIAN_STRING || (key= hessian_string_getstring(h_map_key)) == NULL) {
+            pep_log_error("xacml_response_lazy_unmarshal: Hessian map<key> is not an Hessian string.");
+            if (h_map_key != NULL) hessian_delete(h_map_key);
+            return PEP_IO_ERROR;
+        }
+        if (strcmp(XACML_HESSIAN_RESPONSE_REQUEST,key) == 0) {
+            size_t start= pep_buffer_tell(input);
+            int value_tag= pep_buffer_getc(input);
+            if (value_tag == 'N') {
+                pep_log_warn("xacml_response_lazy_unmarshal: XACML request is NULL.");
+            }
+            else {
+                size_t bytes_l;
+                unsigned char * bytes;
+                if (hessian_skip_tag(value_tag,input) != HESSIAN_OK) {
+                    pep_log_error("xacml_response_lazy_unmarshal: can't skip Hessian map<'%s',value>.",key);
+                    hessian_delete(h_map_key);
+                    return PEP_IO_ERROR;
+                }
+                /* copy the request bytes, decoded on xacml_response_getrequest */
+                bytes_l= pep_buffer_tell(input) - start;
+                bytes= calloc(bytes_l,sizeof(unsigned char));
+                if (bytes == NULL) {
+                    pep_log_error("xacml_response_lazy_unmarshal: can't allocate %d request bytes.",(int)bytes_l);
+                    hessian_delete(h_map_key);
+                    return PEP_IO_ERROR;
+                }
+                pep_buffer_seek(input,start);
+                pep_buffer_read(bytes,sizeof(unsigned char),bytes_l,input);
+                if (xacml_response_setrequestbytes(response,bytes,bytes_l) != PEP_XACML_OK) {
+                    pep_log_error("xacml_response_lazy_unmarshal: can't set XACML request bytes in XACML response.");
+                    free(bytes);
+                    hessian_delete(h_map_key);
+                    return PEP_IO_ERROR;
+                }
+            }
+        }
+        else if (strcmp(XACML_HESSIAN_RESPONSE_RESULTS,key) == 0) {
+            hessian_object_t * h_results= hessian_deserialize(input);
+            if (h_results == NULL || xacml_response_results_unmarshal(response,h_results) != PEP_IO_OK) {
+                pep_log_error("xacml_response_lazy_unmarshal: can't unmarshal XACML results.");
+                if (h_results != NULL) hessian_delete(h_results);
+                hessian_delete(h_map_key);
+                return PEP_IO_ERROR;
+            }
+            hessian_delete(h_results);
+        }
+        else {
+            pep_log_warn("xacml_response_lazy_unmarshal: unknown Hessian map<key>: %s.",key);
+            if (hessian_skip(input) != HESSIAN_OK) {
+                pep_log_error("xacml_response_lazy_unmarshal: can't skip Hessian map<'%s',value>.",key);
+                hessian_delete(h_map_key);
+                return PEP_IO_ERROR;
+            }
+        }
+        hessian_delete(h_map_key);
+        next_tag= pep_buffer_getc(input);
+    }
+    return PEP_IO_OK;
+}
+
+pep_error_t xacml_response_lazy_unmarshalling(xacml_response_t ** response, pep_buffer_t * input) {
+    xacml_response_t * lazy_response= xacml_response_create();
+    if (lazy_response == NULL) {
+        pep_log_error("xacml_response_lazy_unmarshalling: can't create XACML response.");
+        return PEP_ERR_MEMORY;
+    }
+    if (xacml_response_lazy_unmarshal(lazy_response,input) != PEP_IO_OK) {
+        pep_log_error("xacml_response_lazy_unmarshalling: can't unmarshal XACML response.");
+        xacml_response_delete(lazy_response);
+        return PEP_ERR_UNMARSHALLING_HESSIAN;
+    }
+    *response= lazy_response;
+    return PEP_OK;
+}
+
+/* max size of the strings read by the decision-only decoder */
+#define DECISION_STRING_SIZE 1024
+
+/*
+ * Reads the Hessian string of the tag ('s' chunks, final 'S' or null 'N') into
+ * str, without allocation. A string too long for str is consumed and returned
+ * empty, like a null string.
+ */
+static int decision_read_string(int tag, pep_buffer_t * input, char * str, size_t str_size) {
+    size_t str_l= 0;
+    int overflow= 0;
+    if (tag == 'N') {
+        str[0]= '\0';
+        return PEP_IO_OK;
+    }
+    if (tag != 's' && tag != 'S') {
+        pep_log_error("decision_read_string: wrong Hessian tag: %c (%d).",(char)tag,tag);
+        return PEP_IO_ERROR;
+    }
+    for (;;) {
+        int b16= pep_buffer_getc(input);
+        int b8= pep_buffer_getc(input);
+        size_t utf8_l, n_utf8;
+        if (b16 == BUFFER_EOF || b8 == BUFFER_EOF) {
+            pep_log_error("decision_read_string: truncated Hessian string.");
+            return PEP_IO_ERROR;
+        }
+        utf8_l= (b16 << 8) + b8;
+        for (n_utf8= 0; n_utf8 < utf8_l; n_utf8++) {
+            int byte= pep_buffer_getc(input);
+            size_t n_mbyte= hessian_utf8_trailing(byte);
+            for (;;) {
+                if (byte == BUFFER_EOF) {
+                    pep_log_error("decision_read_string: truncated Hessian string, %d UTF-8 chars expected.",(int)utf8_l);
+                    return PEP_IO_ERROR;
+                }
+                if (str_l + 1 < str_size) str[str_l++]= (char)byte;
+                else overflow= 1;
+                if (n_mbyte == 0) break;
+                n_mbyte--;
+                byte= pep_buffer_getc(input);
+            }
+        }
+        if (tag == 'S') break;
+        tag= pep_buffer_getc(input);
+        if (tag != 's' && tag != 'S') {
+            pep_log_error("decision_read_string: invalid chunk tag: %c (%d).",(char)tag,tag);
+            return PEP_IO_ERROR;
+        }
+    }
+    if (overflow) {
+        pep_log_warn("decision_read_string: Hessian string longer than %d bytes ignored.",(int)str_size - 1);
+        str_l= 0;
+    }
+    str[str_l]= '\0';
+    return PEP_IO_OK;
+}
+
+/*
+ * Reads the optional 't' type of a Hessian map (after the 'M' tag) and checks
+ * it against the class name. Returns the tag of the first key in next_tag.
+ */
+static int decision_read_maptype(pep_buffer_t * input, const char * classname, int * next_tag) {
+    char map_type[DECISION_STRING_SIZE];
+    *next_tag= pep_buffer_getc(input);
+    if (*next_tag != 't') return PEP_IO_OK;
+    if (decision_read_string('S',input,map_type,sizeof(map_type)) != PEP_IO_OK || strcmp(classname,map_type) != 0) {
+        pep_log_error("decision_read_maptype: wrong Hessian map type: %s, expected: %s.",map_type,classname);
+        return PEP_IO_ERROR;
+    }
+    *next_tag= pep_buffer_getc(input);
+    return PEP_IO_OK;
+}
+
+/*
+ * Reads the optional 't' type and 'l' length of a Hessian list (after the 'V'
+ * tag). Returns the tag of the first element in next_tag.
+ */
+static int decision_read_listheader(pep_buffer_t * input, int * next_tag) {
+    char list_type[DECISION_STRING_SIZE];
+    *next_tag= pep_buffer_getc(input);
+    if (*next_tag == 't') {
+        if (decision_read_string('S',input,list_type,sizeof(list_type)) != PEP_IO_OK) {
+            pep_log_error("decision_read_listheader: can't read Hessian list type.");
+            return PEP_IO_ERROR;
+        }
+        *next_tag= pep_buffer_getc(input);
+    }
+    if (*next_tag == 'l') {
+        unsigned char length[4];
+        if (pep_buffer_read(length,sizeof(unsigned char),4,input) != 4) {
+            pep_log_error("decision_read_listheader: truncated Hessian list length.");
+            return PEP_IO_ERROR;
+        }
+        *next_tag= pep_buffer_getc(input);
+    }
+    return PEP_IO_OK;
+}
+
+/*
+ * Reads the next Hessian map key into key. Returns PEP_IO_ERROR on a truncated
+ * map or a key which is not a string.
+ */
+static int decision_read_key(int tag, pep_buffer_t * input, char * key, size_t key_size) {
+    if (tag == BUFFER_EOF) {
+        pep_log_error("decision_read_key: truncated Hessian map.");
+        return PEP_IO_ERROR;
+    }
+    if (decision_read_string(tag,input,key,key_size) != PEP_IO_OK) {
+        pep_log_error("decision_read_key: Hessian map<key> is not an Hessian string.");
+        return PEP_IO_ERROR;
+    }
+    return PEP_IO_OK;
+}
+
+/* skips the value of the map pair<key,value> */
+static int decision_skip_value(const char * key, pep_buffer_t * input) {
+    if (hessian_skip(input) != HESSIAN_OK) {
+        pep_log_error("decision_skip_value: can't skip Hessian map<'%s',value>.",key);
+        return PEP_IO_ERROR;
+    }
+    return PEP_IO_OK;
+}
+
+/* reads the 'code' value of the Hessian StatusCode map (or null) into statuscode */
+static int decision_statuscode(pep_buffer_t * input, char * statuscode, size_t statuscode_size) {
+    char key[DECISION_STRING_SIZE];
+    int next_tag= pep_buffer_getc(input);
+    if (next_tag == 'N') return PEP_IO_OK;
+    if (next_tag != 'M' || decision_read_maptype(input,XACML_HESSIAN_STATUSCODE_CLASSNAME,&next_tag) != PEP_IO_OK) {
+        pep_log_error("decision_statuscode: Hessian map<'%s',value> is not a Hessian map.",XACML_HESSIAN_STATUS_CODE);
+        return PEP_IO_ERROR;
+    }
+    while (next_tag != 'z') {
+        if (decision_read_key(next_tag,input,key,sizeof(key)) != PEP_IO_OK) return PEP_IO_ERROR;
+        if (strcmp(XACML_HESSIAN_STATUSCODE_VALUE,key) == 0) {
+            if (decision_read_string(pep_buffer_getc(input),input,statuscode,statuscode_size) != PEP_IO_OK) {
+                pep_log_error("decision_statuscode: Hessian map<'%s',value> is not a Hessian string.",key);
+                return PEP_IO_ERROR;
+            }
+        }
+        else if (decision_skip_value(key,input) != PEP_IO_OK) {
+            return PEP_IO_ERROR;
+        }
+        next_tag= pep_buffer_getc(input);
+    }
+    return PEP_IO_OK;
+}
+
+/* reads the status code value of the Hessian Status map (or null) into statuscode */
+static int decision_status(pep_buffer_t * input, char * statuscode, size_t statuscode_size) {
+    char key[DECISION_STRING_SIZE];
+    int next_tag= pep_buffer_getc(input);
+    if (next_tag == 'N') return PEP_IO_OK;
+    if (next_tag != 'M' || decision_read_maptype(input,XACML_HESSIAN_STATUS_CLASSNAME,&next_tag) != PEP_IO_OK) {
+        pep_log_error("decision_status: Hessian map<'%s',value> is not a Hessian map.",XACML_HESSIAN_RESULT_STATUS);
+        return PEP_IO_ERROR;
+    }
+    while (next_tag != 'z') {
+        if (decision_read_key(next_tag,input,key,sizeof(key)) != PEP_IO_OK) return PEP_IO_ERROR;
+        if (strcmp(XACML_HESSIAN_STATUS_CODE,key) == 0) {
+            if (decision_statuscode(input,statuscode,statuscode_size) != PEP_IO_OK) return PEP_IO_ERROR;
+        }
+        else if (decision_skip_value(key,input) != PEP_IO_OK) {
+            return PEP_IO_ERROR;
+        }
+        next_tag= pep_buffer_getc(input);
+    }
+    return PEP_IO_OK;
+}
+
+/*
+ * Scans the Hessian Obligation map for its id and, if the handler wants it,
+ * rereads the map from its start position and unmarshals the obligation.
+ */
+static int decision_obligation(pep_buffer_t * input, size_t start, int result_idx, const xacml_decision_handler_t * handler) {
+    char key[DECISION_STRING_SIZE];
+    char obligationid[DECISION_STRING_SIZE];
+    hessian_object_t * h_obligation;
+    xacml_obligation_t * obligation= NULL;
+    int next_tag;
+    obligationid[0]= '\0';
+    if (decision_read_maptype(input,XACML_HESSIAN_OBLIGATION_CLASSNAME,&next_tag) != PEP_IO_OK) return PEP_IO_ERROR;
+    while (next_tag != 'z') {
+        if (decision_read_key(next_tag,input,key,sizeof(key)) != PEP_IO_OK) return PEP_IO_ERROR;
+        if (strcmp(XACML_HESSIAN_OBLIGATION_ID,key) == 0) {
+            if (decision_read_string(pep_buffer_getc(input),input,obligationid,sizeof(obligationid)) != PEP_IO_OK) {
+                pep_log_error("decision_obligation: Hessian map<'%s',value> is not a Hessian string.",key);
+                return PEP_IO_ERROR;
+            }
+        }
+        else if (decision_skip_value(key,input) != PEP_IO_OK) {
+            return PEP_IO_ERROR;
+        }
+        next_tag= pep_buffer_getc(input);
+    }
+    if (obligationid[0] == '\0' || !handler->wants(handler->arg,result_idx,obligationid)) {
+        return PEP_IO_OK;
+    }
+    pep_buffer_seek(input,start);
+    h_obligation= hessian_deserialize(input);
+    if (h_obligation == NULL || xacml_obligation_unmarshal(&obligation,h_obligation) != PEP_IO_OK) {
+        pep_log_error("decision_obligation: can't unmarshal XACML obligation: %s.",obligationid);
+        if (h_obligation != NULL) hessian_delete(h_obligation);
+        return PEP_IO_ERROR;
+    }
+    hessian_delete(h_obligation);
+    return handler->obligation(handler->arg,result_idx,obligation);
+}
+
+/* parses the Hessian list of obligations (or null) of a result */
+static int decision_obligations(pep_buffer_t * input, int result_idx, const xacml_decision_handler_t * handler) {
+    int next_tag= pep_buffer_getc(input);
+    if (next_tag == 'N') return PEP_IO_OK;
+    if (next_tag != 'V' || decision_read_listheader(input,&next_tag) != PEP_IO_OK) {
+        pep_log_error("decision_obligations: Hessian map<'%s',value> is not a Hessian list.",XACML_HESSIAN_RESULT_OBLIGATIONS);
+        return PEP_IO_ERROR;
+    }
+    while (next_tag != 'z') {
+        /* position of the map 'M' tag */
+        size_t start= pep_buffer_tell(input) - 1;
+        if (next_tag != 'M') {
+            pep_log_error("decision_obligations: XACML obligation is not a Hessian map: %c (%d).",(char)next_tag,next_tag);
+            return PEP_IO_ERROR;
+        }
+        if (decision_obligation(input,start,result_idx,handler) != PEP_IO_OK) return PEP_IO_ERROR;
+        next_tag= pep_buffer_getc(input);
+    }
+    return PEP_IO_OK;
+}
+
+/* parses the Hessian Result map (after the 'M' tag) */
+static int decision_result(pep_buffer_t * input, int result_idx, const xacml_decision_handler_t * handler) {
+    char key[DECISION_STRING_SIZE];
+    char statuscode[DECISION_STRING_SIZE];
+    xacml_decision_t decision= XACML_DECISION_DENY;
+    int next_tag;
+    statuscode[0]= '\0';
+    if (decision_read_maptype(input,XACML_HESSIAN_RESULT_CLASSNAME,&next_tag) != PEP_IO_OK) return PEP_IO_ERROR;
+    while (next_tag != 'z') {
+        if (decision_read_key(next_tag,input,key,sizeof(key)) != PEP_IO_OK) return PEP_IO_ERROR;
+        /* decision (enum, mandatory) */
+        if (strcmp(XACML_HESSIAN_RESULT_DECISION,key) == 0) {
+            unsigned char b[4];
+            int32_t value;
+            if (pep_buffer_getc(input) != 'I' || pep_buffer_read(b,sizeof(unsigned char),4,input) != 4) {
+                pep_log_error("decision_result: Hessian map<'%s',value> is not a Hessian integer.",key);
+                return PEP_IO_ERROR;
+            }
+            value= (int32_t)(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | (uint32_t)b[3]);
+            if (value < XACML_DECISION_DENY || value > XACML_DECISION_NOT_APPLICABLE) {
+                pep_log_error("decision_result: invalid decision: %d.",(int)value);
+                return PEP_IO_ERROR;
+            }
+            decision= (xacml_decision_t)value;
+        }
+        else if (strcmp(XACML_HESSIAN_RESULT_STATUS,key) == 0) {
+            if (decision_status(input,statuscode,sizeof(statuscode)) != PEP_IO_OK) return PEP_IO_ERROR;
+        }
+        else if (strcmp(XACML_HESSIAN_RESULT_OBLIGATIONS,key) == 0) {
+            if (decision_obligations(input,result_idx,handler) != PEP_IO_OK) return PEP_IO_ERROR;
+        }
+        else if (decision_skip_value(key,input) != PEP_IO_OK) {
+            return PEP_IO_ERROR;
+        }
+        next_tag= pep_buffer_getc(input);
+    }
+    return handler->result(handler->arg,result_idx,decision,(statuscode[0] != '\0') ? statuscode : NULL);
+}
+
+/* parses the Hessian list of results */
+static int decision_results(pep_buffer_t * input, const xacml_decision_handler_t * handler) {
+    int result_idx= 0;
+    int next_tag= pep_buffer_getc(input);
+    if (next_tag != 'V' || decision_read_listheader(input,&next_tag) != PEP_IO_OK) {
+        pep_log_error("decision_results: Hessian map<'%s',value> is not a Hessian list.",XACML_HESSIAN_RESPONSE_RESULTS);
+        return PEP_IO_ERROR;
+    }
+    while (next_tag != 'z') {
+        if (next_tag != 'M') {
+            pep_log_error("decision_results: XACML result is not a Hessian map: %c (%d).",(char)next_tag,next_tag);
+            return PEP_IO_ERROR;
+        }
+        if (decision_result(input,result_idx++,handler) != PEP_IO_OK) return PEP_IO_ERROR;
+        next_tag= pep_buffer_getc(input);
+    }
+    return PEP_IO_OK;
+}
+
+pep_error_t xacml_response_decision_unmarshalling(pep_buffer_t * input, const xacml_decision_handler_t * handler) {
+    char key[DECISION_STRING_SIZE];
+    int next_tag;
+    if (input == NULL || handler == NULL || handler->result == NULL || handler->wants == NULL || handler->obligation == NULL) {
+        pep_log_error("xacml_response_decision_unmarshalling: NULL input buffer or handler callbacks.");
+        return PEP_ERR_NULL_POINTER;
+    }
+    if (pep_buffer_getc(input) != 'M' || decision_read_maptype(input,XACML_HESSIAN_RESPONSE_CLASSNAME,&next_tag) != PEP_IO_OK) {
+        pep_log_error("xacml_response_decision_unmarshalling: XACML response is not a Hessian map.");
+        return PEP_ERR_UNMARSHALLING_HESSIAN;
+    }
+    /* the effective request and the unknown keys are skipped */
+    while (next_tag != 'z') {
+        if (decision_read_key(next_tag,input,key,sizeof(key)) != PEP_IO_OK) {
+            return PEP_ERR_UNMARSHALLING_HESSIAN;
+        }
+        if (strcmp(XACML_HESSIAN_RESPONSE_RESULTS,key) == 0) {
+            if (decision_results(input,handler) != PEP_IO_OK) {
+                pep_log_error("xacml_response_decision_unmarshalling: can't decode XACML results.");
+                return PEP_ERR_UNMARSHALLING_HESSIAN;
+            }
+        }
+        else if (decision_skip_value(key,input) != PEP_IO_OK) {
+            return PEP_ERR_UNMARSHALLING_HESSIAN;
+        }
+        next_tag= pep_buffer_getc(input);
+    }
+    return PEP_OK;
+}
+
+/* adds the Hessian list of results to the XACML response */
+static int xacml_response_results_unmarshal(xacml_response_t * response, const hessian_object_t * h_results) {
+    size_t h_results_l;
+    int j;
+    if (hessian_gettype(h_results) != HESSIAN_LIST) {
+        pep_log_error("xacml_response_results_unmarshal: Hessian map<'%s',value> is not a Hessian list.",XACML_HESSIAN_RESPONSE_RESULTS);
+        return PEP_IO_ERROR;
+    }
+    h_results_l= hessian_list_length(h_results);
+    for(j= 0; j<h_results_l; j++) {
+        hessian_object_t * h_result= hessian_list_get(h_results,j);
+        xacml_result_t * result= NULL;
+        if (xacml_result_unmarshal(&result,h_result) != PEP_IO_OK) {
+            pep_log_error("xacml_response_results_unmarshal: can't unmarshal XACML result at: %d.",j);
+            return PEP_IO_ERROR;
+        }
+        if (xacml_response_addresult(response,result) != PEP_XACML_OK) {
+            pep_log_error("xacml_response_results_unmarshal: can't add XACML result at: %d to XACML response.",j);
+            xacml_result_delete(result);
+            return PEP_IO_ERROR;
+        }
+    }
+    return PEP_IO_OK;
+}
+
 /* OK */
 static int xacml_response_unmarshal(xacml_response_t ** resp, const hessian_object_t * h_response) {
     const char * map_type;
     xacml_response_t * response;
     size_t map_l;
-    int i, j;
+    int i;
     if (hessian_gettype(h_response) != HESSIAN_MAP) {
         pep_log_error("xacml_response_unmarshal: wrong Hessian type: %d (%s).", hessian_gettype(h_response), hessian_getclassname(h_response));
         return PEP_IO_ERROR;
@@ -1257,29 +1802,11 @@ static int xacml_response_unmarshal(xacml_response_t ** resp, const hessian_obje
         }
         /* results list */
         else if (strcmp(XACML_HESSIAN_RESPONSE_RESULTS,key) == 0) {
-            hessian_object_t * h_results= hessian_map_getvalue(h_response,i);
-            size_t h_results_l;
-            if (hessian_gettype(h_results) != HESSIAN_LIST) {
-                pep_log_error("xacml_response_unmarshal: Hessian map<'%s',value> is not a Hessian list at: %d.",key,i);
+            if (xacml_response_results_unmarshal(response,hessian_map_getvalue(h_response,i)) != PEP_IO_OK) {
+                pep_log_error("xacml_response_unmarshal: can't unmarshal XACML results at: %d.",i);
                 xacml_response_delete(response);
                 return PEP_IO_ERROR;
             }
-            h_results_l= hessian_list_length(h_results);
-            for(j= 0; j<h_results_l; j++) {
-                hessian_object_t * h_result= hessian_list_get(h_results,j);
-                xacml_result_t * result= NULL;
-                if (xacml_result_unmarshal(&result,h_result) != PEP_IO_OK) {
-                    pep_log_error("xacml_response_unmarshal: can't unmarshal XACML result at: %d.",j);
-                    xacml_response_delete(response);
-                    return PEP_IO_ERROR;
-                }
-                if (xacml_response_addresult(response,result) != PEP_XACML_OK) {
-                    pep_log_error("xacml_response_unmarshal: can't add XACML result at: %d to XACML response.",j);
-                    xacml_result_delete(result);
-                    xacml_response_delete(response);
-                    return PEP_IO_ERROR;
-                }
-            }
         }
         else {
             /* unkown key ??? */
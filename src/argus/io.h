@@ -24,6 +24,7 @@ extern "C" {
 
 #include "error.h"
 #include "xacml.h"
+#include "i_xacml.h"
 #include "buffer.h" /* ../util/buffer.h */
 
 /**
@@ -37,6 +38,20 @@ extern "C" {
  */
 pep_error_t xacml_request_marshalling(const xacml_request_t * request, pep_buffer_t * output);
 
+/**
+ * Marshalls one section of the PEP XACML request object and writes the serialized
+ * Hessian <key,value> pair bytes (e.g. "action" and the Action map) into the output
+ * buffer. Used to pre-serialize the XACML request templates.
+ *
+ * @param const xacml_request_t * request the PEP XACML request to marshal.
+ * @param int section the request section: XACML_REQUEST_SUBJECTS, XACML_REQUEST_RESOURCES,
+ *        XACML_REQUEST_ACTION or XACML_REQUEST_ENVIRONMENT.
+ * @param pep_buffer_t * output buffer.
+ *
+ * @return pep_error_t PEP_OK or an error code.
+ */
+pep_error_t xacml_request_section_marshalling(const xacml_request_t * request, int section, pep_buffer_t * output);
+
 /**
  * Reads the serialized Hessian bytes from the input buffer and unmarshalls the PEP
  * XACML response object.
@@ -61,6 +76,57 @@ pep_error_t xacml_request_marshalling(const xacml_request_t * request, pep_buffe
  */
 pep_error_t xacml_response_unmarshalling(xacml_response_t ** response, pep_buffer_t * input);
 
+/**
+ * Reads the serialized Hessian bytes from the input buffer and unmarshalls the PEP
+ * XACML response object, like xacml_response_unmarshalling, except the effective
+ * request: its serialized bytes are kept in the response and only unmarshalled
+ * by xacml_response_getrequest.
+ *
+ * @param xacml_response_t ** response the unmarshalled PEP XACML response (output).
+ * @param pep_buffer_t * input the buffer to read from.
+ *
+ * @return pep_error_t PEP_OK or an error code.
+ */
+pep_error_t xacml_response_lazy_unmarshalling(xacml_response_t ** response, pep_buffer_t * input);
+
+/**
+ * Callbacks of the decision-only response decoder. The result and obligation
+ * callbacks return 0, or -1 to abort the decoding.
+ */
+typedef struct xacml_decision_handler {
+    /* called at the end of each result, statuscode can be NULL */
+    int (*result)(void * arg, int result_idx, xacml_decision_t decision, const char * statuscode);
+    /* called for each obligation id, returns 1 to decode the obligation, 0 to skip it */
+    int (*wants)(void * arg, int result_idx, const char * obligationid);
+    /* receives the decoded obligation and its ownership */
+    int (*obligation)(void * arg, int result_idx, xacml_obligation_t * obligation);
+    void * arg;
+} xacml_decision_handler_t;
+
+/**
+ * Reads the serialized Hessian bytes of a XACML response from the input buffer,
+ * and only decodes the result decisions, the status code values and the obligations
+ * wanted by the handler. Everything else, including the effective request, is skipped
+ * without allocation, and no XACML response object is built.
+ *
+ * @param pep_buffer_t * input the buffer to read from.
+ * @param const xacml_decision_handler_t * handler the callbacks.
+ *
+ * @return pep_error_t PEP_OK or an error code.
+ */
+pep_error_t xacml_response_decision_unmarshalling(pep_buffer_t * input, const xacml_decision_handler_t * handler);
+
+/**
+ * Reads the serialized Hessian bytes from the input buffer and unmarshalls the PEP
+ * XACML request object.
+ *
+ * @param xacml_request_t ** request the unmarshalled PEP XACML request (output).
+ * @param pep_buffer_t * input the buffer to read from.
+ *
+ * @return pep_error_t PEP_OK or an error code.
+ */
+pep_error_t xacml_request_unmarshalling(xacml_request_t ** request, pep_buffer_t * input);
+
 /**
  * The Java class namespaces and variable name constants for the PEP model
  * Hessian serialization and deserialization mapping.
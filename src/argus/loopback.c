@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "loopback.h"
+
+struct pep_loopback {
+    transport_responder_func * responder;
+    void * arg;
+    const unsigned char * response; /* response of the last request */
+    size_t response_l;
+};
+
+static int loopback_send(void * arg, int id, const unsigned char * request, size_t request_l) {
+    pep_loopback_t * loopback= (pep_loopback_t *)arg;
+    int rc;
+    loopback->response= NULL;
+    loopback->response_l= 0;
+    rc= loopback->responder(loopback->arg,id,request,request_l,&(loopback->response),&(loopback->response_l));
+    if (rc != PEP_TRANSPORT_OK || loopback->response == NULL) {
+        pep_log_error("loopback_send: PEP#%d responder failed: %d.",id,rc);
+        loopback->response= NULL;
+        loopback->response_l= 0;
+        return PEP_TRANSPORT_ERROR;
+    }
+    return PEP_TRANSPORT_OK;
+}
+
+static int loopback_receive(void * arg, int id, const unsigned char ** response, size_t * response_l) {
+    pep_loopback_t * loopback= (pep_loopback_t *)arg;
+    if (loopback->response == NULL) {
+        pep_log_error("loopback_receive: PEP#%d no response.",id);
+        return PEP_TRANSPORT_ERROR;
+    }
+    *response= loopback->response;
+    *response_l= loopback->response_l;
+    loopback->response= NULL;
+    loopback->response_l= 0;
+    return PEP_TRANSPORT_OK;
+}
+
+const pep_transport_t pep_loopback_transport= { loopback_send, loopback_receive, NULL, NULL, NULL };
+
+pep_loopback_t * pep_loopback_create(transport_responder_func * responder, void * arg) {
+    pep_loopback_t * loopback;
+    if (responder == NULL) {
+        pep_log_error("pep_loopback_create: NULL responder.");
+        return NULL;
+    }
+    loopback= calloc(1,sizeof(pep_loopback_t));
+    if (loopback == NULL) {
+        pep_log_error("pep_loopback_create: can't allocate pep_loopback_t.");
+        return NULL;
+    }
+    loopback->responder= responder;
+    loopback->arg= arg;
+    return loopback;
+}
+
+void pep_loopback_delete(pep_loopback_t * loopback) {
+    if (loopback == NULL) return;
+    free(loopback);
+}
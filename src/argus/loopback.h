@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+
+#ifndef _PEP_LOOPBACK_H_
+#define _PEP_LOOPBACK_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include "pep.h" /* pep_transport_t, transport_responder_func */
+
+/*
+ * In process loopback transport: the send function passes the request to the
+ * user responder, the receive function returns the responder's response.
+ * The transport argument is the pep_loopback_t.
+ */
+typedef struct pep_loopback pep_loopback_t;
+
+/** The loopback transport functions */
+extern const pep_transport_t pep_loopback_transport;
+
+/**
+ * Creates the loopback transport argument of the responder.
+ *
+ * @return pep_loopback_t * or NULL on error.
+ */
+pep_loopback_t * pep_loopback_create(transport_responder_func * responder, void * arg);
+
+/**
+ * Deletes the loopback transport argument.
+ */
+void pep_loopback_delete(pep_loopback_t * loopback);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -21,11 +21,13 @@
 #include "linkedlist.h" /* ../util/linkedlist.h */
 #include "log.h" /* ../util/log.h */
 #include "xacml.h"
+#include "intern.h"
 
 struct xacml_obligation {
     char * id; /* mandatory */
     xacml_fulfillon_t fulfillon; /* optional */
     pep_linkedlist_t * assignments; /* AttributeAssignments list */
+    int id_interned; /* id from the intern pool */
 };
 
 /* id can be NULL */
@@ -38,18 +40,17 @@ xacml_obligation_t * xacml_obligation_create(const char * id) {
     obligation->id= NULL;
     if (id != NULL) {
         size_t size= strlen(id);
-        obligation->id= calloc(size + 1,sizeof(char));
+        obligation->id= pep_intern_strdup(id,&(obligation->id_interned));
         if (obligation->id == NULL) {
             pep_log_error("xacml_obligation_create: can't allocate id (%d bytes).",(int)size);
             free(obligation);
             return NULL;
         }
-        strncpy(obligation->id,id,size);
     }
     obligation->assignments= pep_llist_create();
     if (obligation->assignments == NULL) {
         pep_log_error("xacml_obligation_create: can't create assignments list.");
-        free(obligation->id);
+        pep_intern_strfree(obligation->id,obligation->id_interned);
         free(obligation);
         return NULL;
     }
@@ -69,15 +70,14 @@ int xacml_obligation_setid(xacml_obligation_t * obligation, const char * id) {
         return PEP_XACML_ERROR;
     }
     if (obligation->id != NULL) {
-        free(obligation->id);
+        pep_intern_strfree(obligation->id,obligation->id_interned);
     }
     size= strlen(id);
-    obligation->id= calloc(size + 1,sizeof(char));
+    obligation->id= pep_intern_strdup(id,&(obligation->id_interned));
     if (obligation->id == NULL) {
         pep_log_error("xacml_obligation_setid: can't allocate id (%d bytes).", (int)size);
         return PEP_XACML_ERROR;
     }
-    strncpy(obligation->id,id,size);
     return PEP_XACML_OK;
 
 }
@@ -151,7 +151,7 @@ xacml_attributeassignment_t * xacml_obligation_getattributeassignment(const xacm
 
 void xacml_obligation_delete(xacml_obligation_t * obligation) {
     if (obligation == NULL) return;
-    if (obligation->id != NULL) free(obligation->id);
+    if (obligation->id != NULL) pep_intern_strfree(obligation->id,obligation->id_interned);
     pep_llist_delete_elements(obligation->assignments,(pep_llist_delete_elt_f)xacml_attributeassignment_delete);
     pep_llist_delete(obligation->assignments);
     free(obligation);
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "obligationview.h"
+#include "intern.h"
+
+struct pep_obligation_view {
+    char ** obligationids; /* selected ids */
+    int * obligationids_interned;
+    size_t obligationids_l;
+    xacml_obligation_t ** obligations;
+    size_t obligations_l;
+    size_t obligations_size; /* capacity, kept across calls */
+    char * statuscode;
+    int statuscode_interned;
+};
+
+pep_obligation_view_t * pep_obligation_view_create(const char * const * obligationids) {
+    pep_obligation_view_t * view;
+    size_t ids_l= 0, i;
+    if (obligationids != NULL) {
+        while (obligationids[ids_l] != NULL) ids_l++;
+    }
+    view= calloc(1,sizeof(pep_obligation_view_t));
+    if (view == NULL) {
+        pep_log_error("pep_obligation_view_create: can't allocate pep_obligation_view_t.");
+        return NULL;
+    }
+    if (ids_l > 0) {
+        view->obligationids= calloc(ids_l,sizeof(char *));
+        view->obligationids_interned= calloc(ids_l,sizeof(int));
+        if (view->obligationids == NULL || view->obligationids_interned == NULL) {
+            pep_log_error("pep_obligation_view_create: can't allocate %d obligation ids.",(int)ids_l);
+            pep_obligation_view_delete(view);
+            return NULL;
+        }
+        for (i= 0; i < ids_l; i++) {
+            view->obligationids[i]= pep_intern_strdup(obligationids[i],&(view->obligationids_interned[i]));
+            if (view->obligationids[i] == NULL) {
+                pep_log_error("pep_obligation_view_create: can't copy obligation id: %s.",obligationids[i]);
+                pep_obligation_view_delete(view);
+                return NULL;
+            }
+            view->obligationids_l++;
+        }
+    }
+    return view;
+}
+
+void pep_obligation_view_reset(pep_obligation_view_t * view) {
+    size_t i;
+    if (view == NULL) return;
+    for (i= 0; i < view->obligations_l; i++) {
+        xacml_obligation_delete(view->obligations[i]);
+        view->obligations[i]= NULL;
+    }
+    view->obligations_l= 0;
+    if (view->statuscode != NULL) {
+        pep_intern_strfree(view->statuscode,view->statuscode_interned);
+        view->statuscode= NULL;
+    }
+}
+
+int pep_obligation_view_wants(const pep_obligation_view_t * view, const char * obligationid) {
+    size_t i;
+    if (view == NULL || obligationid == NULL) return 0;
+    for (i= 0; i < view->obligationids_l; i++) {
+        if (strcmp(view->obligationids[i],obligationid) == 0) return 1;
+    }
+    return 0;
+}
+
+int pep_obligation_view_add(pep_obligation_view_t * view, xacml_obligation_t * obligation) {
+    if (view == NULL || obligation == NULL) {
+        pep_log_error("pep_obligation_view_add: NULL view or obligation.");
+        return PEP_XACML_ERROR;
+    }
+    if (view->obligations_l >= view->obligations_size) {
+        size_t size= (view->obligations_size > 0) ? 2 * view->obligations_size : 4;
+        xacml_obligation_t ** obligations= realloc(view->obligations,size * sizeof(xacml_obligation_t *));
+        if (obligations == NULL) {
+            pep_log_error("pep_obligation_view_add: can't grow obligations array to %d.",(int)size);
+            return PEP_XACML_ERROR;
+        }
+        view->obligations= obligations;
+        view->obligations_size= size;
+    }
+    view->obligations[view->obligations_l++]= obligation;
+    return PEP_XACML_OK;
+}
+
+int pep_obligation_view_setstatuscode(pep_obligation_view_t * view, const char * statuscode) {
+    if (view == NULL) return PEP_XACML_ERROR;
+    if (view->statuscode != NULL) {
+        pep_intern_strfree(view->statuscode,view->statuscode_interned);
+        view->statuscode= NULL;
+    }
+    if (statuscode != NULL) {
+        view->statuscode= pep_intern_strdup(statuscode,&(view->statuscode_interned));
+        if (view->statuscode == NULL) {
+            pep_log_error("pep_obligation_view_setstatuscode: can't copy status code: %s.",statuscode);
+            return PEP_XACML_ERROR;
+        }
+    }
+    return PEP_XACML_OK;
+}
+
+size_t pep_obligation_view_length(const pep_obligation_view_t * view) {
+    return (view != NULL) ? view->obligations_l : 0;
+}
+
+const xacml_obligation_t * pep_obligation_view_get(const pep_obligation_view_t * view, int i) {
+    if (view == NULL || i < 0 || (size_t)i >= view->obligations_l) return NULL;
+    return view->obligations[i];
+}
+
+const char * pep_obligation_view_getstatuscode(const pep_obligation_view_t * view) {
+    return (view != NULL) ? view->statuscode : NULL;
+}
+
+void pep_obligation_view_delete(pep_obligation_view_t * view) {
+    size_t i;
+    if (view == NULL) return;
+    pep_obligation_view_reset(view);
+    if (view->obligations != NULL) free(view->obligations);
+    for (i= 0; i < view->obligationids_l; i++) {
+        pep_intern_strfree(view->obligationids[i],view->obligationids_interned[i]);
+    }
+    if (view->obligationids != NULL) free(view->obligationids);
+    if (view->obligationids_interned != NULL) free(view->obligationids_interned);
+    free(view);
+}
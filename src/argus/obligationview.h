@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_OBLIGATIONVIEW_H_
+#define _PEP_OBLIGATIONVIEW_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include "pep.h"
+
+/*
+ * Internal functions of the pep_obligation_view_t, filled by
+ * pep_authorize_decision while decoding the first result of the response.
+ */
+
+/**
+ * Deletes the obligations and the status code of the previous call. The
+ * obligations array is kept for the next call.
+ */
+void pep_obligation_view_reset(pep_obligation_view_t * view);
+
+/**
+ * Returns 1 if the obligation id is one of the selected ids, 0 otherwise.
+ */
+int pep_obligation_view_wants(const pep_obligation_view_t * view, const char * obligationid);
+
+/**
+ * Adds the obligation to the view, the view takes the ownership of the
+ * obligation.
+ *
+ * @return int PEP_XACML_OK or PEP_XACML_ERROR.
+ */
+int pep_obligation_view_add(pep_obligation_view_t * view, xacml_obligation_t * obligation);
+
+/**
+ * Sets the status code value of the result, can be NULL.
+ *
+ * @return int PEP_XACML_OK or PEP_XACML_ERROR.
+ */
+int pep_obligation_view_setstatuscode(pep_obligation_view_t * view, const char * statuscode);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -86,6 +86,77 @@ typedef struct pep_obligationhandler {
 	oh_process_func * process; /**< pointer to the OH process function */
 	oh_destroy_func * destroy; /**< pointer to the OH destroy function */
 } pep_obligationhandler_t;
+
+/**
+ * Obligation handler version 2 init function prototype.
+ *
+ * The init(arg,&ctx) function is called when the OH is added to a PEP client, and
+ * creates the OH context of this PEP client.
+ *
+ * @param void * arg the argument given to pep_addobligationhandler2(...)
+ * @param void ** ctx address of the OH context pointer to set
+ * @return 0 on success or an error code.
+ * @see pep_addobligationhandler2(PEP * pep, const pep_obligationhandler2_t * oh, void * arg)
+ */
+typedef int oh2_init_func(void * arg, void ** ctx);
+
+/**
+ * Obligation handler version 2 process function prototype.
+ *
+ * The process(ctx,&request,&response) function is called with the OH context of the PEP client.
+ *
+ * The request can share its Subjects, Resources, Action and Environment with a request
+ * template: the OH modifies them through the xacml_request_edit* functions.
+ *
+ * @param void * ctx the OH context set by init
+ * @param xacml_request_t ** address of the pointer to the PEP request
+ * @param xacml_response_t ** address of the pointer to the PEP response
+ * @return 0 on success or an error code.
+ */
+typedef int oh2_process_func(void * ctx, xacml_request_t **, xacml_response_t **);
+
+/**
+ * Obligation handler version 2 destroy function prototype.
+ *
+ * The destroy(ctx) function is called when the PEP client is destroyed, and releases
+ * the OH context.
+ *
+ * @param void * ctx the OH context set by init
+ * @return 0 on success or an error code.
+ */
+typedef int oh2_destroy_func(void * ctx);
+
+/**
+ * Obligation handler version 2 obligation function prototype.
+ *
+ * When the OH declares the Obligation ids it handles, the obligation(ctx,&request,&response,result,obligation)
+ * function is called by the pep_authorize(...) function once for each Obligation of the response
+ * with one of these ids, in the response order, instead of the process(ctx,&request,&response) function.
+ * The OH is not called at all if the response contains none of these Obligations.
+ *
+ * The function can add Obligations to the result, but must not remove any. The request
+ * is modified only through the xacml_request_edit* functions, as in process.
+ *
+ * @param void * ctx the OH context set by init
+ * @param xacml_request_t ** address of the pointer to the PEP request
+ * @param xacml_response_t ** address of the pointer to the PEP response
+ * @param xacml_result_t * the Result containing the Obligation
+ * @param xacml_obligation_t * the Obligation to handle
+ * @return 0 on success or an error code.
+ */
+typedef int oh2_obligation_func(void * ctx, xacml_request_t **, xacml_response_t **, xacml_result_t *, xacml_obligation_t *);
+
+/**
+ * Obligation Handler version 2 type: the functions get the OH context of the PEP client.
+ */
+typedef struct pep_obligationhandler2 {
+	char * id; /**< unique identifier for the OH */
+	oh2_init_func * init; /**< pointer to the OH init function */
+	oh2_process_func * process; /**< pointer to the OH process function */
+	oh2_destroy_func * destroy; /**< pointer to the OH destroy function */
+	const char * const * obligation_ids; /**< @a NULL terminated array of the handled Obligation ids, or @a NULL to call process for every response */
+	oh2_obligation_func * obligation; /**< pointer to the OH obligation function, called for each handled Obligation */
+} pep_obligationhandler2_t;
 /** @} */
 
 
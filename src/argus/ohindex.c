@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "ohindex.h"
+
+/* internal entry: chained by obligation id */
+typedef struct ohindex_node {
+    pep_ohindex_entry_t entry;
+    unsigned long hash;
+    int next; /* next node with the same id, or -1 */
+} ohindex_node_t;
+
+struct pep_ohindex {
+    const xacml_response_t * response; /* indexed response */
+    size_t results_l;
+    size_t * obligations_l; /* indexed obligations per result */
+    xacml_result_t ** results; /* indexed results, to detect a changed response */
+    ohindex_node_t * nodes;
+    size_t nodes_l;
+    size_t nodes_size;
+    int * buckets; /* first node + 1, 0 if empty */
+    size_t buckets_mask;
+    int valid;
+};
+
+/* FNV-1a hash of the id */
+static unsigned long ohindex_hash(const char * id) {
+    unsigned long hash= 2166136261UL;
+    while (*id != '\0') {
+        hash^= (unsigned char)*id++;
+        hash*= 16777619UL;
+    }
+    return hash;
+}
+
+/* empties the index */
+static void ohindex_clear(pep_ohindex_t * index) {
+    if (index->obligations_l != NULL) free(index->obligations_l);
+    if (index->results != NULL) free(index->results);
+    index->obligations_l= NULL;
+    index->results= NULL;
+    index->results_l= 0;
+    index->nodes_l= 0;
+    if (index->buckets != NULL) memset(index->buckets,0,(index->buckets_mask + 1) * sizeof(int));
+    index->response= NULL;
+    index->valid= 0;
+}
+
+/* doubles the buckets if nodes_l nodes exceed the 0.5 load factor, and rehashes */
+static int ohindex_grow(pep_ohindex_t * index, size_t nodes_l) {
+    size_t buckets_l= (index->buckets != NULL) ? index->buckets_mask + 1 : 16;
+    int * buckets;
+    int i;
+    if (index->buckets != NULL && nodes_l <= buckets_l / 2) return OHINDEX_OK;
+    if (index->buckets != NULL) buckets_l*= 2;
+    buckets= calloc(buckets_l,sizeof(int));
+    if (buckets == NULL) {
+        pep_log_error("ohindex_grow: can't allocate %d buckets.",(int)buckets_l);
+        return OHINDEX_ERROR;
+    }
+    if (index->buckets != NULL) free(index->buckets);
+    index->buckets= buckets;
+    index->buckets_mask= buckets_l - 1;
+    /* rechain in the insertion order */
+    for (i= index->nodes_l - 1; i >= 0; i--) {
+        size_t bucket= index->nodes[i].hash & index->buckets_mask;
+        index->nodes[i].next= index->buckets[bucket] - 1;
+        index->buckets[bucket]= i + 1;
+    }
+    return OHINDEX_OK;
+}
+
+/* appends an obligation to the index */
+static int ohindex_add(pep_ohindex_t * index, xacml_result_t * result, xacml_obligation_t * obligation) {
+    const char * id= xacml_obligation_getid(obligation);
+    ohindex_node_t * node;
+    size_t bucket;
+    int last;
+    if (id == NULL) return OHINDEX_OK;
+    if (ohindex_grow(index,index->nodes_l + 1) != OHINDEX_OK) return OHINDEX_ERROR;
+    if (index->nodes_l == index->nodes_size) {
+        size_t size= (index->nodes_size > 0) ? index->nodes_size * 2 : 16;
+        ohindex_node_t * nodes= realloc(index->nodes,size * sizeof(ohindex_node_t));
+        if (nodes == NULL) {
+            pep_log_error("ohindex_add: can't allocate %d nodes.",(int)size);
+            return OHINDEX_ERROR;
+        }
+        index->nodes= nodes;
+        index->nodes_size= size;
+    }
+    node= &(index->nodes[index->nodes_l]);
+    node->entry.result= result;
+    node->entry.obligation= obligation;
+    node->entry.seq= index->nodes_l;
+    node->hash= ohindex_hash(id);
+    node->next= -1;
+    index->nodes_l++;
+    /* append at the end of the chain, keeps the response order */
+    bucket= node->hash & index->buckets_mask;
+    if (index->buckets[bucket] == 0) {
+        index->buckets[bucket]= index->nodes_l;
+        return OHINDEX_OK;
+    }
+    last= index->buckets[bucket] - 1;
+    while (index->nodes[last].next >= 0) last= index->nodes[last].next;
+    index->nodes[last].next= index->nodes_l - 1;
+    return OHINDEX_OK;
+}
+
+/* checks the indexed results are still the response results */
+static int ohindex_isvalid(const pep_ohindex_t * index, const xacml_response_t * response) {
+    int i;
+    if (!index->valid || index->response != response) return 0;
+    if (xacml_response_results_length(response) < index->results_l) return 0;
+    for (i= 0; i < index->results_l; i++) {
+        xacml_result_t * result= xacml_response_getresult(response,i);
+        if (result != index->results[i] || xacml_result_obligations_length(result) < index->obligations_l[i]) return 0;
+    }
+    return 1;
+}
+
+pep_ohindex_t * pep_ohindex_create(void) {
+    pep_ohindex_t * index= calloc(1,sizeof(pep_ohindex_t));
+    if (index == NULL) {
+        pep_log_error("pep_ohindex_create: can't allocate pep_ohindex_t.");
+        return NULL;
+    }
+    return index;
+}
+
+int pep_ohindex_update(pep_ohindex_t * index, const xacml_response_t * response) {
+    size_t results_l;
+    int i, j;
+    if (index == NULL || response == NULL) {
+        pep_log_error("pep_ohindex_update: NULL index or response.");
+        return OHINDEX_ERROR;
+    }
+    if (!ohindex_isvalid(index,response)) {
+        ohindex_clear(index);
+    }
+    results_l= xacml_response_results_length(response);
+    if (results_l > index->results_l) {
+        size_t * obligations_l= realloc(index->obligations_l,results_l * sizeof(size_t));
+        xacml_result_t ** results;
+        if (obligations_l == NULL) {
+            pep_log_error("pep_ohindex_update: can't allocate %d results.",(int)results_l);
+            return OHINDEX_ERROR;
+        }
+        index->obligations_l= obligations_l;
+        results= realloc(index->results,results_l * sizeof(xacml_result_t *));
+        if (results == NULL) {
+            pep_log_error("pep_ohindex_update: can't allocate %d results.",(int)results_l);
+            return OHINDEX_ERROR;
+        }
+        index->results= results;
+        for (i= index->results_l; i < results_l; i++) {
+            index->results[i]= xacml_response_getresult(response,i);
+            index->obligations_l[i]= 0;
+        }
+        index->results_l= results_l;
+    }
+    /* index the new obligations */
+    for (i= 0; i < results_l; i++) {
+        xacml_result_t * result= index->results[i];
+        size_t obligations_l= xacml_result_obligations_length(result);
+        for (j= index->obligations_l[i]; j < obligations_l; j++) {
+            if (ohindex_add(index,result,xacml_result_getobligation(result,j)) != OHINDEX_OK) {
+                ohindex_clear(index);
+                return OHINDEX_ERROR;
+            }
+        }
+        index->obligations_l[i]= obligations_l;
+    }
+    index->response= response;
+    index->valid= 1;
+    return OHINDEX_OK;
+}
+
+void pep_ohindex_invalidate(pep_ohindex_t * index) {
+    if (index != NULL) index->valid= 0;
+}
+
+static int ohindex_compare(const void * a, const void * b) {
+    size_t seq_a= ((const pep_ohindex_entry_t *)a)->seq;
+    size_t seq_b= ((const pep_ohindex_entry_t *)b)->seq;
+    return (seq_a > seq_b) - (seq_a < seq_b);
+}
+
+size_t pep_ohindex_lookup(const pep_ohindex_t * index, const char * const * ids, pep_ohindex_entry_t ** entries) {
+    size_t entries_l= 0, entries_size= 0;
+    int i, n, ids_l= 0;
+    if (entries == NULL) return 0;
+    *entries= NULL;
+    if (index == NULL || ids == NULL || index->nodes_l == 0) return 0;
+    for (i= 0; ids[i] != NULL; i++) {
+        const char * id= ids[i];
+        unsigned long hash= ohindex_hash(id);
+        ids_l++;
+        for (n= index->buckets[hash & index->buckets_mask] - 1; n >= 0; n= index->nodes[n].next) {
+            const ohindex_node_t * node= &(index->nodes[n]);
+            if (node->hash != hash || strcmp(xacml_obligation_getid(node->entry.obligation),id) != 0) continue;
+            if (entries_l == entries_size) {
+                size_t size= (entries_size > 0) ? entries_size * 2 : 4;
+                pep_ohindex_entry_t * array= realloc(*entries,size * sizeof(pep_ohindex_entry_t));
+                if (array == NULL) {
+                    pep_log_error("pep_ohindex_lookup: can't allocate %d entries.",(int)size);
+                    free(*entries);
+                    *entries= NULL;
+                    return 0;
+                }
+                *entries= array;
+                entries_size= size;
+            }
+            (*entries)[entries_l++]= node->entry;
+        }
+    }
+    /* several ids: back in the response order */
+    if (ids_l > 1 && entries_l > 1) {
+        qsort(*entries,entries_l,sizeof(pep_ohindex_entry_t),ohindex_compare);
+    }
+    return entries_l;
+}
+
+void pep_ohindex_delete(pep_ohindex_t * index) {
+    if (index == NULL) return;
+    ohindex_clear(index);
+    if (index->nodes != NULL) free(index->nodes);
+    if (index->buckets != NULL) free(index->buckets);
+    free(index);
+}
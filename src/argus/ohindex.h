@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_OHINDEX_H_
+#define _PEP_OHINDEX_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+
+#include "xacml.h"
+
+/** pep_ohindex_* return codes */
+#define OHINDEX_OK      0
+#define OHINDEX_ERROR  -1
+
+/*
+ * Hash index of the Obligations of a response by Obligation id, used to
+ * dispatch the Obligations to the OHs handling them in a single pass.
+ */
+typedef struct pep_ohindex pep_ohindex_t;
+
+/**
+ * Indexed Obligation and its Result.
+ */
+typedef struct pep_ohindex_entry {
+    xacml_result_t * result;
+    xacml_obligation_t * obligation;
+    size_t seq; /* position in the response */
+} pep_ohindex_entry_t;
+
+/**
+ * Creates an empty index.
+ *
+ * @return pep_ohindex_t * the index or NULL on error.
+ */
+pep_ohindex_t * pep_ohindex_create(void);
+
+/**
+ * Indexes the Obligations of the response. Only the Obligations added since
+ * the last call are indexed, unless the response or one of its Results
+ * changed or pep_ohindex_invalidate was called.
+ *
+ * @return int OHINDEX_OK or OHINDEX_ERROR.
+ */
+int pep_ohindex_update(pep_ohindex_t * index, const xacml_response_t * response);
+
+/**
+ * Marks the index as invalid, the next update rebuilds it.
+ */
+void pep_ohindex_invalidate(pep_ohindex_t * index);
+
+/**
+ * Looks up the Obligations with one of the ids.
+ *
+ * @param const char * const * ids NULL terminated array of Obligation ids.
+ * @param pep_ohindex_entry_t ** entries set to the array of matching entries,
+ *        in the response order, to free by the caller (NULL if none).
+ * @return size_t the number of matching entries.
+ */
+size_t pep_ohindex_lookup(const pep_ohindex_t * index, const char * const * ids, pep_ohindex_entry_t ** entries);
+
+/**
+ * Deletes the index.
+ */
+void pep_ohindex_delete(pep_ohindex_t * index);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -17,9 +17,14 @@
 
 /* $Id$ */
 
+/* stat, geteuid */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdarg.h>  /* va_list, va_arg, ... */
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <curl/curl.h>
 
 /* from ../util */
@@ -27,10 +32,23 @@
 #include "buffer.h"
 #include "base64.h"
 #include "log.h"
+#include "probes.h"
+#include "workpool.h"
+#include "sha256.h"
 
 #include "pep.h"
+#include "i_xacml.h"
 #include "io.h"
 #include "error.h"
+#include "cache.h"
+#include "shmcache.h"
+#include "singleflight.h"
+#include "accountcache.h"
+#include "ohindex.h"
+#include "obligationview.h"
+#include "recorder.h"
+#include "capture.h"
+#include "loopback.h"
 
 
 #ifdef HAVE_CONFIG_H
@@ -50,11 +68,38 @@ static const int    DEFAULT_LOG_LEVEL= PEP_LOGLEVEL_NONE;
 static const FILE * DEFAULT_LOG_FILE= NULL;
 static const int    DEFAULT_PIPS_ENABLED= TRUE;
 static const int    DEFAULT_OHS_ENABLED= TRUE;
+static const long   DEFAULT_CACHE_TTL= 0L; /* cache disabled */
+static const int    DEFAULT_CACHE_SIZE= CACHE_DEFAULT_SIZE;
+static const int    DEFAULT_SINGLEFLIGHT_ENABLED= FALSE;
+static const int    DEFAULT_PIP_WORKERS= 4;
+static const int    DEFAULT_LAZY_REQUEST_ENABLED= FALSE;
 /* default SSL cipher without ECDH: OpenSSL 1.0 bug */
 /*
 static const char * DEFAULT_SSL_CIPHER_LIST= "DEFAULT:-ECDH";
 */
 
+/* unix:///path/to/socket endpoint url, sent to the PEPd default /authz path */
+static const char   UNIX_SOCKET_URL_PREFIX[]= "unix://";
+static const char * UNIX_SOCKET_ENDPOINT_URL= "https://localhost/authz";
+
+/** PIP added to a PEP client: version 1 or version 2 with its context */
+typedef struct pip_instance {
+    const char * id;
+    int flags;
+    const pep_pip_t * pip; /* version 1, or NULL */
+    const pep_pip2_t * pip2; /* version 2, or NULL */
+    void * ctx; /* version 2 context */
+} pip_instance_t;
+
+/** OH added to a PEP client: version 1 or version 2 with its context */
+typedef struct oh_instance {
+    const char * id;
+    const pep_obligationhandler_t * oh; /* version 1, or NULL */
+    const pep_obligationhandler2_t * oh2; /* version 2, or NULL */
+    void * ctx; /* version 2 context */
+    const char * const * obligation_ids; /* handled obligation ids of a version 2 OH, NULL for all the responses */
+} oh_instance_t;
+
 /** internal functions prototypes */
 static void init_pep_defaults(PEP * pep);
 static void init_curl_defaults(PEP * pep);
@@ -73,6 +118,33 @@ static int set_curl_stderr(const PEP * pep);
 static int set_curl_nosignal(const PEP * pep);
 static int set_curl_http_headers(PEP * pep);
 static int set_curl_ssl_option_allow_beast(PEP * pep);
+static int set_curl_unix_socket(PEP * pep);
+static int is_trusted_unix_socket(const PEP * pep, const char * socket_path);
+static pep_error_t send_authorization_request(PEP * pep, pep_buffer_t * output, pep_buffer_t * input);
+static pep_error_t send_singleflight_request(PEP * pep, pep_buffer_t * output, pep_buffer_t * input);
+static pep_error_t send_transport_request(PEP * pep, pep_buffer_t * output, pep_buffer_t * input);
+static void release_transport(PEP * pep);
+static pep_cache_t * get_cache(PEP * pep);
+static int cache_key_digest(const PEP * pep, const xacml_request_t * request, uint8_t * cache_key);
+static pep_error_t process_pips(PEP * pep, xacml_request_t ** request);
+static pep_error_t fetch_response(PEP * pep, const xacml_request_t * request, uint8_t * cache_key, int * cache_enabled);
+static void store_response(PEP * pep, const uint8_t * cache_key, const xacml_request_t * request, long cache_ttl);
+static pep_error_t authorize_request(PEP * pep, xacml_request_t ** request, xacml_response_t ** response);
+static pep_error_t authorize_decision(PEP * pep, const xacml_request_t * request, xacml_decision_t * decision, pep_obligation_view_t * view);
+static pep_log_context_t * enter_log_context(PEP * pep, const xacml_request_t * request);
+static void leave_log_context(PEP * pep, pep_log_context_t * previous);
+static void set_phase(PEP * pep, pep_phase_t phase);
+static void trace_begin(PEP * pep, const char * name);
+static void trace_end(PEP * pep, int rc);
+static int attach_traceparent(PEP * pep);
+static int is_valid_traceparent(const char * traceparent);
+static void detach_traceparent(PEP * pep);
+static pep_error_t process_independent_pips(PEP * pep, int first_idx, size_t pips_l, xacml_request_t ** request);
+static int pip_instance_process(pip_instance_t * pip, xacml_request_t ** request);
+static int pip_instance_destroy(pip_instance_t * pip);
+static int oh_instance_process(oh_instance_t * oh, xacml_request_t ** request, xacml_response_t ** response);
+static int oh_instance_destroy(oh_instance_t * oh);
+static int process_indexed_oh(PEP * pep, oh_instance_t * oh, pep_ohindex_t ** ohindex, xacml_request_t ** request, xacml_response_t ** response);
 
 /** 
 * ADT for PEP client handle.
@@ -84,12 +156,17 @@ struct pep_handle {
     int id;
     CURL * curl;
     struct curl_slist * curl_http_headers;
-    pep_linkedlist_t * pips;
-    pep_linkedlist_t * ohs;
+    pep_linkedlist_t * pips; /* pip_instance_t list */
+    pep_linkedlist_t * ohs; /* oh_instance_t list */
     char * option_endpoint_url; /* current url */
     pep_linkedlist_t * option_endpoint_urls; /* urls list */
+    char * option_endpoint_unix_socket; /* unix domain socket of the url, optional */
+    int option_endpoint_unix_socket_uid; /* trusted owner of the unix socket, -1 for euid */
+    int curl_unix_socket_checked; /* unix socket and url set on the curl handle */
+    char * curl_unix_url; /* url sent over the unix socket */
     int option_loglevel;
     FILE * option_logout;
+    pep_log_context_t log_context; /* log configuration of the handle calls */
     long option_timeout; 
     char * option_server_cert;
     char * option_server_capath;
@@ -100,6 +177,26 @@ struct pep_handle {
     char * option_ssl_cipher_list;
     int option_pips_enabled;
     int option_ohs_enabled;
+    long option_cache_ttl;
+    int option_cache_size;
+    pep_cache_t * cache; /* decision cache, created on demand */
+    pep_shmcache_t * shmcache; /* shared memory decision cache, optional */
+    int option_singleflight_enabled;
+    int option_pip_workers;
+    pep_workpool_t * pip_workpool; /* independent PIPs workers, created on demand */
+    int option_lazy_request_enabled;
+    pep_recorder_t * recorder; /* slow calls flight recorder, optional */
+    const pep_tracer_t * tracer; /* optional */
+    void * tracer_arg;
+    void * trace_call_span; /* span of the current call */
+    void * trace_phase_span; /* span of the current phase */
+    struct curl_slist * curl_traceparent; /* traceparent header, linked to curl_http_headers while sending */
+    pep_capture_t * capture; /* traffic capture file, optional */
+    const pep_transport_t * transport; /* NULL: libcurl transport */
+    void * transport_arg;
+    pep_loopback_t * loopback; /* transport_arg of the loopback transport */
+    unsigned char * transport_request; /* request bytes passed to the transport */
+    size_t transport_request_size;
     // temporary buffers for pep_authorize
     pep_buffer_t * output;
     pep_buffer_t * b64output;
@@ -120,6 +217,8 @@ pep_error_t pep_global_init(void) {
 
 /* GLOBAL NOT THREAD SAFE FUNCTION */
 void pep_global_cleanup(void) {
+    /* drain the asynchronous log ring */
+    pep_log_setasync(0);
     curl_global_cleanup();
 }
 
@@ -188,6 +287,7 @@ int pep_getid(PEP * pep) {
 
 pep_error_t pep_addpip(PEP * pep, const pep_pip_t * pip) {
     int pip_rc = -1;
+    pip_instance_t * instance;
     if (pep == NULL) {
         pep_log_error("pep_addpip: NULL pep handle");
         return PEP_ERR_NULL_POINTER;
@@ -196,12 +296,55 @@ pep_error_t pep_addpip(PEP * pep, const pep_pip_t * pip) {
         pep_log_error("pep_addpip: NULL pip pointer");
         return PEP_ERR_NULL_POINTER;
     }
+    instance= calloc(1,sizeof(pip_instance_t));
+    if (instance == NULL) {
+        pep_log_error("pep_addpip: can't allocate PIP[%s] instance.",pip->id);
+        return PEP_ERR_MEMORY;
+    }
+    instance->id= pip->id;
+    instance->flags= 0; /* legacy PIPs run sequentially */
+    instance->pip= pip;
     if ((pip_rc= pip->init()) != 0) {
         pep_log_error("pep_addpip: PIP[%s] init() failed: %d.",pip->id, pip_rc);
+        free(instance);
         return PEP_ERR_PIP_INIT;
     }
-    if (pep_llist_add(pep->pips,(pep_pip_t *)pip) != LLIST_OK) {
+    if (pep_llist_add(pep->pips,instance) != LLIST_OK) {
         pep_log_error("pep_addpip: failed to add initialized PIP[%s] into PEP#%d list.",pip->id,pep->id);
+        free(instance);
+        return PEP_ERR_LLIST;
+    }
+    return PEP_OK;
+}
+
+pep_error_t pep_addpip2(PEP * pep, const pep_pip2_t * pip, void * arg) {
+    int pip_rc = -1;
+    pip_instance_t * instance;
+    if (pep == NULL) {
+        pep_log_error("pep_addpip2: NULL pep handle");
+        return PEP_ERR_NULL_POINTER;
+    }
+    if (pip == NULL) {
+        pep_log_error("pep_addpip2: NULL pip pointer");
+        return PEP_ERR_NULL_POINTER;
+    }
+    instance= calloc(1,sizeof(pip_instance_t));
+    if (instance == NULL) {
+        pep_log_error("pep_addpip2: can't allocate PIP[%s] instance.",pip->id);
+        return PEP_ERR_MEMORY;
+    }
+    instance->id= pip->id;
+    instance->flags= pip->flags;
+    instance->pip2= pip;
+    if ((pip_rc= pip->init(arg,&(instance->ctx))) != 0) {
+        pep_log_error("pep_addpip2: PIP[%s] init(arg,ctx) failed: %d.",pip->id, pip_rc);
+        free(instance);
+        return PEP_ERR_PIP_INIT;
+    }
+    if (pep_llist_add(pep->pips,instance) != LLIST_OK) {
+        pep_log_error("pep_addpip2: failed to add initialized PIP[%s] into PEP#%d list.",pip->id,pep->id);
+        pip->destroy(instance->ctx);
+        free(instance);
         return PEP_ERR_LLIST;
     }
     return PEP_OK;
@@ -209,6 +352,7 @@ pep_error_t pep_addpip(PEP * pep, const pep_pip_t * pip) {
 
 pep_error_t pep_addobligationhandler(PEP * pep, const pep_obligationhandler_t * oh) {
     int oh_rc= -1;
+    oh_instance_t * instance;
     if (pep == NULL) {
         pep_log_error("pep_addobligationhandler: NULL pep handle");
         return PEP_ERR_NULL_POINTER;
@@ -217,12 +361,54 @@ pep_error_t pep_addobligationhandler(PEP * pep, const pep_obligationhandler_t *
         pep_log_error("pep_addobligationhandler: NULL oh pointer");
         return PEP_ERR_NULL_POINTER;
     }
+    instance= calloc(1,sizeof(oh_instance_t));
+    if (instance == NULL) {
+        pep_log_error("pep_addobligationhandler: can't allocate OH[%s] instance.",oh->id);
+        return PEP_ERR_MEMORY;
+    }
+    instance->id= oh->id;
+    instance->oh= oh;
     if ((oh_rc= oh->init()) != 0) {
         pep_log_error("pep_addobligationhandler: OH[%s] init() failed: %d",oh->id, oh_rc);
+        free(instance);
         return PEP_ERR_OH_INIT;
     }
-    if (pep_llist_add(pep->ohs,(pep_obligationhandler_t *)oh) != LLIST_OK) {
+    if (pep_llist_add(pep->ohs,instance) != LLIST_OK) {
         pep_log_error("pep_addobligationhandler: failed to add initialized OH[%s] into PEP#%d list.",oh->id,pep->id);
+        free(instance);
+        return PEP_ERR_LLIST;
+    }
+    return PEP_OK;
+}
+
+pep_error_t pep_addobligationhandler2(PEP * pep, const pep_obligationhandler2_t * oh, void * arg) {
+    int oh_rc= -1;
+    oh_instance_t * instance;
+    if (pep == NULL) {
+        pep_log_error("pep_addobligationhandler2: NULL pep handle");
+        return PEP_ERR_NULL_POINTER;
+    }
+    if (oh == NULL) {
+        pep_log_error("pep_addobligationhandler2: NULL oh pointer");
+        return PEP_ERR_NULL_POINTER;
+    }
+    instance= calloc(1,sizeof(oh_instance_t));
+    if (instance == NULL) {
+        pep_log_error("pep_addobligationhandler2: can't allocate OH[%s] instance.",oh->id);
+        return PEP_ERR_MEMORY;
+    }
+    instance->id= oh->id;
+    instance->oh2= oh;
+    instance->obligation_ids= (oh->obligation != NULL) ? oh->obligation_ids : NULL;
+    if ((oh_rc= oh->init(arg,&(instance->ctx))) != 0) {
+        pep_log_error("pep_addobligationhandler2: OH[%s] init(arg,ctx) failed: %d",oh->id, oh_rc);
+        free(instance);
+        return PEP_ERR_OH_INIT;
+    }
+    if (pep_llist_add(pep->ohs,instance) != LLIST_OK) {
+        pep_log_error("pep_addobligationhandler2: failed to add initialized OH[%s] into PEP#%d list.",oh->id,pep->id);
+        oh->destroy(instance->ctx);
+        free(instance);
         return PEP_ERR_LLIST;
     }
     return PEP_OK;
@@ -234,12 +420,25 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... ) {
     char * str= NULL;
     size_t str_l= 0;
     int value= -1;
+    int decision= -1;
+    int negative_ttl= 0;
+    int capacity= 0;
+    int capture= 0;
     FILE * file= NULL;
+    const pep_tracer_t * tracer= NULL;
+    void * tracer_arg= NULL;
+    const pep_transport_t * transport= NULL;
+    void * transport_arg= NULL;
+    transport_responder_func * responder= NULL;
+    pep_loopback_t * loopback= NULL;
     pep_log_handler_callback * log_handler= NULL;
+    pep_log_record_callback * log_record_handler= NULL;
+    pep_log_context_t * previous_log_context;
     if (pep == NULL) {
         pep_log_error("pep_setoption: NULL pep handle");
         return PEP_ERR_NULL_POINTER;
     }
+    previous_log_context= pep_log_setcontext(&(pep->log_context));
     va_start(args,option);
     switch (option) {
         case PEP_OPTION_ENDPOINT_URL:
@@ -264,6 +463,7 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... ) {
             strncpy(pep->option_endpoint_url,str,str_l);
             pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ENDPOINT_URL: %s",pep->id,pep->option_endpoint_url);
             set_curl_endpoint_url(pep);
+            pep->curl_unix_socket_checked= FALSE;
             break;
         case PEP_OPTION_ENDPOINT_TIMEOUT:
             value= va_arg(args,int);
@@ -444,11 +644,146 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... ) {
             }
             pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ENABLE_OBLIGATIONHANDLERS: %s",pep->id,(pep->option_ohs_enabled == TRUE) ? "TRUE" : "FALSE");
             break;
+        case PEP_OPTION_CACHE_TTL:
+            value= va_arg(args,int);
+            if (value < 0) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_TTL argument is negative: %d.",pep->id,value);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep->option_cache_ttl= (long)value;
+            if (pep->option_cache_ttl > 0 && get_cache(pep) == NULL) {
+                rc= PEP_ERR_MEMORY;
+                break;
+            }
+            if (pep->cache != NULL && pep_cache_setttl(pep->cache,pep->option_cache_ttl) != CACHE_OK) {
+                rc= PEP_ERR_MEMORY;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_CACHE_TTL: %d",pep->id,(int)pep->option_cache_ttl);
+            break;
+        case PEP_OPTION_CACHE_SIZE:
+            value= va_arg(args,int);
+            if (value < 1) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_SIZE argument is invalid: %d.",pep->id,value);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep->option_cache_size= value;
+            if (pep->cache != NULL && pep_cache_setsize(pep->cache,(size_t)pep->option_cache_size) != CACHE_OK) {
+                rc= PEP_ERR_MEMORY;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_CACHE_SIZE: %d",pep->id,pep->option_cache_size);
+            break;
+        case PEP_OPTION_CACHE_OBLIGATION_TTL:
+            str= va_arg(args,char *);
+            value= va_arg(args,int);
+            if (str == NULL || value < 0) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_OBLIGATION_TTL argument is NULL or negative.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (get_cache(pep) == NULL) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_OBLIGATION_TTL: decision cache disabled, set PEP_OPTION_CACHE_TTL first.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (pep_cache_setobligationttl(pep->cache,str,(long)value) != CACHE_OK) {
+                rc= PEP_ERR_MEMORY;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_CACHE_OBLIGATION_TTL: %s %d",pep->id,str,value);
+            break;
+        case PEP_OPTION_CACHE_DECISION:
+            decision= va_arg(args,int);
+            value= va_arg(args,int);
+            if (decision < XACML_DECISION_DENY || decision > XACML_DECISION_NOT_APPLICABLE) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_DECISION invalid decision: %d.",pep->id,decision);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (get_cache(pep) == NULL) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_DECISION: decision cache disabled, set PEP_OPTION_CACHE_TTL first.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (pep_cache_setdecisioncacheable(pep->cache,(xacml_decision_t)decision,value) != CACHE_OK) {
+                rc= PEP_ERR_MEMORY;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_CACHE_DECISION: %d %s",pep->id,decision,value ? "TRUE" : "FALSE");
+            break;
+        case PEP_OPTION_CACHE_SHM_FILE:
+            str= va_arg(args,char *);
+            if (str == NULL) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CACHE_SHM_FILE argument is NULL.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (pep->shmcache != NULL) {
+                pep_log_debug("pep_setoption: PEP#%d shared memory cache already opened, closing...",pep->id);
+                pep_shmcache_close(pep->shmcache);
+            }
+            pep->shmcache= pep_shmcache_open(str,(size_t)pep->option_cache_size);
+            if (pep->shmcache == NULL) {
+                pep_log_error("pep_setoption: PEP#%d can't open shared memory cache: %s.",pep->id,str);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_CACHE_SHM_FILE: %s",pep->id,str);
+            break;
+        case PEP_OPTION_ENABLE_SINGLEFLIGHT:
+            value= va_arg(args,int);
+            if (value == 1) {
+                pep->option_singleflight_enabled= TRUE;
+            }
+            else {
+                pep->option_singleflight_enabled= FALSE;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ENABLE_SINGLEFLIGHT: %s",pep->id,(pep->option_singleflight_enabled == TRUE) ? "TRUE" : "FALSE");
+            break;
+        case PEP_OPTION_ACCOUNT_CACHE_TTL:
+            value= va_arg(args,int);
+            negative_ttl= va_arg(args,int);
+            if (value < 0 || negative_ttl < 0) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_ACCOUNT_CACHE_TTL argument is negative.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep_accountcache_setttl((long)value,(long)negative_ttl);
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ACCOUNT_CACHE_TTL: %d %d",pep->id,value,negative_ttl);
+            break;
+        case PEP_OPTION_PIP_WORKERS:
+            value= va_arg(args,int);
+            if (value < 0) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_PIP_WORKERS argument is negative.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep->option_pip_workers= value;
+            /* recreated on demand with the new size */
+            if (pep->pip_workpool != NULL) {
+                pep_workpool_delete(pep->pip_workpool);
+                pep->pip_workpool= NULL;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_PIP_WORKERS: %d",pep->id,pep->option_pip_workers);
+            break;
+        case PEP_OPTION_ENABLE_LAZY_REQUEST:
+            value= va_arg(args,int);
+            if (value == 1) {
+                pep->option_lazy_request_enabled= TRUE;
+            }
+            else {
+                pep->option_lazy_request_enabled= FALSE;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ENABLE_LAZY_REQUEST: %s",pep->id,(pep->option_lazy_request_enabled == TRUE) ? "TRUE" : "FALSE");
+            break;
         case PEP_OPTION_LOG_LEVEL:
             value= va_arg(args,int);
             if (PEP_LOGLEVEL_NONE <= value && value <= PEP_LOGLEVEL_DEBUG) {
                 pep->option_loglevel= value;
-                pep_log_setlevel(pep->option_loglevel);
+                pep_log_context_setlevel(&(pep->log_context),pep->option_loglevel);
             }
             pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_LOG_LEVEL: %d",pep->id,pep->option_loglevel);
             set_curl_verbose(pep);
@@ -456,14 +791,157 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... ) {
         case PEP_OPTION_LOG_STDERR:
             file= va_arg(args,FILE *);
             pep->option_logout= file;
-            pep_log_setout(pep->option_logout);
+            pep->log_context.out= pep->option_logout;
             pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_LOG_STDERR: %p",pep->id,pep->option_logout);
             set_curl_stderr(pep);
             break;
+        case PEP_OPTION_LOG_ASYNC:
+            value= va_arg(args,int);
+            if (value < 0) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_LOG_ASYNC argument is negative.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (pep_log_setasync((size_t)value) != LOG_OK) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_LOG_ASYNC: can't create log ring of %d lines",pep->id,value);
+                rc= PEP_ERR_MEMORY;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_LOG_ASYNC: %d",pep->id,value);
+            break;
         case PEP_OPTION_LOG_HANDLER:
             log_handler= va_arg(args,pep_log_handler_callback *);
-            pep_log_sethandler(log_handler);
-            pep_log_debug("pep_setoption: PEP_OPTION_LOG_HANDLER: %p",log_handler);
+            pep->log_context.handler= log_handler;
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_LOG_HANDLER: %p",pep->id,log_handler);
+            break;
+        case PEP_OPTION_LOG_RECORD_HANDLER:
+            log_record_handler= va_arg(args,pep_log_record_callback *);
+            pep->log_context.record_handler= log_record_handler;
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_LOG_RECORD_HANDLER: %p",pep->id,log_record_handler);
+            break;
+        case PEP_OPTION_FLIGHT_RECORDER:
+            value= va_arg(args,int);
+            capacity= va_arg(args,int);
+            capture= va_arg(args,int);
+            if (value < 0 || capacity < 0) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_FLIGHT_RECORDER argument is negative.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            if (pep->recorder != NULL) {
+                pep_recorder_delete(pep->recorder);
+                pep->recorder= NULL;
+            }
+            if (capacity > 0) {
+                pep->recorder= pep_recorder_create(pep->id,(long)value,(size_t)capacity,capture);
+                if (pep->recorder == NULL) {
+                    pep_log_error("pep_setoption: PEP#%d PEP_OPTION_FLIGHT_RECORDER: can't create flight recorder of %d records.",pep->id,capacity);
+                    rc= PEP_ERR_MEMORY;
+                    break;
+                }
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_FLIGHT_RECORDER: %dms %d %s",pep->id,value,capacity,capture ? "TRUE" : "FALSE");
+            break;
+        case PEP_OPTION_FLIGHT_RECORDER_SIGNAL:
+            file= va_arg(args,FILE *);
+            if (pep_recorder_setsignalout(file) != RECORDER_OK) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_FLIGHT_RECORDER_SIGNAL: can't set the SIGUSR2 handler.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_FLIGHT_RECORDER_SIGNAL: %p",pep->id,file);
+            break;
+        case PEP_OPTION_TRACER:
+            tracer= va_arg(args,const pep_tracer_t *);
+            tracer_arg= va_arg(args,void *);
+            if (tracer != NULL && (tracer->start_span == NULL || tracer->end_span == NULL)) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_TRACER without start_span or end_span function.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep->tracer= tracer;
+            pep->tracer_arg= tracer_arg;
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_TRACER: %p",pep->id,tracer);
+            break;
+        case PEP_OPTION_CAPTURE_FILE:
+            str= va_arg(args,char *);
+            if (pep->capture != NULL) {
+                pep_capture_close(pep->capture);
+                pep->capture= NULL;
+            }
+            if (str != NULL) {
+                pep->capture= pep_capture_open(str);
+                if (pep->capture == NULL) {
+                    pep_log_error("pep_setoption: PEP#%d PEP_OPTION_CAPTURE_FILE: can't open capture file: %s.",pep->id,str);
+                    rc= PEP_ERR_OPTION_INVALID;
+                    break;
+                }
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_CAPTURE_FILE: %s",pep->id,(str != NULL) ? str : "NULL");
+            break;
+        case PEP_OPTION_TRANSPORT:
+            transport= va_arg(args,const pep_transport_t *);
+            transport_arg= va_arg(args,void *);
+            if (transport != NULL
+                && ((transport->send == NULL && (transport->send_async == NULL || transport->wait == NULL))
+                    || (transport->receive == NULL && (transport->receive_async == NULL || transport->wait == NULL)))) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_TRANSPORT without send or receive function.",pep->id);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            release_transport(pep);
+            pep->transport= transport;
+            pep->transport_arg= transport_arg;
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_TRANSPORT: %p",pep->id,transport);
+            break;
+        case PEP_OPTION_ENDPOINT_UNIX_SOCKET:
+            str= va_arg(args,char *);
+            if (pep->option_endpoint_unix_socket != NULL) {
+                free(pep->option_endpoint_unix_socket);
+                pep->option_endpoint_unix_socket= NULL;
+            }
+            if (str != NULL) {
+                str_l= strlen(str);
+                pep->option_endpoint_unix_socket= calloc(str_l + 1, sizeof(char));
+                if (pep->option_endpoint_unix_socket == NULL) {
+                    pep_log_error("pep_setoption: PEP#%d can't allocate option_endpoint_unix_socket: %s.",pep->id,str);
+                    rc= PEP_ERR_MEMORY;
+                    break;
+                }
+                strncpy(pep->option_endpoint_unix_socket,str,str_l);
+            }
+            pep->curl_unix_socket_checked= FALSE;
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ENDPOINT_UNIX_SOCKET: %s",pep->id,(str != NULL) ? str : "NULL");
+            break;
+        case PEP_OPTION_ENDPOINT_UNIX_SOCKET_UID:
+            value= va_arg(args,int);
+            if (value < -1) {
+                pep_log_error("pep_setoption: PEP#%d PEP_OPTION_ENDPOINT_UNIX_SOCKET_UID: invalid uid %d.",pep->id,value);
+                rc= PEP_ERR_OPTION_INVALID;
+                break;
+            }
+            pep->option_endpoint_unix_socket_uid= value;
+            pep->curl_unix_socket_checked= FALSE;
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_ENDPOINT_UNIX_SOCKET_UID: %d",pep->id,value);
+            break;
+        case PEP_OPTION_TRANSPORT_LOOPBACK:
+            responder= va_arg(args,transport_responder_func *);
+            transport_arg= va_arg(args,void *);
+            if (responder != NULL) {
+                loopback= pep_loopback_create(responder,transport_arg);
+                if (loopback == NULL) {
+                    pep_log_error("pep_setoption: PEP#%d PEP_OPTION_TRANSPORT_LOOPBACK: can't create loopback transport.",pep->id);
+                    rc= PEP_ERR_MEMORY;
+                    break;
+                }
+            }
+            release_transport(pep);
+            if (loopback != NULL) {
+                pep->transport= &pep_loopback_transport;
+                pep->transport_arg= loopback;
+                pep->loopback= loopback;
+            }
+            pep_log_debug("pep_setoption: PEP#%d PEP_OPTION_TRANSPORT_LOOPBACK: %p",pep->id,loopback);
             break;
         default:
             pep_log_error("pep_setoption: PEP#%d invalid option: %d",pep->id,option);
@@ -471,192 +949,281 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... ) {
             break;
     }
     va_end(args);
+    pep_log_setcontext(previous_log_context);
     return rc;
 }
 
+/*
+ * Sets the log context of the handle for the calling thread, with the hash of
+ * the request if it can be logged. Returns the previous context to restore
+ * with leave_log_context.
+ */
+static pep_log_context_t * enter_log_context(PEP * pep, const xacml_request_t * request) {
+    static const char HEX_DIGITS[]= "0123456789abcdef";
+    pep_log_context_t * context= &(pep->log_context);
+    uint8_t hash[XACML_HASH_LENGTH];
+    int i;
+    context->phase= NULL;
+    context->request[0]= '\0';
+    if (request != NULL && (context->level >= PEP_LOGLEVEL_INFO || context->record_handler != NULL)
+        && xacml_request_hash(request,hash) == PEP_XACML_OK) {
+        for (i= 0; i < (LOG_REQUEST_HASH_SIZE - 1) / 2; i++) {
+            context->request[2*i]= HEX_DIGITS[hash[i] >> 4];
+            context->request[2*i + 1]= HEX_DIGITS[hash[i] & 0x0F];
+        }
+        context->request[LOG_REQUEST_HASH_SIZE - 1]= '\0';
+    }
+    return pep_log_setcontext(context);
+}
 
-pep_error_t pep_authorize(PEP * pep, xacml_request_t ** request, xacml_response_t ** response) {
-    int i= 0;
-    int pip_rc, oh_rc;
-    //pep_buffer_t * output, * b64output, * b64input, * input;
-    size_t output_l, b64output_l;
-    pep_error_t marshal_rc, unmarshal_rc;
-    CURLcode curl_rc;
-    long http_code= 0;
-    xacml_request_t * effective_request;
-    if (pep == NULL) {
-        pep_log_error("pep_authorize: NULL pep handle");
-        return PEP_ERR_NULL_POINTER;
+/* clears the structured fields and restores the previous log context */
+static void leave_log_context(PEP * pep, pep_log_context_t * previous) {
+    pep->log_context.phase= NULL;
+    pep->log_context.request[0]= '\0';
+    pep_log_setcontext(previous);
+}
+
+/* starts the phase of the call */
+static void set_phase(PEP * pep, pep_phase_t phase) {
+    pep->log_context.phase= pep_phase_name(phase);
+    if (pep->recorder != NULL) pep_recorder_phase(pep->recorder,phase);
+    if (pep->tracer != NULL) {
+        if (pep->trace_phase_span != NULL) pep->tracer->end_span(pep->tracer_arg,pep->trace_phase_span,PEP_OK);
+        pep->trace_phase_span= pep->tracer->start_span(pep->tracer_arg,pep->id,pep_phase_name(phase),pep->trace_call_span);
     }
-    if (pep->option_endpoint_url == NULL) {
-        pep_log_error("pep_authorize: NULL mandatory option PEP_OPTION_ENDPOINT_URL");
-        return PEP_ERR_NULL_POINTER;
+}
+
+/* starts the span of the call, if traced */
+static void trace_begin(PEP * pep, const char * name) {
+    if (pep->tracer == NULL) return;
+    pep->trace_phase_span= NULL;
+    pep->trace_call_span= pep->tracer->start_span(pep->tracer_arg,pep->id,name,NULL);
+}
+
+/* ends the spans of the last phase and of the call, if traced */
+static void trace_end(PEP * pep, int rc) {
+    if (pep->tracer == NULL) return;
+    if (pep->trace_phase_span != NULL) pep->tracer->end_span(pep->tracer_arg,pep->trace_phase_span,rc);
+    if (pep->trace_call_span != NULL) pep->tracer->end_span(pep->tracer_arg,pep->trace_call_span,rc);
+    pep->trace_phase_span= NULL;
+    pep->trace_call_span= NULL;
+}
+
+
+/* applies the PIPs, if enabled and any, to the request */
+static pep_error_t process_pips(PEP * pep, xacml_request_t ** request) {
+    int i, pip_rc;
+    size_t pips_l;
+    if (!pep->option_pips_enabled || pep_llist_length(pep->pips) < 1) {
+        return PEP_OK;
+    }
+    set_phase(pep,PEP_PHASE_PIPS);
+    pips_l= pep_llist_length(pep->pips);
+    pep_log_info("process_pips: PEP#%d %d PIPs available, processing...",pep->id, (int)pips_l);
+    for (i= 0; i<pips_l; i++) {
+        pip_instance_t * pip= pep_llist_get(pep->pips,i);
+        size_t independent_l= 0;
+        /* consecutive independent PIPs */
+        while (i + independent_l < pips_l) {
+            pip_instance_t * next= pep_llist_get(pep->pips,i + independent_l);
+            if (next == NULL || !(next->flags & PEP_PIP_INDEPENDENT)) break;
+            independent_l++;
+        }
+        if (independent_l > 1 && pep->option_pip_workers > 0) {
+            pep_error_t pips_rc= process_independent_pips(pep,i,independent_l,request);
+            if (pips_rc != PEP_OK) {
+                return pips_rc;
+            }
+            i+= independent_l - 1;
+        }
+        else if (pip != NULL) {
+            pep_log_debug("process_pips: PEP#%d calling pip[%s]->process(request)...",pep->id,pip->id);
+            pip_rc= pip_instance_process(pip,request);
+            if (pip_rc != 0) {
+                pep_log_error("process_pips: PIP[%s] process(request) failed: %d", pip->id, pip_rc);
+                return PEP_ERR_PIP_PROCESS;
+            }
+        }
     }
-    if (request == NULL || *request == NULL) {
-        pep_log_error("pep_authorize: PEP#%d NULL request pointer",pep->id);
-        return PEP_ERR_NULL_POINTER;
+    return PEP_OK;
+}
+
+/*
+ * Reads the serialized response of the request into the new pep->input buffer,
+ * from the decision caches or from the PEPd. On a cache miss, cache_enabled is
+ * set if the response must be stored with store_response. On error, the input
+ * buffer is deleted.
+ */
+static pep_error_t fetch_response(PEP * pep, const xacml_request_t * request, uint8_t * cache_key, int * cache_enabled) {
+    pep_error_t marshal_rc, send_rc;
+    long cache_ttl= 0;
+    int cache_hit= FALSE;
+    *cache_enabled= FALSE;
+
+    /* create the Hessian input buffer */
+    pep->input= pep_buffer_create(1024);
+    if (pep->input == NULL) {
+        pep_log_error("fetch_response: PEP#%d can't create input buffer.",pep->id);
+        return PEP_ERR_MEMORY;
     }
-    
-    /* apply pips if enabled and any */
-    if (pep->option_pips_enabled && pep_llist_length(pep->pips) > 0) {
-        size_t pips_l= pep_llist_length(pep->pips);
-        pep_log_info("pep_authorize: PEP#%d %d PIPs available, processing...",pep->id, (int)pips_l);
-        for (i= 0; i<pips_l; i++) {
-            pep_pip_t * pip= pep_llist_get(pep->pips,i);
-            if (pip != NULL) {
-                pep_log_debug("pep_authorize: PEP#%d calling pip[%s]->process(request)...",pep->id,pip->id);
-                pip_rc= pip->process(request);
-                if (pip_rc != 0) {
-                    pep_log_error("pep_authorize: PIP[%s] process(request) failed: %d", pip->id, pip_rc);
-                    return PEP_ERR_PIP_PROCESS;
-                }
+
+    /* lookup the decision cache, the canonical request digest is the key */
+    if (pep->cache != NULL && pep->option_cache_ttl > 0) {
+        set_phase(pep,PEP_PHASE_CACHE);
+        if (cache_key_digest(pep,request,cache_key) != PEP_XACML_OK) {
+            pep_log_warn("fetch_response: PEP#%d can't compute request digest, decision cache not used.",pep->id);
+        }
+        else if (pep_cache_get(pep->cache,cache_key,XACML_HASH_LENGTH,pep->input) == CACHE_OK) {
+            pep_log_info("fetch_response: PEP#%d XACML response found in decision cache.",pep->id);
+            cache_hit= TRUE;
+        }
+        else if (pep->shmcache != NULL && pep_shmcache_get(pep->shmcache,cache_key,XACML_HASH_LENGTH,pep->input,&cache_ttl) == CACHE_OK) {
+            pep_log_info("fetch_response: PEP#%d XACML response found in shared memory decision cache.",pep->id);
+            cache_hit= TRUE;
+            /* keep a local copy for the remaining time-to-live */
+            if (pep_cache_put(pep->cache,cache_key,XACML_HASH_LENGTH,pep->input,pep_cache_getsubjectid(request),cache_ttl) != CACHE_OK) {
+                pep_log_warn("fetch_response: PEP#%d can't store XACML response in decision cache.",pep->id);
             }
+            pep_buffer_rewind(pep->input);
         }
+        else {
+            *cache_enabled= TRUE;
+        }
+    }
+    if (cache_hit) {
+        pep_recorder_capture(pep->recorder,RECORDER_RESPONSE,pep->input);
+        return PEP_OK;
     }
 
     /* marshal the authorization request into output buffer */
+    set_phase(pep,PEP_PHASE_MARSHAL);
     pep->output= pep_buffer_create(512);
     if (pep->output == NULL) {
-        pep_log_error("pep_authorize: PEP#%d can't create output buffer (512 bytes).",pep->id);
+        pep_log_error("fetch_response: PEP#%d can't create output buffer (512 bytes).",pep->id);
+        pep_buffer_delete(pep->input);
         return PEP_ERR_MEMORY;
     }
-    marshal_rc= xacml_request_marshalling(*request,pep->output);
+    PEP_PROBE1(marshal__start,pep->id);
+    marshal_rc= xacml_request_marshalling(request,pep->output);
+    PEP_PROBE3(marshal__end,pep->id,marshal_rc,pep_buffer_length(pep->output));
     if ( marshal_rc != PEP_OK ) {
-        pep_log_error("pep_authorize: PEP#%d can't marshal XACML request: %s.",pep->id,pep_strerror(marshal_rc));
+        pep_log_error("fetch_response: PEP#%d can't marshal XACML request: %s.",pep->id,pep_strerror(marshal_rc));
         pep_buffer_delete(pep->output);
+        pep_buffer_delete(pep->input);
         return marshal_rc;
     }
+    pep_recorder_capture(pep->recorder,RECORDER_REQUEST,pep->output);
 
-    /* base64 encode the output buffer */
-    output_l= pep_buffer_length(pep->output);
-    pep->b64output= pep_buffer_create( output_l );
-    if (pep->b64output == NULL) {
-        pep_log_error("pep_authorize: PEP#%d can't create base64 output buffer (%d bytes).",pep->id,(int)output_l);
-        pep_buffer_delete(pep->output);
-        return PEP_ERR_MEMORY;
+    /* send the request to the PEPd, and read the response into the Hessian input buffer */
+    set_phase(pep,PEP_PHASE_SEND);
+    if (pep->option_singleflight_enabled && pep->transport == NULL) {
+        send_rc= send_singleflight_request(pep,pep->output,pep->input);
+    }
+    else {
+        send_rc= send_authorization_request(pep,pep->output,pep->input);
     }
-    
-    pep_log_debug("pep_authorize: PEP#%d: encoding base64 output...",pep->id);
-    pep_base64_encode_buffer_l(pep->output,pep->b64output,BASE64_DEFAULT_LINE_SIZE);
 
     /* output buffer not needed anymore. */
     pep_buffer_delete(pep->output);
 
-    /* configure curl handler to POST the base64 encoded marshalled PEP request buffer */
-    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_POST, 1L);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_setopt(curl,CURLOPT_POST,1) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        return PEP_ERR_CURL + curl_rc;
-    }
-    b64output_l= pep_buffer_length(pep->b64output);
-    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_POSTFIELDSIZE, (long)b64output_l);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_setopt(curl,CURLOPT_POSTFIELDSIZE,%d) failed: %s.",pep->id,(int)b64output_l,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        return PEP_ERR_CURL + curl_rc;
+    if (send_rc != PEP_OK) {
+        pep_buffer_delete(pep->input);
+        return send_rc;
     }
+    pep_recorder_capture(pep->recorder,RECORDER_RESPONSE,pep->input);
+    return PEP_OK;
+}
 
-    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_READDATA, pep->b64output);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_setopt(curl,CURLOPT_READDATA,b64output) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        return PEP_ERR_CURL + curl_rc;
+/* stores the serialized response of pep->input in the decision caches for ttl seconds */
+static void store_response(PEP * pep, const uint8_t * cache_key, const xacml_request_t * request, long cache_ttl) {
+    if (cache_ttl <= 0) return;
+    set_phase(pep,PEP_PHASE_CACHE);
+    pep_log_debug("store_response: PEP#%d caching XACML response for %ld seconds.",pep->id,cache_ttl);
+    if (pep_cache_put(pep->cache,cache_key,XACML_HASH_LENGTH,pep->input,pep_cache_getsubjectid(request),cache_ttl) != CACHE_OK) {
+        pep_log_warn("store_response: PEP#%d can't store XACML response in decision cache.",pep->id);
     }
-
-    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_READFUNCTION, pep_buffer_read);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_setopt(curl,CURLOPT_READFUNCTION,buffer_read) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        return PEP_ERR_CURL + curl_rc;
+    if (pep->shmcache != NULL && pep_shmcache_put(pep->shmcache,cache_key,XACML_HASH_LENGTH,pep->input,pep_cache_getsubjectid(request),cache_ttl) == CACHE_ERROR) {
+        pep_log_warn("store_response: PEP#%d can't store XACML response in shared memory decision cache.",pep->id);
     }
+}
 
+pep_error_t pep_authorize(PEP * pep, xacml_request_t ** request, xacml_response_t ** response) {
+    pep_log_context_t * previous_log_context;
+    pep_error_t rc;
+    if (pep == NULL) {
+        pep_log_error("pep_authorize: NULL pep handle");
+        return PEP_ERR_NULL_POINTER;
+    }
+    previous_log_context= enter_log_context(pep,(request != NULL) ? *request : NULL);
+    pep_recorder_begin(pep->recorder);
+    trace_begin(pep,"pep_authorize");
+    rc= authorize_request(pep,request,response);
+    trace_end(pep,rc);
+    pep_recorder_end(pep->recorder,rc);
+    leave_log_context(pep,previous_log_context);
+    return rc;
+}
 
-    /* configure curl handler to read the base64 encoded HTTP response */
-    pep->b64input= pep_buffer_create(1024);
-    if (pep->b64input == NULL) {
-        pep_log_error("pep_authorize: PEP#%d can't create base64 input buffer.",pep->id);
-        pep_buffer_delete(pep->b64output);
-        return PEP_ERR_MEMORY;
+/* pep_authorize with the log context of the handle */
+static pep_error_t authorize_request(PEP * pep, xacml_request_t ** request, xacml_response_t ** response) {
+    int i= 0;
+    int oh_rc;
+    pep_error_t pips_rc, fetch_rc, unmarshal_rc;
+    int cache_enabled= FALSE;
+    uint8_t cache_key[XACML_HASH_LENGTH];
+    xacml_request_t * effective_request;
+    if (pep->option_endpoint_url == NULL && pep->transport == NULL) {
+        pep_log_error("pep_authorize: NULL mandatory option PEP_OPTION_ENDPOINT_URL");
+        return PEP_ERR_NULL_POINTER;
     }
-
-    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_WRITEDATA, pep->b64input);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_setopt(curl,CURLOPT_WRITEDATA,b64input) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        pep_buffer_delete(pep->b64input);
-        return PEP_ERR_CURL + curl_rc;
+    if (request == NULL || *request == NULL) {
+        pep_log_error("pep_authorize: PEP#%d NULL request pointer",pep->id);
+        return PEP_ERR_NULL_POINTER;
     }
-    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_WRITEFUNCTION, pep_buffer_write);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,buffer_write) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        pep_buffer_delete(pep->b64input);
-        return PEP_ERR_CURL + curl_rc;
+    
+    /* apply pips if enabled and any */
+    PEP_PROBE1(pips__start,pep->id);
+    pips_rc= process_pips(pep,request);
+    PEP_PROBE2(pips__end,pep->id,pips_rc);
+    if (pips_rc != PEP_OK) {
+        return pips_rc;
     }
 
-
-    /* send the request */
-    pep_log_info("pep_authorize: PEP#%d sending XACML request to: %s",pep->id,pep->option_endpoint_url);
-    curl_rc= curl_easy_perform(pep->curl);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d sending XACML request to %s failed: curl[%d] %s.",pep->id,pep->option_endpoint_url,(int)curl_rc,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        pep_buffer_delete(pep->b64input);
-        return PEP_ERR_CURL + curl_rc;
+    /* read the response from the decision cache or the PEPd */
+    fetch_rc= fetch_response(pep,*request,cache_key,&cache_enabled);
+    if (fetch_rc != PEP_OK) {
+        return fetch_rc;
     }
 
-    /* check for HTTP 200 response code */
-    http_code= 0;
-    curl_rc= curl_easy_getinfo(pep->curl,CURLINFO_RESPONSE_CODE,&http_code);
-    if (curl_rc != CURLE_OK) {
-        pep_log_error("pep_authorize: PEP#%d curl_easy_getinfo(pep->curl,CURLINFO_RESPONSE_CODE,&http_code) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
-        pep_buffer_delete(pep->b64output);
-        pep_buffer_delete(pep->b64input);
-        return PEP_ERR_CURL + curl_rc;
+    /* unmarshal the PEP response */
+    set_phase(pep,PEP_PHASE_UNMARSHAL);
+    PEP_PROBE2(unmarshal__start,pep->id,pep_buffer_length(pep->input));
+    if (pep->option_lazy_request_enabled) {
+        unmarshal_rc= xacml_response_lazy_unmarshalling(response,pep->input);
     }
-    if (http_code != 200) {
-        pep_log_error("pep_authorize: PEP#%d: HTTP status code: %d.",pep->id,(int)http_code);
-        pep_buffer_delete(pep->b64output);
-        pep_buffer_delete(pep->b64input);
-        return PEP_ERR_AUTHZ_REQUEST;
+    else {
+        unmarshal_rc= xacml_response_unmarshalling(response,pep->input);
     }
-
-    /* not required anymore */
-    pep_buffer_delete(pep->b64output);
-
-    pep_log_debug("pep_authorize: PEP#%d: HTTP status code: %d.",pep->id,(int)http_code);
-
-    /* create the Hessian input buffer */
-    pep->input= pep_buffer_create(1024);
-    if (pep->input == NULL) {
-        pep_log_error("pep_authorize: PEP#%d can't create input buffer.",pep->id);
-        pep_buffer_delete(pep->b64input);
-        return PEP_ERR_MEMORY;
-    }
-
-    /* base64 decode the input buffer into the Hessian buffer. */
-    pep_log_debug("pep_authorize: PEP#%d: decoding base64 input...",pep->id);
-    pep_base64_decode_buffer(pep->b64input,pep->input);
-
-    /* unmarshal the PEP response */
-    unmarshal_rc= xacml_response_unmarshalling(response,pep->input);
+    PEP_PROBE2(unmarshal__end,pep->id,unmarshal_rc);
     if ( unmarshal_rc != PEP_OK) {
         pep_log_error("pep_authorize: PEP#%d can't unmarshal the XACML response: %s.", pep->id, pep_strerror(unmarshal_rc));
-        pep_buffer_delete(pep->b64input);
         pep_buffer_delete(pep->input);
         return unmarshal_rc;
     }
 
     pep_log_info("pep_authorize: PEP#%d XACML Response decoded and deserialized.",pep->id);
 
+    /* store the response in the decision cache according to the cache policies */
+    if (cache_enabled) {
+        store_response(pep,cache_key,*request,pep_cache_getresponsettl(pep->cache,*response));
+    }
+
     /* not required anymore */
-    pep_buffer_delete(pep->b64input);
     pep_buffer_delete(pep->input);
 
 
-    /* get effective response */
-    effective_request= xacml_response_getrequest(*response);
+    /* get effective response, left serialized in the response if lazy */
+    effective_request= pep->option_lazy_request_enabled ? NULL : xacml_response_getrequest(*response);
     if (effective_request != NULL) {
         pep_log_debug("pep_authorize: PEP#%d effective request received",pep->id);
         /* delete original */
@@ -668,23 +1235,207 @@ pep_error_t pep_authorize(PEP * pep, xacml_request_t ** request, xacml_response_
     /* apply obligation handlers if enabled and any */
     if (pep->option_ohs_enabled && pep_llist_length(pep->ohs) > 0) {
         size_t ohs_l= pep_llist_length(pep->ohs);
+        pep_ohindex_t * ohindex= NULL; /* obligations index, created on demand */
+        set_phase(pep,PEP_PHASE_OHS);
+        PEP_PROBE2(ohs__start,pep->id,(int)ohs_l);
         pep_log_info("pep_authorize: PEP#%d %d OHs available, processing...",pep->id,(int)ohs_l);
         for (i= 0; i<ohs_l; i++) {
-            pep_obligationhandler_t * oh= pep_llist_get(pep->ohs,i);
+            oh_instance_t * oh= pep_llist_get(pep->ohs,i);
             if (oh != NULL) {
-                pep_log_debug("pep_authorize: PEP#%d calling OH[%s]->process(request,response)...",pep->id,oh->id);
-                oh_rc = oh->process(request,response);
+                if (oh->obligation_ids != NULL) {
+                    oh_rc= process_indexed_oh(pep,oh,&ohindex,request,response);
+                }
+                else {
+                    pep_log_debug("pep_authorize: PEP#%d calling OH[%s]->process(request,response)...",pep->id,oh->id);
+                    oh_rc = oh_instance_process(oh,request,response);
+                    /* the response may have been modified in any way */
+                    pep_ohindex_invalidate(ohindex);
+                }
                 if (oh_rc != 0) {
                     pep_log_error("pep_authorize: PEP#%d OH[%s] process(request,response) failed: %d.",pep->id,oh->id,oh_rc);
+                    pep_ohindex_delete(ohindex);
+                    PEP_PROBE2(ohs__end,pep->id,PEP_ERR_OH_PROCESS);
                     return PEP_ERR_OH_PROCESS;
                 }
             }
         }
+        pep_ohindex_delete(ohindex);
+        PEP_PROBE2(ohs__end,pep->id,PEP_OK);
     }
     
     return PEP_OK;
 }
 
+
+/* state of the decision-only decoding of a response */
+typedef struct {
+    PEP * pep;
+    pep_obligation_view_t * view;
+    xacml_decision_t decision;
+    int results_l;
+    long cache_ttl; /* TTL of the response in the decision cache, 0 if not cacheable */
+} decision_state_t;
+
+static int decision_state_result(void * arg, int result_idx, xacml_decision_t decision, const char * statuscode) {
+    decision_state_t * state= arg;
+    state->results_l++;
+    if (!pep_cache_isdecisioncacheable(state->pep->cache,decision)) {
+        state->cache_ttl= 0;
+    }
+    if (result_idx > 0) {
+        pep_log_debug("decision_state_result: PEP#%d result[%d] ignored.",state->pep->id,result_idx);
+        return 0;
+    }
+    state->decision= decision;
+    if (state->view != NULL && pep_obligation_view_setstatuscode(state->view,statuscode) != PEP_XACML_OK) {
+        return -1;
+    }
+    return 0;
+}
+
+static int decision_state_wants(void * arg, int result_idx, const char * obligationid) {
+    decision_state_t * state= arg;
+    state->cache_ttl= pep_cache_getobligationttl(state->pep->cache,obligationid,state->cache_ttl);
+    return result_idx == 0 && pep_obligation_view_wants(state->view,obligationid);
+}
+
+static int decision_state_obligation(void * arg, int result_idx, xacml_obligation_t * obligation) {
+    decision_state_t * state= arg;
+    if (pep_obligation_view_add(state->view,obligation) != PEP_XACML_OK) {
+        xacml_obligation_delete(obligation);
+        return -1;
+    }
+    return 0;
+}
+
+pep_error_t pep_authorize_decision(PEP * pep, const xacml_request_t * request, xacml_decision_t * decision, pep_obligation_view_t * view) {
+    pep_log_context_t * previous_log_context;
+    pep_error_t rc;
+    if (pep == NULL) {
+        pep_log_error("pep_authorize_decision: NULL pep handle");
+        return PEP_ERR_NULL_POINTER;
+    }
+    previous_log_context= enter_log_context(pep,request);
+    pep_recorder_begin(pep->recorder);
+    trace_begin(pep,"pep_authorize_decision");
+    rc= authorize_decision(pep,request,decision,view);
+    trace_end(pep,rc);
+    pep_recorder_end(pep->recorder,rc);
+    leave_log_context(pep,previous_log_context);
+    return rc;
+}
+
+/* pep_authorize_decision with the log context of the handle */
+static pep_error_t authorize_decision(PEP * pep, const xacml_request_t * request, xacml_decision_t * decision, pep_obligation_view_t * view) {
+    pep_error_t pips_rc, fetch_rc, unmarshal_rc;
+    int cache_enabled= FALSE;
+    uint8_t cache_key[XACML_HASH_LENGTH];
+    xacml_request_t * overlay= NULL;
+    const xacml_request_t * effective_request= request;
+    decision_state_t state;
+    xacml_decision_handler_t handler;
+    if (pep->option_endpoint_url == NULL && pep->transport == NULL) {
+        pep_log_error("pep_authorize_decision: NULL mandatory option PEP_OPTION_ENDPOINT_URL");
+        return PEP_ERR_NULL_POINTER;
+    }
+    if (request == NULL || decision == NULL) {
+        pep_log_error("pep_authorize_decision: PEP#%d NULL request or decision pointer",pep->id);
+        return PEP_ERR_NULL_POINTER;
+    }
+    pep_obligation_view_reset(view);
+
+    /* apply pips on a copy-on-write overlay, the caller request is const */
+    if (pep->option_pips_enabled && pep_llist_length(pep->pips) > 0) {
+        overlay= xacml_request_createoverlay(request);
+        if (overlay == NULL) {
+            pep_log_error("pep_authorize_decision: PEP#%d can't create XACML request overlay.",pep->id);
+            return PEP_ERR_MEMORY;
+        }
+        PEP_PROBE1(pips__start,pep->id);
+        pips_rc= process_pips(pep,&overlay);
+        PEP_PROBE2(pips__end,pep->id,pips_rc);
+        if (pips_rc != PEP_OK) {
+            xacml_request_delete(overlay);
+            return pips_rc;
+        }
+        effective_request= overlay;
+    }
+
+    /* read the response from the decision cache or the PEPd */
+    fetch_rc= fetch_response(pep,effective_request,cache_key,&cache_enabled);
+    if (fetch_rc != PEP_OK) {
+        if (overlay != NULL) xacml_request_delete(overlay);
+        return fetch_rc;
+    }
+
+    /* decode only the decision, status code and selected obligations */
+    set_phase(pep,PEP_PHASE_UNMARSHAL);
+    state.pep= pep;
+    state.view= view;
+    state.decision= XACML_DECISION_INDETERMINATE;
+    state.results_l= 0;
+    state.cache_ttl= pep_cache_getttl(pep->cache);
+    handler.result= decision_state_result;
+    handler.wants= decision_state_wants;
+    handler.obligation= decision_state_obligation;
+    handler.arg= &state;
+    PEP_PROBE2(unmarshal__start,pep->id,pep_buffer_length(pep->input));
+    unmarshal_rc= xacml_response_decision_unmarshalling(pep->input,&handler);
+    PEP_PROBE2(unmarshal__end,pep->id,unmarshal_rc);
+    if (unmarshal_rc == PEP_OK && state.results_l < 1) {
+        pep_log_error("pep_authorize_decision: PEP#%d XACML response without result.",pep->id);
+        unmarshal_rc= PEP_ERR_UNMARSHALLING_HESSIAN;
+    }
+    if (unmarshal_rc != PEP_OK) {
+        pep_log_error("pep_authorize_decision: PEP#%d can't decode the XACML response: %s.",pep->id,pep_strerror(unmarshal_rc));
+        pep_obligation_view_reset(view);
+        pep_buffer_delete(pep->input);
+        if (overlay != NULL) xacml_request_delete(overlay);
+        return unmarshal_rc;
+    }
+
+    pep_log_info("pep_authorize_decision: PEP#%d XACML decision: %d.",pep->id,(int)state.decision);
+
+    /* store the response in the decision cache according to the cache policies */
+    if (cache_enabled) {
+        store_response(pep,cache_key,effective_request,state.cache_ttl);
+    }
+
+    pep_buffer_delete(pep->input);
+    if (overlay != NULL) xacml_request_delete(overlay);
+    *decision= state.decision;
+    return PEP_OK;
+}
+
+pep_error_t pep_flightrecorder_dump(PEP * pep, FILE * out) {
+    if (pep == NULL || out == NULL) {
+        pep_log_error("pep_flightrecorder_dump: NULL pep handle or output stream");
+        return PEP_ERR_NULL_POINTER;
+    }
+    if (pep->recorder == NULL) {
+        pep_log_warn("pep_flightrecorder_dump: PEP#%d flight recorder not enabled.",pep->id);
+        return PEP_OK;
+    }
+    pep_recorder_dump(pep->recorder,out);
+    return PEP_OK;
+}
+
+pep_error_t pep_cache_invalidate(PEP * pep, const char * subjectid) {
+    size_t removed= 0;
+    if (pep == NULL) {
+        pep_log_error("pep_cache_invalidate: NULL pep handle");
+        return PEP_ERR_NULL_POINTER;
+    }
+    if (pep->cache != NULL) {
+        removed= pep_cache_removesubject(pep->cache,subjectid);
+    }
+    if (pep->shmcache != NULL) {
+        removed+= pep_shmcache_removesubject(pep->shmcache,subjectid);
+    }
+    pep_log_debug("pep_cache_invalidate: PEP#%d %d cached responses removed for subject: %s",pep->id,(int)removed,(subjectid != NULL) ? subjectid : "ALL");
+    return PEP_OK;
+}
+
 /* no return code, not useful */
 void pep_destroy(PEP * pep) {
     int pips_destroy_rc= 0;
@@ -697,6 +1448,10 @@ void pep_destroy(PEP * pep) {
         curl_slist_free_all(pep->curl_http_headers);
         pep->curl_http_headers= NULL;
     }
+    if (pep->curl_traceparent != NULL) {
+        curl_slist_free_all(pep->curl_traceparent);
+        pep->curl_traceparent= NULL;
+    }
 
     /* release curl */
     if (pep->curl != NULL) {
@@ -709,6 +1464,14 @@ void pep_destroy(PEP * pep) {
         free(pep->option_endpoint_url);
         pep->option_endpoint_url= NULL;
     }
+    if (pep->option_endpoint_unix_socket != NULL) {
+        free(pep->option_endpoint_unix_socket);
+        pep->option_endpoint_unix_socket= NULL;
+    }
+    if (pep->curl_unix_url != NULL) {
+        free(pep->curl_unix_url);
+        pep->curl_unix_url= NULL;
+    }
     if (pep->option_ssl_cipher_list != NULL) {
         free(pep->option_ssl_cipher_list);
         pep->option_ssl_cipher_list= NULL;
@@ -735,11 +1498,27 @@ void pep_destroy(PEP * pep) {
         pep->option_client_keypassword= NULL;
     }
 
+    /* release decision cache */
+    if (pep->cache != NULL) {
+        pep_cache_delete(pep->cache);
+        pep->cache= NULL;
+    }
+    if (pep->shmcache != NULL) {
+        pep_shmcache_close(pep->shmcache);
+        pep->shmcache= NULL;
+    }
+
+    /* stop the PIP workers before destroying the pips */
+    if (pep->pip_workpool != NULL) {
+        pep_workpool_delete(pep->pip_workpool);
+        pep->pip_workpool= NULL;
+    }
+
     /* destroy all pips if any */
     while (pep_llist_length(pep->pips) > 0) {
-        pep_pip_t * pip= pep_llist_remove(pep->pips,0);
+        pip_instance_t * pip= pep_llist_remove(pep->pips,0);
         if (pip != NULL) {
-            pips_destroy_rc += pip->destroy();
+            pips_destroy_rc += pip_instance_destroy(pip);
         }
     }
     pep_llist_delete(pep->pips);
@@ -749,9 +1528,9 @@ void pep_destroy(PEP * pep) {
 
     /* destroy all obligation handlers if any */
     while (pep_llist_length(pep->ohs) > 0) {
-        pep_obligationhandler_t * oh= pep_llist_remove(pep->ohs,0);
+        oh_instance_t * oh= pep_llist_remove(pep->ohs,0);
         if (oh != NULL) {
-            ohs_destroy_rc += oh->destroy();
+            ohs_destroy_rc += oh_instance_destroy(oh);
         }
     }
     pep_llist_delete(pep->ohs);
@@ -759,6 +1538,22 @@ void pep_destroy(PEP * pep) {
         pep_log_warn("pep_destroy: some OH->destroy() failed...");
     }
 
+    if (pep->recorder != NULL) {
+        pep_recorder_delete(pep->recorder);
+        pep->recorder= NULL;
+    }
+    if (pep->capture != NULL) {
+        pep_capture_close(pep->capture);
+        pep->capture= NULL;
+    }
+    release_transport(pep);
+    if (pep->transport_request != NULL) {
+        free(pep->transport_request);
+        pep->transport_request= NULL;
+    }
+
+    /* writes the queued asynchronous log lines, the caller can close its log file */
+    pep_log_context_destroy(&(pep->log_context));
     free(pep);
 }
 
@@ -775,8 +1570,15 @@ static void init_pep_defaults(PEP * pep) {
     pep->curl_http_headers= NULL;
     /* set default options */
     pep->option_endpoint_url= NULL;
+    pep->option_endpoint_unix_socket= NULL;
+    pep->option_endpoint_unix_socket_uid= -1;
+    pep->curl_unix_socket_checked= FALSE;
+    pep->curl_unix_url= NULL;
     pep->option_loglevel= DEFAULT_LOG_LEVEL;
     pep->option_logout= (FILE *)DEFAULT_LOG_FILE;
+    pep_log_context_init(&(pep->log_context),pep->id);
+    pep_log_context_setlevel(&(pep->log_context),DEFAULT_LOG_LEVEL);
+    pep->log_context.out= pep->option_logout;
     pep->option_timeout= (long)DEFAULT_CURL_TIMEOUT; 
     pep->option_server_cert= NULL;
     pep->option_server_capath= NULL;
@@ -787,6 +1589,507 @@ static void init_pep_defaults(PEP * pep) {
     pep->option_ssl_cipher_list= NULL;
     pep->option_pips_enabled= DEFAULT_PIPS_ENABLED;
     pep->option_ohs_enabled= DEFAULT_OHS_ENABLED;
+    pep->option_cache_ttl= DEFAULT_CACHE_TTL;
+    pep->option_cache_size= DEFAULT_CACHE_SIZE;
+    pep->cache= NULL;
+    pep->shmcache= NULL;
+    pep->option_singleflight_enabled= DEFAULT_SINGLEFLIGHT_ENABLED;
+    pep->option_pip_workers= DEFAULT_PIP_WORKERS;
+    pep->pip_workpool= NULL;
+    pep->option_lazy_request_enabled= DEFAULT_LAZY_REQUEST_ENABLED;
+    pep->recorder= NULL;
+    pep->tracer= NULL;
+    pep->tracer_arg= NULL;
+    pep->curl_traceparent= NULL;
+    pep->capture= NULL;
+    pep->transport= NULL;
+    pep->transport_arg= NULL;
+    pep->loopback= NULL;
+    pep->transport_request= NULL;
+    pep->transport_request_size= 0;
+}
+
+/**
+ * returns the decision cache of the pep handle, creates it if needed, or NULL if
+ * the cache is disabled (PEP_OPTION_CACHE_TTL 0)
+ */
+static pep_cache_t * get_cache(PEP * pep) {
+    if (pep->cache == NULL && pep->option_cache_ttl > 0) {
+        pep->cache= pep_cache_create((size_t)pep->option_cache_size,pep->option_cache_ttl);
+        if (pep->cache == NULL) {
+            pep_log_error("get_cache: PEP#%d can't create decision cache.",pep->id);
+        }
+    }
+    return pep->cache;
+}
+
+/**
+ * computes the decision cache key: SHA-256 of the canonical request digest, the
+ * endpoint url and the client certificate, a response of another PEPd or given
+ * to another client identity is never returned.
+ */
+static int cache_key_digest(const PEP * pep, const xacml_request_t * request, uint8_t * cache_key) {
+    pep_sha256_t sha256;
+    uint8_t digest[XACML_HASH_LENGTH];
+    if (xacml_request_digest(request,XACML_HASH_SHA256,digest) != PEP_XACML_OK) {
+        return PEP_XACML_ERROR;
+    }
+    pep_sha256_init(&sha256);
+    pep_sha256_update(&sha256,digest,XACML_HASH_LENGTH);
+    if (pep->option_endpoint_url != NULL) {
+        pep_sha256_update(&sha256,pep->option_endpoint_url,strlen(pep->option_endpoint_url));
+    }
+    pep_sha256_update(&sha256,"",1);
+    if (pep->option_client_cert != NULL) {
+        pep_sha256_update(&sha256,pep->option_client_cert,strlen(pep->option_client_cert));
+    }
+    pep_sha256_final(&sha256,cache_key);
+    return PEP_XACML_OK;
+}
+
+/** calls the version 1 or version 2 PIP process function */
+static int pip_instance_process(pip_instance_t * pip, xacml_request_t ** request) {
+    if (pip->pip2 != NULL) return pip->pip2->process(pip->ctx,request);
+    /* a legacy PIP modifies the sections returned by the get functions */
+    if (xacml_request_ownsections(*request) != PEP_XACML_OK) {
+        pep_log_error("pip_instance_process: can't copy request sections for PIP[%s].",pip->id);
+        return PEP_ERR_MEMORY;
+    }
+    return pip->pip->process(request);
+}
+
+/** calls the version 1 or version 2 PIP destroy function, and frees the instance */
+static int pip_instance_destroy(pip_instance_t * pip) {
+    int rc= (pip->pip2 != NULL) ? pip->pip2->destroy(pip->ctx) : pip->pip->destroy();
+    free(pip);
+    return rc;
+}
+
+/** calls the version 1 or version 2 OH process function */
+static int oh_instance_process(oh_instance_t * oh, xacml_request_t ** request, xacml_response_t ** response) {
+    if (oh->oh2 != NULL) return oh->oh2->process(oh->ctx,request,response);
+    /* a legacy OH modifies the sections returned by the get functions */
+    if (*request != NULL && xacml_request_ownsections(*request) != PEP_XACML_OK) {
+        pep_log_error("oh_instance_process: can't copy request sections for OH[%s].",oh->id);
+        return PEP_ERR_MEMORY;
+    }
+    return oh->oh->process(request,response);
+}
+
+/** calls the version 1 or version 2 OH destroy function, and frees the instance */
+static int oh_instance_destroy(oh_instance_t * oh) {
+    int rc= (oh->oh2 != NULL) ? oh->oh2->destroy(oh->ctx) : oh->oh->destroy();
+    free(oh);
+    return rc;
+}
+
+/**
+ * Calls the OH obligation function for each obligation of the response it handles,
+ * looked up in the obligations index. The OH is not called if the response contains
+ * none of its obligations.
+ */
+static int process_indexed_oh(PEP * pep, oh_instance_t * oh, pep_ohindex_t ** ohindex, xacml_request_t ** request, xacml_response_t ** response) {
+    pep_ohindex_entry_t * entries= NULL;
+    size_t entries_l;
+    int k, rc= 0;
+    if (*ohindex == NULL) {
+        *ohindex= pep_ohindex_create();
+        if (*ohindex == NULL) {
+            pep_log_error("process_indexed_oh: PEP#%d can't create obligations index.",pep->id);
+            return -1;
+        }
+    }
+    if (pep_ohindex_update(*ohindex,*response) != OHINDEX_OK) {
+        pep_log_error("process_indexed_oh: PEP#%d can't index the response obligations.",pep->id);
+        return -1;
+    }
+    entries_l= pep_ohindex_lookup(*ohindex,oh->obligation_ids,&entries);
+    if (entries_l == 0) {
+        pep_log_debug("process_indexed_oh: PEP#%d no obligation handled by OH[%s]",pep->id,oh->id);
+        return 0;
+    }
+    for (k= 0; k < entries_l && rc == 0; k++) {
+        pep_log_debug("process_indexed_oh: PEP#%d calling OH[%s]->obligation(request,response,result,obligation[%s])...",pep->id,oh->id,xacml_obligation_getid(entries[k].obligation));
+        rc= oh->oh2->obligation(oh->ctx,request,response,entries[k].result,entries[k].obligation);
+    }
+    free(entries);
+    return rc;
+}
+
+/** independent PIPs batch, one overlay per PIP */
+typedef struct pip_batch {
+    pip_instance_t ** pips;
+    xacml_request_t ** overlays;
+    int * rcs;
+    pep_log_context_t * log_context; /* log context of the PEP handle */
+} pip_batch_t;
+
+/** runs the PIP job_idx of the batch on its overlay, with the log context of the PEP handle */
+static void pip_batch_job(void * arg, size_t job_idx) {
+    pip_batch_t * batch= arg;
+    pep_log_context_t * previous_log_context= pep_log_setcontext(batch->log_context);
+    batch->rcs[job_idx]= pip_instance_process(batch->pips[job_idx],&(batch->overlays[job_idx]));
+    pep_log_setcontext(previous_log_context);
+}
+
+/** deletes the overlays and the arrays of the batch */
+static void pip_batch_free(pip_batch_t * batch, size_t pips_l) {
+    int i;
+    if (batch->overlays != NULL) {
+        for (i= 0; i < pips_l; i++) {
+            if (batch->overlays[i] != NULL) xacml_request_delete(batch->overlays[i]);
+        }
+        free(batch->overlays);
+    }
+    if (batch->pips != NULL) free(batch->pips);
+    if (batch->rcs != NULL) free(batch->rcs);
+}
+
+/**
+ * Runs the pips_l independent PIPs starting at first_idx in parallel, each on a
+ * private overlay of the request, and merges the overlays into the request in
+ * the PIPs order.
+ */
+static pep_error_t process_independent_pips(PEP * pep, int first_idx, size_t pips_l, xacml_request_t ** request) {
+    pip_batch_t batch;
+    int i;
+    if (pep->pip_workpool == NULL) {
+        pep->pip_workpool= pep_workpool_create((size_t)pep->option_pip_workers);
+        if (pep->pip_workpool == NULL) {
+            pep_log_error("process_independent_pips: PEP#%d can't create PIP workers.",pep->id);
+            return PEP_ERR_MEMORY;
+        }
+    }
+    batch.pips= calloc(pips_l,sizeof(pip_instance_t *));
+    batch.overlays= calloc(pips_l,sizeof(xacml_request_t *));
+    batch.rcs= calloc(pips_l,sizeof(int));
+    batch.log_context= &(pep->log_context);
+    if (batch.pips == NULL || batch.overlays == NULL || batch.rcs == NULL) {
+        pep_log_error("process_independent_pips: PEP#%d can't allocate batch of %d PIPs.",pep->id,(int)pips_l);
+        pip_batch_free(&batch,pips_l);
+        return PEP_ERR_MEMORY;
+    }
+    for (i= 0; i < pips_l; i++) {
+        batch.pips[i]= pep_llist_get(pep->pips,first_idx + i);
+        batch.overlays[i]= xacml_request_createoverlay(*request);
+        if (batch.overlays[i] == NULL) {
+            pep_log_error("process_independent_pips: PEP#%d can't create request overlay for PIP[%s].",pep->id,batch.pips[i]->id);
+            pip_batch_free(&batch,pips_l);
+            return PEP_ERR_MEMORY;
+        }
+    }
+    pep_log_debug("process_independent_pips: PEP#%d calling %d independent PIPs in parallel...",pep->id,(int)pips_l);
+    if (pep_workpool_run(pep->pip_workpool,pip_batch_job,&batch,pips_l) != WORKPOOL_OK) {
+        pep_log_error("process_independent_pips: PEP#%d can't run the independent PIPs.",pep->id);
+        pip_batch_free(&batch,pips_l);
+        return PEP_ERR_PIP_PROCESS;
+    }
+    for (i= 0; i < pips_l; i++) {
+        if (batch.rcs[i] != 0) {
+            pep_log_error("pep_authorize: PIP[%s] process(request) failed: %d", batch.pips[i]->id, batch.rcs[i]);
+            pip_batch_free(&batch,pips_l);
+            return PEP_ERR_PIP_PROCESS;
+        }
+    }
+    if (xacml_request_merge(*request,batch.overlays,pips_l) != PEP_XACML_OK) {
+        pep_log_error("process_independent_pips: PEP#%d can't merge the request overlays.",pep->id);
+        pip_batch_free(&batch,pips_l);
+        return PEP_ERR_PIP_PROCESS;
+    }
+    pip_batch_free(&batch,pips_l);
+    return PEP_OK;
+}
+
+/**
+ * Base64 encodes the marshalled request of the output buffer, POSTs it to the PEPd
+ * endpoint and base64 decodes the PEPd response into the input buffer.
+ */
+static pep_error_t send_authorization_request(PEP * pep, pep_buffer_t * output, pep_buffer_t * input) {
+    size_t output_l, b64output_l;
+    CURLcode curl_rc;
+    long http_code= 0;
+    int traceparent_attached= FALSE;
+
+    if (pep->transport != NULL) {
+        return send_transport_request(pep,output,input);
+    }
+
+    /* route the url over the unix domain socket, if any */
+    if (!pep->curl_unix_socket_checked) {
+        int unix_rc= set_curl_unix_socket(pep);
+        if (unix_rc != 0) {
+            return PEP_ERR_CURL + unix_rc;
+        }
+    }
+
+    if (pep->capture != NULL) pep_capture_write(pep->capture,CAPTURE_REQUEST,output);
+
+    /* base64 encode the output buffer */
+    output_l= pep_buffer_length(output);
+    pep->b64output= pep_buffer_create( output_l );
+    if (pep->b64output == NULL) {
+        pep_log_error("send_authorization_request: PEP#%d can't create base64 output buffer (%d bytes).",pep->id,(int)output_l);
+        return PEP_ERR_MEMORY;
+    }
+    
+    pep_log_debug("send_authorization_request: PEP#%d: encoding base64 output...",pep->id);
+    PEP_PROBE2(base64__encode__start,pep->id,output_l);
+    pep_base64_encode_buffer_l(output,pep->b64output,BASE64_DEFAULT_LINE_SIZE);
+    PEP_PROBE2(base64__encode__end,pep->id,pep_buffer_length(pep->b64output));
+
+    /* configure curl handler to POST the base64 encoded marshalled PEP request buffer */
+    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_POST, 1L);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_setopt(curl,CURLOPT_POST,1) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        return PEP_ERR_CURL + curl_rc;
+    }
+    b64output_l= pep_buffer_length(pep->b64output);
+    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_POSTFIELDSIZE, (long)b64output_l);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_setopt(curl,CURLOPT_POSTFIELDSIZE,%d) failed: %s.",pep->id,(int)b64output_l,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        return PEP_ERR_CURL + curl_rc;
+    }
+
+    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_READDATA, pep->b64output);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_setopt(curl,CURLOPT_READDATA,b64output) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        return PEP_ERR_CURL + curl_rc;
+    }
+
+    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_READFUNCTION, pep_buffer_read);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_setopt(curl,CURLOPT_READFUNCTION,buffer_read) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        return PEP_ERR_CURL + curl_rc;
+    }
+
+
+    /* configure curl handler to read the base64 encoded HTTP response */
+    pep->b64input= pep_buffer_create(1024);
+    if (pep->b64input == NULL) {
+        pep_log_error("send_authorization_request: PEP#%d can't create base64 input buffer.",pep->id);
+        pep_buffer_delete(pep->b64output);
+        return PEP_ERR_MEMORY;
+    }
+
+    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_WRITEDATA, pep->b64input);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_setopt(curl,CURLOPT_WRITEDATA,b64input) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        pep_buffer_delete(pep->b64input);
+        return PEP_ERR_CURL + curl_rc;
+    }
+    curl_rc= curl_easy_setopt(pep->curl, CURLOPT_WRITEFUNCTION, pep_buffer_write);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,buffer_write) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        pep_buffer_delete(pep->b64input);
+        return PEP_ERR_CURL + curl_rc;
+    }
+
+
+    /* send the request */
+    pep_log_info("send_authorization_request: PEP#%d sending XACML request to: %s",pep->id,pep->option_endpoint_url);
+    if (pep->tracer != NULL && pep->tracer->traceparent != NULL) {
+        traceparent_attached= attach_traceparent(pep);
+    }
+    PEP_PROBE2(curl__start,pep->id,b64output_l);
+    curl_rc= curl_easy_perform(pep->curl);
+    PEP_PROBE3(curl__end,pep->id,curl_rc,pep_buffer_length(pep->b64input));
+    pep_recorder_curl(pep->recorder,pep->curl);
+    if (traceparent_attached) detach_traceparent(pep);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d sending XACML request to %s failed: curl[%d] %s.",pep->id,pep->option_endpoint_url,(int)curl_rc,curl_easy_strerror(curl_rc));
+        if (curl_rc == CURLE_COULDNT_CONNECT) {
+            /* check the unix socket again, the PEPd may be restarted */
+            pep->curl_unix_socket_checked= FALSE;
+        }
+        pep_buffer_delete(pep->b64output);
+        pep_buffer_delete(pep->b64input);
+        return PEP_ERR_CURL + curl_rc;
+    }
+
+    /* check for HTTP 200 response code */
+    http_code= 0;
+    curl_rc= curl_easy_getinfo(pep->curl,CURLINFO_RESPONSE_CODE,&http_code);
+    if (curl_rc != CURLE_OK) {
+        pep_log_error("send_authorization_request: PEP#%d curl_easy_getinfo(pep->curl,CURLINFO_RESPONSE_CODE,&http_code) failed: %s.",pep->id,curl_easy_strerror(curl_rc));
+        pep_buffer_delete(pep->b64output);
+        pep_buffer_delete(pep->b64input);
+        return PEP_ERR_CURL + curl_rc;
+    }
+    if (http_code != 200) {
+        pep_log_error("send_authorization_request: PEP#%d: HTTP status code: %d.",pep->id,(int)http_code);
+        pep_buffer_delete(pep->b64output);
+        pep_buffer_delete(pep->b64input);
+        return PEP_ERR_AUTHZ_REQUEST;
+    }
+
+    /* not required anymore */
+    pep_buffer_delete(pep->b64output);
+
+    pep_log_debug("send_authorization_request: PEP#%d: HTTP status code: %d.",pep->id,(int)http_code);
+
+    if (pep->capture != NULL) pep_capture_write(pep->capture,CAPTURE_RESPONSE,pep->b64input);
+
+    /* base64 decode the input buffer into the Hessian buffer. */
+    pep_log_debug("send_authorization_request: PEP#%d: decoding base64 input...",pep->id);
+    PEP_PROBE2(base64__decode__start,pep->id,pep_buffer_length(pep->b64input));
+    pep_base64_decode_buffer(pep->b64input,input);
+    PEP_PROBE2(base64__decode__end,pep->id,pep_buffer_length(input));
+
+    /* not required anymore */
+    pep_buffer_delete(pep->b64input);
+
+    return PEP_OK;
+}
+
+/**
+ * Sends the marshalled request of the output buffer with the transport of the
+ * handle, blocking or non-blocking, and reads the response into the input buffer.
+ */
+static pep_error_t send_transport_request(PEP * pep, pep_buffer_t * output, pep_buffer_t * input) {
+    const pep_transport_t * transport= pep->transport;
+    const unsigned char * response= NULL;
+    size_t output_l, response_l= 0;
+    long timeout_ms= pep->option_timeout * 1000L;
+    int rc;
+
+    /* copy the request bytes, the scratch array is reused by the next calls */
+    output_l= pep_buffer_length(output);
+    if (output_l > pep->transport_request_size) {
+        unsigned char * transport_request= realloc(pep->transport_request,output_l);
+        if (transport_request == NULL) {
+            pep_log_error("send_transport_request: PEP#%d can't allocate request (%d bytes).",pep->id,(int)output_l);
+            return PEP_ERR_MEMORY;
+        }
+        pep->transport_request= transport_request;
+        pep->transport_request_size= output_l;
+    }
+    pep_buffer_read(pep->transport_request,sizeof(unsigned char),output_l,output);
+    pep_buffer_rewind(output);
+
+    pep_log_info("send_transport_request: PEP#%d sending XACML request with transport %p",pep->id,transport);
+    if (transport->send != NULL) {
+        rc= transport->send(pep->transport_arg,pep->id,pep->transport_request,output_l);
+    }
+    else {
+        while ((rc= transport->send_async(pep->transport_arg,pep->id,pep->transport_request,output_l)) == PEP_TRANSPORT_AGAIN) {
+            if (transport->wait(pep->transport_arg,pep->id,timeout_ms) != PEP_TRANSPORT_OK) {
+                rc= PEP_TRANSPORT_ERROR;
+                break;
+            }
+        }
+    }
+    if (rc != PEP_TRANSPORT_OK) {
+        pep_log_error("send_transport_request: PEP#%d sending XACML request failed: %d.",pep->id,rc);
+        return PEP_ERR_AUTHZ_REQUEST;
+    }
+
+    if (transport->receive != NULL) {
+        rc= transport->receive(pep->transport_arg,pep->id,&response,&response_l);
+    }
+    else {
+        while ((rc= transport->receive_async(pep->transport_arg,pep->id,&response,&response_l)) == PEP_TRANSPORT_AGAIN) {
+            if (transport->wait(pep->transport_arg,pep->id,timeout_ms) != PEP_TRANSPORT_OK) {
+                rc= PEP_TRANSPORT_ERROR;
+                break;
+            }
+        }
+    }
+    if (rc != PEP_TRANSPORT_OK || response == NULL) {
+        pep_log_error("send_transport_request: PEP#%d receiving XACML response failed: %d.",pep->id,rc);
+        return PEP_ERR_AUTHZ_REQUEST;
+    }
+    pep_log_debug("send_transport_request: PEP#%d received %d bytes.",pep->id,(int)response_l);
+    pep_buffer_write(response,sizeof(unsigned char),response_l,input);
+    return PEP_OK;
+}
+
+/** restores the libcurl transport, deletes the loopback transport */
+static void release_transport(PEP * pep) {
+    if (pep->loopback != NULL) {
+        pep_loopback_delete(pep->loopback);
+        pep->loopback= NULL;
+    }
+    pep->transport= NULL;
+    pep->transport_arg= NULL;
+}
+
+/** writes the NUL terminated option string, or an empty string if NULL, in the key */
+static void singleflight_key_option(pep_buffer_t * key, const char * option) {
+    if (option != NULL) {
+        pep_buffer_write(option,sizeof(char),strlen(option),key);
+    }
+    pep_buffer_putc('\0',key);
+}
+
+/**
+ * Sends the marshalled request of the output buffer only once for all the threads
+ * sending an identical request to the same endpoint at the same time. The leader
+ * sends the request, the followers receive a copy of the leader response or error.
+ */
+static pep_error_t send_singleflight_request(PEP * pep, pep_buffer_t * output, pep_buffer_t * input) {
+    pep_flight_t * flight= NULL;
+    pep_buffer_t * key= NULL;
+    unsigned char * key_bytes= NULL;
+    size_t key_l, prefix_l, output_l;
+    pep_error_t rc;
+    int join_rc;
+    /* key: endpoint url, TLS configuration and request bytes */
+    output_l= pep_buffer_length(output);
+    key= pep_buffer_create(output_l + 256);
+    if (key == NULL) {
+        pep_log_error("send_singleflight_request: PEP#%d can't create key buffer.",pep->id);
+        return PEP_ERR_MEMORY;
+    }
+    pep_buffer_write(pep->option_endpoint_url,sizeof(char),strlen(pep->option_endpoint_url) + 1,key);
+    if (pep->option_endpoint_unix_socket != NULL) {
+        pep_buffer_write(pep->option_endpoint_unix_socket,sizeof(char),strlen(pep->option_endpoint_unix_socket) + 1,key);
+        pep_buffer_write(&(pep->option_endpoint_unix_socket_uid),sizeof(int),1,key);
+    }
+    pep_buffer_write(&(pep->option_ssl_validation),sizeof(int),1,key);
+    singleflight_key_option(key,pep->option_server_cert);
+    singleflight_key_option(key,pep->option_server_capath);
+    singleflight_key_option(key,pep->option_client_cert);
+    singleflight_key_option(key,pep->option_client_key);
+    singleflight_key_option(key,pep->option_ssl_cipher_list);
+    prefix_l= pep_buffer_length(key);
+    key_l= prefix_l + output_l;
+    key_bytes= calloc(key_l + 1,sizeof(unsigned char));
+    if (key_bytes == NULL) {
+        pep_log_error("send_singleflight_request: PEP#%d can't allocate key (%d bytes).",pep->id,(int)key_l);
+        pep_buffer_delete(key);
+        return PEP_ERR_MEMORY;
+    }
+    pep_buffer_read(key_bytes,sizeof(unsigned char),prefix_l,key);
+    pep_buffer_read(key_bytes + prefix_l,sizeof(unsigned char),output_l,output);
+    pep_buffer_rewind(output);
+    pep_buffer_delete(key);
+
+    join_rc= pep_singleflight_join(key_bytes,key_l,&flight);
+    free(key_bytes);
+    switch (join_rc) {
+    case SINGLEFLIGHT_LEADER:
+        rc= send_authorization_request(pep,output,input);
+        pep_singleflight_complete(flight,rc,input);
+        break;
+    case SINGLEFLIGHT_FOLLOWER:
+        pep_log_info("send_singleflight_request: PEP#%d identical request in flight, waiting for its response...",pep->id);
+        rc= pep_singleflight_wait(flight,input);
+        if (rc != PEP_OK) {
+            pep_log_error("send_singleflight_request: PEP#%d in flight request failed: %s.",pep->id,pep_strerror(rc));
+        }
+        break;
+    default:
+        /* no coalescing */
+        rc= send_authorization_request(pep,output,input);
+        break;
+    }
+    return rc;
 }
 
 /** set some curl default value */
@@ -845,6 +2148,80 @@ static int set_curl_http_headers(PEP * pep) {
     return 0;
 }
 
+/* "traceparent: " header prefix */
+#define TRACEPARENT_HEADER "traceparent: "
+#define TRACEPARENT_HEADER_LENGTH 13
+
+/**
+ * Links the traceparent header of the "send" span at the end of the curl
+ * http headers. The header node is allocated once and its value overwritten
+ * for each request. Returns TRUE if the header is linked.
+ */
+static int attach_traceparent(PEP * pep) {
+    char traceparent[PEP_TRACEPARENT_LENGTH + 1];
+    struct curl_slist * tail;
+    memset(traceparent,0,sizeof(traceparent));
+    if (pep->tracer->traceparent(pep->tracer_arg,pep->trace_phase_span,traceparent) != 0) {
+        return FALSE;
+    }
+    if (!is_valid_traceparent(traceparent)) {
+        pep_log_warn("attach_traceparent: PEP#%d invalid traceparent, header not sent.",pep->id);
+        return FALSE;
+    }
+    if (pep->curl_traceparent == NULL) {
+        pep->curl_traceparent= curl_slist_append(NULL,TRACEPARENT_HEADER "00-00000000000000000000000000000000-0000000000000000-00");
+        if (pep->curl_traceparent == NULL) {
+            pep_log_warn("attach_traceparent: PEP#%d can't allocate traceparent header.",pep->id);
+            return FALSE;
+        }
+    }
+    memcpy(pep->curl_traceparent->data + TRACEPARENT_HEADER_LENGTH,traceparent,PEP_TRACEPARENT_LENGTH);
+    if (pep->curl_http_headers == NULL) {
+        pep->curl_http_headers= pep->curl_traceparent;
+    }
+    else {
+        for (tail= pep->curl_http_headers; tail->next != NULL; tail= tail->next);
+        tail->next= pep->curl_traceparent;
+    }
+    curl_easy_setopt(pep->curl,CURLOPT_HTTPHEADER,pep->curl_http_headers);
+    pep_log_debug("attach_traceparent: PEP#%d %s",pep->id,pep->curl_traceparent->data);
+    return TRUE;
+}
+
+/**
+ * Returns TRUE if the traceparent has the W3C format "2hex-32hex-16hex-2hex",
+ * with lowercase hex digits: nothing else can be written in the http header.
+ */
+static int is_valid_traceparent(const char * traceparent) {
+    size_t i;
+    if (strlen(traceparent) != PEP_TRACEPARENT_LENGTH) {
+        return FALSE;
+    }
+    for (i= 0; i < PEP_TRACEPARENT_LENGTH; i++) {
+        char c= traceparent[i];
+        if (i == 2 || i == 35 || i == 52) {
+            if (c != '-') return FALSE;
+        }
+        else if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/** unlinks the traceparent header from the curl http headers */
+static void detach_traceparent(PEP * pep) {
+    struct curl_slist * node;
+    if (pep->curl_http_headers == pep->curl_traceparent) {
+        pep->curl_http_headers= NULL;
+    }
+    else {
+        for (node= pep->curl_http_headers; node != NULL && node->next != pep->curl_traceparent; node= node->next);
+        if (node != NULL) node->next= NULL;
+    }
+    curl_easy_setopt(pep->curl,CURLOPT_HTTPHEADER,pep->curl_http_headers);
+}
+
 /** disable signal for multi-threading */
 static int set_curl_nosignal(const PEP * pep) {
     CURLcode curl_rc;
@@ -870,6 +2247,108 @@ static int set_curl_endpoint_url(const PEP * pep) {
 }
 
 
+/*
+ * set libcurl CURLOPT_UNIX_SOCKET_PATH and CURLOPT_URL for the unix:///path/to/socket
+ * endpoint url or the PEP_OPTION_ENDPOINT_UNIX_SOCKET option. The https url is sent
+ * as http, without TLS, if the socket is trusted. Returns a CURLcode.
+ */
+static int set_curl_unix_socket(PEP * pep) {
+    const char * socket_path= pep->option_endpoint_unix_socket;
+    const char * url= pep->option_endpoint_url;
+    pep->curl_unix_socket_checked= TRUE;
+    if (strncmp(url,UNIX_SOCKET_URL_PREFIX,sizeof(UNIX_SOCKET_URL_PREFIX) - 1) == 0) {
+        socket_path= url + sizeof(UNIX_SOCKET_URL_PREFIX) - 1;
+        url= UNIX_SOCKET_ENDPOINT_URL;
+    }
+    if (socket_path == NULL && pep->curl_unix_url == NULL) {
+        /* no unix socket, url already set */
+        return CURLE_OK;
+    }
+#if LIBCURL_VERSION_NUM >= 0x072800
+    {
+        CURLcode curl_rc;
+        size_t url_l;
+        if (pep->curl_unix_url != NULL) {
+            free(pep->curl_unix_url);
+            pep->curl_unix_url= NULL;
+        }
+        if (socket_path == NULL) {
+            /* unix socket removed, restore the url */
+            pep_log_debug("set_curl_unix_socket: PEP#%d no unix socket, url: %s",pep->id,pep->option_endpoint_url);
+            curl_easy_setopt(pep->curl, CURLOPT_UNIX_SOCKET_PATH, NULL);
+            return (set_curl_endpoint_url(pep) == 0) ? CURLE_OK : CURLE_URL_MALFORMAT;
+        }
+        url_l= strlen(url);
+        pep->curl_unix_url= calloc(url_l + 1, sizeof(char));
+        if (pep->curl_unix_url == NULL) {
+            pep_log_error("set_curl_unix_socket: PEP#%d can't allocate url: %s.",pep->id,url);
+            pep->curl_unix_socket_checked= FALSE;
+            return CURLE_OUT_OF_MEMORY;
+        }
+        if (strncmp(url,"https://",8) == 0 && is_trusted_unix_socket(pep,socket_path)) {
+            /* trusted local hop, skip TLS */
+            memcpy(pep->curl_unix_url,"http://",7);
+            memcpy(pep->curl_unix_url + 7,url + 8,url_l - 8);
+        }
+        else {
+            memcpy(pep->curl_unix_url,url,url_l);
+        }
+        pep_log_info("set_curl_unix_socket: PEP#%d unix socket: %s url: %s",pep->id,socket_path,pep->curl_unix_url);
+        curl_rc= curl_easy_setopt(pep->curl, CURLOPT_UNIX_SOCKET_PATH, socket_path);
+        if (curl_rc == CURLE_OK) {
+            curl_rc= curl_easy_setopt(pep->curl, CURLOPT_URL, pep->curl_unix_url);
+        }
+        if (curl_rc != CURLE_OK) {
+            pep_log_error("set_curl_unix_socket: PEP#%d curl_easy_setopt(curl,CURLOPT_UNIX_SOCKET_PATH,%s) failed: %s.",pep->id,socket_path,curl_easy_strerror(curl_rc));
+            pep->curl_unix_socket_checked= FALSE;
+        }
+        return curl_rc;
+    }
+#else
+    pep_log_error("set_curl_unix_socket: PEP#%d libcurl %s does not support unix domain socket %s.",pep->id,LIBCURL_VERSION,(socket_path != NULL) ? socket_path : "");
+    pep->curl_unix_socket_checked= FALSE;
+    return CURLE_UNSUPPORTED_PROTOCOL;
+#endif
+}
+
+/*
+ * returns TRUE if the unix socket itself, not a symlink, and its directory are
+ * owned by root or the PEPd uid (PEP_OPTION_ENDPOINT_UNIX_SOCKET_UID, default the
+ * effective user), and the directory is not writable by group or others: no other
+ * user can have replaced the PEPd socket.
+ */
+static int is_trusted_unix_socket(const PEP * pep, const char * socket_path) {
+    struct stat st;
+    char * dir;
+    const char * slash;
+    size_t dir_l;
+    uid_t uid= (pep->option_endpoint_unix_socket_uid >= 0) ? (uid_t)pep->option_endpoint_unix_socket_uid : geteuid();
+    int trusted;
+    if (lstat(socket_path,&st) != 0 || !S_ISSOCK(st.st_mode) || (st.st_uid != 0 && st.st_uid != uid)) {
+        pep_log_warn("is_trusted_unix_socket: PEP#%d %s is not a socket owned by root or uid %d, TLS used.",pep->id,socket_path,(int)uid);
+        return FALSE;
+    }
+    slash= strrchr(socket_path,'/');
+    dir_l= (slash == NULL || slash == socket_path) ? 1 : (size_t)(slash - socket_path);
+    dir= calloc(dir_l + 1,sizeof(char));
+    if (dir == NULL) {
+        pep_log_error("is_trusted_unix_socket: PEP#%d can't allocate directory name.",pep->id);
+        return FALSE;
+    }
+    if (slash == NULL) {
+        dir[0]= '.';
+    }
+    else {
+        strncpy(dir,socket_path,dir_l);
+    }
+    trusted= (stat(dir,&st) == 0 && (st.st_uid == 0 || st.st_uid == uid) && !(st.st_mode & (S_IWGRP|S_IWOTH)));
+    if (!trusted) {
+        pep_log_warn("is_trusted_unix_socket: PEP#%d %s not owned by root or uid %d or writable by group/others, TLS used.",pep->id,dir,(int)uid);
+    }
+    free(dir);
+    return trusted;
+}
+
 /* set libcurl CURLOPT_TIMEOUT */
 static int set_curl_connection_timeout(const PEP * pep) {
     CURLcode curl_rc;
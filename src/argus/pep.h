@@ -67,8 +67,13 @@ extern "C" {
 
 /** @defgroup PEPClient PEP client API */
 /** @defgroup Logging Log Level and Output */
+/** @defgroup Tracing Tracing Hooks */
+/** @defgroup Transport Transport */
 
+#include <stdio.h> /* FILE */
+#include <stddef.h> /* size_t */
 #include <stdarg.h> /* va_list */
+#include <time.h> /* time_t */
 #include "xacml.h"
 #include "profiles.h"
 #include "pip.h"
@@ -84,6 +89,10 @@ extern "C" {
  * By default the log level is {@link #PEP_LOGLEVEL_NONE} and the log output is NULL, therefore,
  * the PEP client doesn't log anything.
  *
+ * The log level, output and handlers are set per PEP client handle, and apply to the messages
+ * logged during the calls of this handle. The messages logged outside of a handle call use the
+ * configuration last set on any handle.
+ *
  * See @ref Error for example how to handle error in your code.
  *
  * Example to debug in a log file:
@@ -151,6 +160,192 @@ extern "C" {
  */
 typedef int pep_log_handler_callback(int level, const char * format, va_list args);
 
+#ifndef _PEP_LOG_RECORD_T_
+#define _PEP_LOG_RECORD_T_
+/**
+ * Structured log record, passed to the {@link #pep_log_record_callback} function.
+ */
+typedef struct pep_log_record {
+    int level; /**< The log level: {@link #PEP_LOGLEVEL_ERROR} ... {@link #PEP_LOGLEVEL_DEBUG} */
+    time_t time; /**< The log time */
+    int id; /**< The PEP client id, see pep_getid(PEP * pep) */
+    const char * phase; /**< The authorization phase: "pips", "cache", "marshal", "send", "unmarshal" or "ohs", or @c NULL */
+    const char * request; /**< The request hash (16 hex digits), or @c NULL */
+    const char * message; /**< The formatted message, not terminated with a "\n" */
+} pep_log_record_t;
+#endif
+
+/**
+ * Optional structured log record callback prototype. When set, it @b replaces the log handler
+ * and the log output of the PEP client handle.
+ *
+ * @param record The log record, only valid during the call
+ * @return int 0 or an error code.
+ *
+ * Example to log the records as JSON lines:
+ * @code
+ * int my_record_log(const pep_log_record_t * record) {
+ *    fprintf(my_logfile,"{\"level\":%d,\"pep\":%d,\"phase\":\"%s\",\"request\":\"%s\",\"msg\":\"%s\"}\n",
+ *            record->level,record->id,record->phase ? record->phase : "",
+ *            record->request ? record->request : "",record->message);
+ *    return 0;
+ * }
+ * ...
+ * rc= pep_setoption(pep,PEP_OPTION_LOG_RECORD_HANDLER, (pep_log_record_callback *)my_record_log);
+ * @endcode
+ *
+ * @see pep_setoption(pep,pep_option_t option,...)
+ */
+typedef int pep_log_record_callback(const pep_log_record_t * record);
+
+/** @} */
+
+
+/** @addtogroup Tracing
+ *
+ * Optional tracing hooks, to report the PEP client calls and their phases as spans of
+ * your distributed tracing system, and to propagate the trace context to the PEP daemon
+ * in a W3C Trace Context @c traceparent HTTP header.
+ *
+ * Each pep_authorize or pep_authorize_decision call is a span ("pep_authorize" or
+ * "pep_authorize_decision"), and each of its phases is a child span: "pips", "cache",
+ * "marshal", "send", "unmarshal" and "ohs". Without tracer (default), no span is created.
+ *
+ * @{
+ */
+
+/** Length of a W3C @c traceparent header value: "00-<trace-id>-<parent-id>-<trace-flags>" */
+#define PEP_TRACEPARENT_LENGTH 55
+
+/**
+ * Tracer start span function prototype.
+ *
+ * @param void * arg the tracer argument given with {@link #PEP_OPTION_TRACER}
+ * @param int id the PEP client id
+ * @param const char * name the span name: the function or the phase name
+ * @param void * parent the parent span, or @c NULL for the call span
+ * @return void * the span, passed to the end span function, can be @c NULL.
+ */
+typedef void * tracer_start_span_func(void * arg, int id, const char * name, void * parent);
+
+/**
+ * Tracer end span function prototype.
+ *
+ * @param void * arg the tracer argument given with {@link #PEP_OPTION_TRACER}
+ * @param void * span the span returned by the start span function
+ * @param int rc the {@link #pep_error_t} of the call or phase
+ */
+typedef void tracer_end_span_func(void * arg, void * span, int rc);
+
+/**
+ * Tracer traceparent function prototype, called before sending the request to the PEP
+ * daemon with the "send" span.
+ *
+ * @param void * arg the tracer argument given with {@link #PEP_OPTION_TRACER}
+ * @param void * span the "send" span
+ * @param char * traceparent buffer of {@link #PEP_TRACEPARENT_LENGTH} + 1 chars to fill with the
+ *        @c traceparent value, e.g. "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01".
+ *        A value not in this format (lowercase hex digits and dashes) is not sent.
+ * @return int 0 to send the @c traceparent header, or any other value to not send it.
+ */
+typedef int tracer_traceparent_func(void * arg, void * span, char * traceparent);
+
+/**
+ * Tracer type: span callbacks and optional trace context propagation.
+ */
+typedef struct pep_tracer {
+    tracer_start_span_func * start_span; /**< pointer to the start span function */
+    tracer_end_span_func * end_span; /**< pointer to the end span function */
+    tracer_traceparent_func * traceparent; /**< pointer to the traceparent function, or @c NULL */
+} pep_tracer_t;
+
+/** @} */
+
+
+/** @addtogroup Transport
+ *
+ * Optional transport of the marshalled (Hessian) requests and responses, replacing
+ * the default libcurl HTTP(S) transport to the PEP daemon endpoint. The endpoint URL,
+ * SSL options, traffic capture, @c traceparent header and {@link #PEP_OPTION_ENABLE_SINGLEFLIGHT} only
+ * apply to the default transport.
+ *
+ * A blocking transport implements the send and receive functions. A non-blocking
+ * transport, driven by your own I/O loop, implements the send_async, receive_async
+ * and wait functions instead: the PEP client calls the async function until it
+ * does not return {@link #PEP_TRANSPORT_AGAIN} anymore, and calls the wait function
+ * in between.
+ *
+ * @{
+ */
+
+/** Transport functions return codes */
+#define PEP_TRANSPORT_OK      0 /**< Transport function succeed */
+#define PEP_TRANSPORT_AGAIN   1 /**< Async transport function not completed, call it again after wait */
+#define PEP_TRANSPORT_ERROR  -1 /**< Transport function failed */
+
+/**
+ * Transport send function prototype.
+ *
+ * @param void * arg the transport argument given with {@link #PEP_OPTION_TRANSPORT}
+ * @param int id the PEP client id
+ * @param const unsigned char * request the marshalled request bytes, only valid during the call
+ * @param size_t request_l the length of the request
+ * @return int {@link #PEP_TRANSPORT_OK}, {@link #PEP_TRANSPORT_ERROR} or for send_async
+ *         {@link #PEP_TRANSPORT_AGAIN}.
+ */
+typedef int transport_send_func(void * arg, int id, const unsigned char * request, size_t request_l);
+
+/**
+ * Transport receive function prototype.
+ *
+ * @param void * arg the transport argument given with {@link #PEP_OPTION_TRANSPORT}
+ * @param int id the PEP client id
+ * @param const unsigned char ** response set to the marshalled response bytes, owned by
+ *        the transport and valid until its next send
+ * @param size_t * response_l set to the length of the response
+ * @return int {@link #PEP_TRANSPORT_OK}, {@link #PEP_TRANSPORT_ERROR} or for receive_async
+ *         {@link #PEP_TRANSPORT_AGAIN}.
+ */
+typedef int transport_receive_func(void * arg, int id, const unsigned char ** response, size_t * response_l);
+
+/**
+ * Transport wait function prototype, called when an async function returned
+ * {@link #PEP_TRANSPORT_AGAIN}. Blocks until the transport can make progress,
+ * e.g. with poll(2) on its sockets.
+ *
+ * @param void * arg the transport argument given with {@link #PEP_OPTION_TRANSPORT}
+ * @param int id the PEP client id
+ * @param long timeout_ms the {@link #PEP_OPTION_ENDPOINT_TIMEOUT} in milliseconds
+ * @return int {@link #PEP_TRANSPORT_OK} or {@link #PEP_TRANSPORT_ERROR} to abort the call.
+ */
+typedef int transport_wait_func(void * arg, int id, long timeout_ms);
+
+/**
+ * Transport type: blocking or non-blocking exchange of the marshalled request and response.
+ */
+typedef struct pep_transport {
+    transport_send_func * send; /**< pointer to the send function, or @c NULL */
+    transport_receive_func * receive; /**< pointer to the receive function, or @c NULL */
+    transport_send_func * send_async; /**< pointer to the non-blocking send function, used if send is @c NULL */
+    transport_receive_func * receive_async; /**< pointer to the non-blocking receive function, used if receive is @c NULL */
+    transport_wait_func * wait; /**< pointer to the wait function, required by the async functions */
+} pep_transport_t;
+
+/**
+ * Loopback transport responder function prototype: answers the request in process,
+ * e.g. with a recorded response, to benchmark the PEP client without network.
+ *
+ * @param void * arg the responder argument given with {@link #PEP_OPTION_TRANSPORT_LOOPBACK}
+ * @param int id the PEP client id
+ * @param const unsigned char * request the marshalled request bytes
+ * @param size_t request_l the length of the request
+ * @param const unsigned char ** response set to the marshalled response bytes, owned by
+ *        the responder and valid until its next call
+ * @param size_t * response_l set to the length of the response
+ * @return int {@link #PEP_TRANSPORT_OK} or {@link #PEP_TRANSPORT_ERROR}.
+ */
+typedef int transport_responder_func(void * arg, int id, const unsigned char * request, size_t request_l, const unsigned char ** response, size_t * response_l);
+
 /** @} */
 
 
@@ -171,10 +366,10 @@ typedef struct pep_handle PEP;
  * @see pep_setoption(pep,option, ...) to set a configuration option.
  */
 typedef enum pep_option {
-    PEP_OPTION_LOG_LEVEL,  /**< Set log level (default {@link #PEP_LOGLEVEL_NONE}) */
-    PEP_OPTION_LOG_STDERR,  /**< Set log engine file descriptor: @c stderr, @c stdout, @c NULL (default @c NULL) */
-    PEP_OPTION_LOG_HANDLER,  /**< Set the optional log handler callback function pointer (default @c NULL) */
-    PEP_OPTION_ENDPOINT_URL, /**< Set the @b mandatory PEP daemon endpoint URL. */
+    PEP_OPTION_LOG_LEVEL,  /**< Set log level of the PEP client handle calls (default {@link #PEP_LOGLEVEL_NONE}) */
+    PEP_OPTION_LOG_STDERR,  /**< Set log engine file descriptor of the PEP client handle calls: @c stderr, @c stdout, @c NULL (default @c NULL) */
+    PEP_OPTION_LOG_HANDLER,  /**< Set the optional log handler callback function pointer of the PEP client handle calls (default @c NULL) */
+    PEP_OPTION_ENDPOINT_URL, /**< Set the @b mandatory PEP daemon endpoint URL, or @c unix:///path/to/socket for a node local PEP daemon. */
     PEP_OPTION_ENDPOINT_SSL_VALIDATION, /**< Enable SSL validation: 0 or 1 (default 1) */
     PEP_OPTION_ENDPOINT_SERVER_CERT, /**< PEP daemon server SSL certificate (PEM format): absolute filename */
     PEP_OPTION_ENDPOINT_SERVER_CAPATH, /**< Directory holding CA certificates (hashed filenames in PEM format) to verify the PEP daemon: absolute directory name */
@@ -184,7 +379,26 @@ typedef enum pep_option {
     PEP_OPTION_ENDPOINT_TIMEOUT, /**< Timeout for the connection to endpoint URL in second (default 30s) */
     PEP_OPTION_ENABLE_PIPS, /**< Enable PIPs pre-processing: 0 or 1 (default 1) */
     PEP_OPTION_ENABLE_OBLIGATIONHANDLERS, /**< Enable OHs post-processing: 0 or 1 (default 1) */
-    PEP_OPTION_ENDPOINT_SSL_CIPHER_LIST /**< PEP client list of ciphers to use for the SSL connection: string */
+    PEP_OPTION_ENDPOINT_SSL_CIPHER_LIST, /**< PEP client list of ciphers to use for the SSL connection: string */
+    PEP_OPTION_CACHE_TTL, /**< Enable the decision cache: default time-to-live of the cached responses in second, 0 disables the cache (default 0) */
+    PEP_OPTION_CACHE_SIZE, /**< Maximum number of responses in the decision cache (default 1024) */
+    PEP_OPTION_CACHE_OBLIGATION_TTL, /**< Time-to-live in second of the responses containing an obligation: obligation id string and int TTL, 0 never caches the response, the cache must be enabled first */
+    PEP_OPTION_CACHE_DECISION, /**< Cache or not the responses with a decision: {@link #xacml_decision_t} and 0 or 1 (default PERMIT and DENY are cached), the cache must be enabled first */
+    PEP_OPTION_CACHE_SHM_FILE, /**< Decision cache shared by all processes using the same memory-mapped file: absolute filename (e.g. /dev/shm/argus-pep-cache) */
+    PEP_OPTION_ENABLE_SINGLEFLIGHT, /**< Send identical requests of concurrent threads only once and share the response or error: 0 or 1 (default 0) */
+    PEP_OPTION_ACCOUNT_CACHE_TTL, /**< Cache the POSIX account resolutions of the obligation handlers (process wide): int TTL and int TTL of the names not found in second, 0 disables (default 0) */
+    PEP_OPTION_PIP_WORKERS, /**< Number of worker threads running the independent PIPs in parallel, 0 runs them sequentially: int (default 4) */
+    PEP_OPTION_ENABLE_LAZY_REQUEST, /**< Keep the effective request of the response serialized, unmarshalled by xacml_response_getrequest: 0 or 1 (default 0) */
+    PEP_OPTION_LOG_ASYNC, /**< Write the log lines from a background thread through a lock-free ring (process wide): int number of lines of the ring, dropped when full, 0 for synchronous logging (default 0) */
+    PEP_OPTION_LOG_RECORD_HANDLER, /**< Set the optional structured log record callback function pointer, replacing the log handler and output (default @c NULL) */
+    PEP_OPTION_FLIGHT_RECORDER, /**< Record the phase and curl timings of the calls slower than a threshold in a bounded ring: int threshold in millisecond, int number of records, 0 disables, and 0 or 1 to also record the Hessian request and response bytes (default disabled) */
+    PEP_OPTION_FLIGHT_RECORDER_SIGNAL, /**< Dump the flight recorders on SIGUSR2 (process wide): @c FILE @c * output, @c NULL restores the default SIGUSR2 action (default @c NULL) */
+    PEP_OPTION_TRACER, /**< Set the tracer of the calls and their phases: {@link #pep_tracer_t} @c * and @c void @c * tracer argument, @c NULL disables (default @c NULL) */
+    PEP_OPTION_CAPTURE_FILE, /**< Append the marshalled requests and the raw responses sent and received to a capture file, for test/bench/replay_capture: absolute filename, @c NULL stops the capture (default @c NULL) */
+    PEP_OPTION_TRANSPORT, /**< Set the transport of the requests and responses: {@link #pep_transport_t} @c * and @c void @c * transport argument, @c NULL restores the libcurl transport (default @c NULL) */
+    PEP_OPTION_TRANSPORT_LOOPBACK, /**< Answer the requests in process, without network: {@link #transport_responder_func} @c * and @c void @c * responder argument, @c NULL restores the libcurl transport (default @c NULL) */
+    PEP_OPTION_ENDPOINT_UNIX_SOCKET, /**< Connect to the PEP daemon endpoint URL with a unix domain socket, without TLS if the socket is trusted: absolute socket filename, @c NULL disables (default @c NULL) */
+    PEP_OPTION_ENDPOINT_UNIX_SOCKET_UID /**< Uid of the PEP daemon owning a trusted unix domain socket, in addition to root: int uid, -1 for the effective uid of the process (default -1) */
 } pep_option_t;
 
 /**
@@ -265,6 +479,32 @@ pep_error_t pep_addpip(PEP * pep, const pep_pip_t * pip);
  */
 pep_error_t pep_addobligationhandler(PEP * pep, const pep_obligationhandler_t * oh);
 
+/**
+ * Adds a version 2 PIP, with its own context, to the PEP client. The PIP init(arg,&ctx)
+ * function is called in this method, and the context is passed to the process(ctx,request)
+ * and destroy(ctx) functions of this PEP client.
+ *
+ * @param pep pointer to the @b handle of the PEP client.
+ * @param pip pointer to the {@link #pep_pip2_t} to add.
+ * @param arg argument passed to the PIP init function.
+ *
+ * @return {@link #pep_error_t} PEP_OK on success or an error code.
+ */
+pep_error_t pep_addpip2(PEP * pep, const pep_pip2_t * pip, void * arg);
+
+/**
+ * Adds a version 2 Obligation Handler, with its own context, to the PEP client. The OH
+ * init(arg,&ctx) function is called in this method, and the context is passed to the
+ * process(ctx,request,response) and destroy(ctx) functions of this PEP client.
+ *
+ * @param pep pointer to the @b handle of the PEP client.
+ * @param oh pointer to the {@link #pep_obligationhandler2_t} to add.
+ * @param arg argument passed to the OH init function.
+ *
+ * @return {@link #pep_error_t} PEP_OK on success or an error code.
+ */
+pep_error_t pep_addobligationhandler2(PEP * pep, const pep_obligationhandler2_t * oh, void * arg);
+
 /**
  * Sets a PEP client configuration option.
  *
@@ -320,6 +560,101 @@ pep_error_t pep_addobligationhandler(PEP * pep, const pep_obligationhandler_t *
  *   // already enabled by default, only for example purpose
  *   pep_setoption(pep,PEP_OPTION_ENABLE_OBLIGATIONHANDLERS, (int)1);
  * @endcode
+ * Option {@link #PEP_OPTION_CACHE_TTL} @c int argument:
+ * @code
+ *   // cache the PERMIT and DENY responses for 5 minutes
+ *   pep_setoption(pep,PEP_OPTION_CACHE_TTL, (int)300);
+ * @endcode
+ * Option {@link #PEP_OPTION_CACHE_OBLIGATION_TTL} @c const @c char @c * and @c int arguments:
+ * @code
+ *   // cache the responses with a POSIX account mapping for 30 seconds only
+ *   pep_setoption(pep,PEP_OPTION_CACHE_OBLIGATION_TTL, XACML_GLITE_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX, (int)30);
+ * @endcode
+ * Option {@link #PEP_OPTION_CACHE_DECISION} {@link #xacml_decision_t} and @c int arguments:
+ * @code
+ *   // never cache the DENY responses
+ *   pep_setoption(pep,PEP_OPTION_CACHE_DECISION, XACML_DECISION_DENY, (int)0);
+ * @endcode
+ * Option {@link #PEP_OPTION_CACHE_SHM_FILE} @c const @c char @c * argument:
+ * @code
+ *   // share the cached responses with the other processes of the node (same user)
+ *   pep_setoption(pep,PEP_OPTION_CACHE_SHM_FILE, (const char *)"/dev/shm/argus-pep-cache");
+ * @endcode
+ * Option {@link #PEP_OPTION_ENABLE_SINGLEFLIGHT} @c int (@a FALSE or @a TRUE) argument:
+ * @code
+ *   // coalesce the identical requests sent at the same time by the threads of the process
+ *   pep_setoption(pep,PEP_OPTION_ENABLE_SINGLEFLIGHT, (int)1);
+ * @endcode
+ * Option {@link #PEP_OPTION_ACCOUNT_CACHE_TTL} @c int and @c int arguments:
+ * @code
+ *   // cache the uid/gid of the mapped POSIX accounts for 10 minutes, and the unknown names for 1 minute
+ *   pep_setoption(pep,PEP_OPTION_ACCOUNT_CACHE_TTL, (int)600, (int)60);
+ * @endcode
+ * Option {@link #PEP_OPTION_PIP_WORKERS} @c int argument:
+ * @code
+ *   // run the PEP_PIP_INDEPENDENT PIPs with 2 worker threads and the calling thread
+ *   pep_setoption(pep,PEP_OPTION_PIP_WORKERS, (int)2);
+ * @endcode
+ * Option {@link #PEP_OPTION_ENABLE_LAZY_REQUEST} @c int (@a FALSE or @a TRUE) argument:
+ * @code
+ *   // only unmarshal the effective request if xacml_response_getrequest(response) is called
+ *   pep_setoption(pep,PEP_OPTION_ENABLE_LAZY_REQUEST, (int)1);
+ * @endcode
+ * Option {@link #PEP_OPTION_LOG_ASYNC} @c int argument:
+ * @code
+ *   // queue up to 4096 log lines, written by a background thread
+ *   pep_setoption(pep,PEP_OPTION_LOG_ASYNC, (int)4096);
+ *   ...
+ *   // drain the queued lines before exit
+ *   pep_setoption(pep,PEP_OPTION_LOG_ASYNC, (int)0);
+ * @endcode
+ * Option {@link #PEP_OPTION_LOG_RECORD_HANDLER} {@link #pep_log_record_callback} @c * argument:
+ * @code
+ *   // receive the log records of this handle with the PEP id, phase and request hash
+ *   pep_setoption(pep,PEP_OPTION_LOG_RECORD_HANDLER, (pep_log_record_callback *)my_record_log);
+ * @endcode
+ * Option {@link #PEP_OPTION_FLIGHT_RECORDER} @c int, @c int and @c int arguments:
+ * @code
+ *   // keep the last 16 calls slower than 200 ms, with their request and response bytes
+ *   pep_setoption(pep,PEP_OPTION_FLIGHT_RECORDER, (int)200, (int)16, (int)1);
+ * @endcode
+ * Option {@link #PEP_OPTION_FLIGHT_RECORDER_SIGNAL} @c FILE @c * argument:
+ * @code
+ *   // on SIGUSR2, each PEP client dumps its flight recorder at the end of its next call
+ *   pep_setoption(pep,PEP_OPTION_FLIGHT_RECORDER_SIGNAL, (FILE *)stderr);
+ * @endcode
+ * Option {@link #PEP_OPTION_TRACER} {@link #pep_tracer_t} @c * and @c void @c * arguments:
+ * @code
+ *   // report the spans to my tracing system, and send the traceparent header
+ *   static const pep_tracer_t my_tracer= { my_start_span, my_end_span, my_traceparent };
+ *   pep_setoption(pep,PEP_OPTION_TRACER, &my_tracer, (void *)my_tracing_context);
+ * @endcode
+ * Option {@link #PEP_OPTION_CAPTURE_FILE} @c char @c * argument:
+ * @code
+ *   // record the PEP traffic, replayed offline by replay_capture
+ *   pep_setoption(pep,PEP_OPTION_CAPTURE_FILE, "/var/tmp/pep-traffic.cap");
+ * @endcode
+ * Option {@link #PEP_OPTION_TRANSPORT} {@link #pep_transport_t} @c * and @c void @c * arguments:
+ * @code
+ *   static const pep_transport_t my_transport= { my_send, my_receive, NULL, NULL, NULL };
+ *   pep_setoption(pep,PEP_OPTION_TRANSPORT, &my_transport, (void *)my_connection);
+ * @endcode
+ * Option {@link #PEP_OPTION_TRANSPORT_LOOPBACK} {@link #transport_responder_func} @c * and @c void @c * arguments:
+ * @code
+ *   // answer all the requests with a recorded response
+ *   pep_setoption(pep,PEP_OPTION_TRANSPORT_LOOPBACK, my_responder, (void *)my_recorded_response);
+ * @endcode
+ * Option {@link #PEP_OPTION_ENDPOINT_UNIX_SOCKET} @c const @c char @c * argument:
+ * @code
+ *   // the https URL is requested over the unix socket, as http (no TLS, no client
+ *   // certificate) if the socket itself (not a symlink) and its directory are owned
+ *   // by root or the PEPd uid and the directory is not writable by group/others
+ *   pep_setoption(pep,PEP_OPTION_ENDPOINT_URL, (const char *)"https://localhost:8154/authz");
+ *   pep_setoption(pep,PEP_OPTION_ENDPOINT_UNIX_SOCKET, (const char *)"/var/run/argus/pepd.sock");
+ *   pep_setoption(pep,PEP_OPTION_ENDPOINT_UNIX_SOCKET_UID, (int)pepd_uid);
+ *   // same, with the PEPd default /authz path
+ *   pep_setoption(pep,PEP_OPTION_ENDPOINT_URL, (const char *)"unix:///var/run/argus/pepd.sock");
+ * @endcode
  *
  */
 pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... );
@@ -333,6 +668,8 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... );
  * the response is received from the PEPd.
  *
  * After the call, the @c request parameter is the @b effective XACML request, as processed by the PEPd.
+ * With the option {@link #PEP_OPTION_ENABLE_LAZY_REQUEST}, the @c request parameter is left unchanged
+ * and the effective XACML request is unmarshalled on demand by xacml_response_getrequest.
  *
  * @param pep pointer to the @b handle of the PEP client.
  * @param request address of the pointer to the {@link #xacml_request_t} to send.
@@ -342,6 +679,88 @@ pep_error_t pep_setoption(PEP * pep, pep_option_t option, ... );
  */
 pep_error_t pep_authorize(PEP * pep, xacml_request_t ** request, xacml_response_t ** response);
 
+/**
+ * Obligation view type: the decision status code and the selected obligations of
+ * a {@link #pep_authorize_decision} call. The view can be reused for successive calls.
+ */
+typedef struct pep_obligation_view pep_obligation_view_t;
+
+/**
+ * Creates an obligation view, selecting the obligations to decode.
+ *
+ * @param obligation_ids NULL terminated array of the obligation ids to decode, or
+ *        @c NULL to decode no obligation.
+ *
+ * @return pep_obligation_view_t * pointer to the obligation view or @c NULL on error.
+ */
+pep_obligation_view_t * pep_obligation_view_create(const char * const * obligation_ids);
+
+/**
+ * Returns the number of obligations decoded by the last {@link #pep_authorize_decision} call.
+ */
+size_t pep_obligation_view_length(const pep_obligation_view_t * view);
+
+/**
+ * Returns the decoded obligation at index i, or @c NULL if the index is out of range.
+ * The obligation is owned by the view, and is valid until the next call.
+ */
+const xacml_obligation_t * pep_obligation_view_get(const pep_obligation_view_t * view, int i);
+
+/**
+ * Returns the status code value of the decision, or @c NULL if absent.
+ */
+const char * pep_obligation_view_getstatuscode(const pep_obligation_view_t * view);
+
+/**
+ * Deletes the obligation view and its decoded obligations.
+ */
+void pep_obligation_view_delete(pep_obligation_view_t * view);
+
+/**
+ * Sends the XACML request to the PEP daemon and only returns the decision, the status code
+ * and the selected obligations of the response, without building a {@link #xacml_response_t}.
+ *
+ * The PIPs are applied on a copy-on-write overlay of the XACML request, the @c request
+ * parameter is not modified. The ObligationHandlers are @b not applied. The decision cache
+ * is used as with {@link #pep_authorize}. If the response contains several results, the
+ * decision and the obligations of the first result are returned.
+ *
+ * @param pep pointer to the @b handle of the PEP client.
+ * @param request pointer to the {@link #xacml_request_t} to send.
+ * @param decision pointer to the {@link #xacml_decision_t} received.
+ * @param view pointer to the obligation view to fill, or @c NULL.
+ *
+ * @return {@link #pep_error_t} PEP_OK on success or an error code.
+ */
+pep_error_t pep_authorize_decision(PEP * pep, const xacml_request_t * request, xacml_decision_t * decision, pep_obligation_view_t * view);
+
+/**
+ * Writes the calls recorded by the PEP client flight recorder, oldest first, to the output
+ * stream. Each record starts with "# " text lines: the date, the error code and the total time,
+ * the time of each phase and the curl timing breakdown in millisecond. If captured, the raw
+ * Hessian request and response bytes follow a "# request: <n> bytes" or "# response: <n> bytes"
+ * line.
+ *
+ * @param pep pointer to the @b handle of the PEP client.
+ * @param out the output stream.
+ *
+ * @return {@link #pep_error_t} PEP_OK on success or an error code.
+ * @see PEP_OPTION_FLIGHT_RECORDER to enable the flight recorder.
+ */
+pep_error_t pep_flightrecorder_dump(PEP * pep, FILE * out);
+
+/**
+ * Removes the cached responses of a subject from the PEP client decision cache.
+ * The subject is identified by the value of its {@link #XACML_SUBJECT_ID} attribute.
+ *
+ * @param pep pointer to the @b handle of the PEP client.
+ * @param subjectid the subject-id value, or @c NULL to remove all the cached responses.
+ *
+ * @return {@link #pep_error_t} PEP_OK on success or an error code.
+ * @see PEP_OPTION_CACHE_TTL to enable the decision cache.
+ */
+pep_error_t pep_cache_invalidate(PEP * pep, const char * subjectid);
+
 /**
  * Cleanups and destroys the PEP client. Any uses of the @b handle after this function has been called are illegal. 
  *
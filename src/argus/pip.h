@@ -75,6 +75,21 @@ typedef int pip_process_func(xacml_request_t **);
  */
 typedef int pip_destroy_func(void);
 
+/**
+ * PIP flag: the PIP is independent of the other PIPs and only @b adds Attributes,
+ * Subjects or Resources to the request.
+ *
+ * Consecutive independent PIPs are run in parallel, each on a private copy-on-write
+ * overlay of the request, and the additions of the overlays are merged into the request
+ * in the PIPs registration order before the next PIP.
+ *
+ * Only a version 2 PIP can be independent (pep_pip2_t flags), the PIPs added
+ * with pep_addpip(...) always run sequentially.
+ *
+ * @see #PEP_OPTION_PIP_WORKERS
+ */
+#define PEP_PIP_INDEPENDENT 0x1
+
 /**
  * PIP type.
  */
@@ -85,6 +100,106 @@ typedef struct pep_pip {
 	pip_destroy_func * destroy; /**< pointer to the PIP destroy function */
 } pep_pip_t;
 
+/**
+ * PIP version 2 init function prototype.
+ *
+ * The init(arg,&ctx) function is called when the PIP is added to a PEP client, and
+ * creates the PIP context of this PEP client (connection pool, cache, ...).
+ *
+ * @param void * arg the argument given to pep_addpip2(...)
+ * @param void ** ctx address of the PIP context pointer to set
+ * @return 0 on success or an error code.
+ * @see pep_addpip2(PEP * pep, const pep_pip2_t * pip, void * arg)
+ */
+typedef int pip2_init_func(void * arg, void ** ctx);
+
+/**
+ * PIP version 2 process function prototype.
+ *
+ * The process(ctx,request) function is called with the PIP context of the PEP client.
+ * The function is never called concurrently with the same context, unless the PEP
+ * client handle itself is shared between threads.
+ *
+ * The request can share its Subjects, Resources, Action and Environment with a request
+ * template: the PIP modifies them through the xacml_request_edit* functions.
+ *
+ * @param void * ctx the PIP context set by init
+ * @param xacml_request_t ** address of the pointer to the PEP request
+ * @return 0 on success or an error code.
+ */
+typedef int pip2_process_func(void * ctx, xacml_request_t **);
+
+/**
+ * PIP version 2 destroy function prototype.
+ *
+ * The destroy(ctx) function is called when the PEP client is destroyed, and releases
+ * the PIP context.
+ *
+ * @param void * ctx the PIP context set by init
+ * @return 0 on success or an error code.
+ */
+typedef int pip2_destroy_func(void * ctx);
+
+/**
+ * PIP version 2 type: the functions get the PIP context of the PEP client.
+ */
+typedef struct pep_pip2 {
+	char * id; /**< unique identifier for the PIP */
+	pip2_init_func * init; /**< pointer to the PIP init function */
+	pip2_process_func * process; /**< pointer to PIP process function */
+	pip2_destroy_func * destroy; /**< pointer to the PIP destroy function */
+	int flags; /**< PIP flags: 0 or {@link #PEP_PIP_INDEPENDENT} */
+} pep_pip2_t;
+
+/**
+ * Attribute rewrite rule type.
+ *
+ * A Subject/Attribute with the AttributeId @a source_id is derived into a new
+ * Subject/Attribute @a target_id with the DataType @a target_datatype. The
+ * derived Attribute shares the AttributeValues of the source Attribute.
+ *
+ * @see pep_rewrite_create(const pep_rewrite_rule_t * rules, size_t rules_l)
+ */
+typedef struct pep_rewrite_rule {
+	const char * source_id; /**< AttributeId of the source Attribute */
+	const char * target_id; /**< AttributeId of the derived Attribute */
+	const char * target_datatype; /**< DataType of the derived Attribute, @a NULL to keep the source DataType */
+} pep_rewrite_rule_t;
+
+/**
+ * Compiled attribute rewrite rules table type.
+ */
+typedef struct pep_rewrite pep_rewrite_t;
+
+/**
+ * Compiles the rewrite rules table into a hash lookup table. Several rules
+ * can have the same @a source_id, they are applied in the table order.
+ *
+ * @param rules the rewrite rules table
+ * @param rules_l the number of rules in the table
+ * @return pep_rewrite_t * the compiled table or @a NULL on error.
+ * @note The rule strings are not copied, and must remain valid until the compiled
+ *       table is deleted.
+ */
+pep_rewrite_t * pep_rewrite_create(const pep_rewrite_rule_t * rules, size_t rules_l);
+
+/**
+ * Applies the compiled rewrite rules to all the Subject/Attributes of the request,
+ * in a single pass. The derived Attributes are added to their Subject.
+ *
+ * @param rewrite the compiled rewrite rules table
+ * @param request the XACML Request to rewrite
+ * @return int {@link #PEP_XACML_OK} or {@link #PEP_XACML_ERROR} on error.
+ */
+int pep_rewrite_subjects(const pep_rewrite_t * rewrite, xacml_request_t * request);
+
+/**
+ * Deletes the compiled rewrite rules table.
+ *
+ * @param rewrite the compiled rewrite rules table
+ */
+void pep_rewrite_delete(pep_rewrite_t * rewrite);
+
 /** @} */
 
 
@@ -24,22 +24,13 @@
 #include <unistd.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "log.h" /* ../util/log.h */
 
 #include "profiles.h"
-
-#ifndef NGROUPS_MAX
-#define NGROUPS_MAX 128
-#endif
-
-#ifndef GETPW_R_SIZE_MAX
-#define GETPW_R_SIZE_MAX 10000
-#endif
-
-#ifndef GETGR_R_SIZE_MAX
-#define GETGR_R_SIZE_MAX 10000
-#endif
+#include "accountcache.h"
+#include "intern.h"
 
 /**
  * AuthZ Interop Profile to Grid WN AuthZ Profile PIP adapter
@@ -52,12 +43,17 @@ static char AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID[]= "AuthZInterop2GridWNAdapterPIP"
 static char GRIDWN_TO_AUTHZINTEROP_ADAPTER_ID[]= "GridWN2AuthZInteropAdapterOH";
 
 /*
- * method prototypes for the static pep_pip_t and pep_obligationhandler_t structs
+ * method prototypes for the static pep_pip_t, pep_obligationhandler_t and pep_obligationhandler2_t structs
  */
 static int empty_init(void);
 static int empty_destroy(void);
 static int authzinterop2gridwn_pip_process(xacml_request_t ** request);
 static int gridwn2authzinterop_oh_process(xacml_request_t ** request,xacml_response_t ** response);
+static int gridwn2authzinterop_oh_obligation(xacml_request_t ** request,xacml_response_t ** response,xacml_result_t * result,xacml_obligation_t * obligation);
+static int empty_init2(void * arg, void ** ctx);
+static int empty_destroy2(void * ctx);
+static int gridwn2authzinterop_oh2_process(void * ctx,xacml_request_t ** request,xacml_response_t ** response);
+static int gridwn2authzinterop_oh2_obligation(void * ctx,xacml_request_t ** request,xacml_response_t ** response,xacml_result_t * result,xacml_obligation_t * obligation);
 
 /*
  * static initialization of the PIP
@@ -71,6 +67,14 @@ static const pep_pip_t _authzinterop2gridwn_pip= {
 /* public variable defined in profiles.h */
 const pep_pip_t * authzinterop2gridwn_adapter_pip= &_authzinterop2gridwn_pip;
 
+/*
+ * Obligation ids handled by the OH
+ */
+static const char * const gridwn2authzinterop_obligation_ids[]= {
+    XACML_GRIDWN_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX,
+    NULL
+};
+
 /*
  * static init of the OH
  */
@@ -79,11 +83,24 @@ static const pep_obligationhandler_t _gridwn2authzinterop_oh= {
     empty_init,
     gridwn2authzinterop_oh_process,
     empty_destroy
-
 };
 /* public variable defined in profiles.h */
 const pep_obligationhandler_t * gridwn2authzinterop_adapter_oh= &_gridwn2authzinterop_oh;
 
+/*
+ * static init of the version 2 OH, called only for the handled obligations
+ */
+static const pep_obligationhandler2_t _gridwn2authzinterop_oh2= {
+    GRIDWN_TO_AUTHZINTEROP_ADAPTER_ID,
+    empty_init2,
+    gridwn2authzinterop_oh2_process,
+    empty_destroy2,
+    gridwn2authzinterop_obligation_ids,
+    gridwn2authzinterop_oh2_obligation
+};
+/* public variable defined in profiles.h */
+const pep_obligationhandler2_t * gridwn2authzinterop_adapter_oh2= &_gridwn2authzinterop_oh2;
+
 /* Nothing to do */
 static int empty_init(void) {
     return 0;
@@ -94,80 +111,54 @@ static int empty_destroy(void) {
     return 0;
 }
 
+/* No context */
+static int empty_init2(void * arg, void ** ctx) {
+    *ctx= NULL;
+    return 0;
+}
+
+/* Nothing to do */
+static int empty_destroy2(void * ctx) {
+    return 0;
+}
+
 /*
- * Creates a new Subject/Attribute XACML_SUBJECT_KEY_INFO based on the
+ * AuthZ Interop to Grid WN Subject/Attribute rewrite rules
+ */
+static const pep_rewrite_rule_t authzinterop2gridwn_rules[]= {
+    { XACML_AUTHZINTEROP_SUBJECT_CERTCHAIN, XACML_SUBJECT_KEY_INFO, XACML_DATATYPE_STRING },
+    { XACML_AUTHZINTEROP_SUBJECT_VOMS_PRIMARY_FQAN, XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY, XACML_GRIDWN_DATATYPE_FQAN },
+    { XACML_AUTHZINTEROP_SUBJECT_VOMS_FQAN, XACML_GRIDWN_ATTRIBUTE_FQAN, XACML_GRIDWN_DATATYPE_FQAN }
+};
+
+/* compiled rules, shared by all the PEP clients for the process lifetime */
+static pep_rewrite_t * authzinterop2gridwn_rewrite= NULL;
+static pthread_once_t authzinterop2gridwn_once= PTHREAD_ONCE_INIT;
+
+static void authzinterop2gridwn_compile(void) {
+    authzinterop2gridwn_rewrite= pep_rewrite_create(authzinterop2gridwn_rules,sizeof(authzinterop2gridwn_rules)/sizeof(pep_rewrite_rule_t));
+}
+
+/*
+ * Derives the Subject/Attribute XACML_SUBJECT_KEY_INFO from the
  * XACML_AUTHZINTEROP_SUBJECT_CERTCHAIN.
- * Creates new Subject/Attributes XACML_GRIDWN_ATTRIBUTE_FQAN and
- * XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY based on XACML_AUTHZINTEROP_SUBJECT_VOMS_FQAN and
+ * Derives the Subject/Attributes XACML_GRIDWN_ATTRIBUTE_FQAN and
+ * XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY from XACML_AUTHZINTEROP_SUBJECT_VOMS_FQAN and
  * XACML_AUTHZINTEROP_SUBJECT_VOMS_PRIMARY_FQAN.
  * Adds the XACML_GRIDWN_ATTRIBUTE_PROFILE_ID in the Environment if not already present.
  */
 static int authzinterop2gridwn_pip_process(xacml_request_t ** request) {
-    int i, j, profile_id_present;
-    size_t subjects_l= xacml_request_subjects_length(*request);
+    int profile_id_present;
     xacml_environment_t * environment;
-    size_t environment_attrs_l;
-    for (i= 0; i<subjects_l; i++) {
-        xacml_subject_t * subject= xacml_request_getsubject(*request,i);
-        size_t subject_attrs_l= xacml_subject_attributes_length(subject);
-        for(j= 0; j<subject_attrs_l; j++) {
-            xacml_attribute_t * attr= xacml_subject_getattribute(subject,j);
-            const char * attr_id= xacml_attribute_getid(attr);
-            if (strncmp(XACML_AUTHZINTEROP_SUBJECT_CERTCHAIN,attr_id,strlen(XACML_AUTHZINTEROP_SUBJECT_CERTCHAIN)) == 0) {
-                xacml_attribute_t * keyinfo= xacml_attribute_clone(attr);
-                pep_log_debug("%s: clone subject[%d].attribute[%d].id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID, i,j,attr_id);
-                if (keyinfo!=NULL) {
-                    pep_log_debug("%s: set cloned attribute id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_SUBJECT_KEY_INFO);
-                    xacml_attribute_setid(keyinfo,XACML_SUBJECT_KEY_INFO);
-                    pep_log_debug("%s: set cloned attribute datatype= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_DATATYPE_STRING);
-                    xacml_attribute_setdatatype(keyinfo,XACML_DATATYPE_STRING);
-                    if (xacml_subject_addattribute(subject,keyinfo) != PEP_XACML_OK) {
-                        pep_log_error("%s: failed to add new attribute{%s} to subject[%d]",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_SUBJECT_KEY_INFO,i);
-                        xacml_attribute_delete(keyinfo);
-                    }
-                }
-                else {
-                    pep_log_warn("%s: failed to clone subject[%d].attribute[%d]",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID, i,j);
-                }
-            }
-            else if (strncmp(XACML_AUTHZINTEROP_SUBJECT_VOMS_PRIMARY_FQAN,attr_id,strlen(XACML_AUTHZINTEROP_SUBJECT_VOMS_PRIMARY_FQAN))==0) {
-                xacml_attribute_t * fqan_primary= xacml_attribute_clone(attr);
-                pep_log_debug("%s: clone subject[%d].attribute[%d].id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID, i,j,attr_id);
-                if (fqan_primary!=NULL) {
-                    pep_log_debug("%s: set cloned attribute id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY);
-                    xacml_attribute_setid(fqan_primary,XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY);
-                    pep_log_debug("%s: set cloned attribute datatype= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_DATATYPE_FQAN);
-                    xacml_attribute_setdatatype(fqan_primary,XACML_GRIDWN_DATATYPE_FQAN);
-                    if (xacml_subject_addattribute(subject,fqan_primary) != PEP_XACML_OK) {
-                        pep_log_error("%s: failed to add new attribute{%s} to subject[%d]",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY,i);
-                        xacml_attribute_delete(fqan_primary);
-                    }
-                }
-                else {
-                    pep_log_warn("%s: failed to clone subject[%d].attribute[%d]",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID, i,j);
-                }
-            }
-            else if (strncmp(XACML_AUTHZINTEROP_SUBJECT_VOMS_FQAN,attr_id,strlen(XACML_AUTHZINTEROP_SUBJECT_VOMS_FQAN))==0) {
-                xacml_attribute_t * fqans= xacml_attribute_clone(attr);
-                pep_log_debug("%s: clone subject[%d].attribute[%d].id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID, i,j,attr_id);
-                if (fqans!=NULL) {
-                    pep_log_debug("%s: set cloned attribute id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY);
-                    xacml_attribute_setid(fqans,XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY);
-                    pep_log_debug("%s: set cloned attribute datatype= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_DATATYPE_FQAN);
-                    xacml_attribute_setdatatype(fqans,XACML_GRIDWN_DATATYPE_FQAN);
-                    if (xacml_subject_addattribute(subject,fqans) != PEP_XACML_OK) {
-                        pep_log_error("%s: failed to add new attribute{%s} to subject[%d]",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY,i);
-                        xacml_attribute_delete(fqans);
-                    }
-                }
-                else {
-                    pep_log_warn("%s: failed to clone subject[%d].attribute[%d]",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID, i,j);
-                }
-            }
-        }
+    pthread_once(&authzinterop2gridwn_once,authzinterop2gridwn_compile);
+    if (authzinterop2gridwn_rewrite == NULL) {
+        pep_log_warn("%s: no compiled rewrite rules",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID);
+    }
+    else if (pep_rewrite_subjects(authzinterop2gridwn_rewrite,*request) != PEP_XACML_OK) {
+        pep_log_warn("%s: failed to rewrite some subject attributes",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID);
     }
     /* check environment for Grid WN AuthZ Profile ID, if not present add it */
-    environment= xacml_request_getenvironment(*request);
+    environment= xacml_request_editenvironment(*request);
     /* create environment if not already existing */
     if (environment==NULL) {
         environment= xacml_environment_create();
@@ -178,15 +169,10 @@ static int authzinterop2gridwn_pip_process(xacml_request_t ** request) {
             pep_log_warn("%s: failed to create XACML Environment",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID);
         }
     }
-    environment_attrs_l= xacml_environment_attributes_length(environment);
     profile_id_present= 0;
-    for (i= 0; i<environment_attrs_l; i++) {
-        xacml_attribute_t * attr= xacml_environment_getattribute(environment,i);
-        const char * attr_id= xacml_attribute_getid(attr);
-        if (strncmp(XACML_GRIDWN_ATTRIBUTE_PROFILE_ID,attr_id,strlen(XACML_GRIDWN_ATTRIBUTE_PROFILE_ID))==0) {
-            pep_log_debug("%s: found environment.attribute[%d].id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,i,attr_id);
-            profile_id_present= 1;
-        }
+    if (environment && xacml_environment_findattribute(environment,XACML_GRIDWN_ATTRIBUTE_PROFILE_ID) != NULL) {
+        pep_log_debug("%s: found environment.attribute.id= %s",AUTHZINTEROP_TO_GRIDWN_ADAPTER_ID,XACML_GRIDWN_ATTRIBUTE_PROFILE_ID);
+        profile_id_present= 1;
     }
     /* profile id is not present, then add it */
     if (!profile_id_present && environment) {
@@ -219,7 +205,7 @@ static int resolve_user_uidgid(const char * username, uid_t * pw_uid, gid_t * pw
  * Resolve uidgid and groups by calling POSIX getpwent and getgrent
  */
 static int gridwn2authzinterop_oh_process(xacml_request_t ** request,xacml_response_t ** response) {
-    int i, j, k, m;
+    int i, j, rc;
     size_t results_l= xacml_response_results_length(*response);
     for (i= 0; i<results_l; i++) {
         xacml_result_t * result= xacml_response_getresult(*response,i);
@@ -229,76 +215,10 @@ static int gridwn2authzinterop_oh_process(xacml_request_t ** request,xacml_respo
             for (j= 0; j<obligations_l; j++) {
                 xacml_obligation_t * obligation= xacml_result_getobligation(result,j);
                 const char * obligation_id= xacml_obligation_getid(obligation);
-                xacml_fulfillon_t obligation_fulfillon= xacml_obligation_getfulfillon(obligation);
                 if (strncmp(XACML_GRIDWN_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX,obligation_id,strlen(XACML_GRIDWN_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX))==0) {
-                    /* do local POSIX resolve for uid/gids */
-                    const char * username= NULL;
-                    const char * groupname= NULL;
-                    size_t n_groupnames= 0;
-                    char ** groupnames= calloc(NGROUPS_MAX,sizeof(char *));
-                    size_t attrs_l= xacml_obligation_attributeassignments_length(obligation);
-                    pep_log_debug("%s: resolve local POSIX account mapping",GRIDWN_TO_AUTHZINTEROP_ADAPTER_ID);
-                    for (k= 0; k<attrs_l; k++) {
-                        xacml_attributeassignment_t * attr= xacml_obligation_getattributeassignment(obligation,k);
-                        const char * attr_id= xacml_attributeassignment_getid(attr);
-                        const char * attr_value= xacml_attributeassignment_getvalue(attr);
-                        if (strcmp(XACML_GRIDWN_ATTRIBUTE_USER_ID,attr_id)==0) {
-                            username= attr_value;
-                        }
-                        else if (strcmp(XACML_GRIDWN_ATTRIBUTE_GROUP_ID_PRIMARY,attr_id)==0) {
-                            groupname= attr_value;
-                        }
-                        else if (strcmp(XACML_GRIDWN_ATTRIBUTE_GROUP_ID,attr_id)==0) {
-                            groupnames[n_groupnames++]= (char *)attr_value;
-                        }
-                    }
-
-                    /* username obligation */
-                    if (username) {
-                        xacml_obligation_t * username_obligation= create_username_obligation(obligation_fulfillon,username);
-                        if (username_obligation) {
-                            xacml_result_addobligation(result,username_obligation);
-                        }
+                    if ((rc= gridwn2authzinterop_oh_obligation(request,response,result,obligation)) != 0) {
+                        return rc;
                     }
-                    /* uidgid obligation */
-                    if (username) {
-                        /* resolve POSIX username and groupname id (uid and gid) */
-                        /* if only the username (without groupname), use the user default group */
-                        uid_t user_uid;
-                        gid_t user_gid, group_gid;
-                        if (resolve_user_uidgid(username,&user_uid,&user_gid)==0) {
-                            uid_t obligation_uid= user_uid;
-                            gid_t obligation_gid= user_gid;
-                            xacml_obligation_t * uidgid_obligation;
-                            if (groupname && resolve_group_gid(groupname, &group_gid)==0) {
-                                obligation_gid= group_gid;
-                            }
-                            uidgid_obligation= create_uidgid_obligation(obligation_fulfillon,obligation_uid,obligation_gid);
-                            if (uidgid_obligation) {
-                                xacml_result_addobligation(result,uidgid_obligation);
-                            }
-                        }
-                    }
-                    /* secondary gids obligation */
-                    if (n_groupnames>0) {
-                        /* resolve POSIX secondary groupnames gids */
-                        gid_t * gids= calloc(n_groupnames,sizeof(gid_t));
-                        int resolve_error= 0;
-                        for (m= 0; m<n_groupnames; m++) {
-                            if (resolve_group_gid(groupnames[m],&gids[m])!=0) {
-                                resolve_error= 1;
-                                break;
-                            }
-                        }
-                        if (!resolve_error) {
-                            xacml_obligation_t * secgids_obligation= create_secondarygids_obligation(obligation_fulfillon,gids,n_groupnames);
-                            if (secgids_obligation) {
-                                xacml_result_addobligation(result,secgids_obligation);
-                            }
-                        }
-                        free(gids);
-                    }
-                    free(groupnames);
                 }
             }
         }
@@ -306,6 +226,113 @@ static int gridwn2authzinterop_oh_process(xacml_request_t ** request,xacml_respo
     return 0;
 }
 
+/* version 2 OH process, without context */
+static int gridwn2authzinterop_oh2_process(void * ctx,xacml_request_t ** request,xacml_response_t ** response) {
+    return gridwn2authzinterop_oh_process(request,response);
+}
+
+/* version 2 OH obligation, without context */
+static int gridwn2authzinterop_oh2_obligation(void * ctx,xacml_request_t ** request,xacml_response_t ** response,xacml_result_t * result,xacml_obligation_t * obligation) {
+    return gridwn2authzinterop_oh_obligation(request,response,result,obligation);
+}
+
+/*
+ * Converts a local-environment-map/posix obligation of a PERMIT result to uidgid, secondary-gid
+ * and username obligations. Called directly by pep_authorize for the indexed obligations of
+ * the version 2 OH.
+ */
+static int gridwn2authzinterop_oh_obligation(xacml_request_t ** request,xacml_response_t ** response,xacml_result_t * result,xacml_obligation_t * obligation) {
+    int k, m;
+    xacml_fulfillon_t obligation_fulfillon= xacml_obligation_getfulfillon(obligation);
+    /* do local POSIX resolve for uid/gids */
+    const char * username= NULL;
+    const char * groupname= NULL;
+    size_t n_groupnames= 0;
+    size_t attrs_l= xacml_obligation_attributeassignments_length(obligation);
+    const char * user_id= pep_intern(XACML_GRIDWN_ATTRIBUTE_USER_ID);
+    const char * group_id_primary= pep_intern(XACML_GRIDWN_ATTRIBUTE_GROUP_ID_PRIMARY);
+    const char * group_id= pep_intern(XACML_GRIDWN_ATTRIBUTE_GROUP_ID);
+    char ** groupnames;
+    if (xacml_result_getdecision(result)!=XACML_DECISION_PERMIT) {
+        return 0;
+    }
+    /* at most one secondary groupname per attribute assignment */
+    groupnames= calloc(attrs_l + 1,sizeof(char *));
+    if (groupnames == NULL) {
+        pep_log_error("%s: can't allocate %d groupnames.",GRIDWN_TO_AUTHZINTEROP_ADAPTER_ID,(int)attrs_l);
+        return -1;
+    }
+    pep_log_debug("%s: resolve local POSIX account mapping",GRIDWN_TO_AUTHZINTEROP_ADAPTER_ID);
+    for (k= 0; k<attrs_l; k++) {
+        xacml_attributeassignment_t * attr= xacml_obligation_getattributeassignment(obligation,k);
+        const char * attr_id= xacml_attributeassignment_getid(attr);
+        const char * attr_value= xacml_attributeassignment_getvalue(attr);
+        /* assignment ids are interned: pointer comparison */
+        if (attr_id == user_id) {
+            username= attr_value;
+        }
+        else if (attr_id == group_id_primary) {
+            groupname= attr_value;
+        }
+        else if (attr_id == group_id) {
+            groupnames[n_groupnames++]= (char *)attr_value;
+        }
+    }
+
+    /* username obligation */
+    if (username) {
+        xacml_obligation_t * username_obligation= create_username_obligation(obligation_fulfillon,username);
+        if (username_obligation) {
+            xacml_result_addobligation(result,username_obligation);
+        }
+    }
+    /* uidgid obligation */
+    if (username) {
+        /* resolve POSIX username and groupname id (uid and gid) */
+        /* if only the username (without groupname), use the user default group */
+        uid_t user_uid;
+        gid_t user_gid, group_gid;
+        if (resolve_user_uidgid(username,&user_uid,&user_gid)==0) {
+            uid_t obligation_uid= user_uid;
+            gid_t obligation_gid= user_gid;
+            xacml_obligation_t * uidgid_obligation;
+            if (groupname && resolve_group_gid(groupname, &group_gid)==0) {
+                obligation_gid= group_gid;
+            }
+            uidgid_obligation= create_uidgid_obligation(obligation_fulfillon,obligation_uid,obligation_gid);
+            if (uidgid_obligation) {
+                xacml_result_addobligation(result,uidgid_obligation);
+            }
+        }
+    }
+    /* secondary gids obligation */
+    if (n_groupnames>0) {
+        /* resolve POSIX secondary groupnames gids */
+        gid_t * gids= calloc(n_groupnames,sizeof(gid_t));
+        int resolve_error= 0;
+        if (gids == NULL) {
+            pep_log_error("%s: can't allocate %d gids.",GRIDWN_TO_AUTHZINTEROP_ADAPTER_ID,(int)n_groupnames);
+            free(groupnames);
+            return -1;
+        }
+        for (m= 0; m<n_groupnames; m++) {
+            if (resolve_group_gid(groupnames[m],&gids[m])!=0) {
+                resolve_error= 1;
+                break;
+            }
+        }
+        if (!resolve_error) {
+            xacml_obligation_t * secgids_obligation= create_secondarygids_obligation(obligation_fulfillon,gids,n_groupnames);
+            if (secgids_obligation) {
+                xacml_result_addobligation(result,secgids_obligation);
+            }
+        }
+        free(gids);
+    }
+    free(groupnames);
+    return 0;
+}
+
 /*
  * return NULL on error
  */
@@ -399,27 +426,25 @@ static xacml_obligation_t * create_secondarygids_obligation(xacml_fulfillon_t fu
 }
 
 /*
- * resolve the POSIX gid for the groupname
+ * resolve the POSIX gid for the groupname (cached)
  * return 0 on success
  */
 static int resolve_group_gid(const char * groupname, gid_t * gid) {
-    struct group gr;
-    struct group *result;
-    char buf[GETGR_R_SIZE_MAX];
-    size_t bufsize= GETGR_R_SIZE_MAX;
     int rc;
-
     if (groupname==NULL) {
         pep_log_warn("resolve_group_gid: groupname is NULL");
         return -1;
     }    
     pep_log_debug("resolve_group_gid for %s",groupname);
-    rc= getgrnam_r(groupname,&gr,buf,bufsize,&result);
-    if (rc==0 && result!=NULL) {
-        *gid= gr.gr_gid;
-        pep_log_debug("resolve_group_gid: gid=%d",gr.gr_gid);
+    rc= pep_accountcache_getgroup(groupname,gid);
+    if (rc==ACCOUNT_OK) {
+        pep_log_debug("resolve_group_gid: gid=%d",*gid);
         return 0;
     }
+    else if (rc==ACCOUNT_NOTFOUND) {
+        pep_log_error("resolve_group_gid: failed to resolve POSIX gid for %s: no such group",groupname);
+        return -2;
+    }
     else {
         pep_log_error("resolve_group_gid: failed to resolve POSIX gid for %s: %s",groupname,strerror(errno));
         return -2;
@@ -427,30 +452,27 @@ static int resolve_group_gid(const char * groupname, gid_t * gid) {
 }
 
 /*
- * resolve the POSIX uid and gid for the username
+ * resolve the POSIX uid and gid for the username (cached)
  * return 0 on success
  */
 static int resolve_user_uidgid(const char * username, uid_t * uid, gid_t * gid) {
-    struct passwd pw;
-    struct passwd *result;
-    char buf[GETPW_R_SIZE_MAX];
-    size_t bufsize= GETPW_R_SIZE_MAX;
     int rc;
     if (username==NULL) {
         pep_log_warn("resolve_user_uidgid: username is NULL");
         return -1;
     }
     pep_log_debug("resolve_user_uidgid for %s",username);
-    rc= getpwnam_r(username,&pw,buf,bufsize,&result);
-    if (rc==0 && result!=NULL) {
-        *uid= pw.pw_uid;
-        *gid= pw.pw_gid;
-        pep_log_debug("resolve_user_uidgid: uid=%d, gid=%d",pw.pw_uid,pw.pw_gid);
+    rc= pep_accountcache_getuser(username,uid,gid);
+    if (rc==ACCOUNT_OK) {
+        pep_log_debug("resolve_user_uidgid: uid=%d, gid=%d",*uid,*gid);
         return 0;
     }
+    else if (rc==ACCOUNT_NOTFOUND) {
+        pep_log_error("failed to resolve POSIX uid/gid for %s: no such user", username);
+        return -2;
+    }
     else {
         pep_log_error("failed to resolve POSIX uid/gid for %s: %s", username, strerror(errno));
         return -2;
     }
 }
-
@@ -178,8 +178,8 @@ static const char XACML_AUTHZINTEROP_OBLIGATION_ATTR_AFS_TOKEN[]= "http://authz-
  *    is copied into a Grid WN AuthZ XACML Subject/Attribute @b "urn:oasis:names:tc:xacml:1.0:subject:key-info".
  * -# The AuthZ Interop XACML Attributes @b "http://authz-interop.org/xacml/subject/voms-fqan"
  *    and @b "http://authz-interop.org/xacml/subject/voms-primary-fqan" are copied into the Grid WN AuthZ XACML
- *    Subject/Attributes @b fqan/primary and @b fqan (see @ref XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY and
- *    @ref XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY).
+ *    Subject/Attributes @b fqan and @b fqan/primary (see @ref XACML_GRIDWN_ATTRIBUTE_FQAN and
+ *    @ref XACML_GRIDWN_ATTRIBUTE_FQAN_PRIMARY). The copies share the AttributeValues of the originals.
  * -# The Grid WN AuthZ XACML Attribute @b profile-id is add to the XACML Environment
  *    (see @ref XACML_GRIDWN_ATTRIBUTE_PROFILE_ID and @ref XACML_GRIDWN_PROFILE_VERSION).
  *
@@ -234,6 +234,22 @@ extern const pep_pip_t * authzinterop2gridwn_adapter_pip;
  */
 extern const pep_obligationhandler_t * gridwn2authzinterop_adapter_oh;
 
+/**
+ * Grid WN AuthZ Profile to AuthZ Interop Profile obligation handler (OH) adapter,
+ * version 2 interface.
+ *
+ * Same OH as @c gridwn2authzinterop_adapter_oh, but declaring the handled Obligation id:
+ * pep_authorize(...) only calls it for the @b local-environment-map/posix Obligations of
+ * the response, found with the response obligations index.
+ *
+ * Example:
+ * @code
+ * // add the Grid WN AuthZ Profile to AuthZ Interop Profile OH adapter as first OH
+ * pep_addobligationhandler2(pep,gridwn2authzinterop_adapter_oh2,NULL);
+ * @endcode
+ */
+extern const pep_obligationhandler2_t * gridwn2authzinterop_adapter_oh2;
+
 /** @} */
 
 #ifdef  __cplusplus
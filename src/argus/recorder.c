@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+/* clock_gettime, localtime_r, sigaction and SA_RESTART */
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "recorder.h"
+
+/* curl timing breakdown, see CURLINFO_*_TIME */
+#define RECORDER_CURL_TIMES 6
+static const CURLINFO CURL_TIMES_INFO[RECORDER_CURL_TIMES]= {
+    CURLINFO_NAMELOOKUP_TIME, CURLINFO_CONNECT_TIME, CURLINFO_APPCONNECT_TIME,
+    CURLINFO_PRETRANSFER_TIME, CURLINFO_STARTTRANSFER_TIME, CURLINFO_TOTAL_TIME
+};
+static const char * CURL_TIMES_NAMES[RECORDER_CURL_TIMES]= {
+    "namelookup", "connect", "appconnect", "pretransfer", "starttransfer", "total"
+};
+
+static const char * PHASE_NAMES[PEP_PHASES]= {
+    "pips", "cache", "marshal", "send", "unmarshal", "ohs"
+};
+
+/* timings and captured bytes of a call */
+typedef struct recorder_entry {
+    time_t time;
+    int rc;
+    long total_us;
+    long phases_us[PEP_PHASES];
+    int curl_timed;
+    double curl_times[RECORDER_CURL_TIMES]; /* seconds */
+    pep_buffer_t * request; /* created on demand, reused */
+    pep_buffer_t * response;
+    int captured[2]; /* request and response bytes valid */
+} recorder_entry_t;
+
+struct pep_recorder {
+    int id;
+    long threshold_us;
+    int capture;
+    /* call being timed */
+    recorder_entry_t current;
+    struct timespec start;
+    struct timespec phase_start;
+    int phase; /* -1 outside of a phase */
+    /* ring of the slow calls, protected by the mutex */
+    pthread_mutex_t mutex;
+    recorder_entry_t * entries;
+    size_t capacity;
+    size_t next; /* next entry to replace */
+    size_t length;
+    unsigned long calls; /* number of calls timed */
+    int signals_seen; /* SIGUSR2 count at the last dump */
+};
+
+/* number of SIGUSR2 received, and the process wide dump output */
+static volatile sig_atomic_t recorder_signals= 0;
+static FILE * recorder_signal_out= NULL;
+
+static void recorder_sighandler(int signum) {
+    recorder_signals++;
+}
+
+/* elapsed microseconds between the two times */
+static long recorder_elapsed_us(const struct timespec * from, const struct timespec * to) {
+    return (long)(to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000L;
+}
+
+/* copies the whole buffer, keeping its read position */
+static int recorder_copy(pep_buffer_t * dst, pep_buffer_t * src) {
+    char chunk[1024];
+    size_t pos= pep_buffer_tell(src);
+    size_t n;
+    pep_buffer_reset(dst);
+    pep_buffer_rewind(src);
+    while ((n= pep_buffer_read(chunk,sizeof(char),sizeof(chunk),src)) > 0) {
+        if (pep_buffer_write(chunk,sizeof(char),n,dst) != n) {
+            pep_buffer_seek(src,pos);
+            return RECORDER_ERROR;
+        }
+    }
+    pep_buffer_seek(src,pos);
+    return RECORDER_OK;
+}
+
+const char * pep_phase_name(pep_phase_t phase) {
+    if (phase < 0 || phase >= PEP_PHASES) return NULL;
+    return PHASE_NAMES[phase];
+}
+
+pep_recorder_t * pep_recorder_create(int id, long threshold_ms, size_t capacity, int capture) {
+    pep_recorder_t * recorder;
+    if (capacity < 1) {
+        pep_log_error("pep_recorder_create: invalid capacity: %d",(int)capacity);
+        return NULL;
+    }
+    recorder= calloc(1,sizeof(pep_recorder_t));
+    if (recorder == NULL) {
+        pep_log_error("pep_recorder_create: can't allocate pep_recorder_t.");
+        return NULL;
+    }
+    recorder->entries= calloc(capacity,sizeof(recorder_entry_t));
+    if (recorder->entries == NULL) {
+        pep_log_error("pep_recorder_create: can't allocate %d records.",(int)capacity);
+        free(recorder);
+        return NULL;
+    }
+    recorder->id= id;
+    recorder->threshold_us= (threshold_ms > 0) ? threshold_ms * 1000L : 0;
+    recorder->capture= capture ? 1 : 0;
+    recorder->capacity= capacity;
+    recorder->phase= -1;
+    recorder->signals_seen= recorder_signals;
+    pthread_mutex_init(&(recorder->mutex),NULL);
+    return recorder;
+}
+
+void pep_recorder_begin(pep_recorder_t * recorder) {
+    recorder_entry_t * current;
+    int i;
+    if (recorder == NULL) return;
+    current= &(recorder->current);
+    current->rc= 0;
+    current->total_us= 0;
+    for (i= 0; i < PEP_PHASES; i++) current->phases_us[i]= 0;
+    current->curl_timed= 0;
+    current->captured[RECORDER_REQUEST]= 0;
+    current->captured[RECORDER_RESPONSE]= 0;
+    recorder->phase= -1;
+    clock_gettime(CLOCK_MONOTONIC,&(recorder->start));
+}
+
+void pep_recorder_phase(pep_recorder_t * recorder, pep_phase_t phase) {
+    struct timespec now;
+    if (recorder == NULL) return;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    if (recorder->phase >= 0) {
+        recorder->current.phases_us[recorder->phase]+= recorder_elapsed_us(&(recorder->phase_start),&now);
+    }
+    recorder->phase= phase;
+    recorder->phase_start= now;
+}
+
+void pep_recorder_curl(pep_recorder_t * recorder, CURL * curl) {
+    int i;
+    if (recorder == NULL) return;
+    for (i= 0; i < RECORDER_CURL_TIMES; i++) {
+        recorder->current.curl_times[i]= 0.0;
+        curl_easy_getinfo(curl,CURL_TIMES_INFO[i],&(recorder->current.curl_times[i]));
+    }
+    recorder->current.curl_timed= 1;
+}
+
+void pep_recorder_capture(pep_recorder_t * recorder, int which, pep_buffer_t * buffer) {
+    pep_buffer_t ** copy;
+    if (recorder == NULL || !recorder->capture || buffer == NULL) return;
+    copy= (which == RECORDER_REQUEST) ? &(recorder->current.request) : &(recorder->current.response);
+    if (*copy == NULL) {
+        *copy= pep_buffer_create(pep_buffer_length(buffer) + 1);
+        if (*copy == NULL) {
+            pep_log_warn("pep_recorder_capture: can't create capture buffer.");
+            return;
+        }
+    }
+    recorder->current.captured[which]= (recorder_copy(*copy,buffer) == RECORDER_OK);
+}
+
+/* writes an entry, ring mutex locked */
+static void recorder_write_entry(const pep_recorder_t * recorder, const recorder_entry_t * entry, size_t n, FILE * out) {
+    struct tm tm;
+    char date[32];
+    int i;
+    localtime_r(&(entry->time),&tm);
+    strftime(date,sizeof(date),"%Y-%m-%d %H:%M:%S",&tm);
+    fprintf(out,"# PEP#%d slow call %d/%d: %s rc=%d total=%.3fms\n",
+            recorder->id,(int)n,(int)recorder->length,date,entry->rc,entry->total_us / 1000.0);
+    fprintf(out,"# phases (ms):");
+    for (i= 0; i < PEP_PHASES; i++) {
+        fprintf(out," %s=%.3f",PHASE_NAMES[i],entry->phases_us[i] / 1000.0);
+    }
+    fprintf(out,"\n");
+    if (entry->curl_timed) {
+        fprintf(out,"# curl (ms):");
+        for (i= 0; i < RECORDER_CURL_TIMES; i++) {
+            fprintf(out," %s=%.3f",CURL_TIMES_NAMES[i],entry->curl_times[i] * 1000.0);
+        }
+        fprintf(out,"\n");
+    }
+    if (entry->captured[RECORDER_REQUEST]) {
+        fprintf(out,"# request: %d bytes\n",(int)pep_buffer_length(entry->request));
+        pep_buffer_fwrite(entry->request,out);
+        fprintf(out,"\n");
+    }
+    if (entry->captured[RECORDER_RESPONSE]) {
+        fprintf(out,"# response: %d bytes\n",(int)pep_buffer_length(entry->response));
+        pep_buffer_fwrite(entry->response,out);
+        fprintf(out,"\n");
+    }
+}
+
+void pep_recorder_end(pep_recorder_t * recorder, int rc) {
+    recorder_entry_t * current;
+    struct timespec now;
+    int signals;
+    if (recorder == NULL) return;
+    current= &(recorder->current);
+    pep_recorder_phase(recorder,-1);
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    current->total_us= recorder_elapsed_us(&(recorder->start),&now);
+    current->rc= rc;
+    pthread_mutex_lock(&(recorder->mutex));
+    recorder->calls++;
+    if (current->total_us >= recorder->threshold_us) {
+        recorder_entry_t * entry= &(recorder->entries[recorder->next]);
+        pep_buffer_t * request= entry->request;
+        pep_buffer_t * response= entry->response;
+        time(&(current->time));
+        /* the entry takes the captured bytes, its buffers are reused by the next call */
+        *entry= *current;
+        current->request= request;
+        current->response= response;
+        recorder->next= (recorder->next + 1) % recorder->capacity;
+        if (recorder->length < recorder->capacity) recorder->length++;
+        pep_log_info("pep_recorder_end: PEP#%d slow call recorded: %.3fms",recorder->id,current->total_us / 1000.0);
+    }
+    pthread_mutex_unlock(&(recorder->mutex));
+    signals= recorder_signals;
+    if (signals != recorder->signals_seen) {
+        FILE * out= recorder_signal_out;
+        recorder->signals_seen= signals;
+        if (out != NULL) pep_recorder_dump(recorder,out);
+    }
+}
+
+int pep_recorder_dump(pep_recorder_t * recorder, FILE * out) {
+    size_t i, first;
+    if (recorder == NULL || out == NULL) {
+        pep_log_error("pep_recorder_dump: NULL recorder or output stream.");
+        return RECORDER_ERROR;
+    }
+    pthread_mutex_lock(&(recorder->mutex));
+    fprintf(out,"# PEP#%d flight recorder: %lu calls, %d slow calls recorded (threshold %.3fms)\n",
+            recorder->id,recorder->calls,(int)recorder->length,recorder->threshold_us / 1000.0);
+    first= (recorder->next + recorder->capacity - recorder->length) % recorder->capacity;
+    for (i= 0; i < recorder->length; i++) {
+        recorder_write_entry(recorder,&(recorder->entries[(first + i) % recorder->capacity]),i + 1,out);
+    }
+    pthread_mutex_unlock(&(recorder->mutex));
+    fflush(out);
+    return RECORDER_OK;
+}
+
+void pep_recorder_delete(pep_recorder_t * recorder) {
+    size_t i;
+    if (recorder == NULL) return;
+    for (i= 0; i < recorder->capacity; i++) {
+        if (recorder->entries[i].request != NULL) pep_buffer_delete(recorder->entries[i].request);
+        if (recorder->entries[i].response != NULL) pep_buffer_delete(recorder->entries[i].response);
+    }
+    if (recorder->current.request != NULL) pep_buffer_delete(recorder->current.request);
+    if (recorder->current.response != NULL) pep_buffer_delete(recorder->current.response);
+    pthread_mutex_destroy(&(recorder->mutex));
+    free(recorder->entries);
+    free(recorder);
+}
+
+int pep_recorder_setsignalout(FILE * out) {
+    struct sigaction action;
+    memset(&action,0,sizeof(struct sigaction));
+    sigemptyset(&(action.sa_mask));
+    action.sa_flags= SA_RESTART;
+    action.sa_handler= (out != NULL) ? recorder_sighandler : SIG_DFL;
+    recorder_signal_out= out;
+    if (sigaction(SIGUSR2,&action,NULL) != 0) {
+        pep_log_error("pep_recorder_setsignalout: can't set SIGUSR2 action.");
+        return RECORDER_ERROR;
+    }
+    return RECORDER_OK;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_RECORDER_H_
+#define _PEP_RECORDER_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h> /* FILE */
+#include <stddef.h> /* size_t */
+#include <curl/curl.h>
+
+/* from ../util */
+#include "buffer.h"
+
+/** pep_recorder_* return codes */
+#define RECORDER_OK      0
+#define RECORDER_ERROR  -1
+
+/** Authorization phases of a PEP client call */
+typedef enum pep_phase {
+    PEP_PHASE_PIPS= 0,
+    PEP_PHASE_CACHE,
+    PEP_PHASE_MARSHAL,
+    PEP_PHASE_SEND,
+    PEP_PHASE_UNMARSHAL,
+    PEP_PHASE_OHS,
+    PEP_PHASES /* number of phases */
+} pep_phase_t;
+
+/** Bytes captured by pep_recorder_capture */
+#define RECORDER_REQUEST   0 /* Hessian request */
+#define RECORDER_RESPONSE  1 /* Hessian response */
+
+/*
+ * Flight recorder of a PEP client handle: times the phases of each
+ * authorization call and keeps the calls slower than the threshold in a
+ * bounded ring, the oldest record being replaced. The calls are timed by the
+ * thread using the handle, the ring can be dumped by any thread.
+ */
+typedef struct pep_recorder pep_recorder_t;
+
+/**
+ * Returns the name of the phase: "pips", "cache", "marshal", "send",
+ * "unmarshal" or "ohs".
+ */
+const char * pep_phase_name(pep_phase_t phase);
+
+/**
+ * Creates the flight recorder of the PEP client id.
+ *
+ * @param long threshold_ms minimal total time in milliseconds of the recorded calls.
+ * @param size_t capacity number of records of the ring.
+ * @param int capture 1 to also record the Hessian request and response bytes.
+ * @return pep_recorder_t * or NULL on error.
+ */
+pep_recorder_t * pep_recorder_create(int id, long threshold_ms, size_t capacity, int capture);
+
+/**
+ * Starts timing a call.
+ */
+void pep_recorder_begin(pep_recorder_t * recorder);
+
+/**
+ * Ends the current phase of the call and starts the next one.
+ */
+void pep_recorder_phase(pep_recorder_t * recorder, pep_phase_t phase);
+
+/**
+ * Reads the timing breakdown of the last transfer of the curl handle.
+ */
+void pep_recorder_curl(pep_recorder_t * recorder, CURL * curl);
+
+/**
+ * Copies the Hessian request or response bytes, if the recorder captures
+ * them. The read position of the buffer is left unchanged.
+ *
+ * @param int which RECORDER_REQUEST or RECORDER_RESPONSE.
+ */
+void pep_recorder_capture(pep_recorder_t * recorder, int which, pep_buffer_t * buffer);
+
+/**
+ * Ends the call, records it if slower than the threshold. Dumps the ring to
+ * the signal output if SIGUSR2 was received since the last dump.
+ *
+ * @param int rc the pep_error_t of the call.
+ */
+void pep_recorder_end(pep_recorder_t * recorder, int rc);
+
+/**
+ * Writes the records, oldest first, to the output stream.
+ *
+ * @return int RECORDER_OK or RECORDER_ERROR.
+ */
+int pep_recorder_dump(pep_recorder_t * recorder, FILE * out);
+
+/**
+ * Deletes the flight recorder and its records.
+ */
+void pep_recorder_delete(pep_recorder_t * recorder);
+
+/**
+ * Installs a process wide SIGUSR2 handler requesting all the flight recorders
+ * to dump their ring to the output stream, at the end of their next call.
+ * A NULL output restores the default SIGUSR2 action.
+ *
+ * @return int RECORDER_OK or RECORDER_ERROR.
+ */
+int pep_recorder_setsignalout(FILE * out);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
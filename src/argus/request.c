@@ -16,20 +16,43 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 /* from ../util */
 #include "linkedlist.h"
 #include "log.h"
+#include "sha256.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "io.h"
+
+/* sections of the request inherited from the template */
+#define INHERIT_SUBJECTS     (1 << XACML_REQUEST_SUBJECTS)
+#define INHERIT_RESOURCES    (1 << XACML_REQUEST_RESOURCES)
+#define INHERIT_ACTION       (1 << XACML_REQUEST_ACTION)
+#define INHERIT_ENVIRONMENT  (1 << XACML_REQUEST_ENVIRONMENT)
 
 struct xacml_request {
     pep_linkedlist_t * subjects;
     pep_linkedlist_t * resources;
     xacml_action_t * action;
     xacml_environment_t * environment;
+    xacml_request_template_t * tmpl; /* NULL if not created from a template */
+    const xacml_request_t * base; /* template request or overlaid request, NULL if none */
+    int inherited; /* INHERIT_* bits of the sections shared with the base request */
+};
+
+struct xacml_request_template {
+    volatile int refcount; /* creator and requests */
+    xacml_request_t * request;
+    unsigned char * bytes[XACML_REQUEST_SECTIONS]; /* pre-serialized sections */
+    size_t bytes_l[XACML_REQUEST_SECTIONS];
 };
 
+static void template_release(xacml_request_template_t * tmpl);
+static int request_ownsection(xacml_request_t * request, int section);
+
 /**
  * Creates an empty PEP request.
  */
@@ -54,6 +77,9 @@ xacml_request_t * xacml_request_create() {
     }
     request->action= NULL;
     request->environment= NULL;
+    request->tmpl= NULL;
+    request->base= NULL;
+    request->inherited= 0;
     return request;
 }
 
@@ -62,6 +88,10 @@ int xacml_request_addsubject(xacml_request_t * request, xacml_subject_t * subjec
         pep_log_error("xacml_request_addsubject: NULL request or subject.");
         return PEP_XACML_ERROR;
     }
+    if (request_ownsection(request,XACML_REQUEST_SUBJECTS) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_addsubject: can't copy template subjects.");
+        return PEP_XACML_ERROR;
+    }
     if (pep_llist_add(request->subjects,subject) != LLIST_OK) {
         pep_log_error("xacml_request_addsubject: can't add subject to list.");
         return PEP_XACML_ERROR;
@@ -85,11 +115,36 @@ xacml_subject_t * xacml_request_getsubject(const xacml_request_t * request, int
     return pep_llist_get(request->subjects,index);
 }
 
+xacml_subject_t * xacml_request_editsubject(xacml_request_t * request, int index) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_editsubject: NULL request.");
+        return NULL;
+    }
+    /* the subject will be modified: copy the template subjects */
+    if (request_ownsection(request,XACML_REQUEST_SUBJECTS) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_editsubject: can't copy template subjects.");
+        return NULL;
+    }
+    return pep_llist_get(request->subjects,index);
+}
+
+const xacml_subject_t * xacml_request_peeksubject(const xacml_request_t * request, int index) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_peeksubject: NULL request.");
+        return NULL;
+    }
+    return pep_llist_get(request->subjects,index);
+}
+
 int xacml_request_addresource(xacml_request_t * request, xacml_resource_t * resource) {
     if (request == NULL || resource == NULL) {
         pep_log_error("xacml_request_addresource: NULL request or resource.");
         return PEP_XACML_ERROR;
     }
+    if (request_ownsection(request,XACML_REQUEST_RESOURCES) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_addresource: can't copy template resources.");
+        return PEP_XACML_ERROR;
+    }
     if (pep_llist_add(request->resources,resource) != LLIST_OK) {
         pep_log_error("xacml_request_addresource: can't add resource to list.");
         return PEP_XACML_ERROR;
@@ -113,12 +168,35 @@ xacml_resource_t * xacml_request_getresource(const xacml_request_t * request, in
     return pep_llist_get(request->resources,index);
 }
 
+xacml_resource_t * xacml_request_editresource(xacml_request_t * request, int index) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_editresource: NULL request.");
+        return NULL;
+    }
+    /* the resource will be modified: copy the template resources */
+    if (request_ownsection(request,XACML_REQUEST_RESOURCES) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_editresource: can't copy template resources.");
+        return NULL;
+    }
+    return pep_llist_get(request->resources,index);
+}
+
+const xacml_resource_t * xacml_request_peekresource(const xacml_request_t * request, int index) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_peekresource: NULL request.");
+        return NULL;
+    }
+    return pep_llist_get(request->resources,index);
+}
+
 int xacml_request_setaction(xacml_request_t * request, xacml_action_t * action) {
     if (request == NULL) {
         pep_log_error("xacml_request_setaction: NULL request.");
         return PEP_XACML_ERROR;
     }
-    if (request->action != NULL) xacml_action_delete(request->action);
+    /* the template action is not deleted, only replaced */
+    if (request->inherited & INHERIT_ACTION) request->inherited&= ~INHERIT_ACTION;
+    else if (request->action != NULL) xacml_action_delete(request->action);
     request->action= action;
     return PEP_XACML_OK;
 }
@@ -131,12 +209,35 @@ xacml_action_t * xacml_request_getaction(const xacml_request_t * request) {
     return request->action;
 }
 
+xacml_action_t * xacml_request_editaction(xacml_request_t * request) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_editaction: NULL request.");
+        return NULL;
+    }
+    /* the action will be modified: copy the template action */
+    if (request_ownsection(request,XACML_REQUEST_ACTION) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_editaction: can't copy template action.");
+        return NULL;
+    }
+    return request->action;
+}
+
+const xacml_action_t * xacml_request_peekaction(const xacml_request_t * request) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_peekaction: NULL request.");
+        return NULL;
+    }
+    return request->action;
+}
+
 int xacml_request_setenvironment(xacml_request_t * request, xacml_environment_t * env) {
     if (request == NULL) {
         pep_log_error("xacml_request_setenvironment: NULL request.");
         return PEP_XACML_ERROR;
     }
-    if (request->environment != NULL) xacml_environment_delete(request->environment);
+    /* the template environment is not deleted, only replaced */
+    if (request->inherited & INHERIT_ENVIRONMENT) request->inherited&= ~INHERIT_ENVIRONMENT;
+    else if (request->environment != NULL) xacml_environment_delete(request->environment);
     request->environment= env;
     return PEP_XACML_OK;
 }
@@ -149,18 +250,667 @@ xacml_environment_t * xacml_request_getenvironment(const xacml_request_t * reque
     return request->environment;
 }
 
+xacml_environment_t * xacml_request_editenvironment(xacml_request_t * request) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_editenvironment: NULL request.");
+        return NULL;
+    }
+    /* the environment will be modified: copy the template environment */
+    if (request_ownsection(request,XACML_REQUEST_ENVIRONMENT) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_editenvironment: can't copy template environment.");
+        return NULL;
+    }
+    return request->environment;
+}
+
+const xacml_environment_t * xacml_request_peekenvironment(const xacml_request_t * request) {
+    if (request == NULL) {
+        pep_log_error("xacml_request_peekenvironment: NULL request.");
+        return NULL;
+    }
+    return request->environment;
+}
+
 /**
  * Delete the given PEP request.
  */
 void xacml_request_delete(xacml_request_t * request) {
     if (request == NULL) return;
-    pep_llist_delete_elements(request->subjects,(pep_llist_delete_elt_f)xacml_subject_delete);
-    pep_llist_delete(request->subjects);
-    pep_llist_delete_elements(request->resources,(pep_llist_delete_elt_f)xacml_resource_delete);
-    pep_llist_delete(request->resources);
-    if (request->action != NULL) xacml_action_delete(request->action);
-    if (request->environment != NULL) xacml_environment_delete(request->environment);
+    if (!(request->inherited & INHERIT_SUBJECTS)) {
+        pep_llist_delete_elements(request->subjects,(pep_llist_delete_elt_f)xacml_subject_delete);
+        pep_llist_delete(request->subjects);
+    }
+    if (!(request->inherited & INHERIT_RESOURCES)) {
+        pep_llist_delete_elements(request->resources,(pep_llist_delete_elt_f)xacml_resource_delete);
+        pep_llist_delete(request->resources);
+    }
+    if (!(request->inherited & INHERIT_ACTION) && request->action != NULL) xacml_action_delete(request->action);
+    if (!(request->inherited & INHERIT_ENVIRONMENT) && request->environment != NULL) xacml_environment_delete(request->environment);
+    if (request->tmpl != NULL) template_release(request->tmpl);
     free(request);
     request= NULL;
 }
 
+/*
+ * Copies the base request section into the request, if still inherited.
+ */
+static int request_ownsection(xacml_request_t * request, int section) {
+    const xacml_request_t * parent;
+    pep_linkedlist_t * list;
+    size_t list_l;
+    int i;
+    if (!(request->inherited & (1 << section))) return PEP_XACML_OK;
+    parent= request->base;
+    switch (section) {
+        case XACML_REQUEST_SUBJECTS:
+        case XACML_REQUEST_RESOURCES:
+            list= pep_llist_create();
+            if (list == NULL) {
+                pep_log_error("request_ownsection: can't create list.");
+                return PEP_XACML_ERROR;
+            }
+            list_l= pep_llist_length((section == XACML_REQUEST_SUBJECTS) ? parent->subjects : parent->resources);
+            for (i= 0; i < list_l; i++) {
+                void * clone= (section == XACML_REQUEST_SUBJECTS)
+                    ? (void *)xacml_subject_clone(pep_llist_get(parent->subjects,i))
+                    : (void *)xacml_resource_clone(pep_llist_get(parent->resources,i));
+                if (clone == NULL || pep_llist_add(list,clone) != LLIST_OK) {
+                    pep_log_error("request_ownsection: can't copy template element[%d] of section %d.",i,section);
+                    if (section == XACML_REQUEST_SUBJECTS) {
+                        if (clone != NULL) xacml_subject_delete(clone);
+                        pep_llist_delete_elements(list,(pep_llist_delete_elt_f)xacml_subject_delete);
+                    }
+                    else {
+                        if (clone != NULL) xacml_resource_delete(clone);
+                        pep_llist_delete_elements(list,(pep_llist_delete_elt_f)xacml_resource_delete);
+                    }
+                    pep_llist_delete(list);
+                    return PEP_XACML_ERROR;
+                }
+            }
+            if (section == XACML_REQUEST_SUBJECTS) request->subjects= list;
+            else request->resources= list;
+            break;
+        case XACML_REQUEST_ACTION:
+            request->action= NULL;
+            if (parent->action != NULL && (request->action= xacml_action_clone(parent->action)) == NULL) {
+                pep_log_error("request_ownsection: can't copy template action.");
+                request->action= parent->action;
+                return PEP_XACML_ERROR;
+            }
+            break;
+        case XACML_REQUEST_ENVIRONMENT:
+            request->environment= NULL;
+            if (parent->environment != NULL && (request->environment= xacml_environment_clone(parent->environment)) == NULL) {
+                pep_log_error("request_ownsection: can't copy template environment.");
+                request->environment= parent->environment;
+                return PEP_XACML_ERROR;
+            }
+            break;
+        default:
+            pep_log_error("request_ownsection: invalid request section: %d.",section);
+            return PEP_XACML_ERROR;
+    }
+    request->inherited&= ~(1 << section);
+    return PEP_XACML_OK;
+}
+
+int xacml_request_ownsections(xacml_request_t * request) {
+    int section;
+    if (request == NULL) {
+        pep_log_error("xacml_request_ownsections: NULL request.");
+        return PEP_XACML_ERROR;
+    }
+    for (section= 0; section < XACML_REQUEST_SECTIONS; section++) {
+        if (request_ownsection(request,section) != PEP_XACML_OK) {
+            pep_log_error("xacml_request_ownsections: can't copy request section: %d.",section);
+            return PEP_XACML_ERROR;
+        }
+    }
+    return PEP_XACML_OK;
+}
+
+xacml_request_template_t * xacml_request_template_create(xacml_request_t * request) {
+    xacml_request_template_t * tmpl;
+    pep_buffer_t * buffer;
+    int section;
+    if (request == NULL) {
+        pep_log_error("xacml_request_template_create: NULL request.");
+        return NULL;
+    }
+    if (request->tmpl != NULL) {
+        pep_log_error("xacml_request_template_create: request already created from a template.");
+        return NULL;
+    }
+    tmpl= calloc(1,sizeof(struct xacml_request_template));
+    if (tmpl == NULL) {
+        pep_log_error("xacml_request_template_create: can't allocate xacml_request_template_t.");
+        return NULL;
+    }
+    /* pre-serialize the sections */
+    for (section= 0; section < XACML_REQUEST_SECTIONS; section++) {
+        buffer= pep_buffer_create(256);
+        if (buffer == NULL) {
+            pep_log_error("xacml_request_template_create: can't create buffer.");
+            break;
+        }
+        if (xacml_request_section_marshalling(request,section,buffer) != PEP_OK) {
+            pep_log_error("xacml_request_template_create: can't marshal request section: %d.",section);
+            pep_buffer_delete(buffer);
+            break;
+        }
+        tmpl->bytes_l[section]= pep_buffer_length(buffer);
+        tmpl->bytes[section]= calloc(tmpl->bytes_l[section] + 1,sizeof(unsigned char));
+        if (tmpl->bytes[section] == NULL) {
+            pep_log_error("xacml_request_template_create: can't allocate %d bytes.",(int)tmpl->bytes_l[section]);
+            pep_buffer_delete(buffer);
+            break;
+        }
+        pep_buffer_read(tmpl->bytes[section],sizeof(unsigned char),tmpl->bytes_l[section],buffer);
+        pep_buffer_delete(buffer);
+    }
+    if (section < XACML_REQUEST_SECTIONS) {
+        for (section= 0; section < XACML_REQUEST_SECTIONS; section++) {
+            if (tmpl->bytes[section] != NULL) free(tmpl->bytes[section]);
+        }
+        free(tmpl);
+        return NULL;
+    }
+    tmpl->request= request;
+    tmpl->refcount= 1;
+    return tmpl;
+}
+
+static void template_release(xacml_request_template_t * tmpl) {
+    int section;
+    if (__sync_sub_and_fetch(&(tmpl->refcount),1) > 0) return;
+    xacml_request_delete(tmpl->request);
+    for (section= 0; section < XACML_REQUEST_SECTIONS; section++) {
+        free(tmpl->bytes[section]);
+    }
+    free(tmpl);
+}
+
+void xacml_request_template_delete(xacml_request_template_t * tmpl) {
+    if (tmpl == NULL) return;
+    template_release(tmpl);
+}
+
+xacml_request_t * xacml_request_createfromtemplate(xacml_request_template_t * tmpl) {
+    xacml_request_t * request;
+    if (tmpl == NULL) {
+        pep_log_error("xacml_request_createfromtemplate: NULL template.");
+        return NULL;
+    }
+    request= calloc(1,sizeof(struct xacml_request));
+    if (request == NULL) {
+        pep_log_error("xacml_request_createfromtemplate: can't allocate xacml_request_t.");
+        return NULL;
+    }
+    __sync_add_and_fetch(&(tmpl->refcount),1);
+    /* all the sections are shared with the template */
+    request->subjects= tmpl->request->subjects;
+    request->resources= tmpl->request->resources;
+    request->action= tmpl->request->action;
+    request->environment= tmpl->request->environment;
+    request->tmpl= tmpl;
+    request->base= tmpl->request;
+    request->inherited= INHERIT_SUBJECTS | INHERIT_RESOURCES | INHERIT_ACTION | INHERIT_ENVIRONMENT;
+    return request;
+}
+
+xacml_request_t * xacml_request_createoverlay(const xacml_request_t * base) {
+    xacml_request_t * request;
+    if (base == NULL) {
+        pep_log_error("xacml_request_createoverlay: NULL base request.");
+        return NULL;
+    }
+    request= calloc(1,sizeof(struct xacml_request));
+    if (request == NULL) {
+        pep_log_error("xacml_request_createoverlay: can't allocate xacml_request_t.");
+        return NULL;
+    }
+    /* all the sections are shared with the base request, copied on write */
+    request->subjects= base->subjects;
+    request->resources= base->resources;
+    request->action= base->action;
+    request->environment= base->environment;
+    request->tmpl= NULL;
+    request->base= base;
+    request->inherited= INHERIT_SUBJECTS | INHERIT_RESOURCES | INHERIT_ACTION | INHERIT_ENVIRONMENT;
+    return request;
+}
+
+const xacml_request_template_t * xacml_request_gettemplate(const xacml_request_t * request) {
+    if (request == NULL) return NULL;
+    return request->tmpl;
+}
+
+int xacml_request_getsectionbytes(const xacml_request_t * request, int section, const unsigned char ** bytes, size_t * bytes_l) {
+    if (request == NULL || request->tmpl == NULL) return 0;
+    if (section < 0 || section >= XACML_REQUEST_SECTIONS) return 0;
+    if (!(request->inherited & (1 << section))) return 0;
+    *bytes= request->tmpl->bytes[section];
+    *bytes_l= request->tmpl->bytes_l[section];
+    return 1;
+}
+
+/*
+ * Canonical request encoding, used to compute the order-insensitive request
+ * digest. Every string is length prefixed, and the elements of each unordered
+ * collection (values, attributes, subjects, resources) are encoded separately
+ * and then sorted, so two requests differing only by insertion order have the
+ * same encoding.
+ */
+typedef struct canon {
+    unsigned char * data;
+    size_t length;
+    size_t size;
+} canon_t;
+
+#define CANON_NULL_LENGTH 0xFFFFFFFFUL
+
+static int canon_write(canon_t * canon, const void * data, size_t data_l) {
+    if (canon->length + data_l > canon->size) {
+        size_t size= (canon->size > 0) ? canon->size : 64;
+        unsigned char * buf;
+        while (size < canon->length + data_l) size*= 2;
+        buf= realloc(canon->data,size);
+        if (buf == NULL) {
+            pep_log_error("canon_write: can't reallocate canonical buffer (%d bytes).",(int)size);
+            return PEP_XACML_ERROR;
+        }
+        canon->data= buf;
+        canon->size= size;
+    }
+    memcpy(canon->data + canon->length,data,data_l);
+    canon->length+= data_l;
+    return PEP_XACML_OK;
+}
+
+/* 32-bit big-endian length */
+static int canon_putlength(canon_t * canon, unsigned long length) {
+    unsigned char bytes[4];
+    bytes[0]= (unsigned char)(length >> 24);
+    bytes[1]= (unsigned char)(length >> 16);
+    bytes[2]= (unsigned char)(length >> 8);
+    bytes[3]= (unsigned char)length;
+    return canon_write(canon,bytes,4);
+}
+
+static int canon_putstring(canon_t * canon, const char * str) {
+    size_t str_l;
+    if (str == NULL) return canon_putlength(canon,CANON_NULL_LENGTH);
+    str_l= strlen(str);
+    if (canon_putlength(canon,str_l) != PEP_XACML_OK) return PEP_XACML_ERROR;
+    return canon_write(canon,str,str_l);
+}
+
+static int canon_compare(const void * a, const void * b) {
+    const canon_t * ca= a;
+    const canon_t * cb= b;
+    size_t min_l= (ca->length < cb->length) ? ca->length : cb->length;
+    int cmp= (min_l > 0) ? memcmp(ca->data,cb->data,min_l) : 0;
+    if (cmp != 0) return cmp;
+    if (ca->length == cb->length) return 0;
+    return (ca->length < cb->length) ? -1 : 1;
+}
+
+/* sorts the encoded items, writes them as a set and frees them */
+static int canon_putset(canon_t * canon, canon_t * items, size_t items_l) {
+    int rc= PEP_XACML_OK;
+    size_t i;
+    qsort(items,items_l,sizeof(canon_t),canon_compare);
+    if (canon_putlength(canon,items_l) != PEP_XACML_OK) rc= PEP_XACML_ERROR;
+    for (i= 0; i < items_l; i++) {
+        if (rc == PEP_XACML_OK && canon_putlength(canon,items[i].length) != PEP_XACML_OK) rc= PEP_XACML_ERROR;
+        if (rc == PEP_XACML_OK && canon_write(canon,items[i].data,items[i].length) != PEP_XACML_OK) rc= PEP_XACML_ERROR;
+        if (items[i].data != NULL) free(items[i].data);
+    }
+    free(items);
+    return rc;
+}
+
+static int canon_putattribute(canon_t * canon, const xacml_attribute_t * attr) {
+    const char * datatype= xacml_attribute_getdatatype(attr);
+    size_t values_l= xacml_attribute_values_length(attr);
+    canon_t * values;
+    size_t i;
+    /* no datatype means the default string datatype */
+    if (datatype == NULL) datatype= XACML_DATATYPE_STRING;
+    if (canon_putstring(canon,xacml_attribute_getid(attr)) != PEP_XACML_OK
+        || canon_putstring(canon,datatype) != PEP_XACML_OK
+        || canon_putstring(canon,xacml_attribute_getissuer(attr)) != PEP_XACML_OK) {
+        return PEP_XACML_ERROR;
+    }
+    values= calloc(values_l + 1,sizeof(canon_t));
+    if (values == NULL) {
+        pep_log_error("canon_putattribute: can't allocate %d values.",(int)values_l);
+        return PEP_XACML_ERROR;
+    }
+    for (i= 0; i < values_l; i++) {
+        if (canon_putstring(&values[i],xacml_attribute_getvalue(attr,i)) != PEP_XACML_OK) {
+            canon_putset(canon,values,values_l);
+            return PEP_XACML_ERROR;
+        }
+    }
+    return canon_putset(canon,values,values_l);
+}
+
+typedef xacml_attribute_t * (*canon_getattribute_f)(const void * container, int attr_idx);
+
+static int canon_putattributes(canon_t * canon, const void * container, size_t attrs_l, canon_getattribute_f getattribute) {
+    canon_t * attrs= calloc(attrs_l + 1,sizeof(canon_t));
+    size_t i;
+    if (attrs == NULL) {
+        pep_log_error("canon_putattributes: can't allocate %d attributes.",(int)attrs_l);
+        return PEP_XACML_ERROR;
+    }
+    for (i= 0; i < attrs_l; i++) {
+        xacml_attribute_t * attr= getattribute(container,i);
+        if (attr == NULL || canon_putattribute(&attrs[i],attr) != PEP_XACML_OK) {
+            canon_putset(canon,attrs,attrs_l);
+            return PEP_XACML_ERROR;
+        }
+    }
+    return canon_putset(canon,attrs,attrs_l);
+}
+
+static xacml_attribute_t * canon_subject_getattribute(const void * subject, int i) {
+    return xacml_subject_getattribute(subject,i);
+}
+
+static xacml_attribute_t * canon_resource_getattribute(const void * resource, int i) {
+    return xacml_resource_getattribute(resource,i);
+}
+
+static xacml_attribute_t * canon_action_getattribute(const void * action, int i) {
+    return xacml_action_getattribute(action,i);
+}
+
+static xacml_attribute_t * canon_environment_getattribute(const void * env, int i) {
+    return xacml_environment_getattribute(env,i);
+}
+
+static int canon_putrequest(canon_t * canon, const xacml_request_t * request) {
+    size_t subjects_l= pep_llist_length(request->subjects);
+    size_t resources_l= pep_llist_length(request->resources);
+    canon_t * items;
+    size_t i;
+    /* subjects */
+    items= calloc(subjects_l + 1,sizeof(canon_t));
+    if (items == NULL) {
+        pep_log_error("canon_putrequest: can't allocate %d subjects.",(int)subjects_l);
+        return PEP_XACML_ERROR;
+    }
+    for (i= 0; i < subjects_l; i++) {
+        xacml_subject_t * subject= pep_llist_get(request->subjects,i);
+        if (canon_putstring(&items[i],xacml_subject_getcategory(subject)) != PEP_XACML_OK
+            || canon_putattributes(&items[i],subject,xacml_subject_attributes_length(subject),canon_subject_getattribute) != PEP_XACML_OK) {
+            canon_putset(canon,items,subjects_l);
+            return PEP_XACML_ERROR;
+        }
+    }
+    if (canon_putset(canon,items,subjects_l) != PEP_XACML_OK) return PEP_XACML_ERROR;
+    /* resources */
+    items= calloc(resources_l + 1,sizeof(canon_t));
+    if (items == NULL) {
+        pep_log_error("canon_putrequest: can't allocate %d resources.",(int)resources_l);
+        return PEP_XACML_ERROR;
+    }
+    for (i= 0; i < resources_l; i++) {
+        xacml_resource_t * resource= pep_llist_get(request->resources,i);
+        if (canon_putstring(&items[i],xacml_resource_getcontent(resource)) != PEP_XACML_OK
+            || canon_putattributes(&items[i],resource,xacml_resource_attributes_length(resource),canon_resource_getattribute) != PEP_XACML_OK) {
+            canon_putset(canon,items,resources_l);
+            return PEP_XACML_ERROR;
+        }
+    }
+    if (canon_putset(canon,items,resources_l) != PEP_XACML_OK) return PEP_XACML_ERROR;
+    /* action and environment, a missing one is not an empty one */
+    if (request->action == NULL) {
+        if (canon_putlength(canon,CANON_NULL_LENGTH) != PEP_XACML_OK) return PEP_XACML_ERROR;
+    }
+    else if (canon_putattributes(canon,request->action,xacml_action_attributes_length(request->action),canon_action_getattribute) != PEP_XACML_OK) {
+        return PEP_XACML_ERROR;
+    }
+    if (request->environment == NULL) {
+        if (canon_putlength(canon,CANON_NULL_LENGTH) != PEP_XACML_OK) return PEP_XACML_ERROR;
+    }
+    else if (canon_putattributes(canon,request->environment,xacml_environment_attributes_length(request->environment),canon_environment_getattribute) != PEP_XACML_OK) {
+        return PEP_XACML_ERROR;
+    }
+    return PEP_XACML_OK;
+}
+
+#define HASH_ROTL64(x,n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+/*
+ * Fast non-cryptographic 256-bit hash: four independently seeded 64-bit
+ * multiply-rotate lanes over the 8 bytes words, with a final avalanche.
+ */
+static void hash_fast(const unsigned char * data, size_t data_l, uint8_t out[XACML_HASH_LENGTH]) {
+    static const uint64_t seeds[4]= { 0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL, 0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL };
+    const uint64_t prime1= 0x9e3779b97f4a7c15ULL;
+    const uint64_t prime2= 0xc2b2ae3d27d4eb4fULL;
+    uint64_t lanes[4];
+    uint64_t word;
+    size_t i, j;
+    for (j= 0; j < 4; j++) lanes[j]= seeds[j] ^ ((uint64_t)data_l * prime1);
+    for (i= 0; i < data_l; i+= 8) {
+        size_t n= (data_l - i < 8) ? data_l - i : 8;
+        word= 0;
+        for (j= 0; j < n; j++) word|= (uint64_t)data[i + j] << (8 * j);
+        for (j= 0; j < 4; j++) {
+            lanes[j]^= word + seeds[j];
+            lanes[j]= HASH_ROTL64(lanes[j],31) * prime1;
+            lanes[j]^= lanes[j] >> 29;
+        }
+    }
+    for (j= 0; j < 4; j++) {
+        uint64_t h= lanes[j] ^ HASH_ROTL64(lanes[(j + 1) & 3],17);
+        /* splitmix64 finalizer */
+        h^= h >> 30; h*= 0xbf58476d1ce4e5b9ULL;
+        h^= h >> 27; h*= prime2;
+        h^= h >> 31;
+        for (i= 0; i < 8; i++) out[j * 8 + i]= (uint8_t)(h >> (8 * i));
+    }
+}
+
+int xacml_request_digest(const xacml_request_t * request, xacml_hash_t algorithm, uint8_t out[XACML_HASH_LENGTH]) {
+    canon_t canon= { NULL, 0, 0 };
+    pep_sha256_t sha256;
+    if (request == NULL || out == NULL) {
+        pep_log_error("xacml_request_digest: NULL request or digest.");
+        return PEP_XACML_ERROR;
+    }
+    if (canon_putrequest(&canon,request) != PEP_XACML_OK) {
+        pep_log_error("xacml_request_digest: can't encode canonical request.");
+        if (canon.data != NULL) free(canon.data);
+        return PEP_XACML_ERROR;
+    }
+    switch (algorithm) {
+        case XACML_HASH_SHA256:
+            pep_sha256_init(&sha256);
+            pep_sha256_update(&sha256,canon.data,canon.length);
+            pep_sha256_final(&sha256,out);
+            break;
+        case XACML_HASH_FAST:
+            hash_fast(canon.data,canon.length,out);
+            break;
+        default:
+            pep_log_error("xacml_request_digest: invalid hash algorithm: %d.",(int)algorithm);
+            free(canon.data);
+            return PEP_XACML_ERROR;
+    }
+    free(canon.data);
+    return PEP_XACML_OK;
+}
+
+int xacml_request_hash(const xacml_request_t * request, uint8_t out[XACML_HASH_LENGTH]) {
+    return xacml_request_digest(request,XACML_HASH_FAST,out);
+}
+
+/*
+ * Overlays merge
+ */
+typedef int (*merge_addattribute_f)(void * container, xacml_attribute_t * attr);
+
+static int merge_subject_addattribute(void * subject, xacml_attribute_t * attr) {
+    return xacml_subject_addattribute(subject,attr);
+}
+
+static int merge_resource_addattribute(void * resource, xacml_attribute_t * attr) {
+    return xacml_resource_addattribute(resource,attr);
+}
+
+static int merge_action_addattribute(void * action, xacml_attribute_t * attr) {
+    return xacml_action_addattribute(action,attr);
+}
+
+static int merge_environment_addattribute(void * env, xacml_attribute_t * attr) {
+    return xacml_environment_addattribute(env,attr);
+}
+
+/* adds a copy of the attributes from_idx to attrs_l - 1 of src into dst, the values are shared */
+static int merge_attributes(void * dst, merge_addattribute_f addattribute, const void * src, size_t from_idx, size_t attrs_l, canon_getattribute_f getattribute) {
+    size_t i;
+    for (i= from_idx; i < attrs_l; i++) {
+        xacml_attribute_t * attr= xacml_attribute_clone(getattribute(src,i));
+        if (attr == NULL || addattribute(dst,attr) != PEP_XACML_OK) {
+            pep_log_error("merge_attributes: can't add attribute[%d].",(int)i);
+            if (attr != NULL) xacml_attribute_delete(attr);
+            return PEP_XACML_ERROR;
+        }
+    }
+    return PEP_XACML_OK;
+}
+
+/* number of attributes of the request before the merge */
+typedef struct merge_counts {
+    size_t subjects_l;
+    size_t * subject_attrs_l;
+    size_t resources_l;
+    size_t * resource_attrs_l;
+    size_t action_attrs_l;
+    size_t environment_attrs_l;
+} merge_counts_t;
+
+static int merge_overlay(xacml_request_t * request, const xacml_request_t * overlay, const merge_counts_t * counts) {
+    size_t n, attrs_l;
+    int i;
+    if (!(overlay->inherited & INHERIT_SUBJECTS)) {
+        n= pep_llist_length(overlay->subjects);
+        for (i= 0; i < n; i++) {
+            const xacml_subject_t * subject= pep_llist_get(overlay->subjects,i);
+            if (i < counts->subjects_l) {
+                attrs_l= xacml_subject_attributes_length(subject);
+                if (attrs_l > counts->subject_attrs_l[i]
+                    && merge_attributes(xacml_request_editsubject(request,i),merge_subject_addattribute,subject,counts->subject_attrs_l[i],attrs_l,canon_subject_getattribute) != PEP_XACML_OK) {
+                    return PEP_XACML_ERROR;
+                }
+            }
+            else {
+                xacml_subject_t * clone= xacml_subject_clone(subject);
+                if (clone == NULL || xacml_request_addsubject(request,clone) != PEP_XACML_OK) {
+                    if (clone != NULL) xacml_subject_delete(clone);
+                    return PEP_XACML_ERROR;
+                }
+            }
+        }
+    }
+    if (!(overlay->inherited & INHERIT_RESOURCES)) {
+        n= pep_llist_length(overlay->resources);
+        for (i= 0; i < n; i++) {
+            const xacml_resource_t * resource= pep_llist_get(overlay->resources,i);
+            if (i < counts->resources_l) {
+                attrs_l= xacml_resource_attributes_length(resource);
+                if (attrs_l > counts->resource_attrs_l[i]
+                    && merge_attributes(xacml_request_editresource(request,i),merge_resource_addattribute,resource,counts->resource_attrs_l[i],attrs_l,canon_resource_getattribute) != PEP_XACML_OK) {
+                    return PEP_XACML_ERROR;
+                }
+            }
+            else {
+                xacml_resource_t * clone= xacml_resource_clone(resource);
+                if (clone == NULL || xacml_request_addresource(request,clone) != PEP_XACML_OK) {
+                    if (clone != NULL) xacml_resource_delete(clone);
+                    return PEP_XACML_ERROR;
+                }
+            }
+        }
+    }
+    if (!(overlay->inherited & INHERIT_ACTION) && overlay->action != NULL) {
+        attrs_l= xacml_action_attributes_length(overlay->action);
+        if (attrs_l > counts->action_attrs_l) {
+            xacml_action_t * action= xacml_request_editaction(request);
+            if (action == NULL) {
+                action= xacml_action_create();
+                if (action == NULL || xacml_request_setaction(request,action) != PEP_XACML_OK) {
+                    if (action != NULL) xacml_action_delete(action);
+                    return PEP_XACML_ERROR;
+                }
+            }
+            if (merge_attributes(action,merge_action_addattribute,overlay->action,counts->action_attrs_l,attrs_l,canon_action_getattribute) != PEP_XACML_OK) {
+                return PEP_XACML_ERROR;
+            }
+        }
+    }
+    if (!(overlay->inherited & INHERIT_ENVIRONMENT) && overlay->environment != NULL) {
+        attrs_l= xacml_environment_attributes_length(overlay->environment);
+        if (attrs_l > counts->environment_attrs_l) {
+            xacml_environment_t * env= xacml_request_editenvironment(request);
+            if (env == NULL) {
+                env= xacml_environment_create();
+                if (env == NULL || xacml_request_setenvironment(request,env) != PEP_XACML_OK) {
+                    if (env != NULL) xacml_environment_delete(env);
+                    return PEP_XACML_ERROR;
+                }
+            }
+            if (merge_attributes(env,merge_environment_addattribute,overlay->environment,counts->environment_attrs_l,attrs_l,canon_environment_getattribute) != PEP_XACML_OK) {
+                return PEP_XACML_ERROR;
+            }
+        }
+    }
+    return PEP_XACML_OK;
+}
+
+int xacml_request_merge(xacml_request_t * request, xacml_request_t * const * overlays, size_t overlays_l) {
+    merge_counts_t counts;
+    int i, rc= PEP_XACML_OK;
+    if (request == NULL || (overlays == NULL && overlays_l > 0)) {
+        pep_log_error("xacml_request_merge: NULL request or overlays.");
+        return PEP_XACML_ERROR;
+    }
+    /* counts before the merge, the overlays were created from this state */
+    memset(&counts,0,sizeof(merge_counts_t));
+    counts.subjects_l= pep_llist_length(request->subjects);
+    counts.resources_l= pep_llist_length(request->resources);
+    counts.subject_attrs_l= calloc(counts.subjects_l + 1,sizeof(size_t));
+    counts.resource_attrs_l= calloc(counts.resources_l + 1,sizeof(size_t));
+    if (counts.subject_attrs_l == NULL || counts.resource_attrs_l == NULL) {
+        pep_log_error("xacml_request_merge: can't allocate attributes counts.");
+        if (counts.subject_attrs_l != NULL) free(counts.subject_attrs_l);
+        if (counts.resource_attrs_l != NULL) free(counts.resource_attrs_l);
+        return PEP_XACML_ERROR;
+    }
+    for (i= 0; i < counts.subjects_l; i++) {
+        counts.subject_attrs_l[i]= xacml_subject_attributes_length(pep_llist_get(request->subjects,i));
+    }
+    for (i= 0; i < counts.resources_l; i++) {
+        counts.resource_attrs_l[i]= xacml_resource_attributes_length(pep_llist_get(request->resources,i));
+    }
+    counts.action_attrs_l= (request->action != NULL) ? xacml_action_attributes_length(request->action) : 0;
+    counts.environment_attrs_l= (request->environment != NULL) ? xacml_environment_attributes_length(request->environment) : 0;
+    /* in the overlays order */
+    for (i= 0; i < overlays_l; i++) {
+        if (overlays[i] == NULL) continue;
+        if (merge_overlay(request,overlays[i],&counts) != PEP_XACML_OK) {
+            pep_log_error("xacml_request_merge: can't merge overlay[%d].",i);
+            rc= PEP_XACML_ERROR;
+            break;
+        }
+    }
+    free(counts.subject_attrs_l);
+    free(counts.resource_attrs_l);
+    return rc;
+}
@@ -23,10 +23,13 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "attrindex.h"
 
 struct xacml_resource {
     char * content;
     pep_linkedlist_t * attributes;
+    pep_attrindex_t * index; /* attributes by id, built on lookup */
 };
 
 xacml_resource_t * xacml_resource_create() {
@@ -54,7 +57,9 @@ int xacml_resource_addattribute(xacml_resource_t * resource, xacml_attribute_t *
         pep_log_error("xacml_resource_addattribute: can't add attribute to list.");
         return PEP_XACML_ERROR;
     }
-    else return PEP_XACML_OK;
+    pep_attrindex_invalidate(&(resource->index));
+    xacml_attribute_setindex(attr,&(resource->index));
+    return PEP_XACML_OK;
 }
 
 size_t xacml_resource_attributes_length(const xacml_resource_t * resource) {
@@ -73,6 +78,15 @@ xacml_attribute_t * xacml_resource_getattribute(const xacml_resource_t * resourc
     return pep_llist_get(resource->attributes, index);
 }
 
+xacml_attribute_t * xacml_resource_findattribute(const xacml_resource_t * resource, const char * id) {
+    if (resource == NULL || id == NULL) {
+        pep_log_error("xacml_resource_findattribute: NULL resource or id.");
+        return NULL;
+    }
+    /* the index is a cache, built on the first lookup */
+    return pep_attrindex_find(&(((xacml_resource_t *)resource)->index),resource->attributes,id);
+}
+
 /* if content is NULL, delete existing */
 int xacml_resource_setcontent(xacml_resource_t * resource, const char * content) {
     if (resource == NULL) {
@@ -104,9 +118,44 @@ const char * xacml_resource_getcontent(const xacml_resource_t * resource) {
 
 void xacml_resource_delete(xacml_resource_t * resource) {
     if (resource == NULL) return;
+    pep_attrindex_invalidate(&(resource->index));
     pep_llist_delete_elements(resource->attributes,(pep_llist_delete_elt_f)xacml_attribute_delete);
     pep_llist_delete(resource->attributes);
     if (resource->content != NULL) free(resource->content);
     free(resource);
     resource= NULL;
 }
+
+/**
+ * Clone the resource and its attributes.
+ */
+xacml_resource_t * xacml_resource_clone(const xacml_resource_t * resource) {
+    xacml_resource_t * clone;
+    size_t attrs_l;
+    int i;
+    if (resource == NULL) {
+        pep_log_warn("xacml_resource_clone: resource is NULL.");
+        return NULL;
+    }
+    clone= xacml_resource_create();
+    if (clone == NULL) {
+        pep_log_error("xacml_resource_clone: can't create clone.");
+        return NULL;
+    }
+    if (xacml_resource_setcontent(clone,resource->content) != PEP_XACML_OK) {
+        pep_log_error("xacml_resource_clone: can't set content: %s",resource->content);
+        xacml_resource_delete(clone);
+        return NULL;
+    }
+    attrs_l= pep_llist_length(resource->attributes);
+    for (i= 0; i < attrs_l; i++) {
+        xacml_attribute_t * attr= xacml_attribute_clone(pep_llist_get(resource->attributes,i));
+        if (attr == NULL || xacml_resource_addattribute(clone,attr) != PEP_XACML_OK) {
+            pep_log_error("xacml_resource_clone: can't clone attribute[%d].",i);
+            if (attr != NULL) xacml_attribute_delete(attr);
+            xacml_resource_delete(clone);
+            return NULL;
+        }
+    }
+    return clone;
+}
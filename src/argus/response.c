@@ -23,12 +23,40 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "io.h"
 
 struct xacml_response {
     xacml_request_t * request; /* original request */
     pep_linkedlist_t * results; /* list of results */
+    unsigned char * request_bytes; /* serialized request, unmarshalled on demand */
+    size_t request_bytes_l;
 };
 
+/* releases the serialized request */
+static void response_clearrequestbytes(xacml_response_t * response) {
+    if (response->request_bytes != NULL) free(response->request_bytes);
+    response->request_bytes= NULL;
+    response->request_bytes_l= 0;
+}
+
+/* unmarshals the serialized request, NULL on error */
+static xacml_request_t * response_decoderequest(const xacml_response_t * response) {
+    xacml_request_t * request= NULL;
+    pep_buffer_t * input= pep_buffer_create(response->request_bytes_l);
+    if (input == NULL) {
+        pep_log_error("xacml_response_getrequest: can't create input buffer (%d bytes).",(int)response->request_bytes_l);
+        return NULL;
+    }
+    pep_buffer_write(response->request_bytes,sizeof(unsigned char),response->request_bytes_l,input);
+    if (xacml_request_unmarshalling(&request,input) != PEP_OK) {
+        pep_log_error("xacml_response_getrequest: can't unmarshal the XACML request (%d bytes).",(int)response->request_bytes_l);
+        request= NULL;
+    }
+    pep_buffer_delete(input);
+    return request;
+}
+
 xacml_response_t * xacml_response_create() {
     xacml_response_t * response= calloc(1,sizeof(struct xacml_response));
     if (response == NULL) {
@@ -51,16 +79,43 @@ int xacml_response_setrequest(xacml_response_t * response, xacml_request_t * req
         return PEP_XACML_ERROR;
     }
     if (response->request != NULL) xacml_request_delete(response->request);
+    response_clearrequestbytes(response);
     response->request= request;
     return PEP_XACML_OK;
 }
 
+int xacml_response_setrequestbytes(xacml_response_t * response, unsigned char * bytes, size_t bytes_l) {
+    if (response == NULL || bytes == NULL) {
+        pep_log_error("xacml_response_setrequestbytes: NULL response or bytes.");
+        return PEP_XACML_ERROR;
+    }
+    if (response->request != NULL) xacml_request_delete(response->request);
+    response->request= NULL;
+    response_clearrequestbytes(response);
+    response->request_bytes= bytes;
+    response->request_bytes_l= bytes_l;
+    return PEP_XACML_OK;
+}
+
 xacml_request_t * xacml_response_getrequest(const xacml_response_t * response) {
+    xacml_request_t * request;
     if (response == NULL) {
         pep_log_error("xacml_response_getrequest: NULL response.");
         return NULL;
     }
-    return response->request;
+    request= response->request;
+    /* pairs with the compare and swap publishing the request */
+    __sync_synchronize();
+    if (request == NULL && response->request_bytes != NULL) {
+        request= response_decoderequest(response);
+        if (request == NULL) return NULL;
+        /* publish, or use the request decoded concurrently */
+        if (!__sync_bool_compare_and_swap(&(((xacml_response_t *)response)->request),NULL,request)) {
+            xacml_request_delete(request);
+            request= response->request;
+        }
+    }
+    return request;
 }
 
 xacml_request_t * xacml_response_relinquishrequest(xacml_response_t * response) {
@@ -70,8 +125,9 @@ xacml_request_t * xacml_response_relinquishrequest(xacml_response_t * response)
         return NULL;
     }
     /* forget about the request, caller is responsible to call xacml_delete_request */
-    request= response->request;
+    request= xacml_response_getrequest(response);
     response->request= NULL;
+    response_clearrequestbytes(response);
     return request;
 }
 
@@ -107,6 +163,7 @@ xacml_result_t * xacml_response_getresult(const xacml_response_t * response, int
 void xacml_response_delete(xacml_response_t * response) {
     if (response == NULL) return;
     if (response->request != NULL) xacml_request_delete(response->request);
+    response_clearrequestbytes(response);
     pep_llist_delete_elements(response->results,(pep_llist_delete_elt_f)xacml_result_delete);
     pep_llist_delete(response->results);
     free(response);
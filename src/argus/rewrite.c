@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* from ../util */
+#include "log.h"
+
+#include "pip.h"
+
+/*
+ * Compiled rewrite rules: open addressing hash table of the distinct
+ * source ids, each slot heads the chain of the rules with this source id.
+ */
+struct pep_rewrite {
+    const pep_rewrite_rule_t * rules;
+    size_t rules_l;
+    int * next; /* next rule with the same source id, or -1 */
+    int * slots; /* first rule index + 1, 0 if the slot is empty */
+    unsigned long * hashes; /* hash of the slot source id */
+    size_t slots_mask;
+};
+
+/* FNV-1a hash of the id */
+static unsigned long rewrite_hash(const char * id) {
+    unsigned long hash= 2166136261UL;
+    while (*id != '\0') {
+        hash^= (unsigned char)*id++;
+        hash*= 16777619UL;
+    }
+    return hash;
+}
+
+/* returns the slot of the id, either empty or holding the id */
+static size_t rewrite_slot(const pep_rewrite_t * rewrite, const char * id, unsigned long hash) {
+    size_t slot= hash & rewrite->slots_mask;
+    while (rewrite->slots[slot] != 0) {
+        if (rewrite->hashes[slot] == hash && strcmp(rewrite->rules[rewrite->slots[slot] - 1].source_id,id) == 0) {
+            break;
+        }
+        slot= (slot + 1) & rewrite->slots_mask;
+    }
+    return slot;
+}
+
+pep_rewrite_t * pep_rewrite_create(const pep_rewrite_rule_t * rules, size_t rules_l) {
+    pep_rewrite_t * rewrite;
+    size_t slots_l= 8;
+    int * last; /* last rule of each slot chain */
+    int i;
+    if (rules == NULL && rules_l > 0) {
+        pep_log_error("pep_rewrite_create: NULL rules table.");
+        return NULL;
+    }
+    /* load factor <= 0.5 */
+    while (slots_l < 2 * rules_l) slots_l*= 2;
+    rewrite= calloc(1,sizeof(pep_rewrite_t));
+    if (rewrite == NULL) {
+        pep_log_error("pep_rewrite_create: can't allocate pep_rewrite_t.");
+        return NULL;
+    }
+    rewrite->rules= rules;
+    rewrite->rules_l= rules_l;
+    rewrite->slots_mask= slots_l - 1;
+    rewrite->next= calloc(rules_l + 1,sizeof(int));
+    rewrite->slots= calloc(slots_l,sizeof(int));
+    rewrite->hashes= calloc(slots_l,sizeof(unsigned long));
+    last= calloc(slots_l,sizeof(int));
+    if (rewrite->next == NULL || rewrite->slots == NULL || rewrite->hashes == NULL || last == NULL) {
+        pep_log_error("pep_rewrite_create: can't allocate hash table (%d slots).",(int)slots_l);
+        if (last != NULL) free(last);
+        pep_rewrite_delete(rewrite);
+        return NULL;
+    }
+    for (i= 0; i<rules_l; i++) {
+        unsigned long hash;
+        size_t slot;
+        if (rules[i].source_id == NULL || rules[i].target_id == NULL) {
+            pep_log_error("pep_rewrite_create: rule[%d] has a NULL source_id or target_id.",i);
+            free(last);
+            pep_rewrite_delete(rewrite);
+            return NULL;
+        }
+        hash= rewrite_hash(rules[i].source_id);
+        slot= rewrite_slot(rewrite,rules[i].source_id,hash);
+        rewrite->next[i]= -1;
+        if (rewrite->slots[slot] == 0) {
+            rewrite->slots[slot]= i + 1;
+            rewrite->hashes[slot]= hash;
+        }
+        else {
+            rewrite->next[last[slot]]= i;
+        }
+        last[slot]= i;
+    }
+    free(last);
+    return rewrite;
+}
+
+int pep_rewrite_subjects(const pep_rewrite_t * rewrite, xacml_request_t * request) {
+    size_t subjects_l;
+    int i, j, rc= PEP_XACML_OK;
+    if (rewrite == NULL || request == NULL) {
+        pep_log_error("pep_rewrite_subjects: NULL rewrite rules or request.");
+        return PEP_XACML_ERROR;
+    }
+    subjects_l= xacml_request_subjects_length(request);
+    for (i= 0; i<subjects_l; i++) {
+        xacml_subject_t * subject= xacml_request_editsubject(request,i);
+        /* only the original attributes, not the derived ones */
+        size_t attrs_l= xacml_subject_attributes_length(subject);
+        for (j= 0; j<attrs_l; j++) {
+            xacml_attribute_t * attr= xacml_subject_getattribute(subject,j);
+            const char * attr_id= xacml_attribute_getid(attr);
+            int rule_idx;
+            size_t slot;
+            if (attr_id == NULL) continue;
+            slot= rewrite_slot(rewrite,attr_id,rewrite_hash(attr_id));
+            for (rule_idx= rewrite->slots[slot] - 1; rule_idx >= 0; rule_idx= rewrite->next[rule_idx]) {
+                const pep_rewrite_rule_t * rule= &(rewrite->rules[rule_idx]);
+                const char * datatype= (rule->target_datatype != NULL) ? rule->target_datatype : xacml_attribute_getdatatype(attr);
+                xacml_attribute_t * derived= xacml_attribute_derive(attr,rule->target_id,datatype);
+                if (derived == NULL) {
+                    pep_log_warn("pep_rewrite_subjects: failed to derive subject[%d].attribute[%d]{%s}",i,j,attr_id);
+                    rc= PEP_XACML_ERROR;
+                    continue;
+                }
+                pep_log_debug("pep_rewrite_subjects: subject[%d].attribute[%d]{%s} derived into {%s,%s}",i,j,attr_id,rule->target_id,datatype);
+                if (xacml_subject_addattribute(subject,derived) != PEP_XACML_OK) {
+                    pep_log_error("pep_rewrite_subjects: failed to add new attribute{%s} to subject[%d]",rule->target_id,i);
+                    xacml_attribute_delete(derived);
+                    rc= PEP_XACML_ERROR;
+                }
+            }
+        }
+    }
+    return rc;
+}
+
+void pep_rewrite_delete(pep_rewrite_t * rewrite) {
+    if (rewrite == NULL) return;
+    if (rewrite->next != NULL) free(rewrite->next);
+    if (rewrite->slots != NULL) free(rewrite->slots);
+    if (rewrite->hashes != NULL) free(rewrite->hashes);
+    free(rewrite);
+}
@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+/* mmap, ftruncate, fstat, nanosleep, kill, O_NOFOLLOW */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/* from ../util */
+#include "buffer.h"
+#include "log.h"
+
+#include "shmcache.h"
+
+/* cache file magic number and layout version */
+#define SHMCACHE_MAGIC   0x50455043 /* "PEPC" */
+#define SHMCACHE_VERSION 2
+
+/* number of slots probed for a key */
+#define SHMCACHE_PROBES 8
+
+/* number of retries of a reader on a concurrent write */
+#define SHMCACHE_READ_RETRIES 16
+
+/* seconds after which a slot still locked is reclaimed, its writer died */
+#define SHMCACHE_LOCK_TIMEOUT 2
+
+/* file header, the slots follow at offset SHMCACHE_HEADER_SIZE */
+#define SHMCACHE_HEADER_SIZE 64
+typedef struct shmcache_header {
+    volatile uint32_t magic; /* set last by the creator */
+    uint32_t version;
+    uint32_t slots_l;
+    uint32_t slot_size;
+} shmcache_header_t;
+
+/* slot: seqlock, entry metadata, then key and value bytes */
+typedef struct shmcache_slot {
+    volatile uint32_t seq; /* odd while being written */
+    uint32_t key_l;
+    uint32_t value_l;
+    volatile uint32_t writer; /* pid of the writer, 0 if unlocked */
+    uint64_t hash; /* 0 for an empty slot */
+    uint64_t subject_hash;
+    int64_t expires;
+    volatile int64_t locked; /* time the slot was locked, 0 if unlocked */
+    unsigned char data[SHMCACHE_SLOT_SIZE - 48];
+} shmcache_slot_t;
+
+struct pep_shmcache {
+    int fd;
+    void * map;
+    size_t map_l;
+    shmcache_slot_t * slots;
+    size_t slots_l;
+};
+
+/* FNV-1a 64 bits, never 0 */
+static uint64_t shmcache_hash(const unsigned char * data, size_t data_l) {
+    uint64_t hash= 14695981039346656037ULL;
+    size_t i;
+    for (i= 0; i < data_l; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return (hash == 0) ? 1 : hash;
+}
+
+/* tries to take the slot seqlock, returns the even sequence taken or -1 if busy */
+static int64_t shmcache_slot_lock(shmcache_slot_t * slot) {
+    uint32_t seq= slot->seq;
+    if ((seq & 1) || !__sync_bool_compare_and_swap(&(slot->seq),seq,seq + 1)) {
+        return -1;
+    }
+    slot->writer= (uint32_t)getpid();
+    slot->locked= (int64_t)time(NULL);
+    __sync_synchronize();
+    return (int64_t)seq;
+}
+
+static void shmcache_slot_unlock(shmcache_slot_t * slot, int64_t seq) {
+    slot->writer= 0;
+    slot->locked= 0;
+    __sync_synchronize();
+    slot->seq= (uint32_t)seq + 2;
+}
+
+/*
+ * Takes the seqlock of a slot left locked by a writer which died while writing:
+ * its pid does not exist anymore, or the slot is locked since more than
+ * SHMCACHE_LOCK_TIMEOUT seconds. The entry is cleared. Returns the sequence taken,
+ * to release with shmcache_slot_unlock, or -1 if the slot is not stale.
+ */
+static int64_t shmcache_slot_reclaim(shmcache_slot_t * slot) {
+    uint32_t seq= slot->seq;
+    uint32_t writer= slot->writer;
+    int64_t locked= slot->locked;
+    int64_t now= (int64_t)time(NULL);
+    int stale;
+    if (!(seq & 1)) {
+        return -1;
+    }
+    if (locked == 0) {
+        /* writer died before recording itself: time the lock from now */
+        __sync_bool_compare_and_swap(&(slot->locked),0,now);
+        locked= now;
+    }
+    stale= (writer != 0 && kill((pid_t)writer,0) != 0 && errno == ESRCH)
+           || now - locked >= SHMCACHE_LOCK_TIMEOUT;
+    if (!stale || slot->seq != seq || !__sync_bool_compare_and_swap(&(slot->seq),seq,seq + 2)) {
+        return -1;
+    }
+    pep_log_warn("pep_shmcache: reclaiming slot locked by dead writer %d since %d seconds.",(int)writer,(int)(now - locked));
+    slot->writer= (uint32_t)getpid();
+    slot->locked= now;
+    __sync_synchronize();
+    slot->hash= 0;
+    slot->expires= 0;
+    return (int64_t)seq + 1;
+}
+
+pep_shmcache_t * pep_shmcache_open(const char * filename, size_t slots_l) {
+    pep_shmcache_t * cache= NULL;
+    shmcache_header_t * header= NULL;
+    struct stat st;
+    struct timespec delay;
+    int created= 0;
+    int retries= 0;
+    if (filename == NULL) {
+        pep_log_error("pep_shmcache_open: NULL filename.");
+        return NULL;
+    }
+    if (slots_l < SHMCACHE_PROBES) {
+        slots_l= SHMCACHE_PROBES;
+    }
+    cache= calloc(1,sizeof(struct pep_shmcache));
+    if (cache == NULL) {
+        pep_log_error("pep_shmcache_open: can't allocate pep_shmcache_t.");
+        return NULL;
+    }
+    /* exclusive creation first, the creator initializes the header */
+    cache->fd= open(filename,O_RDWR|O_CREAT|O_EXCL|O_NOFOLLOW,S_IRUSR|S_IWUSR);
+    if (cache->fd >= 0) {
+        created= 1;
+        if (ftruncate(cache->fd,(off_t)(SHMCACHE_HEADER_SIZE + slots_l * sizeof(shmcache_slot_t))) != 0) {
+            pep_log_error("pep_shmcache_open: can't resize %s: %s.",filename,strerror(errno));
+            close(cache->fd);
+            unlink(filename);
+            free(cache);
+            return NULL;
+        }
+    }
+    else if (errno == EEXIST) {
+        cache->fd= open(filename,O_RDWR|O_NOFOLLOW);
+    }
+    if (cache->fd < 0) {
+        pep_log_error("pep_shmcache_open: can't open %s: %s.",filename,strerror(errno));
+        free(cache);
+        return NULL;
+    }
+    /* the cache content is trusted: must be a regular file of ours, mode 0600 */
+    if (fstat(cache->fd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 07777) != (S_IRUSR|S_IWUSR)) {
+        pep_log_error("pep_shmcache_open: %s is not a regular file owned by uid %d with mode 0600.",filename,(int)geteuid());
+        close(cache->fd);
+        free(cache);
+        return NULL;
+    }
+    /* wait for the creator to size the file and to write the header */
+    delay.tv_sec= 0;
+    delay.tv_nsec= 10000000L; /* 10ms */
+    while (!created && st.st_size < SHMCACHE_HEADER_SIZE && retries++ < 100) {
+        nanosleep(&delay,NULL);
+        fstat(cache->fd,&st);
+    }
+    if (!created) {
+        if (st.st_size < SHMCACHE_HEADER_SIZE) {
+            pep_log_error("pep_shmcache_open: %s is not a cache file.",filename);
+            close(cache->fd);
+            free(cache);
+            return NULL;
+        }
+        slots_l= (st.st_size - SHMCACHE_HEADER_SIZE) / sizeof(shmcache_slot_t);
+    }
+    cache->map_l= SHMCACHE_HEADER_SIZE + slots_l * sizeof(shmcache_slot_t);
+    cache->map= mmap(NULL,cache->map_l,PROT_READ|PROT_WRITE,MAP_SHARED,cache->fd,0);
+    if (cache->map == MAP_FAILED) {
+        pep_log_error("pep_shmcache_open: can't mmap %s (%d bytes): %s.",filename,(int)cache->map_l,strerror(errno));
+        close(cache->fd);
+        free(cache);
+        return NULL;
+    }
+    header= (shmcache_header_t *)cache->map;
+    if (created) {
+        header->version= SHMCACHE_VERSION;
+        header->slots_l= (uint32_t)slots_l;
+        header->slot_size= (uint32_t)sizeof(shmcache_slot_t);
+        __sync_synchronize();
+        header->magic= SHMCACHE_MAGIC;
+    }
+    else {
+        retries= 0;
+        while (header->magic != SHMCACHE_MAGIC && retries++ < 100) {
+            nanosleep(&delay,NULL);
+        }
+        __sync_synchronize();
+        if (header->magic != SHMCACHE_MAGIC || header->version != SHMCACHE_VERSION
+            || header->slot_size != sizeof(shmcache_slot_t) || header->slots_l != slots_l) {
+            pep_log_error("pep_shmcache_open: %s is not a version %d cache file.",filename,SHMCACHE_VERSION);
+            pep_shmcache_close(cache);
+            return NULL;
+        }
+    }
+    cache->slots= (shmcache_slot_t *)((unsigned char *)cache->map + SHMCACHE_HEADER_SIZE);
+    cache->slots_l= slots_l;
+    pep_log_debug("pep_shmcache_open: %s %s with %d slots.",filename,created ? "created" : "opened",(int)slots_l);
+    return cache;
+}
+
+void pep_shmcache_close(pep_shmcache_t * cache) {
+    if (cache == NULL) return;
+    if (cache->map != NULL && cache->map != MAP_FAILED) {
+        munmap(cache->map,cache->map_l);
+    }
+    if (cache->fd >= 0) {
+        close(cache->fd);
+    }
+    free(cache);
+}
+
+int pep_shmcache_get(pep_shmcache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value, long * ttl) {
+    uint64_t hash;
+    unsigned char * data= NULL;
+    size_t i;
+    int retry;
+    time_t now= time(NULL);
+    if (cache == NULL || key == NULL || value == NULL) {
+        pep_log_error("pep_shmcache_get: NULL cache, key or value buffer.");
+        return CACHE_ERROR;
+    }
+    if (key_l > sizeof(((shmcache_slot_t *)NULL)->data)) {
+        return CACHE_MISS;
+    }
+    data= calloc(sizeof(((shmcache_slot_t *)NULL)->data),sizeof(unsigned char));
+    if (data == NULL) {
+        pep_log_error("pep_shmcache_get: can't allocate slot data buffer.");
+        return CACHE_ERROR;
+    }
+    hash= shmcache_hash(key,key_l);
+    for (i= 0; i < SHMCACHE_PROBES; i++) {
+        shmcache_slot_t * slot= &(cache->slots[(hash + i) % cache->slots_l]);
+        for (retry= 0; retry < SHMCACHE_READ_RETRIES; retry++) {
+            uint32_t seq, value_l;
+            int64_t expires;
+            int match;
+            seq= slot->seq;
+            if (seq & 1) {
+                if (retry == SHMCACHE_READ_RETRIES - 1) {
+                    int64_t reclaimed= shmcache_slot_reclaim(slot);
+                    if (reclaimed >= 0) shmcache_slot_unlock(slot,reclaimed);
+                }
+                continue;
+            }
+            __sync_synchronize();
+            value_l= slot->value_l;
+            expires= slot->expires;
+            match= (slot->hash == hash && slot->key_l == key_l && key_l + value_l <= sizeof(slot->data));
+            if (match) {
+                memcpy(data,slot->data,key_l + value_l);
+            }
+            __sync_synchronize();
+            if (slot->seq != seq) continue; /* concurrent write */
+            if (match && memcmp(data,key,key_l) == 0) {
+                if (expires <= (int64_t)now) {
+                    free(data);
+                    return CACHE_MISS;
+                }
+                if (pep_buffer_write(data + key_l,sizeof(unsigned char),value_l,value) != value_l) {
+                    pep_log_error("pep_shmcache_get: can't write %d bytes into value buffer.",(int)value_l);
+                    free(data);
+                    return CACHE_ERROR;
+                }
+                if (ttl != NULL) {
+                    *ttl= (long)(expires - (int64_t)now);
+                }
+                free(data);
+                return CACHE_OK;
+            }
+            break;
+        }
+    }
+    free(data);
+    return CACHE_MISS;
+}
+
+int pep_shmcache_put(pep_shmcache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value, const char * subjectid, long ttl) {
+    shmcache_slot_t * slot= NULL;
+    uint64_t hash;
+    size_t i, value_l;
+    int64_t seq;
+    time_t now= time(NULL);
+    if (cache == NULL || key == NULL || value == NULL) {
+        pep_log_error("pep_shmcache_put: NULL cache, key or value buffer.");
+        return CACHE_ERROR;
+    }
+    pep_buffer_rewind(value);
+    value_l= pep_buffer_length(value);
+    if (key_l + value_l > sizeof(slot->data)) {
+        pep_log_debug("pep_shmcache_put: entry too big for a slot: %d bytes.",(int)(key_l + value_l));
+        return CACHE_MISS;
+    }
+    hash= shmcache_hash(key,key_l);
+    /* same key, else empty or expired slot, else the slot expiring first */
+    for (i= 0; i < SHMCACHE_PROBES; i++) {
+        shmcache_slot_t * probe= &(cache->slots[(hash + i) % cache->slots_l]);
+        if (probe->hash == hash) {
+            slot= probe;
+            break;
+        }
+        if (probe->hash == 0 || probe->expires <= (int64_t)now) {
+            if (slot == NULL || slot->hash != 0) slot= probe;
+        }
+        else if (slot == NULL || (slot->hash != 0 && slot->expires > (int64_t)now && probe->expires < slot->expires)) {
+            slot= probe;
+        }
+    }
+    /* skip if another process is writing the slot, unless it died */
+    seq= shmcache_slot_lock(slot);
+    if (seq < 0) {
+        seq= shmcache_slot_reclaim(slot);
+    }
+    if (seq < 0) {
+        return CACHE_MISS;
+    }
+    memcpy(slot->data,key,key_l);
+    if (pep_buffer_read(slot->data + key_l,sizeof(unsigned char),value_l,value) != value_l) {
+        pep_log_error("pep_shmcache_put: can't read %d bytes from value buffer.",(int)value_l);
+        slot->hash= 0;
+        shmcache_slot_unlock(slot,seq);
+        return CACHE_ERROR;
+    }
+    slot->key_l= (uint32_t)key_l;
+    slot->value_l= (uint32_t)value_l;
+    slot->hash= hash;
+    slot->subject_hash= (subjectid != NULL) ? shmcache_hash((const unsigned char *)subjectid,strlen(subjectid)) : 0;
+    slot->expires= (int64_t)now + ttl;
+    shmcache_slot_unlock(slot,seq);
+    return CACHE_OK;
+}
+
+size_t pep_shmcache_removesubject(pep_shmcache_t * cache, const char * subjectid) {
+    uint64_t subject_hash= 0;
+    size_t i, removed= 0;
+    if (cache == NULL) return 0;
+    if (subjectid != NULL) {
+        subject_hash= shmcache_hash((const unsigned char *)subjectid,strlen(subjectid));
+    }
+    for (i= 0; i < cache->slots_l; i++) {
+        shmcache_slot_t * slot= &(cache->slots[i]);
+        if (slot->hash != 0 && (subjectid == NULL || slot->subject_hash == subject_hash)) {
+            int64_t seq= -1;
+            int retry;
+            /* wait for a concurrent writer, reclaim the slot of a dead one */
+            for (retry= 0; seq < 0 && retry < SHMCACHE_READ_RETRIES * 64; retry++) {
+                seq= shmcache_slot_lock(slot);
+            }
+            if (seq < 0) {
+                seq= shmcache_slot_reclaim(slot);
+            }
+            if (seq < 0) {
+                pep_log_warn("pep_shmcache_removesubject: slot %d locked, skipped.",(int)i);
+                continue;
+            }
+            if (slot->hash != 0 && (subjectid == NULL || slot->subject_hash == subject_hash)) {
+                slot->hash= 0;
+                slot->expires= 0;
+                removed++;
+            }
+            shmcache_slot_unlock(slot,seq);
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_SHMCACHE_H_
+#define _PEP_SHMCACHE_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+
+#include "buffer.h" /* ../util/buffer.h */
+#include "cache.h" /* CACHE_OK, CACHE_MISS, CACHE_ERROR */
+
+/** Size in bytes of a slot, the key and the value must fit in it */
+#define SHMCACHE_SLOT_SIZE 8192
+
+/**
+ * ADT shared memory decision cache type.
+ *
+ * The cache is a fixed-size open addressing table of SHMCACHE_SLOT_SIZE bytes
+ * slots, stored in a memory-mapped file shared by all the processes using the
+ * same file (e.g. /dev/shm/argus-pep-cache). Each slot is protected by a
+ * seqlock: readers never block, a writer skips a slot being written by another
+ * process. A slot left locked by a dead writer is reclaimed as soon as the
+ * writer pid is gone, or after 2 seconds (e.g. other pid namespace). Like
+ * pep_cache_t, keys are request digests and values serialized Hessian bytes.
+ */
+typedef struct pep_shmcache pep_shmcache_t;
+
+/**
+ * Opens, or creates with slots_l slots, the shared memory cache file. The file
+ * must be a regular file, not a symbolic link, owned by the effective user with
+ * mode 0600, otherwise the cache can be used to inject decisions.
+ *
+ * @param const char * filename the cache file.
+ * @param size_t slots_l number of slots if the file is created.
+ *
+ * @return pep_shmcache_t * the mapped cache or NULL on error.
+ */
+pep_shmcache_t * pep_shmcache_open(const char * filename, size_t slots_l);
+
+/**
+ * Unmaps and closes the cache. The cache file is not removed.
+ */
+void pep_shmcache_close(pep_shmcache_t * cache);
+
+/**
+ * Looks up the cached value for the key and writes it into the value buffer.
+ *
+ * @param long * ttl if not NULL, set to the remaining time-to-live of the entry.
+ *
+ * @return int CACHE_OK on hit, CACHE_MISS or CACHE_ERROR.
+ */
+int pep_shmcache_get(pep_shmcache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value, long * ttl);
+
+/**
+ * Stores the value buffer bytes for the key, for ttl seconds. The value buffer is
+ * rewinded. Entries too big for a slot are not stored.
+ *
+ * @return int CACHE_OK, CACHE_MISS if not stored or CACHE_ERROR.
+ */
+int pep_shmcache_put(pep_shmcache_t * cache, const unsigned char * key, size_t key_l, pep_buffer_t * value, const char * subjectid, long ttl);
+
+/**
+ * Expires all the entries of the subjectid, or all entries if subjectid is NULL.
+ *
+ * @return size_t the number of entries expired.
+ */
+size_t pep_shmcache_removesubject(pep_shmcache_t * cache, const char * subjectid);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* from ../util */
+#include "buffer.h"
+#include "log.h"
+
+#include "singleflight.h"
+
+struct pep_flight {
+    unsigned long hash;
+    unsigned char * key;
+    size_t key_l;
+    int refcount; /* leader and followers */
+    int done;
+    pep_error_t rc;
+    unsigned char * value;
+    size_t value_l;
+    pthread_cond_t cond;
+    struct pep_flight * next;
+};
+
+/* process wide in-flight requests, protected by the mutex */
+static pthread_mutex_t flights_mutex= PTHREAD_MUTEX_INITIALIZER;
+static pep_flight_t * flights= NULL;
+
+/* FNV-1a hash of the key bytes */
+static unsigned long flight_hash(const unsigned char * key, size_t key_l) {
+    unsigned long hash= 2166136261UL;
+    size_t i;
+    for (i= 0; i < key_l; i++) {
+        hash ^= key[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/* releases a flight reference, flights_mutex must be locked */
+static void flight_release(pep_flight_t * flight) {
+    if (--(flight->refcount) > 0) return;
+    pthread_cond_destroy(&(flight->cond));
+    if (flight->key != NULL) free(flight->key);
+    if (flight->value != NULL) free(flight->value);
+    free(flight);
+}
+
+int pep_singleflight_join(const unsigned char * key, size_t key_l, pep_flight_t ** flight) {
+    pep_flight_t * current= NULL;
+    unsigned long hash;
+    if (key == NULL || flight == NULL) {
+        pep_log_error("pep_singleflight_join: NULL key or flight pointer.");
+        return SINGLEFLIGHT_ERROR;
+    }
+    hash= flight_hash(key,key_l);
+    pthread_mutex_lock(&flights_mutex);
+    for (current= flights; current != NULL; current= current->next) {
+        if (current->hash == hash && current->key_l == key_l && memcmp(current->key,key,key_l) == 0) {
+            current->refcount++;
+            pthread_mutex_unlock(&flights_mutex);
+            *flight= current;
+            return SINGLEFLIGHT_FOLLOWER;
+        }
+    }
+    current= calloc(1,sizeof(struct pep_flight));
+    if (current == NULL) {
+        pthread_mutex_unlock(&flights_mutex);
+        pep_log_error("pep_singleflight_join: can't allocate pep_flight_t.");
+        return SINGLEFLIGHT_ERROR;
+    }
+    current->key= calloc(key_l + 1,sizeof(unsigned char));
+    if (current->key == NULL) {
+        pthread_mutex_unlock(&flights_mutex);
+        pep_log_error("pep_singleflight_join: can't allocate key (%d bytes).",(int)key_l);
+        free(current);
+        return SINGLEFLIGHT_ERROR;
+    }
+    memcpy(current->key,key,key_l);
+    current->key_l= key_l;
+    current->hash= hash;
+    current->refcount= 1;
+    current->done= 0;
+    current->rc= PEP_OK;
+    pthread_cond_init(&(current->cond),NULL);
+    current->next= flights;
+    flights= current;
+    pthread_mutex_unlock(&flights_mutex);
+    *flight= current;
+    return SINGLEFLIGHT_LEADER;
+}
+
+void pep_singleflight_complete(pep_flight_t * flight, pep_error_t rc, pep_buffer_t * value) {
+    pep_flight_t ** link= NULL;
+    unsigned char * bytes= NULL;
+    size_t bytes_l= 0;
+    if (flight == NULL) return;
+    /* copy the response bytes outside of the lock */
+    if (rc == PEP_OK && value != NULL) {
+        pep_buffer_rewind(value);
+        bytes_l= pep_buffer_length(value);
+        bytes= calloc(bytes_l + 1,sizeof(unsigned char));
+        if (bytes == NULL) {
+            pep_log_error("pep_singleflight_complete: can't allocate value (%d bytes).",(int)bytes_l);
+            rc= PEP_ERR_MEMORY;
+        }
+        else {
+            pep_buffer_read(bytes,sizeof(unsigned char),bytes_l,value);
+            pep_buffer_rewind(value);
+        }
+    }
+    pthread_mutex_lock(&flights_mutex);
+    /* unregister: new identical requests start a new flight */
+    for (link= &flights; *link != NULL; link= &((*link)->next)) {
+        if (*link == flight) {
+            *link= flight->next;
+            break;
+        }
+    }
+    flight->rc= rc;
+    flight->value= bytes;
+    flight->value_l= bytes_l;
+    flight->done= 1;
+    pthread_cond_broadcast(&(flight->cond));
+    flight_release(flight);
+    pthread_mutex_unlock(&flights_mutex);
+}
+
+pep_error_t pep_singleflight_wait(pep_flight_t * flight, pep_buffer_t * value) {
+    pep_error_t rc;
+    if (flight == NULL || value == NULL) {
+        pep_log_error("pep_singleflight_wait: NULL flight or value buffer.");
+        return PEP_ERR_NULL_POINTER;
+    }
+    pthread_mutex_lock(&flights_mutex);
+    while (!flight->done) {
+        pthread_cond_wait(&(flight->cond),&flights_mutex);
+    }
+    rc= flight->rc;
+    if (rc == PEP_OK && pep_buffer_write(flight->value,sizeof(unsigned char),flight->value_l,value) != flight->value_l) {
+        pep_log_error("pep_singleflight_wait: can't write %d bytes into value buffer.",(int)flight->value_l);
+        rc= PEP_ERR_MEMORY;
+    }
+    flight_release(flight);
+    pthread_mutex_unlock(&flights_mutex);
+    return rc;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_SINGLEFLIGHT_H_
+#define _PEP_SINGLEFLIGHT_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+
+#include "error.h"
+#include "buffer.h" /* ../util/buffer.h */
+
+/** pep_singleflight_join return codes */
+#define SINGLEFLIGHT_ERROR    -1
+#define SINGLEFLIGHT_LEADER    0
+#define SINGLEFLIGHT_FOLLOWER  1
+
+/**
+ * ADT in-flight request type.
+ *
+ * The in-flight requests are registered in a process wide table: the first
+ * thread sending a request becomes the leader and does the round-trip to the
+ * PEPd, the threads sending an identical request while it is in flight become
+ * followers and wait for the leader result (response bytes or error code).
+ */
+typedef struct pep_flight pep_flight_t;
+
+/**
+ * Joins the in-flight request identified by key, or registers a new one.
+ *
+ * @param const unsigned char * key the request key bytes.
+ * @param size_t key_l the key length.
+ * @param pep_flight_t ** flight the joined or registered in-flight request (output).
+ *
+ * @return int SINGLEFLIGHT_LEADER if the caller must send the request and call
+ *         pep_singleflight_complete(), SINGLEFLIGHT_FOLLOWER if the caller must
+ *         call pep_singleflight_wait(), or SINGLEFLIGHT_ERROR.
+ */
+int pep_singleflight_join(const unsigned char * key, size_t key_l, pep_flight_t ** flight);
+
+/**
+ * Publishes the leader result, unregisters the in-flight request and wakes up
+ * the followers. The value buffer is rewinded. The leader must not use the
+ * flight after this call.
+ *
+ * @param pep_flight_t * flight the in-flight request.
+ * @param pep_error_t rc the round-trip return code.
+ * @param pep_buffer_t * value the response bytes, only used if rc is PEP_OK.
+ */
+void pep_singleflight_complete(pep_flight_t * flight, pep_error_t rc, pep_buffer_t * value);
+
+/**
+ * Waits for the leader result and copies the response bytes into the value
+ * buffer. The follower must not use the flight after this call.
+ *
+ * @return pep_error_t the leader round-trip return code, or PEP_ERR_MEMORY.
+ */
+pep_error_t pep_singleflight_wait(pep_flight_t * flight, pep_buffer_t * value);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
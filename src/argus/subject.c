@@ -23,10 +23,13 @@
 #include "log.h"
 
 #include "xacml.h"
+#include "i_xacml.h"
+#include "attrindex.h"
 
 struct xacml_subject {
     char * category;
     pep_linkedlist_t * attributes;
+    pep_attrindex_t * index; /* attributes by id, built on lookup */
 };
 
 xacml_subject_t * xacml_subject_create() {
@@ -83,7 +86,9 @@ int xacml_subject_addattribute(xacml_subject_t * subject, xacml_attribute_t * at
         pep_log_error("xacml_subject_addattribute: can't add attribute to list.");
         return PEP_XACML_ERROR;
     }
-    else return PEP_XACML_OK;
+    pep_attrindex_invalidate(&(subject->index));
+    xacml_attribute_setindex(attr,&(subject->index));
+    return PEP_XACML_OK;
 }
 
 size_t xacml_subject_attributes_length(const xacml_subject_t * subject) {
@@ -102,8 +107,18 @@ xacml_attribute_t * xacml_subject_getattribute(const xacml_subject_t * subject,
     return pep_llist_get(subject->attributes, index);
 }
 
+xacml_attribute_t * xacml_subject_findattribute(const xacml_subject_t * subject, const char * id) {
+    if (subject == NULL || id == NULL) {
+        pep_log_error("xacml_subject_findattribute: NULL subject or id.");
+        return NULL;
+    }
+    /* the index is a cache, built on the first lookup */
+    return pep_attrindex_find(&(((xacml_subject_t *)subject)->index),subject->attributes,id);
+}
+
 void xacml_subject_delete(xacml_subject_t * subject) {
     if (subject == NULL) return;
+    pep_attrindex_invalidate(&(subject->index));
     pep_llist_delete_elements(subject->attributes,(pep_llist_delete_elt_f)xacml_attribute_delete);
     pep_llist_delete(subject->attributes);
     if (subject->category != NULL) {
@@ -113,3 +128,36 @@ void xacml_subject_delete(xacml_subject_t * subject) {
     subject= NULL;
 }
 
+/**
+ * Clone the subject and its attributes.
+ */
+xacml_subject_t * xacml_subject_clone(const xacml_subject_t * subject) {
+    xacml_subject_t * clone;
+    size_t attrs_l;
+    int i;
+    if (subject == NULL) {
+        pep_log_warn("xacml_subject_clone: subject is NULL.");
+        return NULL;
+    }
+    clone= xacml_subject_create();
+    if (clone == NULL) {
+        pep_log_error("xacml_subject_clone: can't create clone.");
+        return NULL;
+    }
+    if (xacml_subject_setcategory(clone,subject->category) != PEP_XACML_OK) {
+        pep_log_error("xacml_subject_clone: can't set category: %s",subject->category);
+        xacml_subject_delete(clone);
+        return NULL;
+    }
+    attrs_l= pep_llist_length(subject->attributes);
+    for (i= 0; i < attrs_l; i++) {
+        xacml_attribute_t * attr= xacml_attribute_clone(pep_llist_get(subject->attributes,i));
+        if (attr == NULL || xacml_subject_addattribute(clone,attr) != PEP_XACML_OK) {
+            pep_log_error("xacml_subject_clone: can't clone attribute[%d].",i);
+            if (attr != NULL) xacml_attribute_delete(attr);
+            xacml_subject_delete(clone);
+            return NULL;
+        }
+    }
+    return clone;
+}
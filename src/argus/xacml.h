@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #include <stddef.h> /* size_t */
+#include <stdint.h> /* uint8_t */
 
 /** @defgroup XACML XACML Constants and Objects Model
  *
@@ -68,6 +69,18 @@ static const char XACML_DATATYPE_BASE64BINARY[]= "http://www.w3.org/2001/XMLSche
 static const char XACML_DATATYPE_DAY_TIME_DURATION[]= "http://www.w3.org/TR/2002/WD-xquery-operators-20020816#dayTimeDuration"; /**<  XACML data-type @c dayTimeDuration identifier (XACML 2.0, B.3) */
 static const char XACML_DATATYPE_YEAR_MONTH_DURATION[]= "http://www.w3.org/TR/2002/WD-xquery-operators-20020816#yearMonthDuration"; /**<  XACML data-type @c yearMonthDuration identifier (XACML 2.0, B.3) */
 
+/**
+ * Returns the interned copy of a XACML identifier or datatype.
+ *
+ * The ids and datatypes of the Attributes, Obligations and AttributeAssignments
+ * are interned: for the constants defined in this header and in profiles.h,
+ * the getters return the same pointer as @c xacml_intern(CONSTANT), and the
+ * identifiers can be compared by pointer.
+ * @param str the string to intern
+ * @return const char * the interned string, or @a NULL if the string can not be interned.
+ */
+const char * xacml_intern(const char * str);
+
 /**
  * @anchor Attribute
  * PEP XACML Attribute type.
@@ -163,9 +176,21 @@ void xacml_attribute_delete(xacml_attribute_t * attr);
  * Clone the XACML Attribute.
  * @param attr pointer to the XACML Attribute to clone
  * @return xacml_attribute_t * pointer to the new cloned Attribute or @a NULL on error.
+ * @note The clone shares the AttributeValues of @a attr, they are copied when a value is added.
  */
 xacml_attribute_t * xacml_attribute_clone(const xacml_attribute_t * attr);
 
+/**
+ * Derives a new XACML Attribute with the given id and datatype, sharing the AttributeValues
+ * and copying the issuer of the XACML Attribute.
+ * @param attr pointer to the XACML Attribute to derive
+ * @param id the new AttributeId
+ * @param datatype the new DataType, can be @a NULL
+ * @return xacml_attribute_t * pointer to the new Attribute or @a NULL on error.
+ * @see xacml_attribute_clone(const xacml_attribute_t * attr)
+ */
+xacml_attribute_t * xacml_attribute_derive(const xacml_attribute_t * attr, const char * id, const char * datatype);
+
 /**
  * @anchor Subject
  * PEP XACML Subject type.
@@ -236,6 +261,16 @@ size_t xacml_subject_attributes_length(const xacml_subject_t * subject);
  */
 xacml_attribute_t * xacml_subject_getattribute(const xacml_subject_t * subject, int attr_idx);
 
+/**
+ * Finds the first XACML Attribute with the given id in the XACML Subject.
+ * The lookup uses a hash index of the Attributes by id, built on the first
+ * lookup and rebuilt after an Attribute is added or its id changed.
+ * @param subject pointer to the XACML Subject
+ * @param id the XACML Attribute id to find
+ * @return xacml_attribute_t * pointer to the XACML Attribute or @a NULL if not found.
+ */
+xacml_attribute_t * xacml_subject_findattribute(const xacml_subject_t * subject, const char * id);
+
 /**
  * Deletes the XACML Subject.
  * @param subject pointer to the XACML Subject
@@ -244,6 +279,13 @@ xacml_attribute_t * xacml_subject_getattribute(const xacml_subject_t * subject,
  */
 void xacml_subject_delete(xacml_subject_t * subject);
 
+/**
+ * Clones the XACML Subject. The contained XACML Attributes are cloned.
+ * @param subject pointer to the XACML Subject to clone
+ * @return xacml_subject_t * pointer to the new cloned Subject or @a NULL on error.
+ */
+xacml_subject_t * xacml_subject_clone(const xacml_subject_t * subject);
+
 
 /**
  * PEP XACML Resource type.
@@ -301,12 +343,29 @@ size_t xacml_resource_attributes_length(const xacml_resource_t * resource);
  */
 xacml_attribute_t * xacml_resource_getattribute(const xacml_resource_t * resource, int attr_idx);
 
+/**
+ * Finds the first XACML Attribute with the given id in the XACML Resource.
+ * The lookup uses a hash index of the Attributes by id, built on the first
+ * lookup and rebuilt after an Attribute is added or its id changed.
+ * @param resource pointer to the XACML Resource
+ * @param id the XACML Attribute id to find
+ * @return xacml_attribute_t * pointer to the XACML Attribute or @a NULL if not found.
+ */
+xacml_attribute_t * xacml_resource_findattribute(const xacml_resource_t * resource, const char * id);
+
 /**
  * Deletes the XACML Resource. The XACML Attributes contained in the Resource will be deleted.
  * @param resource pointer to the XACML Resource
  */
 void xacml_resource_delete(xacml_resource_t * resource);
 
+/**
+ * Clones the XACML Resource. The contained XACML Attributes are cloned.
+ * @param resource pointer to the XACML Resource to clone
+ * @return xacml_resource_t * pointer to the new cloned Resource or @a NULL on error.
+ */
+xacml_resource_t * xacml_resource_clone(const xacml_resource_t * resource);
+
 
 /**
  * PEP XACML Action type.
@@ -349,12 +408,29 @@ size_t xacml_action_attributes_length(const xacml_action_t * action);
  */
 xacml_attribute_t * xacml_action_getattribute(const xacml_action_t * action, int attr_idx);
 
+/**
+ * Finds the first XACML Attribute with the given id in the XACML Action.
+ * The lookup uses a hash index of the Attributes by id, built on the first
+ * lookup and rebuilt after an Attribute is added or its id changed.
+ * @param action pointer to the XACML Action
+ * @param id the XACML Attribute id to find
+ * @return xacml_attribute_t * pointer to the XACML Attribute or @a NULL if not found.
+ */
+xacml_attribute_t * xacml_action_findattribute(const xacml_action_t * action, const char * id);
+
 /**
  * Deletes the XACML Action. The XACML Attributes contained in the Action will be deleted.
  * @param action pointer to the XACML Action to delete
  */
 void xacml_action_delete(xacml_action_t * action);
 
+/**
+ * Clones the XACML Action. The contained XACML Attributes are cloned.
+ * @param action pointer to the XACML Action to clone
+ * @return xacml_action_t * pointer to the new cloned Action or @a NULL on error.
+ */
+xacml_action_t * xacml_action_clone(const xacml_action_t * action);
+
 
 /**
  * PEP XACML Environment type.
@@ -399,12 +475,29 @@ size_t xacml_environment_attributes_length(const xacml_environment_t * env);
  */
 xacml_attribute_t * xacml_environment_getattribute(const xacml_environment_t * env, int attr_idx);
 
+/**
+ * Finds the first XACML Attribute with the given id in the XACML Environment.
+ * The lookup uses a hash index of the Attributes by id, built on the first
+ * lookup and rebuilt after an Attribute is added or its id changed.
+ * @param env pointer to the XACML Environment
+ * @param id the XACML Attribute id to find
+ * @return xacml_attribute_t * pointer to the XACML Attribute or @a NULL if not found.
+ */
+xacml_attribute_t * xacml_environment_findattribute(const xacml_environment_t * env, const char * id);
+
 /**
  * Deletes the XACML Environment. The XACML Attributes contained in the Environment will be deleted.
  * @param env pointer to the XACML Environment to delete
  */
 void xacml_environment_delete(xacml_environment_t * env);
 
+/**
+ * Clones the XACML Environment. The contained XACML Attributes are cloned.
+ * @param env pointer to the XACML Environment to clone
+ * @return xacml_environment_t * pointer to the new cloned Environment or @a NULL on error.
+ */
+xacml_environment_t * xacml_environment_clone(const xacml_environment_t * env);
+
 
 /**
  * PEP XACML Request type.
@@ -502,6 +595,111 @@ xacml_environment_t * xacml_request_getenvironment(const xacml_request_t * reque
  */
 void xacml_request_delete(xacml_request_t * request);
 
+/** Length in bytes of a XACML Request digest */
+#define XACML_HASH_LENGTH 32
+
+/**
+ * XACML Request digest algorithms.
+ */
+typedef enum xacml_hash {
+    XACML_HASH_FAST = 0, /**< Fast non-cryptographic 256-bit hash */
+    XACML_HASH_SHA256 /**< SHA-256 hash, collision resistant */
+} xacml_hash_t;
+
+/**
+ * Computes the canonical digest of the XACML Request. The digest does not depend on the
+ * insertion order of the Subjects, Resources, Attributes and AttributeValues, and an Attribute
+ * without datatype is equal to the same Attribute with the {@link #XACML_DATATYPE_STRING} datatype.
+ * Two equivalent Requests have the same digest.
+ * @param request pointer to the XACML Request
+ * @param algorithm the hash algorithm: {@link #XACML_HASH_FAST} or {@link #XACML_HASH_SHA256}
+ * @param out the {@link #XACML_HASH_LENGTH} bytes digest (output)
+ * @return int {@link #PEP_XACML_OK} or {@link #PEP_XACML_ERROR} on error.
+ */
+int xacml_request_digest(const xacml_request_t * request, xacml_hash_t algorithm, uint8_t out[XACML_HASH_LENGTH]);
+
+/**
+ * Computes the canonical digest of the XACML Request with the fast non-cryptographic hash.
+ * @param request pointer to the XACML Request
+ * @param out the {@link #XACML_HASH_LENGTH} bytes digest (output)
+ * @return int {@link #PEP_XACML_OK} or {@link #PEP_XACML_ERROR} on error.
+ * @see xacml_request_digest(const xacml_request_t * request, xacml_hash_t algorithm, uint8_t out[XACML_HASH_LENGTH])
+ */
+int xacml_request_hash(const xacml_request_t * request, uint8_t out[XACML_HASH_LENGTH]);
+
+/**
+ * PEP XACML Request template type. A template is an immutable, reference counted,
+ * XACML Request with its pre-serialized Hessian representation. The XACML Requests
+ * created from a template share its Subjects, Resources, Action and Environment
+ * until they are modified.
+ * @anchor RequestTemplate
+ */
+typedef struct xacml_request_template xacml_request_template_t;
+
+/**
+ * Creates a XACML Request template from the XACML Request. The template takes the
+ * ownership of the Request, which must not be used or deleted afterward.
+ * @param request pointer to the XACML Request (e.g. with the common Resource, Action and Environment)
+ * @return xacml_request_template_t * pointer to the new template or @a NULL on error.
+ */
+xacml_request_template_t * xacml_request_template_create(xacml_request_t * request);
+
+/**
+ * Releases the XACML Request template. The template is deleted when it is released
+ * and all the XACML Requests created from it are deleted. Thread safe.
+ * @param tmpl pointer to the XACML Request template
+ */
+void xacml_request_template_delete(xacml_request_template_t * tmpl);
+
+/**
+ * Creates a XACML Request from the XACML Request template. The new Request initially
+ * shares all its Subjects, Resources, Action and Environment with the template, and
+ * the shared parts are serialized from the template cached bytes. Adding a Subject
+ * or a Resource, or editing a Subject, Resource, Action or Environment, copies the
+ * corresponding part of the template into the Request (copy-on-write). Setting the
+ * Action or the Environment replaces the template one.
+ * @param tmpl pointer to the XACML Request template
+ * @return xacml_request_t * pointer to the new XACML Request or @a NULL on error.
+ * @note The Subjects, Resources, Action and Environment returned by the xacml_request_get*
+ *       functions may be shared with the template and must not be modified, use the
+ *       xacml_request_edit* functions to modify them.
+ */
+xacml_request_t * xacml_request_createfromtemplate(xacml_request_template_t * tmpl);
+
+/**
+ * Gets the XACML Subject of the XACML Request at the given index, to modify it. The
+ * Subjects still shared with the template are first copied into the Request.
+ * @param request pointer to the XACML Request
+ * @param subject_idx index of the XACML Subject to get in range [0..length-1]
+ * @return xacml_subject_t * pointer the XACML Subject or @a NULL if index is out of range or on error
+ */
+xacml_subject_t * xacml_request_editsubject(xacml_request_t * request, int subject_idx);
+
+/**
+ * Gets the XACML Resource of the XACML Request at the given index, to modify it. The
+ * Resources still shared with the template are first copied into the Request.
+ * @param request pointer to the XACML Request
+ * @param resource_idx index of the XACML Resource to get in range [0..length-1]
+ * @return xacml_resource_t * pointer the XACML Resource or @a NULL if index is out of range or on error
+ */
+xacml_resource_t * xacml_request_editresource(xacml_request_t * request, int resource_idx);
+
+/**
+ * Gets the XACML Action of the XACML Request, to modify it. The Action still shared
+ * with the template is first copied into the Request.
+ * @param request pointer to the XACML Request
+ * @return xacml_action_t * pointer to the XACML Action or @a NULL if not present or on error
+ */
+xacml_action_t * xacml_request_editaction(xacml_request_t * request);
+
+/**
+ * Gets the XACML Environment of the XACML Request, to modify it. The Environment still
+ * shared with the template is first copied into the Request.
+ * @param request pointer to the XACML Request
+ * @return xacml_environment_t * pointer to the XACML Environment or @a NULL if not present or on error
+ */
+xacml_environment_t * xacml_request_editenvironment(xacml_request_t * request);
+
 
 /**
  * PEP XACML StatusCode type.
@@ -920,6 +1118,8 @@ int xacml_response_setrequest(xacml_response_t * response, xacml_request_t * req
 
 /** @internal
  * Gets the effective XACML Request associated to the XACML Response.
+ * If the Response was unmarshalled with the PEP_OPTION_ENABLE_LAZY_REQUEST option,
+ * the Request is unmarshalled on the first call.
  * @param response pointer to the XACML Response
  * @return xacml_request_t * pointer to the associated XACML Request or @a NULL if no Request is associated with the Response.
  */
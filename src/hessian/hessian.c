@@ -21,6 +21,7 @@
 
 #include "hessian.h"
 #include "log.h"
+#include "probes.h"
 
 /**
  * Hessian class descriptors
@@ -226,7 +227,10 @@ hessian_object_t * hessian_deserialize(pep_buffer_t * input) {
     return hessian_deserialize_tag(tag,input);
 }
 
-hessian_object_t * hessian_deserialize_tag(int tag, pep_buffer_t * input) {
+/*
+ * Deserializes the object of the tag, returns NULL on error.
+ */
+static hessian_object_t * _deserialize_tag(int tag, pep_buffer_t * input) {
     hessian_t type= _gettype(tag);
     const hessian_class_t * class;
     void * object;
@@ -249,7 +253,9 @@ hessian_object_t * hessian_deserialize_tag(int tag, pep_buffer_t * input) {
     *(const hessian_class_t **) object = class;
     /* deserialize the object */
     if (class->deserialize) {
-        if (class->deserialize(object, tag, input) == HESSIAN_OK) return object;
+        if (class->deserialize(object, tag, input) == HESSIAN_OK) {
+            return object;
+        }
         else {
             pep_log_error("hessian_deserialize: failed to deserialize object: %s tag: %c", class->name, tag);
             return NULL;
@@ -262,6 +268,157 @@ hessian_object_t * hessian_deserialize_tag(int tag, pep_buffer_t * input) {
     }
 }
 
+hessian_object_t * hessian_deserialize_tag(int tag, pep_buffer_t * input) {
+    hessian_object_t * object;
+    PEP_PROBE2(hessian__deserialize__start,tag,pep_buffer_tell(input));
+    object= _deserialize_tag(tag,input);
+    PEP_PROBE3(hessian__deserialize__end,tag,pep_buffer_tell(input),(object != NULL) ? HESSIAN_OK : HESSIAN_ERROR);
+    return object;
+}
+
+/*
+ * Skips n bytes of the input buffer.
+ */
+static int _skip_bytes(size_t n, pep_buffer_t * input) {
+    if (pep_buffer_length(input) < n) {
+        pep_log_error("hessian_skip: truncated input, %d bytes expected.", (int)n);
+        return HESSIAN_ERROR;
+    }
+    return (pep_buffer_seek(input,pep_buffer_tell(input) + n) == BUFFER_OK) ? HESSIAN_OK : HESSIAN_ERROR;
+}
+
+/*
+ * Reads the 16 bits length of a string, xml, binary chunk or type.
+ */
+static int _skip_length(pep_buffer_t * input, size_t * length) {
+    int b16= pep_buffer_getc(input);
+    int b8= pep_buffer_getc(input);
+    if (b16 == BUFFER_EOF || b8 == BUFFER_EOF) {
+        pep_log_error("hessian_skip: truncated input, length expected.");
+        return HESSIAN_ERROR;
+    }
+    *length= (b16 << 8) + b8;
+    return HESSIAN_OK;
+}
+
+/*
+ * Skips utf8_l UTF-8 chars, as read by hessian_utf8_bgets.
+ */
+static int _skip_utf8(size_t utf8_l, pep_buffer_t * input) {
+    size_t n_utf8, n_mbyte;
+    for (n_utf8= 0; n_utf8 < utf8_l; n_utf8++) {
+        int byte= pep_buffer_getc(input);
+        if (byte == BUFFER_EOF) {
+            pep_log_error("hessian_skip: truncated input, %d UTF-8 chars expected.", (int)utf8_l);
+            return HESSIAN_ERROR;
+        }
+        n_mbyte= hessian_utf8_trailing(byte);
+        /* utf8 multi-byte char sequence */
+        if (n_mbyte > 0 && _skip_bytes(n_mbyte,input) != HESSIAN_OK) return HESSIAN_ERROR;
+    }
+    return HESSIAN_OK;
+}
+
+/*
+ * Skips the optional 't' type of a list, map or remote, returns the next tag.
+ */
+static int _skip_type(pep_buffer_t * input, int * next_tag) {
+    size_t utf8_l;
+    *next_tag= pep_buffer_getc(input);
+    if (*next_tag == 't') {
+        if (_skip_length(input,&utf8_l) != HESSIAN_OK || _skip_utf8(utf8_l,input) != HESSIAN_OK) {
+            return HESSIAN_ERROR;
+        }
+        *next_tag= pep_buffer_getc(input);
+    }
+    return HESSIAN_OK;
+}
+
+int hessian_skip(pep_buffer_t * input) {
+    int tag= pep_buffer_getc(input);
+    return hessian_skip_tag(tag,input);
+}
+
+int hessian_skip_tag(int tag, pep_buffer_t * input) {
+    size_t length;
+    int next_tag;
+    switch (tag) {
+    case 'N':
+    case 'T':
+    case 'F':
+        return HESSIAN_OK;
+    case 'I':
+    case 'R':
+        return _skip_bytes(4,input);
+    case 'L':
+    case 'D':
+    case 'd':
+        return _skip_bytes(8,input);
+    case 's':
+    case 'S':
+    case 'x':
+    case 'X':
+        /* chunks 's' or 'x' until the final 'S' or 'X' */
+        for (;;) {
+            if (_skip_length(input,&length) != HESSIAN_OK || _skip_utf8(length,input) != HESSIAN_OK) {
+                return HESSIAN_ERROR;
+            }
+            if (tag == 'S' || tag == 'X') return HESSIAN_OK;
+            tag= pep_buffer_getc(input);
+            if (tag != 's' && tag != 'S' && tag != 'x' && tag != 'X') {
+                pep_log_error("hessian_skip: invalid chunk tag: %c (%d).", (char)tag, tag);
+                return HESSIAN_ERROR;
+            }
+        }
+    case 'b':
+    case 'B':
+        for (;;) {
+            if (_skip_length(input,&length) != HESSIAN_OK || _skip_bytes(length,input) != HESSIAN_OK) {
+                return HESSIAN_ERROR;
+            }
+            if (tag == 'B') return HESSIAN_OK;
+            tag= pep_buffer_getc(input);
+            if (tag != 'b' && tag != 'B') {
+                pep_log_error("hessian_skip: invalid binary chunk tag: %c (%d).", (char)tag, tag);
+                return HESSIAN_ERROR;
+            }
+        }
+    case 'V':
+        if (_skip_type(input,&next_tag) != HESSIAN_OK) return HESSIAN_ERROR;
+        /* optional length */
+        if (next_tag == 'l') {
+            if (_skip_bytes(4,input) != HESSIAN_OK) return HESSIAN_ERROR;
+            next_tag= pep_buffer_getc(input);
+        }
+        while (next_tag != 'z') {
+            if (next_tag == BUFFER_EOF || hessian_skip_tag(next_tag,input) != HESSIAN_OK) {
+                pep_log_error("hessian_skip: can't skip list element.");
+                return HESSIAN_ERROR;
+            }
+            next_tag= pep_buffer_getc(input);
+        }
+        return HESSIAN_OK;
+    case 'M':
+        if (_skip_type(input,&next_tag) != HESSIAN_OK) return HESSIAN_ERROR;
+        while (next_tag != 'z') {
+            /* pair<key,value> */
+            if (next_tag == BUFFER_EOF || hessian_skip_tag(next_tag,input) != HESSIAN_OK || hessian_skip(input) != HESSIAN_OK) {
+                pep_log_error("hessian_skip: can't skip map pair<key,value>.");
+                return HESSIAN_ERROR;
+            }
+            next_tag= pep_buffer_getc(input);
+        }
+        return HESSIAN_OK;
+    case 'r':
+        /* type and url string */
+        if (_skip_type(input,&next_tag) != HESSIAN_OK) return HESSIAN_ERROR;
+        return hessian_skip_tag(next_tag,input);
+    default:
+        pep_log_error("hessian_skip: unknown serialization tag: %c (%d).", (char)tag, tag);
+        return HESSIAN_ERROR;
+    }
+}
+
 /*******************************************************/
 
 const hessian_class_t * hessian_getclass(const hessian_object_t * object) {
@@ -100,6 +100,28 @@ hessian_object_t * hessian_deserialize (pep_buffer_t * input);
  */
 hessian_object_t * hessian_deserialize_tag (int tag, pep_buffer_t * input);
 
+/**
+ * Skips a serialized Hessian object in the input buffer, without
+ * deserializing it. The first character delimiter is directly read from the
+ * buffer.
+ *
+ * @param pep_buffer_t * input pointer to the input buffer.
+ *
+ * @return HESSIAN_OK or HESSIAN_ERROR if the input is invalid or truncated.
+ */
+int hessian_skip (pep_buffer_t * input);
+
+/**
+ * Skips a serialized Hessian object in the input buffer, identified with the
+ * first tag character delimiter.
+ *
+ * @param int tag the first character delimiter.
+ * @param pep_buffer_t * input pointer to the input buffer.
+ *
+ * @return HESSIAN_OK or HESSIAN_ERROR if the input is invalid or truncated.
+ */
+int hessian_skip_tag (int tag, pep_buffer_t * input);
+
 /**
  * Gets the type hessian_t of an object.
  *
@@ -175,6 +197,7 @@ const char * hessian_string_getstring(const hessian_object_t *string);
  *  UTF-8 string utilities
  */
 size_t hessian_utf8_strlen(const char *array);
+size_t hessian_utf8_trailing(int byte);
 char * hessian_utf8_bgets(size_t utf8_l, pep_buffer_t * input);
 
 /**
@@ -135,12 +135,10 @@ static int hessian_string_serialize (const hessian_object_t * object, pep_buffer
         start_pos= pos;
         n_utf8s= 0;
         while( n_utf8s < HESSIAN_CHUNK_SIZE ) {
-            int byte= self->string[pos++];
+            int byte= (unsigned char)self->string[pos++];
             if ((byte & 0xC0) != 0x80) {
                 n_utf8s++;
-                if ((byte & 0xE0) == 0xC0) pos++; /* start of the 2-byte seq. */
-                else if ((byte & 0xF0) == 0xE0) pos+= 2; /* start of the 3-byte seq. */
-                else if ((byte & 0xF0) == 0xF0) pos+= 3; /* start of the 4-byte seq. */
+                pos+= hessian_utf8_trailing(byte);
             }
         }
         pep_buffer_write(chunk,1,(pos - start_pos),output);
@@ -268,13 +266,10 @@ char * hessian_utf8_bgets(size_t utf8_l, pep_buffer_t * input) {
     while(n_utf8 < utf8_l) {
         int byte= pep_buffer_getc(input);
         pep_buffer_putc(byte,tmp);
-        if ((byte & 0xC0) == 0xC0) {
+        if (byte >= 0xC0) {
             /* utf8 multi-byte char sequence */
-            int n_mbyte= 0;
-            if ((byte & 0xF0) == 0xC0) n_mbyte= 1; /* c is start of the 2-byte seq. */
-            else if ((byte & 0xF0) == 0xE0) n_mbyte= 2; /* c is start of the 3-byte seq. */
-            else if ((byte & 0xF0) == 0xF0) n_mbyte= 3; /* c is start of the 4-byte seq. */
-            else pep_log_error("utf8_bgets: unknown multi-bytes utf8 sequence: 0x%0X",byte);
+            size_t n_mbyte= hessian_utf8_trailing(byte);
+            if (n_mbyte == 0) pep_log_error("utf8_bgets: unknown multi-bytes utf8 sequence: 0x%0X",byte);
             /* read additional bytes */
             while (n_mbyte-- > 0) {
                 int mbyte= pep_buffer_getc(input);
@@ -314,6 +309,19 @@ size_t hessian_utf8_strlen(const char *s) {
     return j;
 }
 
+/**
+ * Returns the number of bytes following the UTF8 lead byte in the multi-byte
+ * sequence: 1 for 110xxxxx, 2 for 1110xxxx, 3 for 11110xxx and 0 otherwise
+ * (ASCII, continuation or invalid byte, BUFFER_EOF).
+ */
+size_t hessian_utf8_trailing(int byte) {
+    if (byte < 0xC0) return 0;
+    if (byte < 0xE0) return 1; /* start of the 2-byte seq. */
+    if (byte < 0xF0) return 2; /* start of the 3-byte seq. */
+    if (byte < 0xF8) return 3; /* start of the 4-byte seq. */
+    return 0;
+}
+
 /* return TRUE iff the byte is part of an UTF8 multi-byte sequence.
    2nd, 3rd and 4th byte of multi-byte seq. */
 /* NOT USED
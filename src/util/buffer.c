@@ -264,6 +264,27 @@ int pep_buffer_reset(pep_buffer_t * buffer) {
     return BUFFER_OK;
 }
 
+size_t pep_buffer_tell(pep_buffer_t * buffer) {
+    if (buffer == NULL) {
+        pep_log_error("pep_buffer_tell: buffer is a NULL pointer.");
+        return 0;
+    }
+    return buffer->rpos;
+}
+
+int pep_buffer_seek(pep_buffer_t * buffer, size_t pos) {
+    if (buffer == NULL) {
+        pep_log_error("pep_buffer_seek: buffer is a NULL pointer.");
+        return BUFFER_ERROR;
+    }
+    if (pos > buffer->wpos) {
+        pep_log_error("pep_buffer_seek: position %d beyond the %d bytes written.",(int)pos,(int)buffer->wpos);
+        return BUFFER_ERROR;
+    }
+    buffer->rpos= pos;
+    return BUFFER_OK;
+}
+
 size_t pep_buffer_length(pep_buffer_t * buffer) {
     if (buffer == NULL) {
         pep_log_error("pep_buffer_length: buffer is a NULL pointer.");
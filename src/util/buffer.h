@@ -168,6 +168,25 @@ int pep_buffer_rewind(pep_buffer_t * buffer);
  */
 int pep_buffer_reset(pep_buffer_t * buffer);
 
+/**
+ * Returns the buffer read position.
+ *
+ * @param pep_buffer_t * buffer pointer to the buffer.
+ *
+ * @return size_t the read position or 0 if an error occurs.
+ */
+size_t pep_buffer_tell(pep_buffer_t * buffer);
+
+/**
+ * Sets the buffer read position, at most the number of bytes written.
+ *
+ * @param pep_buffer_t * buffer pointer to the buffer.
+ * @param size_t pos the new read position.
+ *
+ * @return int BUFFER_OK or BUFFER_ERROR if an error occurs.
+ */
+int pep_buffer_seek(pep_buffer_t * buffer, size_t pos);
+
 /**
  * Returns the number of char available to read.
  *
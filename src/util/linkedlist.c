@@ -107,6 +107,20 @@ void * pep_llist_get(pep_linkedlist_t * list, int i) {
     return current->element;
 }
 
+int pep_llist_foreach(const pep_linkedlist_t * list, pep_llist_foreach_f f, void * arg) {
+    struct pep_linkedlist_node * current;
+    int rc;
+    if (list == NULL) {
+        pep_log_error("pep_llist_foreach: NULL pointer list.");
+        return 0;
+    }
+    for (current= list->head; current != NULL; current= current->next) {
+        rc= f(current->element,arg);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
 /**
  * Removes the element at index i [0..n-1] from the linked list.
  * Returns the removed element or NULL.
@@ -71,6 +71,19 @@ int pep_llist_add(pep_linkedlist_t * list, void * element);
  */
 void * pep_llist_get(pep_linkedlist_t * list, int i);
 
+/**
+ * Applies the function on each element of the linked list, in order, until
+ * the function returns non zero.
+ *
+ * @param linkedlist_t * list pointer to the linked list.
+ * @param pep_llist_foreach_f function to apply to each element.
+ * @param void * arg argument passed to the function.
+ *
+ * @return int the non zero value returned by the function, or @c 0.
+ */
+typedef int (*pep_llist_foreach_f) (void * element, void * arg);
+int pep_llist_foreach(const pep_linkedlist_t * list, pep_llist_foreach_f f, void * arg);
+
 /**
  * Removes the element at position i [0..n-1].
  *
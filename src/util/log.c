@@ -15,25 +15,79 @@
  * limitations under the License.
  */
 
+/* localtime_r */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdarg.h>  /* va_list, va_arg, ... */
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include "log.h"
 
-/* tmp buffer for logging */
+/* stack buffer for a formatted log line */
 #define LOG_BUFFER_SIZE 1024
 
+/* length of the "YYYY-MM-DD HH:MM:SS " timestamp prefix */
+#define LOG_TIMESTAMP_LENGTH 20
+
 /* output file handler */
 static FILE * log_out= NULL;
 
-/* log level */
+/* process wide log level */
 static pep_log_level_t log_level= LOG_LEVEL_NONE;
 
+/* max of the process and contexts levels, read by the pep_log_* macros */
+pep_log_level_t pep_log_current_level= LOG_LEVEL_NONE;
+
+/* number of log contexts at each level, protected by the mutex */
+static int log_context_levels[LOG_LEVEL_TRACE + 1];
+static pthread_mutex_t log_context_mutex= PTHREAD_MUTEX_INITIALIZER;
+
+/* log context of the thread, NULL for the process wide configuration */
+static __thread pep_log_context_t * log_context= NULL;
+
+/* record of the asynchronous log ring */
+typedef struct log_record {
+    size_t sequence; /* slot state, see log_ring_push and log_ring_drain */
+    FILE * out;
+    size_t length;
+    char line[LOG_BUFFER_SIZE];
+} log_record_t;
+
+/*
+ * Asynchronous sink: bounded multi-producer single-consumer ring of formatted
+ * log lines (sequence numbered slots), written by the drain thread.
+ */
+typedef struct log_ring {
+    log_record_t * records;
+    size_t mask;
+    size_t enqueue_pos; /* next slot to fill, shared by the producers */
+    size_t dequeue_pos; /* next slot to write, drain thread only */
+    size_t flushed_pos; /* slots written and flushed, protected by the mutex */
+    volatile int waiting; /* drain thread waiting for a record */
+    int stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; /* signaled when a record is published or stop is set */
+    pthread_cond_t drained; /* signaled when the ring is written and flushed */
+    pthread_t thread;
+} log_ring_t;
+
+/* current ring, NULL if synchronous */
+static log_ring_t * log_ring= NULL;
+/* number of threads using the current ring */
+static int log_ring_users= 0;
+/* number of records dropped because the ring was full */
+static unsigned long log_ring_dropped= 0;
+/* serializes pep_log_setasync */
+static pthread_mutex_t log_ring_mutex= PTHREAD_MUTEX_INITIALIZER;
+
 /* internal prototypes: */
 static int _log_vfprintf(FILE * out, time_t * epoch, const char * level, const char * fmt, va_list args);
+static size_t _log_vformat(char * buffer, time_t * epoch, const char * level, const char * fmt, va_list args);
 
 /* level prio strings */
 static const char * LEVEL_EVENTS[]= {"ERROR"," WARN"," INFO","DEBUG","TRACE"};
@@ -54,8 +108,24 @@ int pep_log_sethandler(pep_log_handler_func * handler) {
     return LOG_OK;
 }
 
+/* recomputes pep_log_current_level, log_context_mutex must be locked */
+static void log_update_current_level(void) {
+    pep_log_level_t level= log_level;
+    int i;
+    for (i= LOG_LEVEL_TRACE; i > level; i--) {
+        if (log_context_levels[i] > 0) {
+            level= i;
+            break;
+        }
+    }
+    pep_log_current_level= level;
+}
+
 int pep_log_setlevel(pep_log_level_t level) {
+    pthread_mutex_lock(&log_context_mutex);
     log_level= level;
+    log_update_current_level();
+    pthread_mutex_unlock(&log_context_mutex);
     return LOG_OK;
 }
 
@@ -72,106 +142,383 @@ FILE * pep_log_getout(void) {
     return log_out;
 }
 
+/*
+ * Queues the formatted line, without lock. Returns LOG_ERROR and counts the
+ * record as dropped if the ring is full.
+ */
+static int log_ring_push(log_ring_t * ring, FILE * out, const char * line, size_t length) {
+    log_record_t * record;
+    size_t pos= ring->enqueue_pos;
+    for (;;) {
+        size_t sequence;
+        long diff;
+        record= &(ring->records[pos & ring->mask]);
+        sequence= record->sequence;
+        __sync_synchronize();
+        diff= (long)sequence - (long)pos;
+        if (diff == 0) {
+            /* free slot, claim it */
+            if (__sync_bool_compare_and_swap(&(ring->enqueue_pos),pos,pos + 1)) break;
+        }
+        else if (diff < 0) {
+            /* slot not yet written by the drain thread: ring full */
+            __sync_fetch_and_add(&log_ring_dropped,1);
+            return LOG_ERROR;
+        }
+        pos= ring->enqueue_pos;
+        __sync_synchronize();
+    }
+    record->out= out;
+    record->length= length;
+    memcpy(record->line,line,length);
+    /* publish the record */
+    __sync_synchronize();
+    record->sequence= pos + 1;
+    __sync_synchronize();
+    /* wake up the drain thread only if it waits on an empty ring */
+    if (ring->waiting) {
+        pthread_mutex_lock(&(ring->mutex));
+        pthread_cond_signal(&(ring->cond));
+        pthread_mutex_unlock(&(ring->mutex));
+    }
+    return LOG_OK;
+}
+
+/* writes a line formatted by the drain thread itself */
+static void log_ring_writef(FILE * out, const char * level, const char * fmt, ...) {
+    char buffer[LOG_BUFFER_SIZE];
+    time_t epoch;
+    size_t length;
+    va_list args;
+    if (out == NULL) return;
+    time(&epoch);
+    va_start(args,fmt);
+    length= _log_vformat(buffer,&epoch,level,fmt,args);
+    va_end(args);
+    if (length > 0) fwrite(buffer,sizeof(char),length,out);
+}
+
+/*
+ * Drain thread: writes the queued lines in order, flushes the outputs when
+ * the ring is empty and reports the dropped records, then waits for the next
+ * record. Stops when the ring is empty and stop is set.
+ */
+static void * log_ring_drain(void * arg) {
+    log_ring_t * ring= arg;
+    FILE * last_out= NULL;
+    unsigned long reported= 0;
+    for (;;) {
+        log_record_t * record= &(ring->records[ring->dequeue_pos & ring->mask]);
+        int stop= ring->stop;
+        size_t sequence;
+        unsigned long dropped;
+        __sync_synchronize();
+        sequence= record->sequence;
+        __sync_synchronize();
+        if (sequence == ring->dequeue_pos + 1) {
+            if (last_out != NULL && last_out != record->out) fflush(last_out);
+            fwrite(record->line,sizeof(char),record->length,record->out);
+            last_out= record->out;
+            /* release the slot for the next round */
+            __sync_synchronize();
+            record->sequence= ring->dequeue_pos + ring->mask + 1;
+            ring->dequeue_pos++;
+            continue;
+        }
+        /* ring empty */
+        dropped= log_ring_dropped;
+        __sync_synchronize();
+        if (dropped != reported) {
+            if (last_out == NULL) last_out= log_out;
+            log_ring_writef(last_out,LEVEL_EVENTS[LOG_LEVEL_WARN],"pep_log: %lu log records dropped, asynchronous log ring full.",dropped - reported);
+            reported= dropped;
+        }
+        if (last_out != NULL) {
+            fflush(last_out);
+            last_out= NULL;
+        }
+        pthread_mutex_lock(&(ring->mutex));
+        ring->flushed_pos= ring->dequeue_pos;
+        pthread_cond_broadcast(&(ring->drained));
+        if (stop) {
+            pthread_mutex_unlock(&(ring->mutex));
+            break;
+        }
+        /* wait, unless a record was published before the producers could see waiting */
+        ring->waiting= 1;
+        __sync_synchronize();
+        if (ring->records[ring->dequeue_pos & ring->mask].sequence != ring->dequeue_pos + 1 && !ring->stop) {
+            pthread_cond_wait(&(ring->cond),&(ring->mutex));
+        }
+        ring->waiting= 0;
+        pthread_mutex_unlock(&(ring->mutex));
+    }
+    return NULL;
+}
+
+static void log_ring_free(log_ring_t * ring) {
+    pthread_mutex_destroy(&(ring->mutex));
+    pthread_cond_destroy(&(ring->cond));
+    pthread_cond_destroy(&(ring->drained));
+    free(ring->records);
+    free(ring);
+}
+
+int pep_log_setasync(size_t capacity) {
+    log_ring_t * ring;
+    size_t size, i;
+    int rc= LOG_OK;
+    pthread_mutex_lock(&log_ring_mutex);
+    ring= log_ring;
+    if (ring != NULL) {
+        /* detach the ring, wait for the producers and drain it */
+        log_ring= NULL;
+        __sync_synchronize();
+        while (__sync_fetch_and_add(&log_ring_users,0) > 0) {
+            sched_yield();
+        }
+        pthread_mutex_lock(&(ring->mutex));
+        ring->stop= 1;
+        pthread_cond_signal(&(ring->cond));
+        pthread_mutex_unlock(&(ring->mutex));
+        pthread_join(ring->thread,NULL);
+        log_ring_free(ring);
+    }
+    if (capacity > 0) {
+        /* power of 2 number of records */
+        for (size= 2; size < capacity; size*= 2);
+        ring= calloc(1,sizeof(log_ring_t));
+        if (ring != NULL) ring->records= calloc(size,sizeof(log_record_t));
+        if (ring == NULL || ring->records == NULL) {
+            if (ring != NULL) free(ring);
+            pthread_mutex_unlock(&log_ring_mutex);
+            return LOG_ERROR;
+        }
+        for (i= 0; i < size; i++) {
+            ring->records[i].sequence= i;
+        }
+        ring->mask= size - 1;
+        pthread_mutex_init(&(ring->mutex),NULL);
+        pthread_cond_init(&(ring->cond),NULL);
+        pthread_cond_init(&(ring->drained),NULL);
+        if (pthread_create(&(ring->thread),NULL,log_ring_drain,ring) != 0) {
+            log_ring_free(ring);
+            rc= LOG_ERROR;
+        }
+        else {
+            __sync_synchronize();
+            log_ring= ring;
+        }
+    }
+    pthread_mutex_unlock(&log_ring_mutex);
+    return rc;
+}
+
+unsigned long pep_log_getdropped(void) {
+    return __sync_fetch_and_add(&log_ring_dropped,0);
+}
+
+int pep_log_drain(void) {
+    log_ring_t * ring;
+    size_t queued_pos;
+    /* the ring can't be freed while log_ring_users > 0 */
+    __sync_fetch_and_add(&log_ring_users,1);
+    ring= log_ring;
+    if (ring != NULL) {
+        queued_pos= ring->enqueue_pos;
+        pthread_mutex_lock(&(ring->mutex));
+        while ((long)(ring->flushed_pos - queued_pos) < 0) {
+            pthread_cond_wait(&(ring->drained),&(ring->mutex));
+        }
+        pthread_mutex_unlock(&(ring->mutex));
+    }
+    __sync_fetch_and_sub(&log_ring_users,1);
+    return LOG_OK;
+}
+
+
+void pep_log_context_init(pep_log_context_t * context, int id) {
+    memset(context,0,sizeof(pep_log_context_t));
+    context->id= id;
+    context->level= LOG_LEVEL_NONE;
+}
+
+int pep_log_context_setlevel(pep_log_context_t * context, pep_log_level_t level) {
+    if (context == NULL || level < LOG_LEVEL_NONE || level > LOG_LEVEL_TRACE) {
+        return LOG_ERROR;
+    }
+    pthread_mutex_lock(&log_context_mutex);
+    if (context->level > LOG_LEVEL_NONE) log_context_levels[context->level]--;
+    if (level > LOG_LEVEL_NONE) log_context_levels[level]++;
+    context->level= level;
+    log_update_current_level();
+    pthread_mutex_unlock(&log_context_mutex);
+    return LOG_OK;
+}
+
+void pep_log_context_destroy(pep_log_context_t * context) {
+    if (context == NULL) return;
+    pep_log_context_setlevel(context,LOG_LEVEL_NONE);
+    if (log_context == context) log_context= NULL;
+    /* the queued lines can be written to the context output */
+    pep_log_drain();
+}
+
+pep_log_context_t * pep_log_setcontext(pep_log_context_t * context) {
+    pep_log_context_t * previous= log_context;
+    log_context= context;
+    return previous;
+}
+
+/* formats the message and passes the structured record to the context handler */
+static int log_record(pep_log_context_t * context, pep_log_level_t level, const char * fmt, va_list args) {
+    char message[LOG_BUFFER_SIZE];
+    pep_log_record_t record;
+    int length= vsnprintf(message,LOG_BUFFER_SIZE,fmt,args);
+    if (length < 0) return LOG_ERROR;
+    record.level= level;
+    time(&(record.time));
+    record.id= context->id;
+    record.phase= context->phase;
+    record.request= (context->request[0] != '\0') ? context->request : NULL;
+    record.message= message;
+    return context->record_handler(&record);
+}
 
+/*
+ * Logs the message with the context of the thread, or with the process wide
+ * level and handler if the thread has no context.
+ */
+static int log_dispatch(pep_log_level_t level, const char * fmt, va_list args) {
+    pep_log_context_t * context= log_context;
+    time_t epoch;
+    if (context == NULL) {
+        if (log_level < level || log_handler == NULL) return LOG_OK;
+        return log_handler(level,fmt,args);
+    }
+    if (context->level < level) return LOG_OK;
+    if (context->record_handler != NULL) {
+        return log_record(context,level,fmt,args);
+    }
+    if (context->handler != NULL) {
+        return context->handler(level,fmt,args);
+    }
+    time(&epoch);
+    return _log_vfprintf(context->out,&epoch,LEVEL_EVENTS[level],fmt,args);
+}
 
-int pep_log_info(const char *fmt, ...) {
+int (pep_log_info)(const char *fmt, ...) {
     int rc= LOG_OK;
     va_list args;
-    if (log_level >= LOG_LEVEL_INFO) {
+    if (pep_log_current_level >= LOG_LEVEL_INFO) {
         va_start(args,fmt);
-        if (log_handler != NULL) {
-            rc= log_handler(LOG_LEVEL_INFO,fmt,args);
-        }
+        rc= log_dispatch(LOG_LEVEL_INFO,fmt,args);
         va_end(args);
     }
     return rc;
 }
 
-int pep_log_warn(const char *fmt, ...) {
+int (pep_log_warn)(const char *fmt, ...) {
     int rc= LOG_OK;
     va_list args;
-    if (log_level >= LOG_LEVEL_WARN) {
+    if (pep_log_current_level >= LOG_LEVEL_WARN) {
         va_start(args,fmt);
-        if (log_handler != NULL) {
-            rc= log_handler(LOG_LEVEL_WARN,fmt,args);
-        }
+        rc= log_dispatch(LOG_LEVEL_WARN,fmt,args);
         va_end(args);
     }
     return rc;
 }
 
-int pep_log_error(const char *fmt, ...) {
+int (pep_log_error)(const char *fmt, ...) {
     int rc= LOG_OK;
     va_list args;
-    if (log_level >= LOG_LEVEL_ERROR) {
+    if (pep_log_current_level >= LOG_LEVEL_ERROR) {
         va_start(args,fmt);
-        if (log_handler != NULL) {
-            rc= log_handler(LOG_LEVEL_ERROR,fmt,args);
-        }
+        rc= log_dispatch(LOG_LEVEL_ERROR,fmt,args);
         va_end(args);
     }
     return rc;
 }
 
-int pep_log_debug(const char *fmt, ...) {
+int (pep_log_debug)(const char *fmt, ...) {
     int rc= LOG_OK;
     va_list args;
-    if (log_level >= LOG_LEVEL_DEBUG) {
+    if (pep_log_current_level >= LOG_LEVEL_DEBUG) {
         va_start(args,fmt);
-        if (log_handler != NULL) {
-            rc= log_handler(LOG_LEVEL_DEBUG,fmt,args);
-        }
+        rc= log_dispatch(LOG_LEVEL_DEBUG,fmt,args);
         va_end(args);
     }
     return rc;
 }
 
-int pep_log_trace(const char *fmt, ...) {
+int (pep_log_trace)(const char *fmt, ...) {
     int rc= LOG_OK;
     va_list args;
-    if (log_level >= LOG_LEVEL_TRACE) {
+    if (pep_log_current_level >= LOG_LEVEL_TRACE) {
         va_start(args,fmt);
-        if (log_handler != NULL) {
-            rc= log_handler(LOG_LEVEL_TRACE,fmt,args);
-        }
+        rc= log_dispatch(LOG_LEVEL_TRACE,fmt,args);
         va_end(args);
     }
     return rc;
 }
 
 
+/* timestamp prefix of the current second, cached per thread */
+static __thread time_t log_timestamp_epoch= (time_t)-1;
+static __thread char log_timestamp[LOG_TIMESTAMP_LENGTH + 1];
+
+/*
+ * Formats the log line "YYYY-MM-DD HH:MM:SS <level>: <formated_message>\n"
+ * into the LOG_BUFFER_SIZE buffer, a message too long for the buffer is
+ * truncated. Returns the line length, or 0 on error.
+ */
+static size_t _log_vformat(char * buffer, time_t * epoch, const char * level, const char * fmt, va_list args) {
+    size_t length;
+    int rc;
+    /* rebuild the timestamp prefix only when the second changes */
+    if (*epoch != log_timestamp_epoch) {
+        struct tm time;
+        if (localtime_r(epoch,&time) == NULL
+            || strftime(log_timestamp,sizeof(log_timestamp),"%Y-%m-%d %H:%M:%S ",&time) == 0) {
+            log_timestamp[0]= '\0';
+        }
+        log_timestamp_epoch= *epoch;
+    }
+    rc= snprintf(buffer,LOG_BUFFER_SIZE,"%s%s: ",log_timestamp,(level != NULL) ? level : "");
+    if (rc < 0) return 0;
+    length= ((size_t)rc < LOG_BUFFER_SIZE) ? (size_t)rc : LOG_BUFFER_SIZE - 1;
+    rc= vsnprintf(buffer + length,LOG_BUFFER_SIZE - length,fmt,args);
+    if (rc < 0) return 0;
+    length+= (size_t)rc;
+    /* keep room for the newline */
+    if (length > LOG_BUFFER_SIZE - 2) length= LOG_BUFFER_SIZE - 2;
+    buffer[length++]= '\n';
+    return length;
+}
+
 /* 
  * logs into file out
- * format "YYYY-MM-DD HH:MM:SS <level>: <formated_message>\n"
+ * The line is formatted in a stack buffer and queued in the asynchronous ring
+ * if enabled, otherwise written with a single fwrite.
  */
 static int _log_vfprintf(FILE * out, time_t * epoch, const char * level, const char * fmt, va_list args) {
-    struct tm * time;
-    size_t size;
-    char * buffer;
-    if (out != NULL) {
-        /* alloc tmp buffer */
-        buffer= calloc(LOG_BUFFER_SIZE + 1, sizeof(char));
-        if (buffer==NULL) return LOG_ERROR;
-        /* format log message into buffer */
-        time= localtime(epoch);
-        strftime(buffer,LOG_BUFFER_SIZE,"%Y-%m-%d %H:%M:%S ",time);
-        size= LOG_BUFFER_SIZE - strlen(buffer);
-        if (level != NULL) {
-            strncat(buffer,level,size);
-            size= LOG_BUFFER_SIZE - strlen(buffer);
-        }
-        strncat(buffer,": ",size);
-        size= LOG_BUFFER_SIZE - strlen(buffer);
-        strncat(buffer,fmt,size);
-        size= LOG_BUFFER_SIZE - strlen(buffer);
-        strncat(buffer,"\n",size);
-        /* write buffer to out file */
-        vfprintf(out,buffer,args);
-        /* flush it */
-        fflush(out);
-        /* free tmp buffer */
-        free(buffer);
+    char buffer[LOG_BUFFER_SIZE];
+    log_ring_t * ring;
+    size_t length;
+    if (out == NULL) return LOG_OK;
+    length= _log_vformat(buffer,epoch,level,fmt,args);
+    if (length == 0) return LOG_ERROR;
+    /* the ring can't be freed while log_ring_users > 0 */
+    __sync_fetch_and_add(&log_ring_users,1);
+    ring= log_ring;
+    if (ring != NULL) {
+        int rc= log_ring_push(ring,out,buffer,length);
+        __sync_fetch_and_sub(&log_ring_users,1);
+        return rc;
     }
+    __sync_fetch_and_sub(&log_ring_users,1);
+    /* write and flush it */
+    if (fwrite(buffer,sizeof(char),length,out) != length) return LOG_ERROR;
+    fflush(out);
     return LOG_OK;
 }
-
@@ -24,6 +24,8 @@ extern "C" {
 
 #include <stdio.h> /* FILE */
 #include <stdarg.h>  /* va_list, va_arg, ... */
+#include <stddef.h> /* size_t */
+#include <time.h> /* time_t */
 
 
 /** log function return codes */
@@ -50,6 +52,74 @@ typedef enum {
  */
 typedef int pep_log_handler_func(int level,const char * fmt, va_list args);
 
+#ifndef _PEP_LOG_RECORD_T_
+#define _PEP_LOG_RECORD_T_
+/**
+ * Structured log record, passed to the record handler of a log context.
+ * Same definition as in argus/pep.h.
+ */
+typedef struct pep_log_record {
+    int level; /* LOG_LEVEL_* */
+    time_t time;
+    int id; /* PEP client id */
+    const char * phase; /* authorization phase, or NULL */
+    const char * request; /* request hash (hex), or NULL */
+    const char * message; /* formatted message, not terminated by "\n" */
+} pep_log_record_t;
+#endif
+
+/**
+ * Optional record handler function prototype
+ *
+ * @param record the structured log record, valid during the call
+ * @return int 0 on success or an error code
+ */
+typedef int pep_log_record_handler_func(const pep_log_record_t * record);
+
+/** Size of the request hash hex string of a log context */
+#define LOG_REQUEST_HASH_SIZE 17
+
+/**
+ * Log context of a PEP client handle: its level, output and handlers, and the
+ * structured fields of its records. While set as the context of the calling
+ * thread (see pep_log_setcontext), it replaces the process wide level, output
+ * and handler.
+ */
+typedef struct pep_log_context {
+    int id; /* PEP client id */
+    pep_log_level_t level; /* use pep_log_context_setlevel */
+    FILE * out;
+    pep_log_handler_func * handler; /* NULL for the default handler writing to out */
+    pep_log_record_handler_func * record_handler; /* replaces the handlers if not NULL */
+    const char * phase; /* current phase, or NULL */
+    char request[LOG_REQUEST_HASH_SIZE]; /* request hash, empty if unknown */
+} pep_log_context_t;
+
+/**
+ * Initializes the log context of the PEP client id, with LOG_LEVEL_NONE.
+ */
+void pep_log_context_init(pep_log_context_t * context, int id);
+
+/**
+ * Sets the log level of the context.
+ * @return {@link #LOG_OK} or {@link #LOG_ERROR} on error
+ */
+int pep_log_context_setlevel(pep_log_context_t * context, pep_log_level_t level);
+
+/**
+ * Releases the log context, it must not be used afterwards. The log lines
+ * queued in the asynchronous ring are written before returning, so the
+ * context output can be closed.
+ */
+void pep_log_context_destroy(pep_log_context_t * context);
+
+/**
+ * Sets the log context of the calling thread, NULL for the process wide
+ * configuration.
+ * @return pep_log_context_t * the previous context of the thread, to restore.
+ */
+pep_log_context_t * pep_log_setcontext(pep_log_context_t * context);
+
 /**
  * Sets the optional log handler function.
  *
@@ -85,6 +155,45 @@ int pep_log_setout(FILE * fd);
  */
 FILE * pep_log_getout(void);
 
+/**
+ * Enables the asynchronous log sink: the log lines of the default log handler
+ * are queued in a bounded lock-free ring and written by a background thread,
+ * instead of being written by the logging thread. When the ring is full, the
+ * new lines are dropped and counted, and the drop count is reported in the
+ * log output. A capacity of 0 drains the ring, stops the thread and restores
+ * the synchronous output.
+ *
+ * @param capacity number of log lines of the ring (rounded up to a power of 2),
+ *        or 0 to disable.
+ * @return {@link #LOG_OK} or {@link #LOG_ERROR} on error
+ *
+ * @note The optional log handler function, if set, is always called
+ * synchronously.
+ */
+int pep_log_setasync(size_t capacity);
+
+/**
+ * Returns the total number of log lines dropped because the asynchronous
+ * ring was full.
+ */
+unsigned long pep_log_getdropped(void);
+
+/**
+ * Waits until the log lines queued in the asynchronous ring are written
+ * and flushed, e.g. before closing their output file. Returns immediately
+ * if the log is synchronous.
+ *
+ * @return {@link #LOG_OK}
+ */
+int pep_log_drain(void);
+
+/*
+ * The pep_log_* functions below are wrapped by macros of the same name, which
+ * test the log level before evaluating the arguments: a disabled log call
+ * costs a load and a compare. The functions can still be called directly with
+ * (pep_log_debug)(fmt,...).
+ */
+
 /**
  * Logs message at LOG_LEVEL_INFO level.
  * @return {@link #LOG_OK} or {@link #LOG_ERROR} on error
@@ -113,6 +222,47 @@ int pep_log_debug(const char *, ...);
  */
 int pep_log_trace(const char *, ...);
 
+/**
+ * Highest log level of the process and of all the log contexts. Read by the
+ * pep_log_* macros, do not set it directly.
+ */
+extern pep_log_level_t pep_log_current_level;
+
+/**
+ * Highest log level compiled in: the log calls above this level are removed
+ * at compile time, their arguments are still type checked. Defaults to LOG_LEVEL_TRACE (4), e.g. use
+ * CPPFLAGS=-DPEP_LOG_COMPILE_LEVEL=2 to strip the debug and trace calls.
+ */
+#ifndef PEP_LOG_COMPILE_LEVEL
+#define PEP_LOG_COMPILE_LEVEL 4
+#endif
+
+/** True if a message at level must be logged */
+#define PEP_LOG_ENABLED(level) \
+    ((level) <= PEP_LOG_COMPILE_LEVEL && (level) <= pep_log_current_level)
+
+#define pep_log_error(...) \
+    (PEP_LOG_ENABLED(LOG_LEVEL_ERROR) ? (pep_log_error)(__VA_ARGS__) : LOG_OK)
+#define pep_log_warn(...) \
+    (PEP_LOG_ENABLED(LOG_LEVEL_WARN) ? (pep_log_warn)(__VA_ARGS__) : LOG_OK)
+#define pep_log_info(...) \
+    (PEP_LOG_ENABLED(LOG_LEVEL_INFO) ? (pep_log_info)(__VA_ARGS__) : LOG_OK)
+
+/* stripped calls are void expressions, sizeof keeps the arguments type checked */
+#if PEP_LOG_COMPILE_LEVEL >= 3
+#define pep_log_debug(...) \
+    (PEP_LOG_ENABLED(LOG_LEVEL_DEBUG) ? (pep_log_debug)(__VA_ARGS__) : LOG_OK)
+#else
+#define pep_log_debug(...) ((void)sizeof((pep_log_debug)(__VA_ARGS__)))
+#endif
+
+#if PEP_LOG_COMPILE_LEVEL >= 4
+#define pep_log_trace(...) \
+    (PEP_LOG_ENABLED(LOG_LEVEL_TRACE) ? (pep_log_trace)(__VA_ARGS__) : LOG_OK)
+#else
+#define pep_log_trace(...) ((void)sizeof((pep_log_trace)(__VA_ARGS__)))
+#endif
+
 #ifdef  __cplusplus
 }
 #endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_PROBES_H_
+#define _PEP_PROBES_H_
+
+/*
+ * USDT static probes of the argus_pep provider, for bpftrace, perf or
+ * SystemTap. A disabled probe is a single nop instruction, its arguments
+ * must be cheap to evaluate. The probes are compiled when <sys/sdt.h> is
+ * found by configure, unless PEP_DISABLE_PROBES is defined.
+ *
+ * Probes of pep_authorize and pep_authorize_decision, the first argument
+ * is the PEP client id:
+ *   pips__start(id)                      pips__end(id,rc)
+ *   marshal__start(id)                   marshal__end(id,rc,bytes)
+ *   base64__encode__start(id,bytes)      base64__encode__end(id,bytes)
+ *   curl__start(id,bytes)                curl__end(id,curl_rc,bytes)
+ *   base64__decode__start(id,bytes)      base64__decode__end(id,bytes)
+ *   unmarshal__start(id,bytes)           unmarshal__end(id,rc)
+ *   ohs__start(id,ohs)                   ohs__end(id,rc)
+ * Probes of hessian_deserialize_tag, with the input buffer read position,
+ * the end probe fires also on error:
+ *   hessian__deserialize__start(tag,pos) hessian__deserialize__end(tag,pos,rc)
+ *
+ * Example:
+ *   bpftrace -e 'usdt:libargus-pep.so:argus_pep:curl__start { @t[arg0]= nsecs; }
+ *                usdt:libargus-pep.so:argus_pep:curl__end { @curl_us= hist((nsecs - @t[arg0]) / 1000); }'
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined(HAVE_SYS_SDT_H) && !defined(PEP_DISABLE_PROBES)
+
+#include <sys/sdt.h>
+
+#define PEP_PROBE1(name,a)          DTRACE_PROBE1(argus_pep,name,a)
+#define PEP_PROBE2(name,a,b)        DTRACE_PROBE2(argus_pep,name,a,b)
+#define PEP_PROBE3(name,a,b,c)      DTRACE_PROBE3(argus_pep,name,a,b,c)
+
+#else
+
+#define PEP_PROBE1(name,a)          do {} while (0)
+#define PEP_PROBE2(name,a,b)        do {} while (0)
+#define PEP_PROBE3(name,a,b,c)      do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PEP_SHA256_H_
+#define _PEP_SHA256_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+#include <stdint.h>
+
+/** Length in bytes of a SHA-256 digest */
+#define SHA256_DIGEST_LENGTH 32
+
+/**
+ * SHA-256 (FIPS 180-4) context.
+ */
+typedef struct pep_sha256 {
+    uint32_t state[8];
+    uint64_t length; /* total bytes hashed */
+    unsigned char block[64];
+    size_t block_l;
+} pep_sha256_t;
+
+/**
+ * Initializes the SHA-256 context.
+ *
+ * @param pep_sha256_t * ctx pointer to the context.
+ */
+void pep_sha256_init(pep_sha256_t * ctx);
+
+/**
+ * Hashes data_l bytes of data.
+ *
+ * @param pep_sha256_t * ctx pointer to the context.
+ * @param const void * data the bytes to hash.
+ * @param size_t data_l number of bytes.
+ */
+void pep_sha256_update(pep_sha256_t * ctx, const void * data, size_t data_l);
+
+/**
+ * Terminates the hash and writes the digest. The context must be initialized
+ * again before reuse.
+ *
+ * @param pep_sha256_t * ctx pointer to the context.
+ * @param uint8_t * digest the SHA256_DIGEST_LENGTH bytes digest (output).
+ */
+void pep_sha256_final(pep_sha256_t * ctx, uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
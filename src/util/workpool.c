@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "workpool.h"
+
+struct pep_workpool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work; /* a batch has jobs to take, or shutdown */
+    pthread_cond_t done; /* the batch is completed */
+    pthread_mutex_t batch_mutex; /* one batch at a time */
+    pthread_t * threads;
+    size_t threads_l;
+    int shutdown;
+    /* current batch, protected by mutex */
+    pep_workpool_job_f * job;
+    void * arg;
+    size_t jobs_l;
+    size_t next; /* next job to take */
+    size_t pending; /* jobs not completed */
+};
+
+/* takes and runs the jobs of the current batch, mutex must be locked */
+static void workpool_runjobs(pep_workpool_t * pool) {
+    while (pool->next < pool->jobs_l) {
+        size_t job_idx= pool->next++;
+        pthread_mutex_unlock(&(pool->mutex));
+        pool->job(pool->arg,job_idx);
+        pthread_mutex_lock(&(pool->mutex));
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&(pool->done));
+        }
+    }
+}
+
+static void * workpool_worker(void * arg) {
+    pep_workpool_t * pool= arg;
+    pthread_mutex_lock(&(pool->mutex));
+    while (!pool->shutdown) {
+        if (pool->next < pool->jobs_l) {
+            workpool_runjobs(pool);
+        }
+        else {
+            pthread_cond_wait(&(pool->work),&(pool->mutex));
+        }
+    }
+    pthread_mutex_unlock(&(pool->mutex));
+    return NULL;
+}
+
+pep_workpool_t * pep_workpool_create(size_t workers) {
+    pep_workpool_t * pool;
+    if (workers == 0) {
+        pep_log_error("pep_workpool_create: no worker.");
+        return NULL;
+    }
+    pool= calloc(1,sizeof(pep_workpool_t));
+    if (pool == NULL) {
+        pep_log_error("pep_workpool_create: can't allocate pep_workpool_t.");
+        return NULL;
+    }
+    pool->threads= calloc(workers,sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        pep_log_error("pep_workpool_create: can't allocate %d threads.",(int)workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&(pool->mutex),NULL);
+    pthread_mutex_init(&(pool->batch_mutex),NULL);
+    pthread_cond_init(&(pool->work),NULL);
+    pthread_cond_init(&(pool->done),NULL);
+    for (pool->threads_l= 0; pool->threads_l < workers; pool->threads_l++) {
+        if (pthread_create(&(pool->threads[pool->threads_l]),NULL,workpool_worker,pool) != 0) {
+            pep_log_error("pep_workpool_create: can't create worker thread #%d.",(int)pool->threads_l);
+            pep_workpool_delete(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+int pep_workpool_run(pep_workpool_t * pool, pep_workpool_job_f * job, void * arg, size_t jobs_l) {
+    if (pool == NULL || job == NULL) {
+        pep_log_error("pep_workpool_run: NULL pool or job.");
+        return WORKPOOL_ERROR;
+    }
+    if (jobs_l == 0) return WORKPOOL_OK;
+    pthread_mutex_lock(&(pool->batch_mutex));
+    pthread_mutex_lock(&(pool->mutex));
+    pool->job= job;
+    pool->arg= arg;
+    pool->jobs_l= jobs_l;
+    pool->next= 0;
+    pool->pending= jobs_l;
+    pthread_cond_broadcast(&(pool->work));
+    /* the caller works too */
+    workpool_runjobs(pool);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&(pool->done),&(pool->mutex));
+    }
+    pool->job= NULL;
+    pool->arg= NULL;
+    pool->jobs_l= 0;
+    pool->next= 0;
+    pthread_mutex_unlock(&(pool->mutex));
+    pthread_mutex_unlock(&(pool->batch_mutex));
+    return WORKPOOL_OK;
+}
+
+void pep_workpool_delete(pep_workpool_t * pool) {
+    size_t i;
+    if (pool == NULL) return;
+    pthread_mutex_lock(&(pool->mutex));
+    pool->shutdown= 1;
+    pthread_cond_broadcast(&(pool->work));
+    pthread_mutex_unlock(&(pool->mutex));
+    for (i= 0; i < pool->threads_l; i++) {
+        pthread_join(pool->threads[i],NULL);
+    }
+    pthread_cond_destroy(&(pool->done));
+    pthread_cond_destroy(&(pool->work));
+    pthread_mutex_destroy(&(pool->batch_mutex));
+    pthread_mutex_destroy(&(pool->mutex));
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* $Id$ */
+
+#ifndef _PEP_WORKPOOL_H_
+#define _PEP_WORKPOOL_H_
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h> /* size_t */
+
+/** pep_workpool_* return codes */
+#define WORKPOOL_OK     0
+#define WORKPOOL_ERROR -1
+
+/**
+ * Small pool of worker threads running batches of jobs. The thread calling
+ * pep_workpool_run also runs jobs of the batch, and the batches of concurrent
+ * callers are run one after the other.
+ */
+typedef struct pep_workpool pep_workpool_t;
+
+/**
+ * Job function prototype: runs the job job_idx of the batch.
+ */
+typedef void pep_workpool_job_f(void * arg, size_t job_idx);
+
+/**
+ * Creates a pool of workers threads.
+ *
+ * @param size_t workers number of worker threads (> 0).
+ * @return pep_workpool_t * the pool or NULL on error.
+ */
+pep_workpool_t * pep_workpool_create(size_t workers);
+
+/**
+ * Runs the jobs 0 to jobs_l - 1 in parallel and waits for their completion.
+ *
+ * @param pep_workpool_t * pool the pool.
+ * @param pep_workpool_job_f * job the job function.
+ * @param void * arg the job function argument.
+ * @param size_t jobs_l number of jobs.
+ * @return int WORKPOOL_OK or WORKPOOL_ERROR.
+ */
+int pep_workpool_run(pep_workpool_t * pool, pep_workpool_job_f * job, void * arg, size_t jobs_l);
+
+/**
+ * Stops the worker threads and deletes the pool.
+ */
+void pep_workpool_delete(pep_workpool_t * pool);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
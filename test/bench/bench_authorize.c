@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Benchmark of pep_authorize against a local PEP daemon (or stub).
+ *
+ * Sends the same request in a loop and reports the mean time per call, with
+ * the given log level and the log output sent to /dev/null. Comparing the
+ * PEP_LOGLEVEL_NONE and PEP_LOGLEVEL_DEBUG runs shows the cost of the
+ * disabled and enabled logging.
+ *
+ * With a capture file (PEP_OPTION_CAPTURE_FILE) instead of an url, the first
+ * captured response answers all the requests with the loopback transport
+ * (PEP_OPTION_TRANSPORT_LOOPBACK), to measure the CPU cost without network.
+ *
+ * usage: bench_authorize url|capturefile [iterations] [loglevel]
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "argus/pep.h"
+
+/* internal headers, from ../../src */
+#include "buffer.h"
+#include "base64.h"
+#include "capture.h"
+
+/* decoded Hessian response answered by the loopback transport */
+static unsigned char * loopback_response= NULL;
+static size_t loopback_response_l= 0;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int loopback_responder(void * arg, int id, const unsigned char * request, size_t request_l, const unsigned char ** response, size_t * response_l) {
+    *response= loopback_response;
+    *response_l= loopback_response_l;
+    return PEP_TRANSPORT_OK;
+}
+
+/* loads the first response of the capture file */
+static int load_response(const char * filename) {
+    FILE * in;
+    pep_buffer_t * record, * decoded;
+    int type, rc;
+    in= fopen(filename,"rb");
+    if (in == NULL) return -1;
+    record= pep_buffer_create(1024);
+    decoded= pep_buffer_create(1024);
+    while ((rc= pep_capture_read(in,&type,record)) == CAPTURE_OK && type != CAPTURE_RESPONSE);
+    fclose(in);
+    if (rc == CAPTURE_OK) {
+        pep_base64_decode_buffer(record,decoded);
+        loopback_response_l= pep_buffer_length(decoded);
+        loopback_response= calloc(loopback_response_l,sizeof(unsigned char));
+        if (loopback_response != NULL) {
+            pep_buffer_read(loopback_response,sizeof(unsigned char),loopback_response_l,decoded);
+        }
+    }
+    pep_buffer_delete(record);
+    pep_buffer_delete(decoded);
+    return (loopback_response != NULL) ? 0 : -1;
+}
+
+static xacml_attribute_t * create_attribute(const char * id, const char * value) {
+    xacml_attribute_t * attr= xacml_attribute_create(id);
+    xacml_attribute_addvalue(attr,value);
+    return attr;
+}
+
+static xacml_request_t * create_request(void) {
+    xacml_request_t * request= xacml_request_create();
+    xacml_subject_t * subject= xacml_subject_create();
+    xacml_resource_t * resource= xacml_resource_create();
+    xacml_action_t * action= xacml_action_create();
+    xacml_subject_addattribute(subject,create_attribute(XACML_SUBJECT_ID,"CN=bench,O=Argus"));
+    xacml_request_addsubject(request,subject);
+    xacml_resource_addattribute(resource,create_attribute(XACML_RESOURCE_ID,"http://authz-interop.org/xacml/resource/bench"));
+    xacml_request_addresource(request,resource);
+    xacml_action_addattribute(action,create_attribute(XACML_ACTION_ID,"http://glite.org/xacml/action/execute"));
+    xacml_request_setaction(request,action);
+    return request;
+}
+
+int main(int argc, char ** argv) {
+    const char * url;
+    int iterations, loglevel, i;
+    double start, elapsed;
+    FILE * devnull;
+    PEP * pep;
+    if (argc < 2) {
+        fprintf(stderr,"usage: %s url|capturefile [iterations] [loglevel]\n",argv[0]);
+        return 1;
+    }
+    url= argv[1];
+    iterations= (argc > 2) ? atoi(argv[2]) : 10000;
+    loglevel= (argc > 3) ? atoi(argv[3]) : PEP_LOGLEVEL_NONE;
+
+    devnull= fopen("/dev/null","w");
+    pep= pep_initialize();
+    if (strstr(url,"://") != NULL) {
+        pep_setoption(pep,PEP_OPTION_ENDPOINT_URL,url);
+    }
+    else {
+        if (load_response(url) != 0) {
+            fprintf(stderr,"ERROR: no response in capture file %s\n",url);
+            return 1;
+        }
+        pep_setoption(pep,PEP_OPTION_TRANSPORT_LOOPBACK,loopback_responder,NULL);
+    }
+    pep_setoption(pep,PEP_OPTION_LOG_STDERR,devnull);
+    pep_setoption(pep,PEP_OPTION_LOG_LEVEL,loglevel);
+
+    /* warm up the connection */
+    for (i= 0; i < 100; i++) {
+        xacml_request_t * request= create_request();
+        xacml_response_t * response= NULL;
+        if (pep_authorize(pep,&request,&response) != PEP_OK) {
+            fprintf(stderr,"ERROR: pep_authorize(%s) failed\n",url);
+            return 1;
+        }
+        xacml_request_delete(request);
+        xacml_response_delete(response);
+    }
+
+    elapsed= 0.0;
+    for (i= 0; i < iterations; i++) {
+        xacml_request_t * request= create_request();
+        xacml_response_t * response= NULL;
+        start= now_us();
+        if (pep_authorize(pep,&request,&response) != PEP_OK) {
+            fprintf(stderr,"ERROR: pep_authorize(%s) failed\n",url);
+            return 1;
+        }
+        elapsed+= now_us() - start;
+        xacml_request_delete(request);
+        xacml_response_delete(response);
+    }
+    printf("pep_authorize: loglevel %d, %d iterations, %.2f us/op\n",loglevel,iterations,elapsed/iterations);
+
+    pep_destroy(pep);
+    fclose(devnull);
+    if (loopback_response != NULL) free(loopback_response);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Replays the traffic captured with PEP_OPTION_CAPTURE_FILE, without network.
+ *
+ * Reads all the records of the capture file, then in a loop feeds the
+ * captured responses through pep_base64_decode_buffer and
+ * xacml_response_unmarshalling, and the captured requests through
+ * xacml_request_unmarshalling and xacml_request_marshalling. Reports the mean
+ * time per record of each type.
+ *
+ * usage: replay_capture file [iterations]
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "argus/pep.h"
+
+/* internal headers, from ../../src */
+#include "buffer.h"
+#include "base64.h"
+#include "io.h"
+#include "capture.h"
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(int argc, char ** argv) {
+    FILE * in;
+    pep_buffer_t ** records= NULL;
+    int * types= NULL;
+    int n_records= 0, n_requests= 0, n_responses= 0, iterations, i, j, type, rc;
+    double start, request_us= 0.0, response_us= 0.0;
+    pep_buffer_t * decoded, * output;
+    if (argc < 2) {
+        fprintf(stderr,"usage: %s file [iterations]\n",argv[0]);
+        return 1;
+    }
+    iterations= (argc > 2) ? atoi(argv[2]) : 1000;
+    in= fopen(argv[1],"rb");
+    if (in == NULL) {
+        fprintf(stderr,"ERROR: can't open %s\n",argv[1]);
+        return 1;
+    }
+
+    /* load all the records in memory */
+    for (;;) {
+        pep_buffer_t * record= pep_buffer_create(1024);
+        rc= pep_capture_read(in,&type,record);
+        if (rc != CAPTURE_OK) {
+            pep_buffer_delete(record);
+            if (rc == CAPTURE_ERROR) {
+                fprintf(stderr,"ERROR: %s: invalid record #%d\n",argv[1],n_records);
+                return 1;
+            }
+            break;
+        }
+        records= realloc(records,(n_records + 1) * sizeof(pep_buffer_t *));
+        types= realloc(types,(n_records + 1) * sizeof(int));
+        if (records == NULL || types == NULL) {
+            fprintf(stderr,"ERROR: can't allocate record #%d\n",n_records);
+            return 1;
+        }
+        records[n_records]= record;
+        types[n_records]= type;
+        if (type == CAPTURE_REQUEST) n_requests++;
+        else if (type == CAPTURE_RESPONSE) n_responses++;
+        n_records++;
+    }
+    fclose(in);
+    printf("%s: %d records, %d requests, %d responses\n",argv[1],n_records,n_requests,n_responses);
+
+    decoded= pep_buffer_create(1024);
+    output= pep_buffer_create(1024);
+    for (i= 0; i < iterations; i++) {
+        for (j= 0; j < n_records; j++) {
+            pep_buffer_t * record= records[j];
+            pep_buffer_rewind(record);
+            if (types[j] == CAPTURE_RESPONSE) {
+                xacml_response_t * response= NULL;
+                start= now_us();
+                pep_buffer_reset(decoded);
+                pep_base64_decode_buffer(record,decoded);
+                rc= xacml_response_unmarshalling(&response,decoded);
+                response_us+= now_us() - start;
+                if (rc != PEP_OK) {
+                    fprintf(stderr,"ERROR: response record #%d: %s\n",j,pep_strerror(rc));
+                    return 1;
+                }
+                xacml_response_delete(response);
+            }
+            else if (types[j] == CAPTURE_REQUEST) {
+                xacml_request_t * request= NULL;
+                start= now_us();
+                rc= xacml_request_unmarshalling(&request,record);
+                if (rc == PEP_OK) {
+                    pep_buffer_reset(output);
+                    rc= xacml_request_marshalling(request,output);
+                }
+                request_us+= now_us() - start;
+                if (rc != PEP_OK) {
+                    fprintf(stderr,"ERROR: request record #%d: %s\n",j,pep_strerror(rc));
+                    return 1;
+                }
+                xacml_request_delete(request);
+            }
+        }
+    }
+    if (n_responses > 0) {
+        printf("response base64 decode + unmarshal: %d iterations, %.2f us/op\n",iterations,response_us/((double)iterations*n_responses));
+    }
+    if (n_requests > 0) {
+        printf("request unmarshal + marshal: %d iterations, %.2f us/op\n",iterations,request_us/((double)iterations*n_requests));
+    }
+
+    for (j= 0; j < n_records; j++) {
+        pep_buffer_delete(records[j]);
+    }
+    free(records);
+    free(types);
+    pep_buffer_delete(decoded);
+    pep_buffer_delete(output);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Tests of the decision cache of a PEP handle: time-to-live expiry, least
+ * recently used eviction, subject invalidation and the obligation TTL policy.
+ *
+ * usage: test_cache
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* internal headers, from ../../src */
+#include "cache.h"
+
+#include "test_common.h"
+
+static int put(pep_cache_t * cache, const char * key, const char * value, const char * subjectid, long ttl) {
+    pep_buffer_t * buffer= value_buffer(value);
+    int rc= pep_cache_put(cache,(const unsigned char *)key,strlen(key),buffer,subjectid,ttl);
+    pep_buffer_delete(buffer);
+    return rc;
+}
+
+/* returns CACHE_OK if the cached value of key is value */
+static int get(pep_cache_t * cache, const char * key, const char * value) {
+    pep_buffer_t * buffer= pep_buffer_create(64);
+    int rc= pep_cache_get(cache,(const unsigned char *)key,strlen(key),buffer);
+    if (rc == CACHE_OK && !value_equals(buffer,value)) rc= CACHE_ERROR;
+    pep_buffer_delete(buffer);
+    return rc;
+}
+
+int main(void) {
+    pep_cache_t * cache= pep_cache_create(3,60);
+    check(cache != NULL,"create cache");
+    if (cache == NULL) return 1;
+    check(pep_cache_getttl(cache) == 60,"default TTL");
+
+    check(put(cache,"key1","permit","CN=alice",60) == CACHE_OK,"put key1");
+    check(get(cache,"key1","permit") == CACHE_OK,"get key1");
+    check(get(cache,"key2","deny") == CACHE_MISS,"get unknown key2 misses");
+    check(put(cache,"key1","deny","CN=alice",60) == CACHE_OK,"replace key1");
+    check(get(cache,"key1","deny") == CACHE_OK,"get replaced key1");
+
+    /* time-to-live */
+    check(put(cache,"short","permit",NULL,1) == CACHE_OK,"put with 1s TTL");
+    check(get(cache,"short","permit") == CACHE_OK,"get before expiry");
+    sleep(2);
+    check(get(cache,"short","permit") == CACHE_MISS,"get after expiry misses");
+    check(get(cache,"key1","deny") == CACHE_OK,"longer TTL entry kept");
+
+    /* least recently used eviction, key1 used last */
+    put(cache,"key2","permit","CN=bob",60);
+    put(cache,"key3","permit","CN=bob",60);
+    get(cache,"key1","deny");
+    check(put(cache,"key4","permit",NULL,60) == CACHE_OK,"put key4 into full cache");
+    check(get(cache,"key2","permit") == CACHE_MISS,"least recently used key2 evicted");
+    check(get(cache,"key1","deny") == CACHE_OK,"recently used key1 kept");
+
+    /* subject invalidation */
+    check(pep_cache_removesubject(cache,"CN=bob") == 1,"remove entries of CN=bob");
+    check(get(cache,"key3","permit") == CACHE_MISS,"key3 of CN=bob removed");
+    check(get(cache,"key1","deny") == CACHE_OK,"key1 of CN=alice kept");
+
+    /* obligation TTL policy */
+    check(pep_cache_setobligationttl(cache,"urn:test:obligation",5) == CACHE_OK,"set obligation TTL");
+    check(pep_cache_getobligationttl(cache,"urn:test:obligation",60) == 5,"obligation TTL overrides");
+    check(pep_cache_getobligationttl(cache,"urn:test:other",60) == 60,"other obligation keeps TTL");
+
+    pep_cache_delete(cache);
+    return check_summary();
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "test_common.h"
+
+static int failures= 0;
+
+void check(int condition, const char * what) {
+    printf("%s: %s\n",condition ? "OK" : "FAILED",what);
+    if (!condition) failures++;
+}
+
+int check_summary(void) {
+    if (failures > 0) {
+        printf("%d tests FAILED\n",failures);
+        return 1;
+    }
+    printf("all tests OK\n");
+    return 0;
+}
+
+pep_buffer_t * value_buffer(const char * value) {
+    pep_buffer_t * buffer= pep_buffer_create(64);
+    if (buffer != NULL) {
+        pep_buffer_write(value,sizeof(char),strlen(value),buffer);
+    }
+    return buffer;
+}
+
+int value_equals(pep_buffer_t * buffer, const char * value) {
+    char read[64];
+    size_t read_l;
+    memset(read,0,sizeof(read));
+    read_l= pep_buffer_read(read,sizeof(char),sizeof(read) - 1,buffer);
+    return read_l == strlen(value) && strcmp(read,value) == 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Test helpers shared by the cache tests: result checks and cached values.
+ */
+#ifndef _TEST_COMMON_H_
+#define _TEST_COMMON_H_
+
+#include "buffer.h" /* ../../src/util/buffer.h */
+
+/**
+ * Prints OK or FAILED and the description of the check, and counts the failures.
+ */
+void check(int condition, const char * what);
+
+/**
+ * Prints the result of all the checks.
+ *
+ * @return int 0 if all the checks passed, 1 otherwise (exit status of the test).
+ */
+int check_summary(void);
+
+/**
+ * Creates a buffer containing the value string, to be put in a cache.
+ */
+pep_buffer_t * value_buffer(const char * value);
+
+/**
+ * Returns 1 if the buffer read from a cache contains exactly the value string, 0 otherwise.
+ */
+int value_equals(pep_buffer_t * buffer, const char * value);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Tests of the shared memory decision cache: entries shared by the handles of
+ * the same file, time-to-live, subject invalidation, rejection of an unsafe
+ * cache file and reclaim of the slots left locked by a dead writer.
+ *
+ * usage: test_shmcache
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* internal headers, from ../../src */
+#include "shmcache.h"
+
+#include "test_common.h"
+
+/* slot layout of shmcache.c: seq, key_l, value_l, writer, ..., locked */
+#define HEADER_SIZE     64
+#define SLOT_WRITER     12
+#define SLOT_LOCKED     40
+
+static int put(pep_shmcache_t * cache, const char * key, const char * value, const char * subjectid, long ttl) {
+    pep_buffer_t * buffer= value_buffer(value);
+    int rc= pep_shmcache_put(cache,(const unsigned char *)key,strlen(key),buffer,subjectid,ttl);
+    pep_buffer_delete(buffer);
+    return rc;
+}
+
+/* returns CACHE_OK if the cached value of key is value */
+static int get(pep_shmcache_t * cache, const char * key, const char * value) {
+    pep_buffer_t * buffer= pep_buffer_create(64);
+    long ttl= 0;
+    int rc= pep_shmcache_get(cache,(const unsigned char *)key,strlen(key),buffer,&ttl);
+    if (rc == CACHE_OK && (!value_equals(buffer,value) || ttl <= 0)) rc= CACHE_ERROR;
+    pep_buffer_delete(buffer);
+    return rc;
+}
+
+/* locks all the slots of the cache file as a writer pid would */
+static void lock_all_slots(const char * filename, uint32_t writer, int64_t locked) {
+    struct stat st;
+    unsigned char * map;
+    size_t offset;
+    int fd= open(filename,O_RDWR);
+    fstat(fd,&st);
+    map= mmap(NULL,(size_t)st.st_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    for (offset= HEADER_SIZE; offset + SHMCACHE_SLOT_SIZE <= (size_t)st.st_size; offset+= SHMCACHE_SLOT_SIZE) {
+        uint32_t * seq= (uint32_t *)(map + offset);
+        if (!(*seq & 1)) (*seq)++;
+        memcpy(map + offset + SLOT_WRITER,&writer,sizeof(writer));
+        memcpy(map + offset + SLOT_LOCKED,&locked,sizeof(locked));
+    }
+    munmap(map,(size_t)st.st_size);
+    close(fd);
+}
+
+/* returns the pid of a terminated process */
+static pid_t dead_pid(void) {
+    pid_t pid= fork();
+    if (pid == 0) _exit(0);
+    waitpid(pid,NULL,0);
+    return pid;
+}
+
+int main(void) {
+    char dir[]= "/tmp/test_shmcache.XXXXXX";
+    char filename[256], link[256];
+    pep_shmcache_t * cache, * other;
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(filename,sizeof(filename),"%s/cache",dir);
+    snprintf(link,sizeof(link),"%s/link",dir);
+
+    cache= pep_shmcache_open(filename,16);
+    check(cache != NULL,"create cache file");
+    if (cache == NULL) return 1;
+    other= pep_shmcache_open(filename,16);
+    check(other != NULL,"open existing cache file");
+
+    check(put(cache,"key1","permit","CN=alice",60) == CACHE_OK,"put key1");
+    check(put(cache,"key2","deny","CN=bob",60) == CACHE_OK,"put key2");
+    check(get(cache,"key1","permit") == CACHE_OK,"get key1");
+    check(get(other,"key2","deny") == CACHE_OK,"get key2 from other handle");
+    check(get(cache,"key3","none") == CACHE_MISS,"get unknown key3 misses");
+
+    check(pep_shmcache_removesubject(other,"CN=alice") == 1,"remove subject CN=alice");
+    check(get(cache,"key1","permit") == CACHE_MISS,"key1 of CN=alice removed");
+    check(get(cache,"key2","deny") == CACHE_OK,"key2 of CN=bob kept");
+
+    check(put(cache,"short","permit",NULL,1) == CACHE_OK,"put with 1s TTL");
+    check(get(cache,"short","permit") == CACHE_OK,"get before expiry");
+    sleep(2);
+    check(get(cache,"short","permit") == CACHE_MISS,"get after expiry misses");
+
+    /* writer died while writing: slots reclaimed on pid check */
+    lock_all_slots(filename,(uint32_t)dead_pid(),(int64_t)time(NULL));
+    check(get(cache,"key2","deny") == CACHE_MISS,"slot of dead writer reclaimed and cleared");
+    check(put(cache,"key4","permit",NULL,60) == CACHE_OK,"put into reclaimed slot");
+    check(get(other,"key4","permit") == CACHE_OK,"get from reclaimed slot");
+
+    /* writer unknown, locked for too long: slots reclaimed on timeout */
+    lock_all_slots(filename,0,(int64_t)time(NULL) - 10);
+    check(put(cache,"key5","deny",NULL,60) == CACHE_OK,"put into timed out locked slot");
+    check(get(cache,"key5","deny") == CACHE_OK,"get from timed out locked slot");
+
+    /* writer alive and locking: slots not reclaimed */
+    lock_all_slots(filename,(uint32_t)getpid(),(int64_t)time(NULL));
+    check(put(cache,"key6","deny",NULL,60) == CACHE_MISS,"slot of live writer not taken");
+    lock_all_slots(filename,0,(int64_t)time(NULL) - 10);
+
+    pep_shmcache_close(other);
+    pep_shmcache_close(cache);
+
+    /* unsafe cache files */
+    chmod(filename,0644);
+    check(pep_shmcache_open(filename,16) == NULL,"reject cache file with mode 0644");
+    chmod(filename,0600);
+    symlink(filename,link);
+    check(pep_shmcache_open(link,16) == NULL,"reject symbolic link to cache file");
+
+    unlink(link);
+    unlink(filename);
+    rmdir(dir);
+    return check_summary();
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Benchmark of the Grid WN to AuthZ Interop obligation handler.
+ *
+ * Runs the gridwn2authzinterop_adapter_oh on a PERMIT response with a
+ * local-environment-map/posix obligation, and compares it with the former
+ * NGROUPS_MAX sized scratch allocation done for each obligation.
+ *
+ * usage: bench_oh [iterations] [username] [groupname]
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/resource.h>
+
+#include "argus/pep.h"
+
+#ifndef NGROUPS_MAX
+#define NGROUPS_MAX 65536
+#endif
+
+/* keeps the compiler from eliding the calloc/free pair */
+static char ** volatile scratch_sink;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long minor_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    return usage.ru_minflt;
+}
+
+static xacml_attributeassignment_t * create_assignment(const char * id, const char * value) {
+    xacml_attributeassignment_t * attr= xacml_attributeassignment_create(id);
+    xacml_attributeassignment_setvalue(attr,value);
+    return attr;
+}
+
+/* PERMIT response with a posix mapping: user, primary group and 2 secondary groups */
+static xacml_response_t * create_response(const char * username, const char * groupname) {
+    xacml_response_t * response= xacml_response_create();
+    xacml_result_t * result= xacml_result_create();
+    xacml_obligation_t * obligation= xacml_obligation_create(XACML_GLITE_OBLIGATION_LOCAL_ENVIRONMENT_MAP_POSIX);
+    xacml_obligation_setfulfillon(obligation,XACML_FULFILLON_PERMIT);
+    xacml_obligation_addattributeassignment(obligation,create_assignment(XACML_GLITE_ATTRIBUTE_USER_ID,username));
+    xacml_obligation_addattributeassignment(obligation,create_assignment(XACML_GLITE_ATTRIBUTE_GROUP_ID_PRIMARY,groupname));
+    xacml_obligation_addattributeassignment(obligation,create_assignment(XACML_GLITE_ATTRIBUTE_GROUP_ID,groupname));
+    xacml_obligation_addattributeassignment(obligation,create_assignment(XACML_GLITE_ATTRIBUTE_GROUP_ID,groupname));
+    xacml_result_setdecision(result,XACML_DECISION_PERMIT);
+    xacml_result_addobligation(result,obligation);
+    xacml_response_addresult(response,result);
+    return response;
+}
+
+int main(int argc, char ** argv) {
+    int iterations= (argc > 1) ? atoi(argv[1]) : 10000;
+    const char * username= (argc > 2) ? argv[2] : "root";
+    const char * groupname= (argc > 3) ? argv[3] : "root";
+    const pep_obligationhandler_t * oh= gridwn2authzinterop_adapter_oh;
+    double start, elapsed= 0.0;
+    long faults;
+    int i;
+
+    /* account resolutions are cached, only the OH itself is measured */
+    PEP * pep= pep_initialize();
+    pep_setoption(pep,PEP_OPTION_ACCOUNT_CACHE_TTL,(int)3600,(int)3600);
+
+    faults= minor_faults();
+    for (i= 0; i < iterations; i++) {
+        xacml_request_t * request= xacml_request_create();
+        xacml_response_t * response= create_response(username,groupname);
+        start= now_us();
+        if (oh->process(&request,&response) != 0) {
+            fprintf(stderr,"ERROR: OH[%s] process failed\n",oh->id);
+            return 1;
+        }
+        elapsed+= now_us() - start;
+        xacml_request_delete(request);
+        xacml_response_delete(response);
+    }
+    printf("OH[%s]: %d iterations, %.2f us/op, %.2f minor faults/op\n",
+           oh->id,iterations,elapsed/iterations,(double)(minor_faults() - faults)/iterations);
+
+    /* former scratch allocation, once per posix obligation */
+    elapsed= 0.0;
+    faults= minor_faults();
+    for (i= 0; i < iterations; i++) {
+        char ** groupnames;
+        start= now_us();
+        groupnames= calloc(NGROUPS_MAX,sizeof(char *));
+        groupnames[0]= (char *)groupname;
+        scratch_sink= groupnames;
+        free(scratch_sink);
+        elapsed+= now_us() - start;
+    }
+    printf("calloc(NGROUPS_MAX=%d): %d iterations, %.2f us/op, %.2f minor faults/op\n",
+           (int)NGROUPS_MAX,iterations,elapsed/iterations,(double)(minor_faults() - faults)/iterations);
+
+    pep_destroy(pep);
+    return 0;
+}
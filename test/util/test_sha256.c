@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * SHA-256 known-answer tests (FIPS 180-2 examples), with the message given
+ * at once and in odd sized parts crossing the 64 bytes block boundaries.
+ *
+ * usage: test_sha256
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* internal header, from ../../src/util */
+#include "sha256.h"
+
+static int failures= 0;
+
+static void check(int condition, const char * what) {
+    printf("%s: %s\n",condition ? "OK" : "FAILED",what);
+    if (!condition) failures++;
+}
+
+static void tohex(const uint8_t digest[SHA256_DIGEST_LENGTH], char hex[2 * SHA256_DIGEST_LENGTH + 1]) {
+    int i;
+    for (i= 0; i < SHA256_DIGEST_LENGTH; i++) {
+        sprintf(hex + 2 * i,"%02x",digest[i]);
+    }
+}
+
+/* hashes count times the message, fed in parts of part_l bytes */
+static void sha256(const char * message, size_t count, size_t part_l, char hex[2 * SHA256_DIGEST_LENGTH + 1]) {
+    pep_sha256_t ctx;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    size_t message_l= strlen(message);
+    size_t i, pos;
+    pep_sha256_init(&ctx);
+    for (i= 0; i < count; i++) {
+        for (pos= 0; pos < message_l; pos+= part_l) {
+            size_t l= (message_l - pos < part_l) ? message_l - pos : part_l;
+            pep_sha256_update(&ctx,message + pos,l);
+        }
+    }
+    pep_sha256_final(&ctx,digest);
+    tohex(digest,hex);
+}
+
+static void check_sha256(const char * message, size_t count, const char * expected, const char * what) {
+    char hex[2 * SHA256_DIGEST_LENGTH + 1];
+    char name[128];
+    sha256(message,count,strlen(message) + 1,hex);
+    check(strcmp(hex,expected) == 0,what);
+    sha256(message,count,7,hex);
+    snprintf(name,sizeof(name),"%s, in 7 bytes parts",what);
+    check(strcmp(hex,expected) == 0,name);
+}
+
+int main(void) {
+    char block[1001];
+    check_sha256("",1,
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+        "empty message");
+    check_sha256("abc",1,
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+        "\"abc\"");
+    check_sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",1,
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+        "448 bits message");
+    /* 55 and 56 bytes: the padding length fits or not in the last block */
+    check_sha256("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",1,
+        "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318",
+        "55 bytes message");
+    check_sha256("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",1,
+        "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a",
+        "56 bytes message");
+    memset(block,'a',1000);
+    block[1000]= '\0';
+    check_sha256(block,1000,
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+        "one million 'a'");
+    if (failures > 0) {
+        printf("%d tests FAILED\n",failures);
+        return 1;
+    }
+    printf("all tests OK\n");
+    return 0;
+}
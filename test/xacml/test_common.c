@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "test_common.h"
+
+static int failures= 0;
+
+void check(int condition, const char * what) {
+    printf("%s: %s\n",condition ? "OK" : "FAILED",what);
+    if (!condition) failures++;
+}
+
+int check_summary(void) {
+    if (failures > 0) {
+        printf("%d tests FAILED\n",failures);
+        return 1;
+    }
+    printf("all tests OK\n");
+    return 0;
+}
+
+xacml_attribute_t * create_attribute(const char * id, const char * value1, const char * value2) {
+    xacml_attribute_t * attr= xacml_attribute_create(id);
+    xacml_attribute_setdatatype(attr,XACML_DATATYPE_STRING);
+    xacml_attribute_addvalue(attr,value1);
+    if (value2 != NULL) xacml_attribute_addvalue(attr,value2);
+    return attr;
+}
+
+xacml_request_t * create_request(int reversed, const char * resource_id) {
+    xacml_request_t * request= xacml_request_create();
+    xacml_subject_t * alice= xacml_subject_create();
+    xacml_subject_t * bob= xacml_subject_create();
+    xacml_resource_t * resource= xacml_resource_create();
+    xacml_action_t * action= xacml_action_create();
+    if (!reversed) {
+        xacml_subject_addattribute(alice,create_attribute(XACML_SUBJECT_ID,"CN=alice",NULL));
+        xacml_subject_addattribute(alice,create_attribute("http://authz-interop.org/xacml/subject/voms-fqan","/vo","/vo/group"));
+        xacml_subject_addattribute(bob,create_attribute(XACML_SUBJECT_ID,"CN=bob",NULL));
+        xacml_request_addsubject(request,alice);
+        xacml_request_addsubject(request,bob);
+    }
+    else {
+        xacml_subject_addattribute(alice,create_attribute("http://authz-interop.org/xacml/subject/voms-fqan","/vo/group","/vo"));
+        xacml_subject_addattribute(alice,create_attribute(XACML_SUBJECT_ID,"CN=alice",NULL));
+        xacml_subject_addattribute(bob,create_attribute(XACML_SUBJECT_ID,"CN=bob",NULL));
+        xacml_request_addsubject(request,bob);
+        xacml_request_addsubject(request,alice);
+    }
+    xacml_resource_addattribute(resource,create_attribute(XACML_RESOURCE_ID,resource_id,NULL));
+    xacml_request_addresource(request,resource);
+    xacml_action_addattribute(action,create_attribute(XACML_ACTION_ID,"submit",NULL));
+    xacml_request_setaction(request,action);
+    return request;
+}
+
+int digest_equals(const xacml_request_t * request1, const xacml_request_t * request2, xacml_hash_t algorithm) {
+    uint8_t digest1[XACML_HASH_LENGTH], digest2[XACML_HASH_LENGTH];
+    if (xacml_request_digest(request1,algorithm,digest1) != PEP_XACML_OK) return -1;
+    if (xacml_request_digest(request2,algorithm,digest2) != PEP_XACML_OK) return -1;
+    return memcmp(digest1,digest2,XACML_HASH_LENGTH) == 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Test helpers shared by the XACML tests: result checks and request fixtures.
+ */
+#ifndef _TEST_COMMON_H_
+#define _TEST_COMMON_H_
+
+#include "argus/xacml.h"
+
+/**
+ * Prints OK or FAILED and the description of the check, and counts the failures.
+ */
+void check(int condition, const char * what);
+
+/**
+ * Prints the result of all the checks.
+ *
+ * @return int 0 if all the checks passed, 1 otherwise (exit status of the test).
+ */
+int check_summary(void);
+
+/**
+ * Creates a string attribute with one or two values (value2 can be NULL).
+ */
+xacml_attribute_t * create_attribute(const char * id, const char * value1, const char * value2);
+
+/**
+ * Creates a request with two subjects, a resource and an action, with the
+ * subjects, attributes and values in the reverse order if reversed.
+ */
+xacml_request_t * create_request(int reversed, const char * resource_id);
+
+/**
+ * Returns 1 if the digests of the requests are equal, 0 if they differ and
+ * -1 on error.
+ */
+int digest_equals(const xacml_request_t * request1, const xacml_request_t * request2, xacml_hash_t algorithm);
+
+#endif
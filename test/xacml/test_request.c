@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Tests of the request digest, equal for equivalent requests and different
+ * otherwise.
+ *
+ * usage: test_request
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "test_common.h"
+
+static void test_digest(void) {
+    xacml_request_t * request= create_request(0,"resource");
+    xacml_request_t * reversed= create_request(1,"resource");
+    xacml_request_t * other= create_request(0,"other-resource");
+    xacml_request_t * empty1= xacml_request_create();
+    xacml_request_t * empty2= xacml_request_create();
+    xacml_subject_t * subject;
+    uint8_t hash1[XACML_HASH_LENGTH], hash2[XACML_HASH_LENGTH];
+
+    check(digest_equals(request,reversed,XACML_HASH_SHA256) == 1,"SHA-256 digest of equivalent requests equal");
+    check(digest_equals(request,reversed,XACML_HASH_FAST) == 1,"fast digest of equivalent requests equal");
+    check(xacml_request_hash(request,hash1) == PEP_XACML_OK && xacml_request_hash(reversed,hash2) == PEP_XACML_OK
+          && memcmp(hash1,hash2,XACML_HASH_LENGTH) == 0,"hash of equivalent requests equal");
+    check(digest_equals(empty1,empty2,XACML_HASH_SHA256) == 1,"digest of empty requests equal");
+
+    check(digest_equals(request,other,XACML_HASH_SHA256) == 0,"SHA-256 digest of different resources differ");
+    check(digest_equals(request,other,XACML_HASH_FAST) == 0,"fast digest of different resources differ");
+    check(digest_equals(request,empty1,XACML_HASH_SHA256) == 0,"digest of request and empty request differ");
+
+    /* same values, different attribute id */
+    subject= xacml_request_getsubject(reversed,0);
+    xacml_attribute_setid(xacml_subject_getattribute(subject,0),"http://authz-interop.org/xacml/subject/subject-x509-id");
+    check(digest_equals(request,reversed,XACML_HASH_SHA256) == 0,"SHA-256 digest of different attribute ids differ");
+    check(digest_equals(request,reversed,XACML_HASH_FAST) == 0,"fast digest of different attribute ids differ");
+
+    /* additional value */
+    xacml_request_delete(other);
+    other= create_request(0,"resource");
+    subject= xacml_request_getsubject(other,1);
+    xacml_attribute_addvalue(xacml_subject_getattribute(subject,0),"CN=carol");
+    check(digest_equals(request,other,XACML_HASH_SHA256) == 0,"SHA-256 digest of different values differ");
+
+    xacml_request_delete(request);
+    xacml_request_delete(reversed);
+    xacml_request_delete(other);
+    xacml_request_delete(empty1);
+    xacml_request_delete(empty2);
+}
+
+int main(void) {
+    test_digest();
+    return check_summary();
+}
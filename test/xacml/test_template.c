@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Tests of the copy-on-write isolation of the requests created from a request
+ * template: the get functions read the shared sections, the edit, add and set
+ * functions copy them into the request.
+ *
+ * usage: test_template
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "test_common.h"
+
+static void test_template(void) {
+    xacml_request_t * request= create_request(0,"resource");
+    xacml_request_t * equivalent= create_request(0,"resource");
+    xacml_request_template_t * tmpl;
+    xacml_request_t * clone1, * clone2;
+    const xacml_subject_t * shared;
+    xacml_subject_t * subject;
+    xacml_resource_t * resource;
+    xacml_action_t * action;
+
+    tmpl= xacml_request_template_create(request);
+    check(tmpl != NULL,"create template");
+    clone1= xacml_request_createfromtemplate(tmpl);
+    clone2= xacml_request_createfromtemplate(tmpl);
+    check(clone1 != NULL && clone2 != NULL,"create requests from template");
+    check(digest_equals(clone1,equivalent,XACML_HASH_SHA256) == 1,"request from template equivalent to template");
+
+    /* get functions read the shared sections */
+    shared= xacml_request_getsubject(clone1,0);
+    check(shared == xacml_request_getsubject(clone2,0),"get subject shared with template");
+
+    /* edit copies the subjects into the request */
+    subject= xacml_request_editsubject(clone1,0);
+    check(subject != NULL && subject != shared,"edit subject copies template subjects");
+    xacml_subject_addattribute(subject,create_attribute("urn:test:attribute","value",NULL));
+    check(xacml_subject_attributes_length(subject) == 3,"attribute added to edited subject");
+    check(xacml_subject_attributes_length(xacml_request_getsubject(clone2,0)) == 2,"template subject unchanged");
+    check(digest_equals(clone1,equivalent,XACML_HASH_SHA256) == 0,"edited request digest changed");
+    check(digest_equals(clone2,equivalent,XACML_HASH_SHA256) == 1,"other request digest unchanged");
+
+    /* add copies the resources into the request */
+    resource= xacml_resource_create();
+    xacml_resource_addattribute(resource,create_attribute(XACML_RESOURCE_ID,"second-resource",NULL));
+    xacml_request_addresource(clone2,resource);
+    check(xacml_request_resources_length(clone2) == 2,"resource added to request");
+    check(xacml_request_resources_length(clone1) == 1,"template resources unchanged");
+
+    /* set replaces the action of the request only */
+    action= xacml_action_create();
+    xacml_action_addattribute(action,create_attribute(XACML_ACTION_ID,"cancel",NULL));
+    xacml_request_setaction(clone2,action);
+    check(strcmp(xacml_attribute_getvalue(xacml_action_getattribute(xacml_request_getaction(clone1),0),0),"submit") == 0,"template action unchanged");
+
+    /* the template is deleted with its last request */
+    xacml_request_delete(clone1);
+    xacml_request_template_delete(tmpl);
+    check(xacml_subject_attributes_length(xacml_request_getsubject(clone2,0)) == 2,"request readable after template release");
+    xacml_request_delete(clone2);
+    xacml_request_delete(equivalent);
+}
+
+int main(void) {
+    test_template();
+    return check_summary();
+}
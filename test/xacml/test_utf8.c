@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) Members of the EGEE Collaboration. 2006-2010.
+ * See http://www.eu-egee.org/partners/ for details on the copyright holders.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * $Id$
+ */
+
+/*
+ * Tests of the UTF-8 multi-byte strings (lead bytes 0xC0 to 0xF4) of a PEPd
+ * response through the full, lazy and streaming (decision-only) decoders.
+ * The effective request of the response contains UTF-8 strings, skipped by
+ * the lazy and streaming decoders, which must keep the decoding in sync.
+ *
+ * usage: test_utf8
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* internal headers, from ../../src */
+#include "buffer.h"
+#include "hessian.h"
+#include "io.h"
+
+#include "test_common.h"
+
+/* 2, 3 and 4 bytes sequences, with the lead bytes 0xC3, 0xD0, 0xD1, 0xDF, 0xE0, 0xE2, 0xEF, 0xF0 and 0xF4 */
+static const char UTF8_VALUE[]= "caf\xC3\xA9 \xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xDF\xBF \xE0\xA0\x80 \xE2\x82\xAC \xEF\xBF\xBD \xF0\x9F\x98\x80 \xF4\x8F\xBF\xBF end";
+static const char UTF8_MESSAGE[]= "\xD0\x9E\xD0\x9A \xE2\x9C\x93";
+static const char OBLIGATION_ID[]= "urn:test:obligation";
+static const char ASSIGNMENT_ID[]= "urn:test:assignment";
+static const char MODEL[]= "org.glite.authz.common.model.";
+
+static void put_string(const char * str, pep_buffer_t * output) {
+    hessian_object_t * h_string= hessian_create(HESSIAN_STRING,str);
+    hessian_serialize(h_string,output);
+    hessian_delete(h_string);
+}
+
+static void put_integer(int32_t value, pep_buffer_t * output) {
+    hessian_object_t * h_integer= hessian_create(HESSIAN_INTEGER,value);
+    hessian_serialize(h_integer,output);
+    hessian_delete(h_integer);
+}
+
+/* starts a typed map of the model class */
+static void put_map(const char * classname, pep_buffer_t * output) {
+    size_t type_l= strlen(MODEL) + strlen(classname);
+    pep_buffer_putc('M',output);
+    pep_buffer_putc('t',output);
+    pep_buffer_putc((int)(type_l >> 8),output);
+    pep_buffer_putc((int)(type_l & 0xFF),output);
+    pep_buffer_write(MODEL,sizeof(char),strlen(MODEL),output);
+    pep_buffer_write(classname,sizeof(char),strlen(classname),output);
+}
+
+/* starts a list of one element */
+static void put_list1(pep_buffer_t * output) {
+    pep_buffer_putc('V',output);
+    pep_buffer_putc('l',output);
+    pep_buffer_putc(0,output);
+    pep_buffer_putc(0,output);
+    pep_buffer_putc(0,output);
+    pep_buffer_putc(1,output);
+}
+
+/* writes the Hessian bytes of a PERMIT response echoing the request, as sent by the PEPd */
+static int put_response(const xacml_request_t * request, pep_buffer_t * output) {
+    put_map("Response",output);
+    put_string("request",output);
+    if (xacml_request_marshalling(request,output) != PEP_OK) return -1;
+    put_string("results",output);
+    put_list1(output);
+    put_map("Result",output);
+    put_string("decision",output); put_integer(XACML_DECISION_PERMIT,output);
+    put_string("resourceId",output); pep_buffer_putc('N',output);
+    put_string("status",output);
+    put_map("Status",output);
+    put_string("message",output); put_string(UTF8_MESSAGE,output);
+    put_string("statusCode",output);
+    put_map("StatusCode",output);
+    put_string("code",output); put_string(XACML_STATUSCODE_OK,output);
+    put_string("subCode",output); pep_buffer_putc('N',output);
+    pep_buffer_putc('z',output); /* StatusCode */
+    pep_buffer_putc('z',output); /* Status */
+    put_string("obligations",output);
+    put_list1(output);
+    put_map("Obligation",output);
+    put_string("id",output); put_string(OBLIGATION_ID,output);
+    put_string("fulfillOn",output); put_integer(XACML_FULFILLON_PERMIT,output);
+    put_string("attributeAssignments",output);
+    put_list1(output);
+    put_map("AttributeAssignment",output);
+    put_string("attributeId",output); put_string(ASSIGNMENT_ID,output);
+    put_string("dataType",output); put_string(XACML_DATATYPE_STRING,output);
+    put_string("value",output); put_string(UTF8_VALUE,output);
+    pep_buffer_putc('z',output); /* AttributeAssignment */
+    pep_buffer_putc('z',output); /* attributeAssignments */
+    pep_buffer_putc('z',output); /* Obligation */
+    pep_buffer_putc('z',output); /* obligations */
+    pep_buffer_putc('z',output); /* Result */
+    pep_buffer_putc('z',output); /* results */
+    pep_buffer_putc('z',output); /* Response */
+    return 0;
+}
+
+static xacml_request_t * create_utf8_request(void) {
+    xacml_request_t * request= xacml_request_create();
+    xacml_subject_t * subject= xacml_subject_create();
+    xacml_attribute_t * attr= xacml_attribute_create(XACML_SUBJECT_ID);
+    xacml_attribute_addvalue(attr,UTF8_VALUE);
+    xacml_attribute_addvalue(attr,UTF8_MESSAGE);
+    xacml_subject_addattribute(subject,attr);
+    xacml_request_addsubject(request,subject);
+    return request;
+}
+
+/* checks the decoded response, and its effective request */
+static void check_response(const xacml_response_t * response, const char * decoder) {
+    char what[128];
+    xacml_result_t * result= xacml_response_getresult(response,0);
+    xacml_obligation_t * obligation= xacml_result_getobligation(result,0);
+    xacml_request_t * request= xacml_response_getrequest(response);
+    xacml_attribute_t * attr;
+    snprintf(what,sizeof(what),"%s decoder: status message",decoder);
+    check(strcmp(xacml_status_getmessage(xacml_result_getstatus(result)),UTF8_MESSAGE) == 0,what);
+    snprintf(what,sizeof(what),"%s decoder: obligation attribute assignment value",decoder);
+    check(obligation != NULL && strcmp(xacml_attributeassignment_getvalue(xacml_obligation_getattributeassignment(obligation,0)),UTF8_VALUE) == 0,what);
+    attr= (request != NULL) ? xacml_subject_getattribute(xacml_request_getsubject(request,0),0) : NULL;
+    snprintf(what,sizeof(what),"%s decoder: request attribute values",decoder);
+    check(attr != NULL && strcmp(xacml_attribute_getvalue(attr,0),UTF8_VALUE) == 0 && strcmp(xacml_attribute_getvalue(attr,1),UTF8_MESSAGE) == 0,what);
+}
+
+/* streaming decoder callbacks */
+typedef struct decoded {
+    int results;
+    xacml_decision_t decision;
+    int statuscode_ok;
+    int value_ok;
+} decoded_t;
+
+static int decoded_result(void * arg, int result_idx, xacml_decision_t decision, const char * statuscode) {
+    decoded_t * decoded= arg;
+    decoded->results++;
+    decoded->decision= decision;
+    decoded->statuscode_ok= (statuscode != NULL && strcmp(statuscode,XACML_STATUSCODE_OK) == 0);
+    return 0;
+}
+
+static int decoded_wants(void * arg, int result_idx, const char * obligationid) {
+    return strcmp(obligationid,OBLIGATION_ID) == 0;
+}
+
+static int decoded_obligation(void * arg, int result_idx, xacml_obligation_t * obligation) {
+    decoded_t * decoded= arg;
+    const char * value= xacml_attributeassignment_getvalue(xacml_obligation_getattributeassignment(obligation,0));
+    decoded->value_ok= (value != NULL && strcmp(value,UTF8_VALUE) == 0);
+    xacml_obligation_delete(obligation);
+    return 0;
+}
+
+int main(void) {
+    xacml_request_t * request= create_utf8_request();
+    xacml_response_t * response;
+    pep_buffer_t * buffer= pep_buffer_create(1024);
+    hessian_object_t * h_string;
+    xacml_decision_handler_t handler;
+    decoded_t decoded;
+    size_t length;
+
+    /* Hessian string: serialization, skip and full decoding */
+    h_string= hessian_create(HESSIAN_STRING,UTF8_VALUE);
+    check(hessian_string_utf8_length(h_string) == 27,"UTF-8 length of the string");
+    hessian_serialize(h_string,buffer);
+    hessian_delete(h_string);
+    length= pep_buffer_length(buffer);
+    check(hessian_skip(buffer) == HESSIAN_OK && pep_buffer_length(buffer) == 0,"skip the serialized string");
+    pep_buffer_seek(buffer,0);
+    check(pep_buffer_length(buffer) == length,"rewind the serialized string");
+    h_string= hessian_deserialize(buffer);
+    check(h_string != NULL && strcmp(hessian_string_getstring(h_string),UTF8_VALUE) == 0,"deserialize the string");
+    hessian_delete(h_string);
+    pep_buffer_delete(buffer);
+
+    /* full decoder */
+    buffer= pep_buffer_create(1024);
+    check(put_response(request,buffer) == 0,"write the response");
+    response= NULL;
+    check(xacml_response_unmarshalling(&response,buffer) == PEP_OK && response != NULL,"full decoder: unmarshal the response");
+    if (response != NULL) check_response(response,"full");
+    xacml_response_delete(response);
+    pep_buffer_delete(buffer);
+
+    /* lazy decoder, the request is skipped and decoded on demand */
+    buffer= pep_buffer_create(1024);
+    put_response(request,buffer);
+    response= NULL;
+    check(xacml_response_lazy_unmarshalling(&response,buffer) == PEP_OK && response != NULL,"lazy decoder: unmarshal the response");
+    if (response != NULL) check_response(response,"lazy");
+    xacml_response_delete(response);
+    pep_buffer_delete(buffer);
+
+    /* streaming decoder, the request is skipped */
+    buffer= pep_buffer_create(1024);
+    put_response(request,buffer);
+    memset(&decoded,0,sizeof(decoded));
+    handler.result= decoded_result;
+    handler.wants= decoded_wants;
+    handler.obligation= decoded_obligation;
+    handler.arg= &decoded;
+    check(xacml_response_decision_unmarshalling(buffer,&handler) == PEP_OK,"streaming decoder: decode the response");
+    check(decoded.results == 1 && decoded.decision == XACML_DECISION_PERMIT,"streaming decoder: decision");
+    check(decoded.statuscode_ok,"streaming decoder: status code");
+    check(decoded.value_ok,"streaming decoder: obligation attribute assignment value");
+    pep_buffer_delete(buffer);
+
+    xacml_request_delete(request);
+    return check_summary();
+}